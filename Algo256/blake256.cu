@@ -11,11 +11,15 @@
 
 extern "C" {
 #include "sph/sph_blake.h"
+#include "sph/sph_midstate.h"
 }
 
 /* threads per block */
 #define TPB 512
 
+// one snapshot per rounds count (blake and blakecoin)
+static __thread sph_midstate80 s_midstate[2];
+
 /* hash by cpu with blake 256 */
 extern "C" void blake256hash(void *output, const void *input, int8_t rounds = 14)
 {
@@ -24,8 +28,7 @@ extern "C" void blake256hash(void *output, const void *input, int8_t rounds = 14
 
 	sph_blake256_set_rounds(rounds);
 
-	sph_blake256_init(&ctx);
-	sph_blake256(&ctx, input, 80);
+	SPH_MIDSTATE80(&s_midstate[rounds == 8], blake256, &ctx, input);
 	sph_blake256_close(&ctx, hash);
 
 	memcpy(output, hash, 32);
@@ -4,6 +4,7 @@
  */
 extern "C" {
 #include "sph/sph_bmw.h"
+#include "sph/sph_midstate.h"
 }
 
 #include <miner.h>
@@ -18,14 +19,15 @@ extern void bmw256_cpu_hash_80(int thr_id, uint32_t threads, uint32_t startNounc
 
 extern uint32_t cuda_check_hash_32(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *d_inputHash);
 
+static __thread sph_midstate80 s_midstate;
+
 // CPU Hash
 extern "C" void bmw_hash(void *state, const void *input)
 {
 	uint32_t _ALIGN(64) hash[16];
 	sph_bmw256_context ctx;
 
-	sph_bmw256_init(&ctx);
-	sph_bmw256(&ctx, input, 80);
+	SPH_MIDSTATE80(&s_midstate, bmw256, &ctx, input);
 	sph_bmw256_close(&ctx, (void*) hash);
 
 	memcpy(state, hash, 32);
@@ -8,6 +8,7 @@ extern "C"
 #include "sph/sph_shavite.h"
 #include "sph/sph_simd.h"
 #include "sph/sph_keccak.h"
+#include "sph/sph_midstate.h"
 
 #include "miner.h"
 }
@@ -27,14 +28,15 @@ extern void keccak256_sm3_free(int thr_id);
 extern void keccak256_sm3_setBlock_80(void *pdata, const void *ptarget);
 extern void keccak256_sm3_hash_80(int thr_id, uint32_t threads, uint32_t startNonce, uint32_t* resNonces, int order);
 
+static __thread sph_midstate80 s_midstate;
+
 // CPU Hash
 extern "C" void keccak256_hash(void *state, const void *input)
 {
 	uint32_t _ALIGN(64) hash[16];
 	sph_keccak_context ctx_keccak;
 
-	sph_keccak256_init(&ctx_keccak);
-	sph_keccak256 (&ctx_keccak, input, 80);
+	SPH_MIDSTATE80(&s_midstate, keccak256, &ctx_keccak, input);
 	sph_keccak256_close(&ctx_keccak, (void*) hash);
 
 	memcpy(state, hash, 32);
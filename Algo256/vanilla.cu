@@ -19,6 +19,7 @@
 
 extern "C" {
 #include "sph/sph_blake.h"
+#include "sph/sph_midstate.h"
 }
 
 #include "cuda_helper.h"
@@ -39,6 +40,9 @@ static uint32_t		*d_resNonce[MAX_GPUS];
 static uint32_t		*h_resNonce[MAX_GPUS];
 static cudaStream_t	streams[MAX_GPUS];
 
+// one snapshot per rounds count
+static __thread sph_midstate80 s_midstate[2];
+
 /* hash by cpu with blake 256 */
 extern "C" void vanillahash(void *output, const void *input, int8_t blakerounds){
 	uchar hash[64];
@@ -46,8 +50,7 @@ extern "C" void vanillahash(void *output, const void *input, int8_t blakerounds)
 
 	sph_blake256_set_rounds(blakerounds);
 
-	sph_blake256_init(&ctx);
-	sph_blake256(&ctx, input, 80);
+	SPH_MIDSTATE80(&s_midstate[blakerounds == 8], blake256, &ctx, input);
 	sph_blake256_close(&ctx, hash);
 
 	memcpy(output, hash, 32);
@@ -5,6 +5,7 @@ extern "C"
 #include "sph/sph_groestl.h"
 #include "sph/sph_jh.h"
 #include "sph/sph_skein.h"
+#include "sph/sph_midstate.h"
 }
 
 #include "miner.h"
@@ -30,6 +31,8 @@ extern void jackpot_compactTest_cpu_hash_64(int thr_id, uint32_t threads, uint32
 
 extern uint32_t cuda_check_hash_branch(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_inputHash, int order);
 
+static __thread sph_midstate80 s_midstate;
+
 // CPU HASH JHA v8
 extern "C" void jackpothash(void *state, const void *input)
 {
@@ -42,8 +45,7 @@ extern "C" void jackpothash(void *state, const void *input)
 	sph_keccak512_context    ctx_keccak;
 	sph_skein512_context     ctx_skein;
 
-	sph_keccak512_init(&ctx_keccak);
-	sph_keccak512 (&ctx_keccak, input, 80);
+	SPH_MIDSTATE80(&s_midstate, keccak512, &ctx_keccak, input);
 	sph_keccak512_close(&ctx_keccak, hash);
 
 	for (rnd = 0; rnd < 3; rnd++)
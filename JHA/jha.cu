@@ -9,6 +9,7 @@ extern "C" {
 #include "sph/sph_groestl.h"
 #include "sph/sph_jh.h"
 #include "sph/sph_skein.h"
+#include "sph/sph_midstate.h"
 }
 
 #include "miner.h"
@@ -23,6 +24,8 @@ extern void jackpot_keccak512_cpu_init(int thr_id, uint32_t threads);
 extern void jackpot_keccak512_cpu_setBlock(void *pdata, size_t inlen);
 extern void jackpot_keccak512_cpu_hash(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *d_hash, int order);
 
+static __thread sph_midstate80 s_midstate;
+
 // CPU HASH
 extern "C" void jha_hash(void *output, const void *input)
 {
@@ -34,8 +37,7 @@ extern "C" void jha_hash(void *output, const void *input)
 	sph_keccak512_context    ctx_keccak;
 	sph_skein512_context     ctx_skein;
 
-	sph_keccak512_init(&ctx_keccak);
-	sph_keccak512 (&ctx_keccak, input, 80);
+	SPH_MIDSTATE80(&s_midstate, keccak512, &ctx_keccak, input);
 	sph_keccak512_close(&ctx_keccak, hash);
 
 	for (int rnd = 0; rnd < 3; rnd++)
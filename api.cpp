@@ -120,6 +120,7 @@ static void gpustatus(int thr_id)
 	if (thr_id >= 0 && thr_id < opt_n_threads) {
 		struct cgpu_info *cgpu = &thr_info[thr_id].gpu;
 		double khashes_per_watt = 0;
+		double khashes_ewma;
 		int gpuid = cgpu->gpu_id;
 		char buf[512]; *buf = '\0';
 		char* card;
@@ -137,6 +138,7 @@ static void gpustatus(int thr_id)
 		cgpu->gpu_plimit = gpu_plimit(cgpu); // mW or %
 #endif
 		cgpu->khashes = stats_get_speed(thr_id, 0.0) / 1000.0;
+		khashes_ewma = stats_get_speed_ewma(thr_id, 0.0) / 1000.0;
 		if (cgpu->monitor.gpu_power) {
 			cgpu->gpu_power = cgpu->monitor.gpu_power;
 			khashes_per_watt = (double)cgpu->khashes / cgpu->monitor.gpu_power;
@@ -150,14 +152,14 @@ static void gpustatus(int thr_id)
 			"POWER=%u;FAN=%hu;RPM=%hu;"
 			"FREQ=%u;MEMFREQ=%u;GPUF=%u;MEMF=%u;"
 			"KHS=%.2f;KHW=%.5f;PLIM=%u;"
-			"ACC=%u;REJ=%u;HWF=%u;I=%.1f;THR=%u|",
+			"ACC=%u;REJ=%u;HWF=%u;I=%.1f;THR=%u;EWMA=%.2f|",
 			gpuid, cgpu->gpu_bus, card, cgpu->gpu_temp,
 			cgpu->gpu_power, cgpu->gpu_fan, cgpu->gpu_fan_rpm,
 			cgpu->gpu_clock/1000, cgpu->gpu_memclock/1000, // base freqs in MHz
 			cgpu->monitor.gpu_clock, cgpu->monitor.gpu_memclock, // current
 			cgpu->khashes, khashes_per_watt, cgpu->gpu_plimit,
 			cgpu->accepted, (unsigned) cgpu->rejected, (unsigned) cgpu->hw_errors,
-			cgpu->intensity, cgpu->throughput);
+			cgpu->intensity, cgpu->throughput, khashes_ewma);
 
 		// append to buffer for multi gpus
 		strcat(buffer, buf);
@@ -43,6 +43,7 @@ function translateField($key)
 	$intl['GPUS'] = 'GPUs';
 	$intl['CPUS'] = 'Threads';
 	$intl['KHS'] = 'Hash rate';
+	$intl['EWMA'] = 'Hash rate (ewma)';
 	$intl['ACC'] = 'Accepted shares';
 	$intl['ACCMN'] = 'Accepted / mn';
 	$intl['REJ'] = 'Rejected';
@@ -117,6 +118,9 @@ function translateValue($key,$val,$data=array())
 		case 'TS':
 			$val = strftime("%H:%M:%S", (int) $val);
 			break;
+		case 'EWMA':
+			$val = $val.' kH/s';
+			break;
 		case 'KHS':
 		case 'NETKHS':
 			$val = '<span class="bold">'.$val.'</span> kH/s';
@@ -235,6 +235,7 @@ bool bench_algo_switch_next(int thr_id)
 	opt_algo = (enum sha_algos) algo;
 	global_hashrate = 0;
 	thr_hashrates[thr_id] = 0; // reset for minmax64
+	scan_window_reset(thr_id);
 	pthread_mutex_unlock(&bench_lock);
 
 	if (need_reset)
@@ -118,6 +118,7 @@ static json_t *opt_config;
 static const bool opt_time = true;
 volatile enum sha_algos opt_algo = ALGO_AUTO;
 int opt_n_threads = 0;
+int opt_cpu_threads = 0;
 int gpu_threads = 1;
 int64_t opt_affinity = -1L;
 int opt_priority = 0;
@@ -131,6 +132,7 @@ bool need_nvsettings = false;
 bool need_memclockrst = false;
 char * device_name[MAX_GPUS];
 short device_map[MAX_GPUS] = { 0 };
+uint8_t device_type[MAX_GPUS] = { 0 };
 long  device_sm[MAX_GPUS] = { 0 };
 short device_mpcount[MAX_GPUS] = { 0 };
 uint32_t gpus_intensity[MAX_GPUS] = { 0 };
@@ -316,6 +318,7 @@ Options:\n\
                         Device IDs start counting from 0! Alternatively takes\n\
                         string names of your cards like gtx780ti or gt640#2\n\
                         (matching 2nd gt640 in the PC)\n\
+                        cpu adds a host cpu device (scrypt-jane, equihash)\n\
   -i  --intensity=N[,N] GPU intensity 8.0-25.0 (default: auto) \n\
                         Decimals are allowed for fine tuning \n\
       --cuda-schedule   Set device threads scheduling mode (default: auto)\n\
@@ -336,6 +339,8 @@ Options:\n\
   -T, --timeout=N       network timeout, in seconds (default: 300)\n\
   -s, --scantime=N      upper bound on time spent scanning current work when\n\
                           long polling is unavailable, in seconds (default: 10)\n\
+      --scan-target=N   seconds of each scan, at the measured device rate (default: 5)\n\
+      --scan-state=FILE save the learned scan windows at exit, reloaded on start\n\
       --submit-stale    ignore stale jobs checks, may create more rejected shares\n\
   -n, --ndevs           list cuda devices\n\
   -N, --statsavg        number of samples used to compute hashrate (default: 30)\n\
@@ -349,6 +354,9 @@ Options:\n\
   -P, --protocol-dump   verbose dump of protocol-level activities\n\
       --cpu-affinity    set process affinity to cpu core(s), mask 0x3 for cores 0 and 1\n\
       --cpu-priority    set process priority (default: 3) 0 idle, 2 normal to 5 highest\n\
+      --cpu-threads=N   number of workers of the cpu device (default: free cores)\n\
+      --verify-threads=N cpu threads checking the gpu nonces in background (default: 0, inline)\n\
+      --verify-queue=N  max nonces waiting for the verify threads (default: 64)\n\
   -b, --api-bind=port   IP:port for the miner API (default: 127.0.0.1:4068), 0 disabled\n\
       --api-remote      Allow remote control, like pool switching, imply --api-allow=0/0\n\
       --api-allow=...   IP/mask of the allowed api client(s), 0/0 for all\n\
@@ -382,6 +390,16 @@ Options:\n\
   -B, --background      run the miner in the background\n\
       --benchmark       run in offline benchmark mode\n\
       --cputest         debug hashes from cpu algorithms\n\
+      --cpu-bench[=ALGOS] time the cpu hashes (all or a comma list), then exit\n\
+      --cpu-bench-runs=N  timed runs of each hash (default: 10)\n\
+      --cpu-bench-json=FILE write the cpu benchmark results in json\n\
+      --sim-pool[=MS]   mine on a local simulated stratum pool, new job every MS\n\
+      --sim-pool-branches=N merkle branches of the simulated jobs (default: 12)\n\
+      --sim-pool-diff=N stratum difficulty of the simulated pool (default: 1)\n\
+      --sim-devices=N   use N virtual devices instead of the cuda ones\n\
+      --sim-rate=N[KMG] hashrate of each virtual device (default: 100M)\n\
+      --sim-share-prob=P probability of a candidate nonce per hash (default: target)\n\
+      --sim-verify      check the virtual devices nonces with the cpu hash\n\
   -c, --config=FILE     load a JSON-format configuration file\n\
   -V, --version         display version information and exit\n\
   -h, --help            display this help text and exit\n\
@@ -409,8 +427,23 @@ struct option options[] = {
 	{ "cert", 1, NULL, 1001 },
 	{ "config", 1, NULL, 'c' },
 	{ "cputest", 0, NULL, 1006 },
+	{ "cpu-bench", 2, NULL, 1090 },
+	{ "cpu-bench-runs", 1, NULL, 1091 },
+	{ "cpu-bench-json", 1, NULL, 1092 },
+	{ "sim-pool", 2, NULL, 1093 },
+	{ "sim-pool-branches", 1, NULL, 1094 },
+	{ "sim-pool-diff", 1, NULL, 1095 },
+	{ "sim-devices", 1, NULL, 1096 },
+	{ "sim-rate", 1, NULL, 1097 },
+	{ "sim-share-prob", 1, NULL, 1098 },
+	{ "sim-verify", 0, NULL, 1099 },
 	{ "cpu-affinity", 1, NULL, 1020 },
 	{ "cpu-priority", 1, NULL, 1021 },
+	{ "cpu-threads", 1, NULL, 1024 },
+	{ "verify-threads", 1, NULL, 1081 },
+	{ "verify-queue", 1, NULL, 1082 },
+	{ "scan-target", 1, NULL, 1083 },
+	{ "scan-state", 1, NULL, 1084 },
 	{ "cuda-schedule", 1, NULL, 1025 },
 	{ "debug", 0, NULL, 'D' },
 	{ "help", 0, NULL, 'h' },
@@ -517,6 +550,18 @@ Boolberry specific options:\n\
 struct work _ALIGN(64) g_work;
 volatile time_t g_work_time;
 pthread_mutex_t g_work_lock;
+// bumped on each g_work update, lets the miner threads skip the lock
+volatile uint32_t g_work_gen = 0;
+
+// to call with g_work_lock held, after g_work was modified
+void g_work_changed()
+{
+#ifdef _MSC_VER
+	InterlockedIncrement((volatile LONG*) &g_work_gen);
+#else
+	__sync_fetch_and_add(&g_work_gen, 1);
+#endif
+}
 
 // get const array size (defined in ccminer.cpp)
 int options_count()
@@ -607,13 +652,23 @@ void proper_exit(int reason)
 		return;
 
 	abort_flag = true;
+	if (opt_verify_threads)
+		verify_pool_stop();
 	usleep(200 * 1000);
-	cuda_shutdown();
+	if (!opt_sim_devices)
+		cuda_shutdown();
 
 	if (reason == EXIT_CODE_OK && app_exit_code != EXIT_CODE_OK) {
 		reason = app_exit_code;
 	}
 
+	if (opt_sim_pool)
+		sim_pool_report();
+	if (opt_verify_threads)
+		verify_pool_report();
+	nonce_lease_report();
+	scan_window_save();
+
 	pthread_mutex_lock(&stats_lock);
 	if (check_dups)
 		hashlog_purge_all();
@@ -815,11 +870,12 @@ static bool work_decode(const json_t *val, struct work *work)
 	// for api stats, on longpoll pools
 	stratum_diff = work->targetdiff;
 
-	work->tx_count = use_pok = 0;
+	work_free(work);
+	use_pok = 0;
 	if (opt_algo == ALGO_ZR5 && work->data[0] & POK_BOOL_MASK) {
 		use_pok = 1;
 		json_t *txs = json_object_get(val, "txs");
-		if (txs && json_is_array(txs)) {
+		if (txs && json_is_array(txs) && (work->txs = work_txs_alloc()) != NULL) {
 			size_t idx, totlen = 0;
 			json_t *p;
 
@@ -833,11 +889,11 @@ static bool work_decode(const json_t *val, struct work *work)
 					use_pok = 0;
 					if (opt_debug) applog(LOG_WARNING,
 						"pok: large block ignored, tx len: %u", txlen);
-					work->tx_count = 0;
+					work_free(work);
 					break;
 				}
-				hex2bin((uchar*)work->txs[tx].data, hexstr, min(txlen, POK_MAX_TX_SZ));
-				work->txs[tx].len = (uint32_t) (txlen);
+				hex2bin((uchar*)work->txs->tx[tx].data, hexstr, min(txlen, POK_MAX_TX_SZ));
+				work->txs->tx[tx].len = (uint32_t) (txlen);
 				totlen += txlen;
 			}
 			if (opt_debug)
@@ -890,11 +946,9 @@ int share_result(int result, int pooln, double sharediff, const char *reason)
 	double hashrate = 0.;
 	struct pool_infos *p = &pools[pooln];
 
-	pthread_mutex_lock(&stats_lock);
 	for (int i = 0; i < opt_n_threads; i++) {
 		hashrate += stats_get_speed(i, thr_hashrates[i]);
 	}
-	pthread_mutex_unlock(&stats_lock);
 
 	result ? p->accepted_count++ : p->rejected_count++;
 
@@ -1266,6 +1320,7 @@ static bool gbt_work_decode(const json_t *val, struct work *work)
 						algo_names[opt_algo], work->height);
 				}
 				g_work.height = work->height;
+				g_work_changed();
 			}
 		}
 	}
@@ -1423,6 +1478,8 @@ static void workio_cmd_free(struct workio_cmd *wc)
 
 	switch (wc->cmd) {
 	case WC_SUBMIT_WORK:
+		if (wc->u.work)
+			work_free(wc->u.work);
 		aligned_free(wc->u.work);
 		break;
 	default: /* do nothing */
@@ -1468,6 +1525,7 @@ static bool workio_get_work(struct workio_cmd *wc, CURL *curl)
 
 		if (unlikely(ret_work->pooln != cur_pooln)) {
 			applog(LOG_ERR, "get_work json_rpc_call failed");
+			work_free(ret_work);
 			aligned_free(ret_work);
 			tq_push(wc->thr->q, NULL);
 			return true;
@@ -1475,6 +1533,7 @@ static bool workio_get_work(struct workio_cmd *wc, CURL *curl)
 
 		if (unlikely((opt_retries >= 0) && (++failures > opt_retries))) {
 			applog(LOG_ERR, "get_work json_rpc_call failed");
+			work_free(ret_work);
 			aligned_free(ret_work);
 			return false;
 		}
@@ -1486,8 +1545,10 @@ static bool workio_get_work(struct workio_cmd *wc, CURL *curl)
 	}
 
 	/* send work to requesting thread */
-	if (!tq_push(wc->thr->q, ret_work))
+	if (!tq_push(wc->thr->q, ret_work)) {
+		work_free(ret_work);
 		aligned_free(ret_work);
+	}
 
 	return true;
 }
@@ -1616,7 +1677,8 @@ bool get_work(struct thr_info *thr, struct work *work)
 	if (!work_heap)
 		return false;
 
-	/* copy returned work into storage provided by caller */
+	/* move returned work into storage provided by caller */
+	work_free(work);
 	memcpy(work, work_heap, sizeof(*work));
 	aligned_free(work_heap);
 
@@ -1637,7 +1699,7 @@ static bool submit_work(struct thr_info *thr, const struct work *work_in)
 
 	wc->cmd = WC_SUBMIT_WORK;
 	wc->thr = thr;
-	memcpy(wc->u.work, work_in, sizeof(struct work));
+	work_copy(wc->u.work, work_in);
 	wc->pooln = work_in->pooln;
 
 	/* send solution to workio thread */
@@ -1651,9 +1713,78 @@ err_out:
 	return false;
 }
 
+/* valid nonce of the verify threads, like the miner thread submit */
+static bool verified_nonce_submit(int thr_id, struct work *work)
+{
+	struct thr_info *thr = &thr_info[thr_id];
+
+	gpu_increment_accept(thr_id, work->valid_nonces);
+	if (opt_benchmark)
+		return true;
+
+	if (opt_led_mode == LED_MODE_SHARES)
+		gpu_led_percent(device_map[thr_id], 50);
+
+	if (!submit_work(thr, work))
+		return false;
+
+	// solo, we can't submit twice a block
+	if (!have_stratum && !have_longpoll) {
+		pthread_mutex_lock(&g_work_lock);
+		g_work_time = 0;
+		pthread_mutex_unlock(&g_work_lock);
+		work_restart[thr_id].restart = 1;
+	}
+	return true;
+}
+
+/* share target of a stratum difficulty, the pools scale it per algo */
+void stratum_set_target(struct work *work, double diff)
+{
+	switch (opt_algo) {
+		case ALGO_HMQ1725:
+		case ALGO_JACKPOT:
+		case ALGO_JHA:
+		case ALGO_NEOSCRYPT:
+		case ALGO_SCRYPT:
+		case ALGO_SCRYPT_JANE:
+			work_set_target(work, diff / 65536.0);
+			break;
+		case ALGO_ALLIUM:
+		case ALGO_DMD_GR:
+		case ALGO_FRESH:
+		case ALGO_FUGUE256:
+		case ALGO_GROESTL:
+		case ALGO_KECCAKC:
+		case ALGO_LBRY:
+		case ALGO_LYRA2v2:
+		case ALGO_LYRA2v3:
+		case ALGO_LYRA2Z:
+		case ALGO_PHI2:
+		case ALGO_TIMETRAVEL:
+		case ALGO_BITCORE:
+		case ALGO_EXOSIS:
+		case ALGO_X16R:
+		case ALGO_X16S:
+			work_set_target(work, diff / 256.0);
+			break;
+		case ALGO_KECCAK:
+		case ALGO_LYRA2:
+			work_set_target(work, diff / 128.0);
+			break;
+		case ALGO_EQUIHASH:
+			equi_work_set_target(work, diff);
+			break;
+		default:
+			work_set_target(work, diff);
+	}
+}
+
 static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 {
 	uchar merkle_root[64] = { 0 };
+	uint32_t root[8];
+	bool merkle_done = false;
 	int i;
 
 	if (sctx->rpc2)
@@ -1699,10 +1830,17 @@ static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 			break;
 		case ALGO_WHIRLPOOL:
 		default:
-			sha256d(merkle_root, sctx->job.coinbase, (int)sctx->job.coinbase_size);
+			// coinbase tail from the job midstate, then the branches
+			if (!stratum_merkle_roots(sctx, sctx->job.xnonce2, root, 1)) {
+				sha256d(merkle_root, sctx->job.coinbase, (int)sctx->job.coinbase_size);
+				break;
+			}
+			for (i = 0; i < 8; i++)
+				be32enc((uint32_t *)merkle_root + i, root[i]);
+			merkle_done = true;
 	}
 
-	for (i = 0; i < sctx->job.merkle_count; i++) {
+	for (i = 0; i < sctx->job.merkle_count && !merkle_done; i++) {
 		memcpy(merkle_root + 32, sctx->job.merkle[i], 32);
 #ifdef WITH_HEAVY_ALGO
 		if (opt_algo == ALGO_HEAVY || opt_algo == ALGO_MJOLLNIR)
@@ -1823,43 +1961,7 @@ static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 	if (opt_difficulty == 0.)
 		opt_difficulty = 1.;
 
-	switch (opt_algo) {
-		case ALGO_HMQ1725:
-		case ALGO_JACKPOT:
-		case ALGO_JHA:
-		case ALGO_NEOSCRYPT:
-		case ALGO_SCRYPT:
-		case ALGO_SCRYPT_JANE:
-			work_set_target(work, sctx->job.diff / (65536.0 * opt_difficulty));
-			break;
-		case ALGO_ALLIUM:
-		case ALGO_DMD_GR:
-		case ALGO_FRESH:
-		case ALGO_FUGUE256:
-		case ALGO_GROESTL:
-		case ALGO_KECCAKC:
-		case ALGO_LBRY:
-		case ALGO_LYRA2v2:
-		case ALGO_LYRA2v3:
-		case ALGO_LYRA2Z:
-		case ALGO_PHI2:
-		case ALGO_TIMETRAVEL:
-		case ALGO_BITCORE:
-		case ALGO_EXOSIS:
-		case ALGO_X16R:
-		case ALGO_X16S:
-			work_set_target(work, sctx->job.diff / (256.0 * opt_difficulty));
-			break;
-		case ALGO_KECCAK:
-		case ALGO_LYRA2:
-			work_set_target(work, sctx->job.diff / (128.0 * opt_difficulty));
-			break;
-		case ALGO_EQUIHASH:
-			equi_work_set_target(work, sctx->job.diff / opt_difficulty);
-			break;
-		default:
-			work_set_target(work, sctx->job.diff / opt_difficulty);
-	}
+	stratum_set_target(work, sctx->job.diff / opt_difficulty);
 
 	if (stratum_diff != sctx->job.diff) {
 		char sdiff[32] = { 0 };
@@ -1873,6 +1975,77 @@ static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 	return true;
 }
 
+/**
+ * Roll the extranonce2 of a thread stratum work, in its own sub-space:
+ * the 5 high bits are 1 and the thread id (MAX_GPUS 16), the others a
+ * counter of the job, so a 2 bytes extranonce2 still gives 2047 rolls,
+ * while the g_work one is only incremented from the low byte. The merkle
+ * root is computed from the coinbase midstate, the job lock is only held
+ * to read the job, g_work and the other threads are untouched.
+ *
+ * The rolled header is private: its nonce space key is only known by
+ * this thread, so the other threads never lease or steal its ranges.
+ * Sharing and stealing stay on the g_work spaces, a slow device then
+ * scans its rolled space alone, but no other thread waits for it.
+ */
+static uint64_t stratum_roll_count[MAX_GPUS];
+static char stratum_roll_job[MAX_GPUS][128];
+
+static bool stratum_roll_work(struct stratum_ctx *sctx, struct work *work, int thr_id)
+{
+	uint32_t root[8];
+	uchar *xnonce2 = work->xnonce2;
+	int size = (int) work->xnonce2_len;
+	bool rolled = false;
+	int i;
+
+	if (sctx->rpc2 || sctx->is_equihash || size < 2)
+		return false;
+
+	switch (opt_algo) {
+	case ALGO_BLAKECOIN:
+	case ALGO_DECRED:
+	case ALGO_EQUIHASH:
+	case ALGO_FUGUE256:
+	case ALGO_GROESTL:
+	case ALGO_HEAVY:
+	case ALGO_KECCAK:
+	case ALGO_MJOLLNIR:
+	case ALGO_SIA:
+	case ALGO_WHIRLCOIN:
+	case ALGO_ZR5:
+		// not the coinbase midstate merkle of stratum_gen_work
+		return false;
+	default:
+		break;
+	}
+
+	pthread_mutex_lock(&stratum_work_lock);
+	if (sctx->job.job_id && size == (int) sctx->xnonce2_size && !strcmp(work->job_id + 8, sctx->job.job_id)) {
+		uint64_t n;
+		// the counter is kept per job, a work copy can't restart it
+		if (strcmp(stratum_roll_job[thr_id], work->job_id)) {
+			snprintf(stratum_roll_job[thr_id], sizeof(stratum_roll_job[0]), "%s", work->job_id);
+			stratum_roll_count[thr_id] = 0;
+		}
+		n = ++stratum_roll_count[thr_id];
+		if (size > 8 || (n >> (8 * size - 5)) == 0) {
+			memset(xnonce2, 0, size);
+			for (i = 0; i < size && i < 8; i++)
+				xnonce2[i] = (uchar) (n >> (8 * i));
+			xnonce2[size-1] |= (uchar) (0x80 | (thr_id << 3));
+			if (stratum_merkle_roots(sctx, xnonce2, root, 1)) {
+				for (i = 0; i < 8; i++)
+					work->data[9 + i] = root[i];
+				rolled = true;
+			}
+		}
+	}
+	pthread_mutex_unlock(&stratum_work_lock);
+
+	return rolled;
+}
+
 void restart_threads(void)
 {
 	if (opt_debug && !opt_quiet)
@@ -1949,6 +2122,14 @@ static void *miner_thread(void *userdata)
 	time_t tm_rate_log = 0;
 	bool work_done = false;
 	bool extrajob = false;
+	// g_work generation of the current work copy
+	uint32_t work_gen = UINT32_MAX;
+	// algos which can continue an unchanged job without the g_work checks
+	bool fast_resume = !opt_benchmark;
+	// stratum nonces leased from the shared space of the work header
+	const bool lease_algo = nonce_lease_algo();
+	uint32_t space_key = 0;
+	bool lease_end = false;
 	char s[16];
 	int rc = 0;
 
@@ -2001,6 +2182,21 @@ static void *miner_thread(void *userdata)
 		}
 	}
 
+	switch (opt_algo) {
+	case ALGO_CRYPTOLIGHT:
+	case ALGO_CRYPTONIGHT:
+	case ALGO_DECRED:
+	case ALGO_EQUIHASH:
+	case ALGO_SIA:
+	case ALGO_WILDKECCAK:
+	case ALGO_ZR5:
+		// these change more than the nonce on each loop
+		fast_resume = false;
+		break;
+	default:
+		break;
+	}
+
 	gpu_led_off(dev_id);
 
 	while (!abort_flag) {
@@ -2008,9 +2204,11 @@ static void *miner_thread(void *userdata)
 		unsigned long hashes_done;
 		uint32_t start_nonce;
 		uint32_t scan_time = have_longpoll ? LP_SCANTIME : opt_scantime;
-		uint64_t max64, minmax = 0x100000;
+		uint64_t max64;
 		int nodata_check_oft = 0;
 		bool regen = false;
+		bool getwork = false;
+		uint32_t secs = 0;
 
 		// &work.data[19]
 		int wcmplen = (opt_algo == ALGO_DECRED) ? 140 : 76;
@@ -2024,6 +2222,7 @@ static void *miner_thread(void *userdata)
 
 		uint32_t *nonceptr = (uint32_t*) (((char*)work.data) + wcmplen);
 		int nVersion = swab32(work.data[0]);
+		bool leased = lease_algo && have_stratum;
 
 	    if (opt_debug)
 	    {
@@ -2052,47 +2251,61 @@ static void *miner_thread(void *userdata)
 		}
 
 		if (have_stratum) {
-			uint32_t sleeptime = 0;
-
 			if (opt_algo == ALGO_DECRED || opt_algo == ALGO_WILDKECCAK /* getjob */)
 				work_done = true; // force "regen" hash
-			while (!work_done && time(NULL) >= (g_work_time + opt_scantime)) {
-				usleep(100*1000);
-				if (sleeptime > 4) {
-					extrajob = true;
-					break;
-				}
-				sleeptime++;
-			}
-			if (sleeptime && opt_debug && !opt_quiet)
-				applog(LOG_DEBUG, "sleeptime: %u ms", sleeptime*100);
+			// no new job during scantime, a new extranonce2 without waiting
+			if (!leased && time(NULL) >= (g_work_time + opt_scantime))
+				extrajob = true;
 			//nonceptr = (uint32_t*) (((char*)work.data) + wcmplen);
-			pthread_mutex_lock(&g_work_lock);
 			extrajob |= work_done;
 
-			regen = (nonceptr[0] >= end_nonce);
+			regen = leased ? lease_end : (nonceptr[0] >= end_nonce);
 			if (opt_algo == ALGO_SIA) {
 				regen = ((nonceptr[1] & 0xFF00) >= 0xF000);
 			}
 			regen = regen || extrajob;
 
+			// space ended, roll the thread extranonce2 without the g_work lock
+			if (regen && leased && !extrajob && work_gen == g_work_gen &&
+			    stratum_roll_work(&stratum, &work, thr_id)) {
+				space_key = nonce_lease_key(work.data, wcmplen);
+				lease_end = false;
+				regen = false;
+			}
+		} else {
+			secs = (uint32_t) (time(NULL) - g_work_time);
+			getwork = (secs >= scan_time || nonceptr[0] >= (end_nonce - 0x100));
+		}
+
+		/* same job and nonces left, continue the scan without the lock */
+		if (!regen && !getwork && fast_resume && work_gen == g_work_gen) {
+			nonceptr[0]++;
+			goto scan;
+		}
+
+		pthread_mutex_lock(&g_work_lock);
+		if (have_stratum) {
 			if (regen) {
 				work_done = false;
 				extrajob = false;
-				if (stratum_gen_work(&stratum, &g_work))
-					g_work_time = time(NULL);
+				lease_end = false;
+				// the space can be already rolled by another thread
+				if (!leased || nonce_lease_key(g_work.data, wcmplen) == space_key) {
+					if (stratum_gen_work(&stratum, &g_work))
+						g_work_time = time(NULL);
+					g_work_changed();
+				}
 				if (opt_algo == ALGO_CRYPTONIGHT || opt_algo == ALGO_CRYPTOLIGHT)
 					nonceptr[0] += 0x100000;
 			}
 		} else {
-			uint32_t secs = 0;
-			pthread_mutex_lock(&g_work_lock);
-			secs = (uint32_t) (time(NULL) - g_work_time);
-			if (secs >= scan_time || nonceptr[0] >= (end_nonce - 0x100)) {
+			if (getwork) {
 				if (opt_debug && g_work_time && !opt_quiet)
 					applog(LOG_DEBUG, "work time %u/%us nonce %x/%x", secs, scan_time, nonceptr[0], end_nonce);
 				/* obtain new work from internal workio thread */
-				if (unlikely(!get_work(mythr, &g_work))) {
+				bool got_work = get_work(mythr, &g_work);
+				g_work_changed();
+				if (unlikely(!got_work)) {
 					pthread_mutex_unlock(&g_work_lock);
 					if (switchn != pool_switch_count) {
 						switchn = pool_switch_count;
@@ -2166,14 +2379,14 @@ static void *miner_thread(void *userdata)
 			uint32_t oldpos = nonceptr[0];
 			bool nicehash = strstr(pools[cur_pooln].url, "nicehash") != NULL;
 			if (memcmp(&work.data[wcmpoft], &g_work.data[wcmpoft], wcmplen)) {
-				memcpy(&work, &g_work, sizeof(struct work));
+				work_copy(&work, &g_work);
 				if (!nicehash) nonceptr[0] = (rand()*4) << 24;
 				nonceptr[0] &=  0xFF000000u; // nicehash prefix hack
 				nonceptr[0] |= (0x00FFFFFFu / opt_n_threads) * thr_id;
 			}
 			// also check the end, nonce in the middle
 			else if (memcmp(&work.data[44/4], &g_work.data[0], 76-44)) {
-				memcpy(&work, &g_work, sizeof(struct work));
+				work_copy(&work, &g_work);
 			}
 			if (oldpos & 0xFFFF) {
 				if (!nicehash) nonceptr[0] = oldpos + 0x1000000u;
@@ -2184,6 +2397,10 @@ static void *miner_thread(void *userdata)
 			}
 		}
 
+		else if (leased && !strcmp(work.job_id, g_work.job_id) && nonce_lease_left(thr_id, space_key)) {
+			// same job rolled by another thread, end the lease of this extranonce2 first
+		}
+
 		else if (memcmp(&work.data[wcmpoft], &g_work.data[wcmpoft], wcmplen)) {
 			#if 0
 			if (opt_debug) {
@@ -2197,8 +2414,11 @@ static void *miner_thread(void *userdata)
 			}
 			#endif
 
-			memcpy(&work, &g_work, sizeof(struct work));
+			work_copy(&work, &g_work);
 			nonceptr[0] = (UINT32_MAX / opt_n_threads) * thr_id; // 0 if single thr
+			space_key = nonce_lease_key(work.data, wcmplen);
+			if (opt_sim_pool)
+				sim_pool_job_hashing(work.job_id);
 		    if (opt_debug)
 		    {
 				applog(LOG_DEBUG,
@@ -2247,7 +2467,9 @@ static void *miner_thread(void *userdata)
 			nonceptr[-1] += 1;
 		}
 
+		work_gen = g_work_gen;
 		pthread_mutex_unlock(&g_work_lock);
+scan:
 
 		// --benchmark [-a all]
 		if (opt_benchmark && bench_algo >= 0) {
@@ -2401,103 +2623,37 @@ static void *miner_thread(void *userdata)
 			}
 		}
 
-		max64 *= (uint32_t)thr_hashrates[thr_id];
-
-		/* on start, max64 should not be 0,
-		 *    before hashrate is computed */
-		if (max64 < minmax) {
-			switch (opt_algo) {
-			case ALGO_BLAKECOIN:
-			case ALGO_BLAKE2S:
-			case ALGO_VANILLA:
-				minmax = 0x80000000U;
-				break;
-			case ALGO_BLAKE:
-			case ALGO_BMW:
-			case ALGO_DECRED:
-			case ALGO_SHA256D:
-			case ALGO_SHA256T:
-			case ALGO_SHA256Q:
-			//case ALGO_WHIRLPOOLX:
-				minmax = 0x40000000U;
-				break;
-			case ALGO_BLAKE2B:
-			case ALGO_KECCAK:
-			case ALGO_KECCAKC:
-			case ALGO_LBRY:
-			case ALGO_LUFFA:
-			case ALGO_SIA:
-			case ALGO_SKEIN:
-			case ALGO_SKEIN2:
-			case ALGO_TRIBUS:
-				minmax = 0x1000000;
-				break;
-			case ALGO_ALLIUM:
-			case ALGO_C11:
-			case ALGO_DEEP:
-			case ALGO_HEAVY:
-			case ALGO_JACKPOT:
-			case ALGO_JHA:
-			case ALGO_HSR:
-			case ALGO_LYRA2v2:
-			case ALGO_LYRA2v3:
-			case ALGO_PHI:
-			case ALGO_PHI2:
-			case ALGO_POLYTIMOS:
-			case ALGO_S3:
-			case ALGO_SKUNK:
-			case ALGO_TIMETRAVEL:
-			case ALGO_BITCORE:
-			case ALGO_EXOSIS:
-			case ALGO_X11EVO:
-			case ALGO_X11:
-			case ALGO_X12:
-			case ALGO_X13:
-			case ALGO_WHIRLCOIN:
-			case ALGO_WHIRLPOOL:
-				minmax = 0x400000;
-				break;
-			case ALGO_X14:
-			case ALGO_X15:
-				minmax = 0x300000;
-				break;
-			case ALGO_LYRA2:
-			case ALGO_LYRA2Z:
-			case ALGO_NEOSCRYPT:
-			case ALGO_SIB:
-			case ALGO_SCRYPT:
-			case ALGO_SONOA:
-			case ALGO_VELTOR:
-				minmax = 0x80000;
-				break;
-			case ALGO_CRYPTOLIGHT:
-			case ALGO_CRYPTONIGHT:
-			case ALGO_SCRYPT_JANE:
-				minmax = 0x1000;
-				break;
-			}
-			max64 = max(minmax-1, max64);
-		}
+		/* nonces for the scan target time, learned per device */
+		max64 = scan_window_size(thr_id, cur_pooln, (double) max64);
 
 		// we can't scan more than uint32 capacity
 		max64 = min(UINT32_MAX, max64);
 
-		start_nonce = nonceptr[0];
+		if (leased) {
+			if (!nonce_lease_next(thr_id, space_key, max64, &start_nonce, &max_nonce)) {
+				// all the nonces of this extranonce2 are scanned or in flight
+				lease_end = true;
+				continue;
+			}
+			nonceptr[0] = start_nonce;
+		} else {
+			start_nonce = nonceptr[0];
 
-		/* never let small ranges at end */
-		if (end_nonce >= UINT32_MAX - 256)
-			end_nonce = UINT32_MAX;
+			/* never let small ranges at end */
+			if (end_nonce >= UINT32_MAX - 256)
+				end_nonce = UINT32_MAX;
 
-		if ((max64 + start_nonce) >= end_nonce)
-			max_nonce = end_nonce;
-		else
-			max_nonce = (uint32_t) (max64 + start_nonce);
+			if ((max64 + start_nonce) >= end_nonce)
+				max_nonce = end_nonce;
+			else
+				max_nonce = (uint32_t) (max64 + start_nonce);
 
-		// todo: keep it rounded to a multiple of 256 ?
+			// todo: keep it rounded to a multiple of 256 ?
 
-		if (unlikely(start_nonce > max_nonce)) {
-			// should not happen but seen in skein2 benchmark with 2 gpus
-			max_nonce = end_nonce = UINT32_MAX;
+			if (unlikely(start_nonce > max_nonce)) {
+				// should not happen but seen in skein2 benchmark with 2 gpus
+				max_nonce = end_nonce = UINT32_MAX;
+			}
 		}
 
 		work.scanned_from = start_nonce;
@@ -2524,14 +2680,18 @@ static void *miner_thread(void *userdata)
 		gettimeofday(&tv_start, NULL);
 
 		// check (and reset) previous errors
-		cudaError_t err = cudaGetLastError();
-		if (err != cudaSuccess && !opt_quiet)
-			gpulog(LOG_WARNING, thr_id, "%s", cudaGetErrorString(err));
+		if (device_type[thr_id] == DEVICE_TYPE_CUDA) {
+			cudaError_t err = cudaGetLastError();
+			if (err != cudaSuccess && !opt_quiet)
+				gpulog(LOG_WARNING, thr_id, "%s", cudaGetErrorString(err));
+		}
 
 		work.valid_nonces = 0;
 
 		/* scan nonces for a proof-of-work hash */
-		switch (opt_algo) {
+		if (device_type[thr_id] == DEVICE_TYPE_SIM)
+			rc = scanhash_sim(thr_id, &work, max_nonce, &hashes_done);
+		else switch (opt_algo) {
 
 		case ALGO_ALLIUM:
 			rc = scanhash_allium(thr_id, &work, max_nonce, &hashes_done);
@@ -2671,8 +2831,12 @@ static void *miner_thread(void *userdata)
 				NULL, &tv_start, &tv_end);
 			break;
 		case ALGO_SCRYPT_JANE:
-			rc = scanhash_scrypt_jane(thr_id, &work, max_nonce, &hashes_done,
-				NULL, &tv_start, &tv_end, nVersion);
+			if (device_type[thr_id] == DEVICE_TYPE_CPU)
+				rc = scanhash_scrypt_jane_cpu(thr_id, &work, max_nonce, &hashes_done,
+					&tv_start, &tv_end, nVersion);
+			else
+				rc = scanhash_scrypt_jane(thr_id, &work, max_nonce, &hashes_done,
+					NULL, &tv_start, &tv_end, nVersion);
 			break;
 #endif
 		case ALGO_SKEIN:
@@ -2771,6 +2935,18 @@ static void *miner_thread(void *userdata)
 			goto out;
 		}
 
+		if (leased) {
+			// the cursor is the next nonce to scan, the whole range when ended
+			uint64_t next = (rc == 0 && nonceptr[0] >= max_nonce) ? (uint64_t) max_nonce + 1 : nonceptr[0];
+			// some scanhash leave the cursor on the found nonce, never rescan it
+			for (int n = 0; rc > 0 && n < work.valid_nonces && n < MAX_NONCES; n++)
+				next = max(next, (uint64_t) work.nonces[n] + 1);
+			// the gpu batches overshoot max_nonce, in the leases of the others
+			next = min(next, (uint64_t) max_nonce + 1);
+			next = max(next, (uint64_t) start_nonce);
+			nonce_lease_done(thr_id, space_key, start_nonce, next);
+		}
+
 		if (opt_led_mode == LED_MODE_MINING)
 			gpu_led_off(dev_id);
 
@@ -2826,13 +3002,14 @@ static void *miner_thread(void *userdata)
 
 			/* store thread hashrate */
 			if (dtime > 0.0) {
-				pthread_mutex_lock(&stats_lock);
 				thr_hashrates[thr_id] = hashes_done / dtime;
 				thr_hashrates[thr_id] *= rate_factor;
 				if (loopcnt > 2) // ignore first (init time)
 					stats_remember_speed(thr_id, hashes_done, thr_hashrates[thr_id], (uint8_t) rc, work.height);
-				pthread_mutex_unlock(&stats_lock);
 			}
+			if (rc >= 0)
+				scan_window_update(thr_id, max_nonce - start_nonce, hashes_done, dtime,
+					rc == 0 && !work_restart[thr_id].restart);
 		}
 
 		if (rc > 0)
@@ -2857,17 +3034,16 @@ static void *miner_thread(void *userdata)
 		/* output */
 		if (!opt_quiet && loopcnt > 1 && (time(NULL) - tm_rate_log) > opt_maxlograte) {
 			format_hashrate(thr_hashrates[thr_id], s);
-			gpulog(LOG_INFO, thr_id, "%s, %s", device_name[dev_id], s);
+			gpulog(LOG_INFO, thr_id, "%s, %s",
+				device_type[thr_id] == DEVICE_TYPE_CPU ? "host cpu" : device_name[dev_id], s);
 			tm_rate_log = time(NULL);
 		}
 
 		/* ignore first loop hashrate */
 		if (firstwork_time && thr_id == (opt_n_threads - 1)) {
 			double hashrate = 0.;
-			pthread_mutex_lock(&stats_lock);
 			for (int i = 0; i < opt_n_threads && thr_hashrates[i]; i++)
 				hashrate += stats_get_speed(i, thr_hashrates[i]);
-			pthread_mutex_unlock(&stats_lock);
 			if (opt_benchmark && bench_algo == -1 && loopcnt > 2) {
 				format_hashrate(hashrate, s);
 				applog(LOG_NOTICE, "Total: %s", s);
@@ -2883,7 +3059,7 @@ static void *miner_thread(void *userdata)
 		if (firstwork_time == 0)
 			firstwork_time = time(NULL);
 
-		if (cgpu) cgpu->accepted += work.valid_nonces;
+		gpu_increment_accept(thr_id, work.valid_nonces);
 
 		/* if nonce found, submit work */
 		if (rc > 0 && !opt_benchmark) {
@@ -2929,6 +3105,7 @@ out:
 		gpu_led_off(dev_id);
 	if (opt_debug_threads)
 		applog(LOG_DEBUG, "%s() died", __func__);
+	work_free(&work);
 	tq_freeze(mythr->q);
 	return NULL;
 }
@@ -3015,6 +3192,7 @@ longpoll_retry:
 				if (sia_work_decode(sia_header, &g_work)) {
 					g_work_time = time(NULL);
 				}
+				g_work_changed();
 				free(sia_header);
 				pthread_mutex_unlock(&g_work_lock);
 			}
@@ -3032,6 +3210,7 @@ longpoll_retry:
 			submit_old = soval ? json_is_true(soval) : false;
 			pthread_mutex_lock(&g_work_lock);
 			if (work_decode(json_object_get(val, "result"), &g_work)) {
+				g_work_changed();
 				restart_threads();
 				if (!opt_quiet) {
 					char netinfo[64] = { 0 };
@@ -3085,7 +3264,7 @@ need_reinit:
 	goto wait_lp_url;
 }
 
-static bool stratum_handle_response(char *buf)
+static bool stratum_handle_response(const char *buf)
 {
 	json_t *val, *err_val, *res_val, *id_val;
 	json_error_t err;
@@ -3121,6 +3300,8 @@ static bool stratum_handle_response(char *buf)
 	timeval_subtract(&diff, &tv_answer, &stratum.tv_submit);
 	// store time required to the pool to answer to a submit
 	stratum.answer_msec = (1000 * diff.tv_sec) + (uint32_t) (0.001 * diff.tv_usec);
+	if (opt_sim_pool)
+		sim_pool_share_answer((uint32_t) (1000000 * diff.tv_sec + diff.tv_usec));
 
 	if (stratum.rpc2) {
 		const char* reject_reason = err_val ? json_string_value(json_object_get(err_val, "message")) : NULL;
@@ -3151,7 +3332,7 @@ static void *stratum_thread(void *userdata)
 	struct pool_infos *pool;
 	stratum_ctx *ctx = &stratum;
 	int pooln, switchn;
-	char *s;
+	const char *s;
 
 wait_stratum_url:
 	stratum.url = (char*)tq_pop(mythr->q, NULL);
@@ -3183,6 +3364,7 @@ wait_stratum_url:
 			pthread_mutex_lock(&g_work_lock);
 			g_work_time = 0;
 			g_work.data[0] = 0;
+			g_work_changed();
 			pthread_mutex_unlock(&g_work_lock);
 			restart_threads();
 
@@ -3222,6 +3404,8 @@ wait_stratum_url:
 			pthread_mutex_lock(&g_work_lock);
 			if (stratum_gen_work(&stratum, &g_work))
 				g_work_time = time(NULL);
+			g_work_changed();
+			scan_window_new_job(cur_pooln);
 			if (stratum.job.clean) {
 				static uint32_t last_block_height;
 				if ((!opt_quiet || !firstwork_time) && stratum.job.height != last_block_height) {
@@ -3252,7 +3436,7 @@ wait_stratum_url:
 				applog(LOG_WARNING, "Stratum connection timed out");
 			s = NULL;
 		} else
-			s = stratum_recv_line(&stratum);
+			s = stratum_recv_line_view(&stratum);
 
 		// double check we are on the right pool
 		if (switchn != pool_switch_count) goto pool_switched;
@@ -3265,7 +3449,6 @@ wait_stratum_url:
 		}
 		if (!stratum_handle_method(&stratum, s))
 			stratum_handle_response(s);
-		free(s);
 	}
 
 out:
@@ -3802,6 +3985,69 @@ void parse_arg(int key, char *arg)
 		print_hash_tests();
 		proper_exit(EXIT_CODE_OK);
 		break;
+	case 1090: // cpu-bench
+		opt_cpu_bench = true;
+		free(opt_cpu_bench_algos);
+		opt_cpu_bench_algos = arg ? strdup(arg) : NULL;
+		break;
+	case 1091: // cpu-bench-runs
+		v = atoi(arg);
+		if (v < 2 || v > 100)
+			show_usage_and_exit(1);
+		opt_cpu_bench_runs = v;
+		break;
+	case 1092: // cpu-bench-json
+		free(opt_cpu_bench_json);
+		opt_cpu_bench_json = strdup(arg);
+		break;
+	case 1093: // sim-pool
+		opt_sim_pool = true;
+		if (arg) {
+			v = atoi(arg);
+			if (v < 10 || v > 3600000)
+				show_usage_and_exit(1);
+			opt_sim_pool_interval = v;
+		}
+		break;
+	case 1094: // sim-pool-branches
+		v = atoi(arg);
+		if (v < 0 || v > 32)
+			show_usage_and_exit(1);
+		opt_sim_pool_branches = v;
+		break;
+	case 1095: // sim-pool-diff
+		d = atof(arg);
+		if (d <= 0.)
+			show_usage_and_exit(1);
+		opt_sim_pool_diff = d;
+		break;
+	case 1096: // sim-devices
+		v = atoi(arg);
+		if (v < 1 || v > MAX_GPUS)
+			show_usage_and_exit(1);
+		opt_sim_devices = v;
+		break;
+	case 1097: // sim-rate
+		d = atof(arg);
+		p = strstr(arg, "K");
+		if (p) d *= 1e3;
+		p = strstr(arg, "M");
+		if (p) d *= 1e6;
+		p = strstr(arg, "G");
+		if (p) d *= 1e9;
+		if (d < 1.)
+			show_usage_and_exit(1);
+		opt_sim_rate = d;
+		break;
+	case 1098: // sim-share-prob
+		d = atof(arg);
+		if (d < 0. || d > 1.)
+			show_usage_and_exit(1);
+		opt_sim_share_prob = d;
+		break;
+	case 1099: // sim-verify
+		opt_sim_verify = true;
+		break;
 	case 1003:
 		want_longpoll = false;
 		break;
@@ -3855,6 +4101,34 @@ void parse_arg(int key, char *arg)
 			show_usage_and_exit(1);
 		opt_priority = v;
 		break;
+	case 1024: // cpu-threads
+		v = atoi(arg);
+		if (v < 0 || v > 1024)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_cpu_threads = v;
+		break;
+	case 1081: // verify-threads
+		v = atoi(arg);
+		if (v < 0 || v > 64)	/* sanity check */
+			show_usage_and_exit(1);
+		opt_verify_threads = v;
+		break;
+	case 1082: // verify-queue
+		v = atoi(arg);
+		if (v < 1 || v > 4096)
+			show_usage_and_exit(1);
+		opt_verify_queue = v;
+		break;
+	case 1083: // scan-target
+		d = atof(arg);
+		if (d < 0.1 || d > 600.)
+			show_usage_and_exit(1);
+		opt_scan_target = d;
+		break;
+	case 1084: // scan-state
+		free(opt_scan_state);
+		opt_scan_state = strdup(arg);
+		break;
 	case 1025: // cuda-schedule
 		opt_cudaschedule = atoi(arg);
 		break;
@@ -3897,11 +4171,26 @@ void parse_arg(int key, char *arg)
 	case 'd': // --device
 		{
 			int device_thr[MAX_GPUS] = { 0 };
-			int ngpus = cuda_num_devices();
-			char* pch = strtok(arg,",");
+			int ngpus = 0;
+			char* list = strdup(arg); // parsed twice, see main()
+			char* pch = strtok(list,",");
 			opt_n_threads = 0;
+			// no cuda driver query for a cpu only list
+			if (strcasecmp(arg, "cpu"))
+				ngpus = cuda_num_devices();
 			while (pch != NULL && opt_n_threads < MAX_GPUS) {
-				if (pch[0] >= '0' && pch[0] <= '9' && strlen(pch) <= 2)
+				device_type[opt_n_threads] = DEVICE_TYPE_CUDA;
+				if (!strcasecmp(pch, "cpu")) {
+					for (int n=0; n < opt_n_threads; n++) {
+						if (device_type[n] == DEVICE_TYPE_CPU) {
+							applog(LOG_ERR, "Only one cpu device can be specified in -d option");
+							proper_exit(EXIT_CODE_USAGE);
+						}
+					}
+					device_type[opt_n_threads] = DEVICE_TYPE_CPU;
+					device_map[opt_n_threads++] = 0;
+				}
+				else if (pch[0] >= '0' && pch[0] <= '9' && strlen(pch) <= 2)
 				{
 					if (atoi(pch) < ngpus)
 						device_map[opt_n_threads++] = atoi(pch);
@@ -3920,9 +4209,12 @@ void parse_arg(int key, char *arg)
 				}
 				pch = strtok (NULL, ",");
 			}
+			free(list);
 			// count threads per gpu
 			for (int n=0; n < opt_n_threads; n++) {
 				int device = device_map[n];
+				if (device_type[n] == DEVICE_TYPE_CPU)
+					continue;
 				device_thr[device]++;
 			}
 			for (int n=0; n < ngpus; n++) {
@@ -4142,6 +4434,17 @@ int main(int argc, char *argv[])
 	// get opt_quiet early
 	parse_single_opt('q', argc, argv);
 
+	// the cpu benchmark, also started with the ccminer-cpubench name
+	parse_single_opt(1090, argc, argv);
+	parse_single_opt(1091, argc, argv);
+	parse_single_opt(1092, argc, argv);
+	if (strstr(argv[0], "cpubench"))
+		opt_cpu_bench = true;
+	// virtual devices or the cpu device alone, no cuda driver required
+	parse_single_opt(1096, argc, argv);
+	parse_single_opt('d', argc, argv);
+	bool cpu_only = (opt_n_threads == 1 && device_type[0] == DEVICE_TYPE_CPU);
+
 	printf("*** ccminer " PACKAGE_VERSION " for nVidia GPUs by tpruvot@github ***\n");
 	if (!opt_quiet) {
 		const char* arch = is_x64() ? "64-bits" : "32-bits";
@@ -4184,11 +4487,15 @@ int main(int argc, char *argv[])
 	if (num_cpus < 1)
 		num_cpus = 1;
 
+	// no cuda device required
+	if (opt_cpu_bench)
+		return cpu_bench_run();
+
 	// number of gpus
-	active_gpus = cuda_num_devices();
+	active_gpus = (opt_sim_devices || cpu_only) ? 0 : cuda_num_devices();
 
 	for (i = 0; i < MAX_GPUS; i++) {
-		device_map[i] = i % active_gpus;
+		device_map[i] = active_gpus ? i % active_gpus : 0;
 		device_name[i] = NULL;
 		device_config[i] = NULL;
 		device_backoff[i] = is_windows() ? 12 : 2;
@@ -4202,11 +4509,19 @@ int main(int argc, char *argv[])
 		device_led[i] = -1;
 	}
 
-	cuda_devicenames();
+	if (!opt_sim_devices && !cpu_only)
+		cuda_devicenames();
 
 	/* parse command line */
 	parse_cmdline(argc, argv);
 
+	if (opt_sim_devices && !sim_devices_init())
+		proper_exit(EXIT_CODE_USAGE);
+
+	// local pool, set as the stratum url before the default config lookup
+	if (opt_sim_pool && !sim_pool_start())
+		proper_exit(EXIT_CODE_USAGE);
+
 	if (!opt_benchmark && !strlen(rpc_url)) {
 		// try default config file (user then binary folder)
 		char defconfig[MAX_PATH] = { 0 };
@@ -4328,17 +4643,27 @@ int main(int argc, char *argv[])
 			applog(LOG_DEBUG, "Binding process to cpu mask %x", opt_affinity);
 		affine_to_cpu_mask(-1, (unsigned long)opt_affinity);
 	}
-	if (active_gpus == 0) {
+	int cpu_devices = 0;
+	for (int n=0; n < opt_n_threads; n++) {
+		if (device_type[n] == DEVICE_TYPE_CPU)
+			cpu_devices++;
+	}
+	if (cpu_devices && opt_algo != ALGO_SCRYPT_JANE && opt_algo != ALGO_EQUIHASH) {
+		applog(LOG_ERR, "The cpu device is only available with the scrypt-jane and equihash algos");
+		exit(1);
+	}
+	if (active_gpus == 0 && !cpu_devices && !opt_sim_devices) {
 		applog(LOG_ERR, "No CUDA devices found! terminating.");
 		exit(1);
 	}
 	if (!opt_n_threads)
 		opt_n_threads = active_gpus;
-	else if (active_gpus > opt_n_threads)
-		active_gpus = opt_n_threads;
+	else if (active_gpus > opt_n_threads - cpu_devices)
+		active_gpus = opt_n_threads - cpu_devices;
 
 	// generally doesn't work well...
-	gpu_threads = max(gpu_threads, opt_n_threads / active_gpus);
+	if (active_gpus)
+		gpu_threads = max(gpu_threads, (opt_n_threads - cpu_devices) / active_gpus);
 
 	if (opt_benchmark && opt_algo == ALGO_AUTO) {
 		bench_init(opt_n_threads);
@@ -4417,13 +4742,16 @@ int main(int argc, char *argv[])
 #ifdef USE_WRAPNVML
 #if defined(__linux__) || defined(_WIN64)
 	/* nvml is currently not the best choice on Windows (only in x64) */
-	hnvml = nvml_create();
+	if (!opt_sim_devices)
+		hnvml = nvml_create();
 	if (hnvml) {
 		bool gpu_reinit = (opt_cudaschedule >= 0); //false
 		cuda_devicenames(); // refresh gpu vendor name
 		if (!opt_quiet)
 			applog(LOG_INFO, "NVML GPU monitoring enabled.");
-		for (int n=0; n < active_gpus; n++) {
+		for (int n=0; n < opt_n_threads; n++) {
+			if (device_type[n] != DEVICE_TYPE_CUDA)
+				continue;
 			if (nvml_set_pstate(hnvml, device_map[n]) == 1)
 				gpu_reinit = true;
 			if (nvml_set_plimit(hnvml, device_map[n]) == 1)
@@ -4451,8 +4779,9 @@ int main(int argc, char *argv[])
 
 	// force reinit to set default device flags
 	if (opt_cudaschedule >= 0 && !hnvml) {
-		for (int n=0; n < active_gpus; n++) {
-			cuda_reset_device(n, NULL);
+		for (int n=0; n < opt_n_threads; n++) {
+			if (device_type[n] == DEVICE_TYPE_CUDA)
+				cuda_reset_device(n, NULL);
 		}
 	}
 #endif
@@ -4489,6 +4818,11 @@ int main(int argc, char *argv[])
 	}
 #endif
 
+	scan_window_init();
+
+	if (!verify_pool_start(verified_nonce_submit))
+		return EXIT_CODE_SW_INIT_ERROR;
+
 	/* start mining threads */
 	for (i = 0; i < opt_n_threads; i++) {
 		thr = &thr_info[i];
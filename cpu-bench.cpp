@@ -0,0 +1,498 @@
+/**
+ * Cpu hash micro benchmarks (--cpu-bench or the ccminer-cpubench name)
+ *
+ * Times the cpu hash of each algo, the one used to validate the gpu
+ * nonces, and the multi-buffer versions. Each function is warmed up,
+ * then timed in several runs of about the same duration to get the mean
+ * and a 95% confidence interval of its cost. No cuda call is made, so it
+ * also runs on build hosts without a gpu.
+ */
+
+#include <ccminer-config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <jansson.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CPU_BENCH_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+#endif
+
+#include "sph/sph_mb512.h"
+#include "neoscrypt/neoscrypt.h"
+#ifndef ARM64
+#include "equi/eqcuda.hpp"
+#include "equi/equihash.h"
+#endif
+
+#include "miner.h"
+
+bool opt_cpu_bench = false;
+char *opt_cpu_bench_algos = NULL;
+char *opt_cpu_bench_json = NULL;
+int opt_cpu_bench_runs = 10;
+
+extern int num_cpus;
+extern int opt_nfactor;
+
+#define CPU_BENCH_WARMUP_NS  (100 * 1000000ULL)
+#define CPU_BENCH_RUN_NS     (50 * 1000000ULL)
+#define CPU_BENCH_MAX_RUNS   100
+#define CPU_BENCH_MB         16  /* messages of the multi-buffer calls */
+
+static uint64_t bench_ns()
+{
+#ifdef WIN32
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+	if (!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (uint64_t) ((double) now.QuadPart * 1e9 / (double) freq.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline uint64_t bench_cycles()
+{
+#ifdef CPU_BENCH_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static void bench_cpu_name(char *name, size_t len)
+{
+	snprintf(name, len, "unknown");
+#if defined(CPU_BENCH_TSC)
+	uint32_t brand[12];
+#ifdef _MSC_VER
+	int r[4];
+	__cpuid(r, 0x80000000);
+	if ((uint32_t) r[0] < 0x80000004)
+		return;
+	for (int i = 0; i < 3; i++)
+		__cpuid((int*) &brand[i*4], 0x80000002 + i);
+#else
+	if (__get_cpuid_max(0x80000000, NULL) < 0x80000004)
+		return;
+	for (int i = 0; i < 3; i++)
+		__get_cpuid(0x80000002 + i, &brand[i*4], &brand[i*4+1], &brand[i*4+2], &brand[i*4+3]);
+#endif
+	char *s = (char*) brand;
+	s[47] = '\0';
+	while (*s == ' ') s++;
+	snprintf(name, len, "%s", s);
+#endif
+}
+
+/* hashes without the common (output, input) prototype */
+
+static void bench_blakecoin(void *output, const void *input) { blake256hash(output, input, 8); }
+static void bench_blake(void *output, const void *input) { blake256hash(output, input, 14); }
+static void bench_fugue256(void *output, const void *input) {
+	fugue256_hash((unsigned char*) output, (const unsigned char*) input, 80);
+}
+static void bench_heavy(void *output, const void *input) {
+	heavycoin_hash((unsigned char*) output, (const unsigned char*) input, 84);
+}
+static void bench_neoscrypt(void *output, const void *input) {
+	neoscrypt((uchar*) output, (const uchar*) input, 0x80000620U);
+}
+static void bench_neoscrypt_4way(void *output, const void *input) {
+	neoscrypt_4way((unsigned char*) output, (const unsigned char*) input, 0x80000620U);
+}
+/* two 76 bytes headers, the main loops interleaved */
+static void bench_cryptolight_x2(void *output, const void *input) {
+	cryptolight_hash_variant_x2(output, input, 76, 1);
+}
+#ifndef ARM64
+static void bench_cryptonight_x2(void *output, const void *input) {
+	cryptonight_fork = 1;
+	cryptonight_hash_variant_x2(output, input, 76, 0);
+}
+#endif
+
+static uint64_t *bench_scratchpad = NULL;
+#define BENCH_SCRATCHPAD_WORDS (1U << 20)
+static bool bench_wildkeccak_init()
+{
+	if (!bench_scratchpad)
+		bench_scratchpad = (uint64_t*) malloc(BENCH_SCRATCHPAD_WORDS * sizeof(uint64_t));
+	if (!bench_scratchpad)
+		return false;
+	for (uint32_t i = 0; i < BENCH_SCRATCHPAD_WORDS; i++)
+		bench_scratchpad[i] = (uint64_t) i * 0x9E3779B97F4A7C15ULL;
+	return true;
+}
+static void bench_wildkeccak(void *output, const void *input) {
+	wildkeccak_hash(output, input, bench_scratchpad, BENCH_SCRATCHPAD_WORDS);
+}
+
+static bool bench_scrypt_init() { opt_nfactor = 9; return true; }
+static bool bench_scrypt_jane_init() { opt_nfactor = 14; return true; }
+
+/* multi-buffer, CPU_BENCH_MB messages per call */
+
+static void bench_sha256d_mb(void *output, const void *input)
+{
+	static const uint32_t midstate[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+	sha256d_midstate_mb((unsigned char*) output, midstate, (const unsigned char*) input, 16, 80, CPU_BENCH_MB);
+}
+
+#define BENCH_MB512(name) \
+	static void bench_ ## name ## _mb(void *output, const void *input) { \
+		sph_ ## name ## _mb(output, input, 64, CPU_BENCH_MB); \
+	}
+BENCH_MB512(blake512)
+BENCH_MB512(bmw512)
+BENCH_MB512(keccak512)
+BENCH_MB512(skein512)
+BENCH_MB512(jh512)
+BENCH_MB512(sha512)
+BENCH_MB512(cubehash512)
+BENCH_MB512(shabal512)
+BENCH_MB512(luffa512)
+
+#ifndef ARM64
+/* 140 bytes header, the 3 bytes size and the 1344 bytes solution */
+static uint8_t bench_equi_data[140 + 3 + 1344];
+static bool bench_equi_solved;
+
+static void bench_equi_solution(int thr_id, const std::vector<uint32_t>& indices, size_t cbitlen, const unsigned char *compressed)
+{
+	uint8_t *sol = &bench_equi_data[143];
+	if (bench_equi_solved || indices.size() != EQ_INDICES)
+		return;
+	memset(sol, 0, EQ_SOLSIZE);
+	for (uint32_t j = 0; j < EQ_INDICES; j++) {
+		for (uint32_t b = 0; b < EQ_INDEX_BITS; b++) {
+			uint32_t bit = j * EQ_INDEX_BITS + b;
+			if ((indices[j] >> (EQ_INDEX_BITS - 1 - b)) & 1)
+				sol[bit >> 3] |= 0x80 >> (bit & 7);
+		}
+	}
+	bench_equi_solved = true;
+}
+static void bench_equi_done(int thr_id) { }
+static bool bench_equi_cancel(int thr_id) { return bench_equi_solved; }
+
+// a real solution is required, the verifier stops at the first error
+static bool bench_equi_init()
+{
+	if (bench_equi_solved)
+		return true;
+	try {
+		eq_cpu_context solver(0);
+		eq_cuda_context_interface *ctx = &solver;
+		for (int n = 0; n < 64 && !bench_equi_solved; n++) {
+			for (int i = 0; i < 140; i++)
+				bench_equi_data[i] = (uint8_t) (i * 13 + n);
+			ctx->solve((const char*) bench_equi_data, 108, (const char*) &bench_equi_data[108], 32,
+				bench_equi_cancel, bench_equi_solution, bench_equi_done);
+		}
+	} catch (const std::exception &e) {
+		applog(LOG_ERR, "cpu-bench: %s", e.what());
+	}
+	bench_equi_data[140] = 0xfd; bench_equi_data[141] = 0x40; bench_equi_data[142] = 0x05;
+	return bench_equi_solved;
+}
+static void bench_equihash(void *output, const void *input) {
+	equi_hash(bench_equi_data, output, sizeof(bench_equi_data));
+}
+static void bench_equi_verify(void *output, const void *input) {
+	*(uint32_t*) output = equi_verify(bench_equi_data, &bench_equi_data[143]);
+}
+#endif
+
+struct cpu_bench_algo {
+	const char *name;
+	void (*hash)(void *output, const void *input);
+	int hashes; /* per call */
+	bool (*init)(void);
+};
+
+static const struct cpu_bench_algo bench_algos[] = {
+	{ "allium", allium_hash, 1, NULL },
+	{ "bastion", (void (*)(void*, const void*)) bastionhash, 1, NULL },
+	{ "bitcore", bitcore_hash, 1, NULL },
+	{ "blake", bench_blake, 1, NULL },
+	{ "blakecoin", bench_blakecoin, 1, NULL },
+	{ "blake2b", blake2b_hash, 1, NULL },
+	{ "blake2s", blake2s_hash, 1, NULL },
+	{ "bmw", bmw_hash, 1, NULL },
+	{ "c11", c11hash, 1, NULL },
+	{ "cryptolight", cryptolight_hash, 1, NULL },
+	{ "cryptolight-x2", bench_cryptolight_x2, 2, NULL },
+#ifndef ARM64
+	{ "cryptonight", cryptonight_hash, 1, NULL },
+	{ "cryptonight-x2", bench_cryptonight_x2, 2, NULL },
+	{ "monero", monero_hash, 1, NULL },
+	{ "stellite", stellite_hash, 1, NULL },
+#endif
+	{ "decred", decred_hash, 1, NULL },
+	{ "deep", deephash, 1, NULL },
+#ifndef ARM64
+	{ "equihash", bench_equihash, 1, bench_equi_init },
+	{ "equihash-verify", bench_equi_verify, 1, bench_equi_init },
+#endif
+	{ "exosis", exosis_hash, 1, NULL },
+	{ "fresh", fresh_hash, 1, NULL },
+	{ "fugue256", bench_fugue256, 1, NULL },
+	{ "groestl", groestlhash, 1, NULL },
+	{ "heavy", bench_heavy, 1, NULL },
+	{ "hmq1725", hmq17hash, 1, NULL },
+	{ "hsr", hsr_hash, 1, NULL },
+	{ "jackpot", jackpothash, 1, NULL },
+	{ "jha", jha_hash, 1, NULL },
+	{ "keccak", keccak256_hash, 1, NULL },
+	{ "lbry", lbry_hash, 1, NULL },
+	{ "luffa", luffa_hash, 1, NULL },
+	{ "lyra2", lyra2re_hash, 1, NULL },
+	{ "lyra2v2", lyra2v2_hash, 1, NULL },
+	{ "lyra2v3", lyra2v3_hash, 1, NULL },
+	{ "lyra2z", lyra2Z_hash, 1, NULL },
+	{ "myriad", myriadhash, 1, NULL },
+	{ "neoscrypt", bench_neoscrypt, 1, NULL },
+	{ "neoscrypt-4way", bench_neoscrypt_4way, 4, NULL },
+	{ "nist5", nist5hash, 1, NULL },
+	{ "pentablake", pentablakehash, 1, NULL },
+	{ "phi", phi_hash, 1, NULL },
+	{ "phi2", phi2_hash, 1, NULL },
+	{ "polytimos", polytimos_hash, 1, NULL },
+	{ "quark", quarkhash, 1, NULL },
+	{ "qubit", qubithash, 1, NULL },
+#ifndef ARM64
+	{ "scrypt", scrypthash, 1, bench_scrypt_init },
+	{ "scrypt-jane", scryptjane_hash, 1, bench_scrypt_jane_init },
+#endif
+	{ "sha256d", sha256d_hash, 1, NULL },
+	{ "sha256t", sha256t_hash, 1, NULL },
+	{ "sha256q", sha256q_hash, 1, NULL },
+	{ "sia", sia_blake2b_hash, 1, NULL },
+	{ "sib", sibhash, 1, NULL },
+	{ "skein", skeincoinhash, 1, NULL },
+	{ "skein2", skein2hash, 1, NULL },
+	{ "skunk", skunk_hash, 1, NULL },
+	{ "s3", s3hash, 1, NULL },
+	{ "timetravel", timetravel_hash, 1, NULL },
+	{ "tribus", tribus_hash, 1, NULL },
+	{ "veltor", veltorhash, 1, NULL },
+	{ "whirlpool", wcoinhash, 1, NULL },
+	{ "wildkeccak", bench_wildkeccak, 1, bench_wildkeccak_init },
+	{ "x11evo", x11evo_hash, 1, NULL },
+	{ "x11", x11hash, 1, NULL },
+	{ "x12", x12hash, 1, NULL },
+	{ "x13", x13hash, 1, NULL },
+	{ "x14", x14hash, 1, NULL },
+	{ "x15", x15hash, 1, NULL },
+	{ "x16r", x16r_hash, 1, NULL },
+	{ "x16s", x16s_hash, 1, NULL },
+	{ "x17", x17hash, 1, NULL },
+	{ "zr5", zr5hash, 1, NULL },
+	/* multi-buffer primitives */
+	{ "sha256d-mb", bench_sha256d_mb, CPU_BENCH_MB, NULL },
+	{ "blake512-mb", bench_blake512_mb, CPU_BENCH_MB, NULL },
+	{ "bmw512-mb", bench_bmw512_mb, CPU_BENCH_MB, NULL },
+	{ "keccak512-mb", bench_keccak512_mb, CPU_BENCH_MB, NULL },
+	{ "skein512-mb", bench_skein512_mb, CPU_BENCH_MB, NULL },
+	{ "jh512-mb", bench_jh512_mb, CPU_BENCH_MB, NULL },
+	{ "sha512-mb", bench_sha512_mb, CPU_BENCH_MB, NULL },
+	{ "cubehash512-mb", bench_cubehash512_mb, CPU_BENCH_MB, NULL },
+	{ "shabal512-mb", bench_shabal512_mb, CPU_BENCH_MB, NULL },
+	{ "luffa512-mb", bench_luffa512_mb, CPU_BENCH_MB, NULL },
+};
+
+struct cpu_bench_stat {
+	double mean, median, min, stddev, ci95;
+};
+
+// two-sided 95% quantiles of the student t distribution, 1 to 30 degrees of freedom
+static const double bench_t95[30] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+static int bench_cmp_double(const void *a, const void *b)
+{
+	const double x = *(const double*) a, y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+static void bench_stat(double *v, int n, struct cpu_bench_stat *st)
+{
+	double sum = 0., var = 0.;
+	for (int i = 0; i < n; i++)
+		sum += v[i];
+	st->mean = sum / n;
+	for (int i = 0; i < n; i++)
+		var += (v[i] - st->mean) * (v[i] - st->mean);
+	st->stddev = n > 1 ? sqrt(var / (n - 1)) : 0.;
+	st->ci95 = n > 1 ? (n <= 31 ? bench_t95[n - 2] : 1.96) * st->stddev / sqrt((double) n) : 0.;
+	qsort(v, n, sizeof(double), bench_cmp_double);
+	st->median = (n & 1) ? v[n/2] : (v[n/2 - 1] + v[n/2]) / 2.;
+	st->min = v[0];
+}
+
+static bool bench_selected(const char *name)
+{
+	if (!opt_cpu_bench_algos || !strlen(opt_cpu_bench_algos))
+		return true;
+	const size_t len = strlen(name);
+	const char *p = opt_cpu_bench_algos;
+	while (p && *p) {
+		const char *end = strchr(p, ',');
+		size_t n = end ? (size_t) (end - p) : strlen(p);
+		if (n == len && !strncasecmp(p, name, n))
+			return true;
+		p = end ? end + 1 : NULL;
+	}
+	return false;
+}
+
+static json_t* bench_stat_json(const struct cpu_bench_stat *st)
+{
+	json_t *o = json_object();
+	json_object_set_new(o, "mean", json_real(st->mean));
+	json_object_set_new(o, "median", json_real(st->median));
+	json_object_set_new(o, "min", json_real(st->min));
+	json_object_set_new(o, "stddev", json_real(st->stddev));
+	json_object_set_new(o, "ci95", json_real(st->ci95));
+	return o;
+}
+
+/**
+ * Time the selected algos, the results are printed in a table and
+ * written in the opt_cpu_bench_json file when set
+ */
+int cpu_bench_run(void)
+{
+	uint8_t _ALIGN(64) input[CPU_BENCH_MB * 128];
+	uint8_t _ALIGN(64) output[CPU_BENCH_MB * 64];
+	double ns[CPU_BENCH_MAX_RUNS], cycles[CPU_BENCH_MAX_RUNS];
+	const int runs = max(2, min(opt_cpu_bench_runs, CPU_BENCH_MAX_RUNS));
+	char cpu[64];
+	int count = 0;
+
+	json_t *results = json_array();
+
+	bench_cpu_name(cpu, sizeof(cpu));
+	printf("ccminer %s cpu hash benchmark, %s (%d threads)\n", PACKAGE_VERSION, cpu, num_cpus);
+	printf("sha256 %s, 512 bits hashes %s, %d runs of %u ms\n\n", sha256_mb_name(), sph_mb512_name(),
+		runs, (uint32_t) (CPU_BENCH_RUN_NS / 1000000));
+	printf("%-16s %14s %12s %10s %14s\n", "algo", "hashes/s", "ns/hash", "+/-95%", "cycles/hash");
+
+	for (uint32_t a = 0; a < ARRAY_SIZE(bench_algos); a++) {
+		const struct cpu_bench_algo *algo = &bench_algos[a];
+		struct cpu_bench_stat st_ns, st_cy;
+		uint64_t t0, c0, iters;
+		uint32_t *nonce = (uint32_t*) &input[76];
+
+		if (!bench_selected(algo->name))
+			continue;
+		if (algo->init && !algo->init()) {
+			printf("%-16s skipped\n", algo->name);
+			continue;
+		}
+
+		for (uint32_t i = 0; i < sizeof(input); i++)
+			input[i] = (uint8_t) (i * 131 + 7);
+
+		// warmup, also gives the number of calls of a run
+		iters = 0;
+		t0 = bench_ns();
+		do {
+			(*nonce)++;
+			algo->hash(output, input);
+			iters++;
+		} while (iters < 2 || bench_ns() - t0 < CPU_BENCH_WARMUP_NS);
+		iters = (iters * CPU_BENCH_RUN_NS) / (bench_ns() - t0);
+		if (iters < 1) iters = 1;
+
+		for (int r = 0; r < runs; r++) {
+			t0 = bench_ns();
+			c0 = bench_cycles();
+			for (uint64_t n = 0; n < iters; n++) {
+				(*nonce)++;
+				algo->hash(output, input);
+			}
+			const double hashes = (double) iters * algo->hashes;
+			cycles[r] = (double) (bench_cycles() - c0) / hashes;
+			ns[r] = (double) (bench_ns() - t0) / hashes;
+		}
+		bench_stat(ns, runs, &st_ns);
+		bench_stat(cycles, runs, &st_cy);
+
+		const double hps = 1e9 / st_ns.mean;
+		printf("%-16s %14.1f %12.1f %9.1f%% %14.0f\n", algo->name, hps, st_ns.mean,
+			100. * st_ns.ci95 / st_ns.mean, st_cy.mean);
+
+		json_t *res = json_object();
+		json_object_set_new(res, "algo", json_string(algo->name));
+		json_object_set_new(res, "hashes_per_call", json_integer(algo->hashes));
+		json_object_set_new(res, "calls_per_run", json_integer((json_int_t) iters));
+		json_object_set_new(res, "runs", json_integer(runs));
+		json_object_set_new(res, "hashes_per_sec", json_real(hps));
+		json_object_set_new(res, "hashes_per_sec_ci95_low", json_real(1e9 / (st_ns.mean + st_ns.ci95)));
+		json_object_set_new(res, "hashes_per_sec_ci95_high", st_ns.mean > st_ns.ci95 ?
+			json_real(1e9 / (st_ns.mean - st_ns.ci95)) : json_null());
+		json_object_set_new(res, "ns_per_hash", bench_stat_json(&st_ns));
+#ifdef CPU_BENCH_TSC
+		json_object_set_new(res, "cycles_per_hash", bench_stat_json(&st_cy));
+#else
+		json_object_set_new(res, "cycles_per_hash", json_null());
+#endif
+		json_array_append_new(results, res);
+		count++;
+	}
+
+	if (!count)
+		applog(LOG_ERR, "cpu-bench: no algo matches \"%s\"", opt_cpu_bench_algos);
+
+	if (opt_cpu_bench_json) {
+		json_t *root = json_object();
+		json_object_set_new(root, "version", json_string(PACKAGE_VERSION));
+		json_object_set_new(root, "time", json_integer((json_int_t) time(NULL)));
+		json_object_set_new(root, "cpu", json_string(cpu));
+		json_object_set_new(root, "threads", json_integer(num_cpus));
+		json_object_set_new(root, "sha256_mb", json_string(sha256_mb_name()));
+		json_object_set_new(root, "hash512_mb", json_string(sph_mb512_name()));
+		json_object_set_new(root, "run_ms", json_integer(CPU_BENCH_RUN_NS / 1000000));
+		json_object_set_new(root, "results", results);
+		if (json_dump_file(root, opt_cpu_bench_json, JSON_INDENT(2) | JSON_PRESERVE_ORDER) < 0) {
+			applog(LOG_ERR, "cpu-bench: unable to write %s", opt_cpu_bench_json);
+			count = 0;
+		}
+		json_decref(root);
+	} else {
+		json_decref(results);
+	}
+
+	free(bench_scratchpad);
+	bench_scratchpad = NULL;
+#ifndef ARM64
+	scryptjane_hash_free();
+#endif
+
+	return count ? EXIT_CODE_OK : EXIT_CODE_USAGE;
+}
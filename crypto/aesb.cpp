@@ -144,6 +144,29 @@ y[3] = (k)[3]  ^ (t_fn[0][x[3] & 0xff] ^ t_fn[1][(x[0] >> 8) & 0xff] ^ t_fn[2][(
 
 d_4(uint32_t, t_dec(f,n), sb_data, u0, u1, u2, u3);
 
+static const uint8_t sbox[256] = sb_data(h0);
+static const uint8_t rcon[10] = rc_data(h0);
+
+#define sub_word(x) bytes2word(sbox[bval(x,0)], sbox[bval(x,1)], sbox[bval(x,2)], sbox[bval(x,3)])
+
+/* the 10 first round keys of the AES-256 schedule (160 bytes), used by the pseudo rounds */
+void aesb_expand_key(const uint8_t *key, uint8_t *expandedKey)
+{
+    uint32_t *w = (uint32_t*) expandedKey;
+    int i;
+
+    for (i = 0; i < 8; i++)
+        w[i] = word_in(key, i);
+    for (i = 8; i < 10 * N_COLS; i++) {
+        uint32_t t = w[i - 1];
+        if (i % 8 == 0)
+            t = sub_word((t >> 8) | (t << 24)) ^ rcon[i / 8 - 1];
+        else if (i % 8 == 4)
+            t = sub_word(t);
+        w[i] = w[i - 8] ^ t;
+    }
+}
+
 void aesb_single_round(const uint8_t *in, uint8_t *out, uint8_t *expandedKey)
 {
     round(((uint32_t*) out), ((uint32_t*) in), ((uint32_t*) expandedKey));
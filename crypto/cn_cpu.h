@@ -0,0 +1,206 @@
+/*
+ * CryptoNight cpu helpers, shared by cryptonight-cpu.cpp and cryptolight-cpu.cpp
+ *
+ * AES-NI rounds (x86-64) with the aesb.cpp tables as fallback, and the
+ * per thread scratchpad allocation (huge pages when the system allows it)
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CN_CPU_AESNI
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#define CN_TARGET(x) __attribute__((target(x)))
+#else
+#define CN_TARGET(x)
+#endif
+
+extern "C" void aesb_single_round(const uint8_t *in, uint8_t *out, uint8_t *expandedKey);
+extern "C" void aesb_pseudo_round_mut(uint8_t *val, uint8_t *expandedKey);
+extern "C" void aesb_expand_key(const uint8_t *key, uint8_t *expandedKey);
+
+static inline uint64_t cn_umul128(uint64_t a, uint64_t b, uint64_t *hi)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	return _umul128(a, b, hi);
+#elif defined(__SIZEOF_INT128__)
+	unsigned __int128 r = (unsigned __int128) a * b;
+	*hi = (uint64_t) (r >> 64);
+	return (uint64_t) r;
+#else
+	// a * b = ah * bh * 2^64 + (ah * bl + al * bh) * 2^32 + al * bl
+	uint64_t al = a & 0xFFFFFFFF, ah = a >> 32;
+	uint64_t bl = b & 0xFFFFFFFF, bh = b >> 32;
+	uint64_t ad = ah * bl, bc = al * bh, bd = al * bl;
+	uint64_t adbc = ad + bc;
+	uint64_t lo = bd + (adbc << 32);
+	*hi = ah * bh + (adbc >> 32) + ((uint64_t) (adbc < ad) << 32) + (lo < bd);
+	return lo;
+#endif
+}
+
+/* the scratchpads of both lanes, kept by the thread */
+static uint8_t* cn_cpu_alloc(size_t size)
+{
+	uint8_t *mem = NULL;
+#if defined(__linux__)
+	mem = (uint8_t*) mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+	if (mem != MAP_FAILED)
+		return mem;
+	mem = (uint8_t*) mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem != MAP_FAILED) {
+		madvise(mem, size, MADV_HUGEPAGE);
+		return mem;
+	}
+	mem = NULL;
+#endif
+#ifdef _MSC_VER
+	mem = (uint8_t*) _aligned_malloc(size, 4096);
+#else
+	if (posix_memalign((void**) &mem, 4096, size))
+		mem = NULL;
+#endif
+	return mem;
+}
+
+#if defined(CN_CPU_AESNI)
+
+static inline int cn_cpu_has_aesni(void)
+{
+	uint32_t r[4];
+#ifdef _MSC_VER
+	int cr[4];
+	__cpuid(cr, 1);
+	r[2] = (uint32_t) cr[2];
+#else
+	__cpuid(1, r[0], r[1], r[2], r[3]);
+#endif
+	return (r[2] & (1 << 25)) != 0;
+}
+
+/* L2 cache size in bytes (0 if unknown) */
+static inline uint32_t cn_cpu_l2_size(void)
+{
+	uint32_t r[4];
+#ifdef _MSC_VER
+	int cr[4];
+	__cpuid(cr, 0x80000000);
+	r[0] = (uint32_t) cr[0];
+	if (r[0] < 0x80000006)
+		return 0;
+	__cpuid(cr, 0x80000006);
+	r[2] = (uint32_t) cr[2];
+#else
+	if (__get_cpuid_max(0x80000000, NULL) < 0x80000006)
+		return 0;
+	__cpuid(0x80000006, r[0], r[1], r[2], r[3]);
+#endif
+	return (r[2] >> 16) * 1024;
+}
+
+static inline __m128i CN_TARGET("aes,sse2") cn_sl_xor(__m128i x)
+{
+	__m128i t = _mm_slli_si128(x, 4);
+	x = _mm_xor_si128(x, t);
+	t = _mm_slli_si128(t, 4);
+	x = _mm_xor_si128(x, t);
+	t = _mm_slli_si128(t, 4);
+	return _mm_xor_si128(x, t);
+}
+
+#define CN_AESNI_GENKEY(rcon, k0, k1, o0, o1) { \
+	__m128i t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k1, rcon), 0xFF); \
+	o0 = _mm_xor_si128(cn_sl_xor(k0), t); \
+	t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(o0, 0x00), 0xAA); \
+	o1 = _mm_xor_si128(cn_sl_xor(k1), t); \
+}
+
+/* the 10 first round keys of the AES-256 schedule, like aesb_expand_key() */
+static inline void CN_TARGET("aes,sse2") cn_aesni_expand_key(const uint8_t *key, __m128i *k)
+{
+	k[0] = _mm_loadu_si128((const __m128i*) key);
+	k[1] = _mm_loadu_si128((const __m128i*) (key + 16));
+	CN_AESNI_GENKEY(0x01, k[0], k[1], k[2], k[3]);
+	CN_AESNI_GENKEY(0x02, k[2], k[3], k[4], k[5]);
+	CN_AESNI_GENKEY(0x04, k[4], k[5], k[6], k[7]);
+	CN_AESNI_GENKEY(0x08, k[6], k[7], k[8], k[9]);
+}
+
+#define CN_AESNI_ROUNDS(k, x) { \
+	for (int r = 0; r < 10; r++) { \
+		x[0] = _mm_aesenc_si128(x[0], k[r]); x[1] = _mm_aesenc_si128(x[1], k[r]); \
+		x[2] = _mm_aesenc_si128(x[2], k[r]); x[3] = _mm_aesenc_si128(x[3], k[r]); \
+		x[4] = _mm_aesenc_si128(x[4], k[r]); x[5] = _mm_aesenc_si128(x[5], k[r]); \
+		x[6] = _mm_aesenc_si128(x[6], k[r]); x[7] = _mm_aesenc_si128(x[7], k[r]); \
+	} \
+}
+
+/* one pseudo round with both implementations, on a fixed key and block */
+static int CN_TARGET("aes,sse2") cn_aesni_check(void)
+{
+	uint8_t _ALIGN(16) key[32], soft[10 * 16], block[8 * 16], ref[8 * 16];
+	__m128i k[10], x[8];
+
+	for (int i = 0; i < 32; i++) key[i] = (uint8_t) (i * 0x1b + 5);
+	for (int i = 0; i < 128; i++) block[i] = ref[i] = (uint8_t) (i * 0x35 + 3);
+	aesb_expand_key(key, soft);
+	for (int p = 0; p < 8; p++)
+		aesb_pseudo_round_mut(&ref[p * 16], soft);
+
+	cn_aesni_expand_key(key, k);
+	for (int p = 0; p < 8; p++)
+		x[p] = _mm_load_si128((const __m128i*) &block[p * 16]);
+	CN_AESNI_ROUNDS(k, x);
+	for (int p = 0; p < 8; p++)
+		_mm_store_si128((__m128i*) &block[p * 16], x[p]);
+
+	return !memcmp(soft, k, sizeof(soft)) && !memcmp(block, ref, sizeof(ref));
+}
+
+#endif /* CN_CPU_AESNI */
+
+/* 1 when the AES-NI loops can be used, checked once */
+static int cn_cpu_aesni(void)
+{
+	static int aesni = -1;
+	if (aesni == -1) {
+#if defined(CN_CPU_AESNI)
+		aesni = cn_cpu_has_aesni() && cn_aesni_check();
+#else
+		aesni = 0;
+#endif
+	}
+	return aesni;
+}
+
+/*
+ * the interleaved loop only helps while both scratchpads stay in the L2,
+ * else the two hashes are faster one after the other
+ */
+static int cn_cpu_interleave(size_t memory)
+{
+	static uint32_t l2 = UINT32_MAX;
+	if (l2 == UINT32_MAX) {
+#if defined(CN_CPU_AESNI)
+		l2 = cn_cpu_l2_size();
+#else
+		l2 = 0;
+#endif
+	}
+	return 2 * memory <= l2;
+}
@@ -0,0 +1,232 @@
+/*
+ * CryptoNight hash on the cpu, one or two inputs at once. The main loops
+ * of two hashes can be interleaved to overlap their scratchpad accesses.
+ *
+ * required macros:
+ * CN_MEMORY, CN_ITER, CN_MASK (offset mask of the 16 bytes blocks),
+ * CN_STORE_VARIANT, CN_FN
+ *
+ * and the static keccak_hash_process(), keccak_hash_permutation() and
+ * extra_hashes[] of the including file
+ */
+
+static __thread uint8_t *CN_FN(long_state) = NULL;
+
+/* fill the scratchpad with the aes rounds of the keccak state */
+static void CN_FN(explode_soft)(const uint8_t *key, const uint8_t *init, uint8_t *ls)
+{
+	uint8_t _ALIGN(16) k[10 * AES_BLOCK_SIZE];
+	uint8_t _ALIGN(16) text[INIT_SIZE_BYTE];
+
+	aesb_expand_key(key, k);
+	memcpy(text, init, INIT_SIZE_BYTE);
+	for (size_t i = 0; i < CN_MEMORY; i += INIT_SIZE_BYTE) {
+		for (int p = 0; p < INIT_SIZE_BLK; p++)
+			aesb_pseudo_round_mut(&text[p * AES_BLOCK_SIZE], k);
+		memcpy(&ls[i], text, INIT_SIZE_BYTE);
+	}
+}
+
+static void CN_FN(implode_soft)(const uint8_t *key, uint8_t *init, const uint8_t *ls)
+{
+	uint8_t _ALIGN(16) k[10 * AES_BLOCK_SIZE];
+	uint64_t _ALIGN(16) text[INIT_SIZE_BYTE / 8];
+
+	aesb_expand_key(key, k);
+	memcpy(text, init, INIT_SIZE_BYTE);
+	for (size_t i = 0; i < CN_MEMORY; i += INIT_SIZE_BYTE) {
+		const uint64_t *src = (const uint64_t*) &ls[i];
+		for (int p = 0; p < INIT_SIZE_BLK; p++) {
+			text[p * 2] ^= src[p * 2];
+			text[p * 2 + 1] ^= src[p * 2 + 1];
+			aesb_pseudo_round_mut((uint8_t*) &text[p * 2], k);
+		}
+	}
+	memcpy(init, text, INIT_SIZE_BYTE);
+}
+
+static void CN_FN(loop_soft)(uint8_t *ls, const uint8_t *sk, const int variant, const uint64_t tweak)
+{
+	uint64_t _ALIGN(16) a[2], b[2], c[2];
+	const uint64_t *k = (const uint64_t*) sk;
+
+	a[0] = k[0] ^ k[4]; a[1] = k[1] ^ k[5];
+	b[0] = k[2] ^ k[6]; b[1] = k[3] ^ k[7];
+
+	for (size_t i = 0; i < CN_ITER / 2; i++) {
+		uint64_t *p = (uint64_t*) &ls[a[0] & CN_MASK];
+		uint64_t hi, lo;
+
+		aesb_single_round((const uint8_t*) p, (uint8_t*) c, (uint8_t*) a);
+		p[0] = c[0] ^ b[0];
+		p[1] = c[1] ^ b[1];
+		CN_STORE_VARIANT(p, variant);
+
+		p = (uint64_t*) &ls[c[0] & CN_MASK];
+		lo = cn_umul128(c[0], p[0], &hi);
+		a[0] += hi;
+		a[1] += lo;
+		hi = p[0]; lo = p[1];
+		p[0] = a[0];
+		p[1] = variant ? a[1] ^ tweak : a[1];
+		a[0] ^= hi;
+		a[1] ^= lo;
+		b[0] = c[0]; b[1] = c[1];
+	}
+}
+
+#if defined(CN_CPU_AESNI)
+
+static void CN_TARGET("aes,sse2") CN_FN(explode_aesni)(const uint8_t *key, const uint8_t *init, uint8_t *ls)
+{
+	__m128i k[10], x[8];
+
+	cn_aesni_expand_key(key, k);
+	for (int p = 0; p < 8; p++)
+		x[p] = _mm_loadu_si128((const __m128i*) &init[p * AES_BLOCK_SIZE]);
+	for (size_t i = 0; i < CN_MEMORY; i += INIT_SIZE_BYTE) {
+		CN_AESNI_ROUNDS(k, x);
+		for (int p = 0; p < 8; p++)
+			_mm_store_si128((__m128i*) &ls[i + p * AES_BLOCK_SIZE], x[p]);
+	}
+}
+
+static void CN_TARGET("aes,sse2") CN_FN(implode_aesni)(const uint8_t *key, uint8_t *init, const uint8_t *ls)
+{
+	__m128i k[10], x[8];
+
+	cn_aesni_expand_key(key, k);
+	for (int p = 0; p < 8; p++)
+		x[p] = _mm_loadu_si128((const __m128i*) &init[p * AES_BLOCK_SIZE]);
+	for (size_t i = 0; i < CN_MEMORY; i += INIT_SIZE_BYTE) {
+		for (int p = 0; p < 8; p++)
+			x[p] = _mm_xor_si128(x[p], _mm_load_si128((const __m128i*) &ls[i + p * AES_BLOCK_SIZE]));
+		CN_AESNI_ROUNDS(k, x);
+	}
+	for (int p = 0; p < 8; p++)
+		_mm_storeu_si128((__m128i*) &init[p * AES_BLOCK_SIZE], x[p]);
+}
+
+/* half a main loop iteration of lane n, same steps as loop_soft() */
+#define CN_AESNI_STEP(n) { \
+	uint8_t *p = &l##n[a##n[0] & CN_MASK]; \
+	uint64_t hi, lo, *q; \
+	__m128i cx = _mm_aesenc_si128(_mm_load_si128((const __m128i*) p), _mm_set_epi64x((int64_t) a##n[1], (int64_t) a##n[0])); \
+	_mm_store_si128((__m128i*) p, _mm_xor_si128(bx##n, cx)); \
+	CN_STORE_VARIANT(p, variant##n); \
+	const uint64_t c0 = (uint64_t) _mm_cvtsi128_si64(cx); \
+	bx##n = cx; \
+	q = (uint64_t*) &l##n[c0 & CN_MASK]; \
+	lo = cn_umul128(c0, q[0], &hi); \
+	a##n[0] += hi; \
+	a##n[1] += lo; \
+	hi = q[0]; lo = q[1]; \
+	q[0] = a##n[0]; \
+	q[1] = variant##n ? a##n[1] ^ tweak##n : a##n[1]; \
+	a##n[0] ^= hi; \
+	a##n[1] ^= lo; \
+}
+
+static void CN_TARGET("aes,sse2") CN_FN(loop_aesni)(uint8_t *l0, const uint8_t *sk, const int variant0, const uint64_t tweak0)
+{
+	const uint64_t *k = (const uint64_t*) sk;
+	uint64_t a0[2] = { k[0] ^ k[4], k[1] ^ k[5] };
+	__m128i bx0 = _mm_set_epi64x((int64_t) (k[3] ^ k[7]), (int64_t) (k[2] ^ k[6]));
+
+	for (size_t i = 0; i < CN_ITER / 2; i++)
+		CN_AESNI_STEP(0);
+}
+
+static void CN_TARGET("aes,sse2") CN_FN(loop_aesni_x2)(uint8_t *l0, uint8_t *l1, const uint8_t *sk0, const uint8_t *sk1,
+	const int variant0, const int variant1, const uint64_t tweak0, const uint64_t tweak1)
+{
+	const uint64_t *k0 = (const uint64_t*) sk0;
+	const uint64_t *k1 = (const uint64_t*) sk1;
+	uint64_t a0[2] = { k0[0] ^ k0[4], k0[1] ^ k0[5] };
+	uint64_t a1[2] = { k1[0] ^ k1[4], k1[1] ^ k1[5] };
+	__m128i bx0 = _mm_set_epi64x((int64_t) (k0[3] ^ k0[7]), (int64_t) (k0[2] ^ k0[6]));
+	__m128i bx1 = _mm_set_epi64x((int64_t) (k1[3] ^ k1[7]), (int64_t) (k1[2] ^ k1[6]));
+
+	for (size_t i = 0; i < CN_ITER / 2; i++) {
+		CN_AESNI_STEP(0);
+		CN_AESNI_STEP(1);
+	}
+}
+
+#undef CN_AESNI_STEP
+
+#endif /* CN_CPU_AESNI */
+
+static void CN_FN(explode)(union cn_slow_hash_state *state, uint64_t *tweak, const uint8_t *in,
+	const size_t len, const int variant, uint8_t *ls, const int aesni)
+{
+	keccak_hash_process(&state->hs, in, len);
+	*tweak = variant ? *((const uint64_t*) (in + 35)) ^ state->hs.w[24] : 0;
+#if defined(CN_CPU_AESNI)
+	if (aesni)
+		CN_FN(explode_aesni)(state->hs.b, state->init, ls);
+	else
+#endif
+	CN_FN(explode_soft)(state->hs.b, state->init, ls);
+}
+
+static void CN_FN(implode)(union cn_slow_hash_state *state, const uint8_t *ls, const int aesni, void *output)
+{
+#if defined(CN_CPU_AESNI)
+	if (aesni)
+		CN_FN(implode_aesni)(&state->hs.b[32], state->init, ls);
+	else
+#endif
+	CN_FN(implode_soft)(&state->hs.b[32], state->init, ls);
+	keccak_hash_permutation(&state->hs);
+
+	int extra_algo = state->hs.b[0] & 3;
+	extra_hashes[extra_algo](state, 200, output);
+	if (opt_debug) applog(LOG_DEBUG, "extra algo=%d", extra_algo);
+}
+
+/* count (1 or 2) inputs of len bytes, one after the other, 32 bytes outputs */
+static void CN_FN(hash_lanes)(void* output, const void* input, const size_t len, const int variant, const int count)
+{
+	union cn_slow_hash_state state[2];
+	uint64_t tweak[2];
+	const int aesni = cn_cpu_aesni();
+	uint8_t *ls = CN_FN(long_state);
+
+	if (!ls) {
+		ls = CN_FN(long_state) = cn_cpu_alloc(2 * CN_MEMORY);
+		if (!ls) {
+			applog(LOG_ERR, "cryptonight: scratchpad allocation failed");
+			exit(1);
+		}
+	}
+
+#if defined(CN_CPU_AESNI)
+	if (aesni && count == 2 && cn_cpu_interleave(CN_MEMORY)) {
+		CN_FN(explode)(&state[0], &tweak[0], (const uint8_t*) input, len, variant, ls, aesni);
+		CN_FN(explode)(&state[1], &tweak[1], (const uint8_t*) input + len, len, variant, &ls[CN_MEMORY], aesni);
+		CN_FN(loop_aesni_x2)(ls, &ls[CN_MEMORY], state[0].k, state[1].k, variant, variant, tweak[0], tweak[1]);
+		CN_FN(implode)(&state[0], ls, aesni, output);
+		CN_FN(implode)(&state[1], &ls[CN_MEMORY], aesni, (uint8_t*) output + 32);
+		return;
+	}
+#endif
+
+	// one hash after the other, in the same (cached) scratchpad
+	for (int n = 0; n < count; n++) {
+		CN_FN(explode)(&state[n], &tweak[n], (const uint8_t*) input + n * len, len, variant, ls, aesni);
+#if defined(CN_CPU_AESNI)
+		if (aesni)
+			CN_FN(loop_aesni)(ls, state[n].k, variant, tweak[n]);
+		else
+#endif
+		CN_FN(loop_soft)(ls, state[n].k, variant, tweak[n]);
+		CN_FN(implode)(&state[n], ls, aesni, (uint8_t*) output + n * 32);
+	}
+}
+
+#undef CN_MEMORY
+#undef CN_ITER
+#undef CN_MASK
+#undef CN_STORE_VARIANT
+#undef CN_FN
@@ -126,23 +126,27 @@ extern "C" int scanhash_cryptonight(int thr_id, struct work* work, uint32_t max_
 
 		if(resNonces[0] != UINT32_MAX)
 		{
-			uint32_t vhash[8];
-			uint32_t tempdata[19];
-			uint32_t *tempnonceptr = (uint32_t*)(((char*)tempdata) + 39);
-			memcpy(tempdata, pdata, 76);
-			*tempnonceptr = resNonces[0];
-			cryptonight_hash_variant(vhash, tempdata, 76, variant);
-			if(vhash[7] <= Htarg && fulltest(vhash, ptarget))
+			uint32_t vhash[2][8];
+			uint32_t tempdata[2][19];
+			memcpy(tempdata[0], pdata, 76);
+			*((uint32_t*)(((char*)tempdata[0]) + 39)) = resNonces[0];
+			if(resNonces[1] != UINT32_MAX) {
+				// both nonces at once, the cpu hash loops are interleaved
+				memcpy(tempdata[1], tempdata[0], 76);
+				*((uint32_t*)(((char*)tempdata[1]) + 39)) = resNonces[1];
+				cryptonight_hash_variant_x2(vhash, tempdata, 76, variant);
+			} else {
+				cryptonight_hash_variant(vhash[0], tempdata[0], 76, variant);
+			}
+			if(vhash[0][7] <= Htarg && fulltest(vhash[0], ptarget))
 			{
 				res = 1;
 				work->nonces[0] = resNonces[0];
-				work_set_target_ratio(work, vhash);
+				work_set_target_ratio(work, vhash[0]);
 				// second nonce
 				if(resNonces[1] != UINT32_MAX)
 				{
-					*tempnonceptr = resNonces[1];
-					cryptonight_hash_variant(vhash, tempdata, 76, variant);
-					if(vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
+					if(vhash[1][7] <= Htarg && fulltest(vhash[1], ptarget)) {
 						res++;
 						work->nonces[1] = resNonces[1];
 					} else {
@@ -150,7 +154,7 @@ extern "C" int scanhash_cryptonight(int thr_id, struct work* work, uint32_t max_
 					}
 				}
 				goto done;
-			} else if (vhash[7] > Htarg) {
+			} else if (vhash[0][7] > Htarg) {
 				gpu_increment_reject(thr_id);
 				if (!opt_quiet)
 					gpulog(LOG_WARNING, thr_id, "result for nonce %08x does not validate on CPU!", resNonces[0]);
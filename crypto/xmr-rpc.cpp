@@ -14,13 +14,16 @@
 #ifdef _MSC_VER
 #include "mman.h" // mmap
 #include <direct.h> // _mkdir
+#include <io.h> // _chsize
 #define chdir(x) _chdir(x)
 #define mkdir(x) _mkdir(x)
 #define getcwd(d,sz) _getcwd(d,sz)
 #define unlink(x) _unlink(x)
+#define ftruncate(fd,sz) _chsize(fd,(long)(sz))
 #define PATH_MAX MAX_PATH
 #else
 #include <sys/mman.h> // mmap
+#include <fcntl.h> // open
 #endif
 
 #if defined(__APPLE__) && !defined(MAP_HUGETLB)
@@ -80,6 +83,23 @@ static time_t prev_save = 0;
 static struct scratchpad_hi current_scratchpad_hi;
 static struct addendums_array_entry add_arr[WILD_KECCAK_ADDENDUMS_ARRAY_SIZE];
 
+// scratchpad changes vs file writes (background compaction)
+static pthread_mutex_t scratchpad_lock = PTHREAD_MUTEX_INITIALIZER;
+// the journal records apply to the scratchpad file of the same generation
+static uint64_t scratchpad_generation = 0;
+static FILE *scratchpad_journal = NULL;
+static uint64_t scratchpad_journal_len = 0;
+static volatile bool scratchpad_compacting = false;
+// records appended while a new generation is written, for its journal
+static bool scratchpad_carry_on = false;
+static uint8_t *scratchpad_carry = NULL;
+static size_t scratchpad_carry_len = 0;
+static bool scratchpad_legacy_file = false;
+#ifndef WIN32
+static void *pscratchpad_map = NULL;
+static size_t pscratchpad_map_len = 0;
+#endif
+
 static char *rpc2_job_id = NULL;
 static char *rpc2_blob = NULL;
 static uint32_t rpc2_target = 0;
@@ -177,11 +197,80 @@ err_out:
 	return false;
 }
 
+static void scratchpad_journal_path(char *path, size_t len)
+{
+	snprintf(path, len, "%s.journal", pscratchpad_local_cache);
+}
+
+static uint64_t scratchpad_journal_sum(const struct scratchpad_journal_rec *rec, const uint64_t *data)
+{
+	struct scratchpad_journal_rec r = *rec;
+	const uint8_t *p = (const uint8_t*) &r;
+	uint64_t h = 0xcbf29ce484222325ULL; // fnv-1a
+	r.checksum = 0;
+	for (size_t i = 0; i < sizeof(r); i++)
+		h = (h ^ p[i]) * 0x100000001b3ULL;
+	p = (const uint8_t*) data;
+	for (size_t i = 0; i < (size_t) rec->count * 8; i++)
+		h = (h ^ p[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+static void scratchpad_journal_write(struct scratchpad_journal_rec *rec, const uint64_t *data)
+{
+	rec->generation = scratchpad_generation;
+	rec->checksum = scratchpad_journal_sum(rec, data);
+
+	if (fwrite(rec, sizeof(*rec), 1, scratchpad_journal) != 1 ||
+		(rec->count && fwrite(data, 8, (size_t) rec->count, scratchpad_journal) != rec->count) ||
+		fflush(scratchpad_journal) == EOF) {
+		applog(LOG_ERR, "failed to write scratchpad journal: %s", strerror(errno));
+		return;
+	}
+	scratchpad_journal_len += sizeof(*rec) + rec->count * 8;
+}
+
+/* keep a copy of the record for the journal of the generation being written */
+static void scratchpad_carry_append(const struct scratchpad_journal_rec *rec, const uint64_t *data)
+{
+	size_t len = sizeof(*rec) + (size_t) rec->count * 8;
+	uint8_t *buf = (uint8_t*) realloc(scratchpad_carry, scratchpad_carry_len + len);
+	if (!buf) {
+		// the new generation will miss it, keep the current one
+		applog(LOG_ERR, "scratchpad journal: out of memory");
+		scratchpad_carry_on = false;
+		return;
+	}
+	memcpy(buf + scratchpad_carry_len, rec, sizeof(*rec));
+	if (rec->count)
+		memcpy(buf + scratchpad_carry_len + sizeof(*rec), data, (size_t) rec->count * 8);
+	scratchpad_carry = buf;
+	scratchpad_carry_len += len;
+}
+
+/* append a scratchpad change, not journaled while the journal is replayed */
+static void scratchpad_journal_append(uint32_t type, const struct scratchpad_hi *hi, const uint64_t *data, uint64_t count)
+{
+	struct scratchpad_journal_rec rec = { 0 };
+	if (!scratchpad_journal)
+		return;
+
+	rec.magic = SCRATCHPAD_JOURNAL_MAGIC;
+	rec.type = type;
+	if (hi) rec.hi = *hi;
+	rec.count = count;
+
+	if (scratchpad_carry_on)
+		scratchpad_carry_append(&rec, data);
+	scratchpad_journal_write(&rec, data);
+}
+
 static void reset_scratchpad(void)
 {
 	current_scratchpad_hi.height = 0;
 	scratchpad_size = 0;
 	//unlink(scratchpad_file);
+	scratchpad_journal_append(SCRATCHPAD_JOURNAL_RESET, NULL, NULL, 0);
 }
 
 static bool patch_scratchpad_with_addendum(uint64_t global_add_startpoint, uint64_t* padd_buff, size_t count/*uint64 units*/)
@@ -244,6 +333,7 @@ static bool revert_scratchpad()
 			continue;
 		pop_addendum(&add_arr[i]);
 	}
+	scratchpad_journal_append(SCRATCHPAD_JOURNAL_REVERT, NULL, NULL, 0);
 	return true;
 }
 
@@ -269,6 +359,19 @@ static bool push_addendum_info(struct scratchpad_hi* pprev_hi, uint64_t size /*
 	return true;
 }
 
+// apply the addendum of block hi, also used to replay the journal
+static bool push_block_addendum(const struct scratchpad_hi *hi, uint64_t* padd_buff, size_t count/*uint64 units*/)
+{
+	if(!apply_addendum(padd_buff, count))
+		return false;
+
+	push_addendum_info(&current_scratchpad_hi, count);
+	current_scratchpad_hi = *hi;
+
+	scratchpad_journal_append(SCRATCHPAD_JOURNAL_APPLY, hi, padd_buff, count);
+	return true;
+}
+
 static bool addendum_decode(const json_t *addm)
 {
 	struct scratchpad_hi hi;
@@ -344,16 +447,13 @@ static bool addendum_decode(const json_t *addm)
 		goto err_out;
 	}
 
-	if(!apply_addendum(padd_buff, add_len/16)) {
+	old_height = current_scratchpad_hi.height;
+	if(!push_block_addendum(&hi, padd_buff, add_len/16)) {
 		applog(LOG_ERR, "JSON Failed to apply_addendum!");
 		goto err_out;
 	}
 	free(padd_buff);
 
-	push_addendum_info(&current_scratchpad_hi, add_len/16);
-	old_height = current_scratchpad_hi.height;
-	current_scratchpad_hi = hi;
-
 	if (!opt_quiet && !opt_quiet_start)
 		applog(LOG_BLUE, "ADDENDUM APPLIED: Block %lld", (long long) current_scratchpad_hi.height);
 
@@ -377,19 +477,22 @@ static bool addendums_decode(const json_t *job)
 		return false;
 	}
 
+	bool ret = true;
 	size_t add_sz = json_array_size(paddms);
-	for (size_t i = 0; i < add_sz; i++)
+	pthread_mutex_lock(&scratchpad_lock);
+	for (size_t i = 0; i < add_sz && ret; i++)
 	{
 		json_t *addm = json_array_get(paddms, i);
 		if (!addm) {
 			applog(LOG_ERR, "Internal error: failed to get addm");
-			return false;
+			ret = false;
 		}
-		if(!addendum_decode(addm))
-			return false;
+		else if(!addendum_decode(addm))
+			ret = false;
 	}
+	pthread_mutex_unlock(&scratchpad_lock);
 
-	return true;
+	return ret;
 }
 
 bool rpc2_job_decode(const json_t *job, struct work *work)
@@ -495,6 +598,7 @@ bool rpc2_stratum_job(struct stratum_ctx *sctx, json_t *id, json_t *params)
 	ret = rpc2_job_decode(params, &rpc2_work);
 	// update miner threads work
 	ret = ret && rpc2_stratum_gen_work(sctx, &g_work);
+	g_work_changed();
 	restart_threads();
 	pthread_mutex_unlock(&rpc2_work_lock);
 	return ret;
@@ -503,7 +607,7 @@ bool rpc2_stratum_job(struct stratum_ctx *sctx, json_t *id, json_t *params)
 bool rpc2_stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 {
 //	pthread_mutex_lock(&rpc2_work_lock);
-	memcpy(work, &rpc2_work, sizeof(struct work));
+	work_copy(work, &rpc2_work);
 	if (stratum_diff != sctx->job.diff) {
 		char sdiff[32] = { 0 };
 		stratum_diff = sctx->job.diff;
@@ -646,66 +750,244 @@ err_out:
 	return false;
 }
 
+/* the header page and the data of a scratchpad file, unlinked on errors */
+static bool scratchpad_write_file(const char *fname, const char *page, const uint64_t *data, uint64_t count, bool do_fsync)
+{
+	const uint64_t sz = WILD_KECCAK_SCRATCHPAD_BUFFSIZE;
+	FILE *fp;
+
+	unlink(fname);
+	fp = fopen(fname, "wbx");
+	if (!fp) {
+		applog(LOG_ERR, "failed to create file %s: %s", fname, strerror(errno));
+		return false;
+	}
+	if ((fwrite(page, SCRATCHPAD_MAP_DATA_OFFSET, 1, fp) != 1) ||
+		(fwrite(data, 8, (size_t) count, fp) != count) ||
+		(fflush(fp) == EOF)) {
+			applog(LOG_ERR, "failed to write file %s: %s", fname, strerror(errno));
+			fclose(fp);
+			unlink(fname);
+			return false;
+	}
+#ifndef WIN32
+	// sparse tail, the whole buffer can be mapped from the file
+	if (ftruncate(fileno(fp), (off_t) (SCRATCHPAD_MAP_DATA_OFFSET + sz)) == -1)
+		applog(LOG_WARNING, "failed to extend file %s: %s", fname, strerror(errno));
+	if (do_fsync && fsync(fileno(fp)) == -1) {
+		applog(LOG_ERR, "failed to fsync file %s: %s", fname, strerror(errno));
+		fclose(fp);
+		unlink(fname);
+		return false;
+	}
+#endif
+	if (fclose(fp) == EOF) {
+		applog(LOG_ERR, "failed to write file %s: %s", fname, strerror(errno));
+		unlink(fname);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Write the scratchpad as a new generation of the cache file (header +
+ * data at SCRATCHPAD_MAP_DATA_OFFSET) and empty the journal, which only
+ * holds the changes since the last write. The lock is held to copy the
+ * scratchpad, then to switch the generation: the journal records added
+ * during the file write are carried to the new journal.
+ */
 bool store_scratchpad_to_file(bool do_fsync)
 {
 	char file_name_buff[PATH_MAX] = { 0 };
-	FILE *fp;
-	int ret;
+	char journal_file[PATH_MAX] = { 0 };
+	char page[SCRATCHPAD_MAP_DATA_OFFSET] = { 0 };
+	struct scratchpad_map_header mh = { 0 };
+	uint64_t *snap, snap_size;
+	bool ok;
 
 	if(opt_algo != ALGO_WILDKECCAK) return true;
 	if(!scratchpad_size || !pscratchpad_buff) return true;
 
 	snprintf(file_name_buff, sizeof(file_name_buff), "%s.tmp", pscratchpad_local_cache);
-	unlink(file_name_buff);
-	fp = fopen(file_name_buff, "wbx");
-	if (!fp) {
-		applog(LOG_ERR, "failed to create file %s: %s", file_name_buff, strerror(errno));
+
+	pthread_mutex_lock(&scratchpad_lock);
+	memcpy(mh.magic, SCRATCHPAD_MAP_MAGIC, sizeof(mh.magic));
+	mh.version = SCRATCHPAD_MAP_VERSION;
+	mh.data_offset = SCRATCHPAD_MAP_DATA_OFFSET;
+	mh.generation = scratchpad_generation + 1;
+	memcpy(mh.sf.add_arr, add_arr, sizeof(mh.sf.add_arr));
+	mh.sf.current_hi = current_scratchpad_hi;
+	mh.sf.scratchpad_size = scratchpad_size;
+	memcpy(page, &mh, sizeof(mh));
+	snap_size = scratchpad_size;
+	snap = (uint64_t*) malloc((size_t) snap_size * 8);
+	if (snap) {
+		memcpy(snap, pscratchpad_buff, (size_t) snap_size * 8);
+		scratchpad_carry_on = true;
+		scratchpad_carry_len = 0;
+	}
+	pthread_mutex_unlock(&scratchpad_lock);
+
+	if (!snap) {
+		applog(LOG_ERR, "failed to allocate the scratchpad copy (%zu bytes)", (size_t) snap_size * 8);
 		return false;
 	}
+	ok = scratchpad_write_file(file_name_buff, page, snap, snap_size, do_fsync);
+	free(snap);
 
-	struct scratchpad_file_header sf = { 0 };
-	memcpy(sf.add_arr, add_arr, sizeof(sf.add_arr));
-	sf.current_hi = current_scratchpad_hi;
-	sf.scratchpad_size = scratchpad_size;
-
-	if ((fwrite(&sf, sizeof(sf), 1, fp) != 1) ||
-		(fwrite(pscratchpad_buff, 8, (size_t) scratchpad_size, fp) != scratchpad_size)) {
-			applog(LOG_ERR, "failed to write file %s: %s", file_name_buff, strerror(errno));
-			fclose(fp);
-			unlink(file_name_buff);
-			return false;
+	pthread_mutex_lock(&scratchpad_lock);
+	if (ok && !scratchpad_carry_on) {
+		// a change is missing in the carried records, keep the current generation
+		unlink(file_name_buff);
+		ok = false;
 	}
-	fflush(fp);
-	/*if (do_fsync) {
-		if (fsync(fileno(fp)) == -1) {
-			applog(LOG_ERR, "failed to fsync file %s: %s", file_name_buff, strerror(errno));
-			fclose(fp);
+	if (ok) {
+#ifdef WIN32
+		unlink(pscratchpad_local_cache); // rename() doesn't replace
+#endif
+		if (rename(file_name_buff, pscratchpad_local_cache) == -1) {
+			applog(LOG_ERR, "failed to rename %s to %s: %s",
+				file_name_buff, pscratchpad_local_cache, strerror(errno));
 			unlink(file_name_buff);
-			return false;
+			ok = false;
 		}
-	}*/
-	if (fclose(fp) == EOF) {
-		applog(LOG_ERR, "failed to write file %s: %s", file_name_buff, strerror(errno));
-		unlink(file_name_buff);
-		return false;
 	}
-	ret = rename(file_name_buff, pscratchpad_local_cache);
-	if (ret == -1) {
-		applog(LOG_ERR, "failed to rename %s to %s: %s",
-			file_name_buff, pscratchpad_local_cache, strerror(errno));
-		unlink(file_name_buff);
+	if (ok) {
+		// older journal records are now in the file (and skipped by generation)
+		scratchpad_generation = mh.generation;
+		scratchpad_legacy_file = false;
+		scratchpad_journal_path(journal_file, sizeof(journal_file));
+		if (scratchpad_journal) fclose(scratchpad_journal);
+		scratchpad_journal = fopen(journal_file, "wb");
+		scratchpad_journal_len = 0;
+		if (!scratchpad_journal)
+			applog(LOG_ERR, "failed to create file %s: %s", journal_file, strerror(errno));
+		for (size_t pos = 0; scratchpad_journal && pos < scratchpad_carry_len; ) {
+			struct scratchpad_journal_rec *rec = (struct scratchpad_journal_rec*) &scratchpad_carry[pos];
+			scratchpad_journal_write(rec, (const uint64_t*) &scratchpad_carry[pos + sizeof(*rec)]);
+			pos += sizeof(*rec) + (size_t) rec->count * 8;
+		}
+	}
+	scratchpad_carry_on = false;
+	free(scratchpad_carry);
+	scratchpad_carry = NULL;
+	scratchpad_carry_len = 0;
+	pthread_mutex_unlock(&scratchpad_lock);
+
+	if (ok)
+		applog(LOG_DEBUG, "saved scratchpad to %s (%zu+%zu bytes)", pscratchpad_local_cache,
+			sizeof(page), (size_t)snap_size * 8);
+	return ok;
+}
+
+static void *scratchpad_compact_thread(void *arg)
+{
+	store_scratchpad_to_file(false);
+	scratchpad_compacting = false;
+	return NULL;
+}
+
+/* rewrite the cache file without blocking the stratum thread */
+static void scratchpad_compact_async(void)
+{
+	pthread_t thr;
+	if (scratchpad_compacting || !pscratchpad_local_cache)
+		return;
+	scratchpad_compacting = true;
+	if (pthread_create(&thr, NULL, scratchpad_compact_thread, NULL)) {
+		scratchpad_compacting = false;
+		store_scratchpad_to_file(false);
+		return;
+	}
+	pthread_detach(thr);
+}
+
+/*
+ * Apply the journal records of the loaded generation, a torn or
+ * foreign tail is cut. Then keep the journal open to append.
+ */
+static void scratchpad_journal_replay(void)
+{
+	char journal_file[PATH_MAX] = { 0 };
+	struct scratchpad_journal_rec rec;
+	uint64_t *data = NULL;
+	long good = 0;
+	int applied = 0;
+	FILE *fp;
+
+	scratchpad_journal_path(journal_file, sizeof(journal_file));
+	fp = fopen(journal_file, "r+b");
+	if (fp) {
+		while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+			if (rec.magic != SCRATCHPAD_JOURNAL_MAGIC || rec.generation != scratchpad_generation)
+				break;
+			if (rec.count * 8 > (WILD_KECCAK_SCRATCHPAD_BUFFSIZE))
+				break;
+			data = (uint64_t*) realloc(data, (size_t) rec.count * 8 + 8);
+			if (!data || (rec.count && fread(data, 8, (size_t) rec.count, fp) != rec.count))
+				break;
+			if (scratchpad_journal_sum(&rec, data) != rec.checksum)
+				break;
+			if (rec.type == SCRATCHPAD_JOURNAL_APPLY)
+				push_block_addendum(&rec.hi, data, (size_t) rec.count);
+			else if (rec.type == SCRATCHPAD_JOURNAL_REVERT)
+				revert_scratchpad();
+			else if (rec.type == SCRATCHPAD_JOURNAL_RESET)
+				reset_scratchpad();
+			good = ftell(fp);
+			applied++;
+		}
+		free(data);
+		fflush(fp);
+		if (ftruncate(fileno(fp), good) == -1)
+			applog(LOG_WARNING, "failed to truncate %s: %s", journal_file, strerror(errno));
+		fclose(fp);
+		if (applied && !opt_quiet)
+			applog(LOG_INFO, "Scratchpad journal: %d changes replayed, block %" PRIu64,
+				applied, current_scratchpad_hi.height);
+	}
+
+	scratchpad_journal = fopen(journal_file, fp ? "ab" : "wb");
+	scratchpad_journal_len = (uint64_t) good;
+	if (!scratchpad_journal)
+		applog(LOG_ERR, "failed to open file %s: %s", journal_file, strerror(errno));
+}
+
+static bool scratchpad_check_header(const char *fname, const struct scratchpad_file_header *fh)
+{
+	if ((fh->scratchpad_size*8 > (WILD_KECCAK_SCRATCHPAD_BUFFSIZE)) ||(fh->scratchpad_size%4)) {
+		applog(LOG_ERR, "file %s size invalid (%" PRIu64 "), max=%zu",
+			fname, fh->scratchpad_size*8, (size_t) WILD_KECCAK_SCRATCHPAD_BUFFSIZE);
 		return false;
 	}
-	applog(LOG_DEBUG, "saved scratchpad to %s (%zu+%zu bytes)", pscratchpad_local_cache,
-		sizeof(struct scratchpad_file_header), (size_t)scratchpad_size * 8);
 	return true;
 }
 
+static void scratchpad_loaded(const struct scratchpad_file_header *fh)
+{
+	long flen;
+
+	scratchpad_size = fh->scratchpad_size;
+	current_scratchpad_hi = fh->current_hi;
+	memcpy(&add_arr[0], &fh->add_arr[0], sizeof(fh->add_arr));
+
+	// legacy (downloaded) files have no journal
+	if (!scratchpad_legacy_file)
+		scratchpad_journal_replay();
+
+	flen = (long)scratchpad_size*8;
+	if (!opt_quiet) {
+		applog(LOG_INFO, "Scratchpad size %ld kB at block %" PRIu64, flen/1024, current_scratchpad_hi.height);
+	}
+	prev_save = time(NULL);
+}
+
 /* TODO: repetitive error+log spam handling */
 bool load_scratchpad_from_file(const char *fname)
 {
 	FILE *fp;
-	long flen;
+	struct scratchpad_map_header mh = { 0 };
+	struct scratchpad_file_header fh = { 0 };
 
 	if(opt_algo != ALGO_WILDKECCAK) return true;
 
@@ -717,16 +999,27 @@ bool load_scratchpad_from_file(const char *fname)
 		return false;
 	}
 
-	struct scratchpad_file_header fh = { 0 };
-	if ((fread(&fh, sizeof(fh), 1, fp) != 1)) {
-		applog(LOG_ERR, "read error from %s: %s", fname, strerror(errno));
-		fclose(fp);
-		return false;
+	// versioned cache file, or the plain header of a downloaded one
+	if ((fread(&mh, sizeof(mh), 1, fp) == 1) && !memcmp(mh.magic, SCRATCHPAD_MAP_MAGIC, sizeof(mh.magic))) {
+		if (mh.version != SCRATCHPAD_MAP_VERSION || mh.data_offset < sizeof(mh)) {
+			applog(LOG_ERR, "file %s has an unsupported version (%u)", fname, mh.version);
+			fclose(fp);
+			return false;
+		}
+		fh = mh.sf;
+		scratchpad_legacy_file = false;
+		fseek(fp, (long) mh.data_offset, SEEK_SET);
+	} else {
+		rewind(fp);
+		if ((fread(&fh, sizeof(fh), 1, fp) != 1)) {
+			applog(LOG_ERR, "read error from %s: %s", fname, strerror(errno));
+			fclose(fp);
+			return false;
+		}
+		scratchpad_legacy_file = true;
 	}
 
-	if ((fh.scratchpad_size*8 > (WILD_KECCAK_SCRATCHPAD_BUFFSIZE)) ||(fh.scratchpad_size%4)) {
-		applog(LOG_ERR, "file %s size invalid (%" PRIu64 "), max=%zu",
-			fname, fh.scratchpad_size*8, WILD_KECCAK_SCRATCHPAD_BUFFSIZE);
+	if (!scratchpad_check_header(fname, &fh)) {
 		fclose(fp);
 		return false;
 	}
@@ -736,21 +1029,61 @@ bool load_scratchpad_from_file(const char *fname)
 		fclose(fp);
 		return false;
 	}
+	fclose(fp);
 
-	scratchpad_size = fh.scratchpad_size;
-	current_scratchpad_hi = fh.current_hi;
-	memcpy(&add_arr[0], &fh.add_arr[0], sizeof(fh.add_arr));
-	flen = (long)scratchpad_size*8;
+	scratchpad_generation = scratchpad_legacy_file ? 0 : mh.generation;
+	scratchpad_loaded(&fh);
 
-	if (!opt_quiet) {
-		applog(LOG_INFO, "Scratchpad size %ld kB at block %" PRIu64, flen/1024, current_scratchpad_hi.height);
+	return true;
+}
+
+#ifndef WIN32
+/*
+ * Map the data of a versioned cache file (copy on write), pages are read
+ * on first use instead of loading the whole file at startup
+ */
+static bool map_scratchpad_from_file(const char *fname)
+{
+	const uint64_t sz = WILD_KECCAK_SCRATCHPAD_BUFFSIZE;
+	struct scratchpad_map_header mh = { 0 };
+	struct stat st;
+	void *map;
+	int fd;
+
+	if(opt_algo != ALGO_WILDKECCAK) return false;
+
+	fd = open(fname, O_RDONLY);
+	if (fd == -1)
+		return false;
+	if (read(fd, &mh, sizeof(mh)) != (ssize_t) sizeof(mh) || memcmp(mh.magic, SCRATCHPAD_MAP_MAGIC, sizeof(mh.magic)) ||
+		mh.version != SCRATCHPAD_MAP_VERSION || (mh.data_offset % 4096) || mh.data_offset < sizeof(mh) ||
+		fstat(fd, &st) == -1 || (uint64_t) st.st_size < mh.data_offset + sz ||
+		!scratchpad_check_header(fname, &mh.sf)) {
+		close(fd);
+		return false;
 	}
 
-	fclose(fp);
-	prev_save = time(NULL);
+	map = mmap(0, (size_t) (mh.data_offset + sz), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		applog(LOG_WARNING, "failed to map %s: %s", fname, strerror(errno));
+		return false;
+	}
+
+	pscratchpad_map = map;
+	pscratchpad_map_len = (size_t) (mh.data_offset + sz);
+	pscratchpad_buff = (uint64_t*) ((uint8_t*) map + mh.data_offset);
+	madvise(pscratchpad_buff, (size_t) sz, MADV_RANDOM);
+	madvise(pscratchpad_buff, (size_t) mh.sf.scratchpad_size * 8, MADV_WILLNEED);
+
+	scratchpad_legacy_file = false;
+	scratchpad_generation = mh.generation;
+	scratchpad_loaded(&mh.sf);
 
+	if (opt_debug) applog(LOG_DEBUG, "scratchpad mapped from %s", fname);
 	return true;
 }
+#endif
 
 bool dump_scratchpad_to_file_debug()
 {
@@ -915,6 +1248,22 @@ void GetScratchpad()
 	if (!opt_quiet)
 		applog(LOG_INFO, "Scratchpad file %s", pscratchpad_local_cache);
 
+	while (scratchpad_compacting)
+		sleep(1); // still reads the buffer
+	if (scratchpad_journal) {
+		fclose(scratchpad_journal);
+		scratchpad_journal = NULL;
+	}
+	if (pscratchpad_map) {
+		// reload after an outdated file was deleted
+		munmap(pscratchpad_map, pscratchpad_map_len);
+		pscratchpad_map = NULL;
+		pscratchpad_buff = NULL;
+	}
+
+	if (map_scratchpad_from_file(pscratchpad_local_cache))
+		return;
+
 	pscratchpad_buff = (uint64_t*) mmap(0, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, 0, 0);
 	if(pscratchpad_buff == MAP_FAILED)
 	{
@@ -946,6 +1295,10 @@ void GetScratchpad()
 			exit(1);
 		}
 	}
+
+	// convert a downloaded file to the mapped format, for the next start
+	if (scratchpad_legacy_file)
+		store_scratchpad_to_file(false);
 }
 
 #else /* Windows */
@@ -982,6 +1335,13 @@ void GetScratchpad()
 	if (!opt_quiet)
 		applog(LOG_INFO, "Scratchpad file %s", pscratchpad_local_cache);
 
+	while (scratchpad_compacting)
+		sleep(1); // still reads the buffer
+	if (scratchpad_journal) {
+		fclose(scratchpad_journal);
+		scratchpad_journal = NULL;
+	}
+
 	if (pscratchpad_buff) {
 		reset_scratchpad();
 		wildkeccak_scratchpad_need_update(NULL);
@@ -1020,6 +1380,9 @@ void GetScratchpad()
 		}
 	}
 
+	if (scratchpad_legacy_file)
+		store_scratchpad_to_file(false);
+
 	if (scratchpad_need_update)
 		wildkeccak_scratchpad_need_update(pscratchpad_buff);
 }
@@ -1121,7 +1484,17 @@ static bool rpc2_stratum_getscratchpad(struct stratum_ctx *sctx)
 
 	applog(LOG_DEBUG, "Getting full scratchpad parsed line");
 
+	pthread_mutex_lock(&scratchpad_lock);
+	// the journal doesn't apply to a full scratchpad, until it is saved
+	if (scratchpad_journal) {
+		char journal_file[PATH_MAX] = { 0 };
+		scratchpad_journal_path(journal_file, sizeof(journal_file));
+		fclose(scratchpad_journal);
+		scratchpad_journal = NULL;
+		unlink(journal_file);
+	}
 	ret = rpc2_getfullscratchpad_decode(val);
+	pthread_mutex_unlock(&scratchpad_lock);
 
 out:
 	free(s);
@@ -1306,9 +1679,10 @@ int rpc2_stratum_thread_stuff(struct pool_infos* pool)
 		}
 	}
 
-	/* save every 12 hours */
-	if ((time(NULL) - prev_save) > 12*3600) {
-		store_scratchpad_to_file(false);
+	/* compact a non empty journal every 12 hours, or when it grows */
+	if (opt_algo == ALGO_WILDKECCAK && ((scratchpad_journal_len && (time(NULL) - prev_save) > 12*3600) ||
+		scratchpad_journal_len > SCRATCHPAD_JOURNAL_MAX)) {
+		scratchpad_compact_async();
 		prev_save = time(NULL);
 	}
 
@@ -1316,6 +1690,7 @@ int rpc2_stratum_thread_stuff(struct pool_infos* pool)
 		pthread_mutex_lock(&rpc2_work_lock);
 		rpc2_stratum_gen_work(&stratum, &g_work);
 		g_work_time = time(NULL);
+		g_work_changed();
 		pthread_mutex_unlock(&rpc2_work_lock);
 
 		if (opt_debug) applog(LOG_DEBUG, "Stratum detected new block");
@@ -26,6 +26,38 @@ struct _PACKED scratchpad_file_header {
     uint64_t scratchpad_size;
 };
 
+/* local cache file, the data is page aligned to be mapped */
+#define SCRATCHPAD_MAP_MAGIC "WKSCRPAD"
+#define SCRATCHPAD_MAP_VERSION 2
+#define SCRATCHPAD_MAP_DATA_OFFSET 4096
+
+struct _PACKED scratchpad_map_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t data_offset;
+    uint64_t generation;
+    struct scratchpad_file_header sf;
+};
+
+/* append-only changes since the cache file was written */
+#define SCRATCHPAD_JOURNAL_MAGIC 0x4c4e524a /* JRNL */
+#define SCRATCHPAD_JOURNAL_MAX (16U << 20)
+
+enum {
+    SCRATCHPAD_JOURNAL_APPLY = 1, /* block addendum, count uint64 follow */
+    SCRATCHPAD_JOURNAL_REVERT,
+    SCRATCHPAD_JOURNAL_RESET
+};
+
+struct _PACKED scratchpad_journal_rec {
+    uint32_t magic;
+    uint32_t type;
+    uint64_t generation;
+    struct scratchpad_hi hi;
+    uint64_t count;
+    uint64_t checksum;
+};
+
 
 bool rpc2_job_decode(const json_t *job, struct work *work);
 bool rpc2_stratum_job(struct stratum_ctx *sctx, json_t *id, json_t *params);
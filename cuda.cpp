@@ -24,10 +24,15 @@
 extern "C" {
 #endif
 
-// CUDA Devices on the System
+// CUDA Devices on the System, queried once (the -d option is parsed twice)
+static int cuda_devices = -1;
+
 int cuda_num_devices()
 {
 	int version = 0, GPU_N = 0;
+	if (cuda_devices >= 0)
+		return cuda_devices;
+
 	cudaError_t err = cudaDriverGetVersion(&version);
 	if (err != cudaSuccess) {
 		applog(LOG_ERR, "Unable to query CUDA driver version! Is an nVidia driver installed?");
@@ -45,6 +50,7 @@ int cuda_num_devices()
 		applog(LOG_ERR, "Unable to query number of CUDA devices! Is an nVidia driver installed?");
 		exit(1);
 	}
+	cuda_devices = GPU_N;
 	return GPU_N;
 }
 
@@ -71,6 +77,8 @@ void cuda_devicenames()
 		char vendorname[32] = { 0 };
 		int dev_id = device_map[i];
 		cudaDeviceProp props;
+		if (device_type[i] != DEVICE_TYPE_CUDA)
+			continue;
 		cudaGetDeviceProperties(&props, dev_id);
 
 		device_sm[dev_id] = (props.major * 100 + props.minor * 10);
@@ -89,7 +89,7 @@ template <u32 RB, u32 SM> struct equi;
 
 struct eq_cuda_context_interface
 {
-	//virtual ~eq_cuda_context_interface();
+	virtual ~eq_cuda_context_interface() {}
 
 	virtual void solve(const char *tequihash_header,
 		unsigned int tequihash_header_len,
@@ -131,6 +131,28 @@ public:
 	~eq_cuda_context();
 };
 
+// ---------------------------------------------------------------------------------------------------
+
+struct eq_cpu_mem;
+
+// host reference solver (equi-cpu.cpp), for the cpu device
+class eq_cpu_context : public eq_cuda_context_interface
+{
+	eq_cpu_mem* mem;
+
+	void solve(const char *tequihash_header,
+		unsigned int tequihash_header_len,
+		const char* nonce,
+		unsigned int nonce_len,
+		fn_cancel cancelf,
+		fn_solution solutionf,
+		fn_hashdone hashdonef);
+public:
+	eq_cpu_context(int thr_id);
+	void freemem();
+	~eq_cpu_context();
+};
+
 // RB, SM, SSM, TPB, PACKER... but any change only here will fail..
 #define CONFIG_MODE_1	9, 1248, 12, 640, packer_cantor
 //#define CONFIG_MODE_2	8, 640, 12, 512, packer_default
@@ -0,0 +1,253 @@
+/**
+ * Equihash 200,9 reference solver on the host cpu
+ *
+ * Wagner's algorithm: the 2^21 leaf hashes are generated with the multi
+ * lane blake2b of the verifier, then at each level the rows are radix
+ * sorted on their next 20 bits digit and each pair of a bucket becomes a
+ * row of the next level (the xor of the remaining digits and the two
+ * parent rows). The last level keeps the pairs colliding on both last
+ * digits and the indices are rebuilt from the parents.
+ *
+ * It is slow (seconds per nonce and ~350 MB) but only needs the host, so
+ * the solution handling of scanhash_equihash can run without a gpu.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "eqcuda.hpp"
+#include "equihash.h"
+
+#include <miner.h>
+
+#define EQ_GROUPS    (1U << EQ_DIGIT_BITS)          // blake2b outputs, 2 leaves each
+#define EQ_ROWS_MAX  ((2U << EQ_DIGIT_BITS) + (1U << 18)) // 2^21 leaves + collisions slack
+#define EQ_BATCH     256
+
+struct eq_cpu_mem {
+	uint32_t *digits[2];   // rows of the even and odd levels, EQ_DIGITS - level digits
+	uint32_t *pairs[WK];   // parent rows of the levels 1 to 8
+	uint64_t *keys[2];     // digit << 32 | row, sorted
+	uint32_t rows;
+	uint32_t nsols;
+	uint32_t sols[MAXREALSOLS][EQ_INDICES];
+};
+
+eq_cpu_context::eq_cpu_context(int thr_id)
+{
+	thread_id = thr_id;
+	device_id = -1;
+	throughput = 1;
+	totalblocks = 1;
+	threadsperblock = 1;
+	threadsperblock_digits = 1;
+
+	mem = (eq_cpu_mem*) calloc(1, sizeof(eq_cpu_mem));
+	if (!mem)
+		throw std::runtime_error("cpu solver: out of memory");
+	equi_mem_sz = sizeof(eq_cpu_mem);
+
+	mem->digits[0] = (uint32_t*) malloc((size_t) EQ_ROWS_MAX * EQ_DIGITS * sizeof(uint32_t));
+	mem->digits[1] = (uint32_t*) malloc((size_t) EQ_ROWS_MAX * (EQ_DIGITS - 1) * sizeof(uint32_t));
+	equi_mem_sz += (size_t) EQ_ROWS_MAX * (2 * EQ_DIGITS - 1) * sizeof(uint32_t);
+	for (int l = 1; l < WK; l++) {
+		mem->pairs[l] = (uint32_t*) malloc((size_t) EQ_ROWS_MAX * 2 * sizeof(uint32_t));
+		equi_mem_sz += (size_t) EQ_ROWS_MAX * 2 * sizeof(uint32_t);
+	}
+	mem->keys[0] = (uint64_t*) malloc((size_t) EQ_ROWS_MAX * sizeof(uint64_t));
+	mem->keys[1] = (uint64_t*) malloc((size_t) EQ_ROWS_MAX * sizeof(uint64_t));
+	equi_mem_sz += (size_t) EQ_ROWS_MAX * 2 * sizeof(uint64_t);
+
+	bool failed = !mem->digits[0] || !mem->digits[1] || !mem->keys[0] || !mem->keys[1];
+	for (int l = 1; l < WK; l++)
+		failed |= !mem->pairs[l];
+	if (failed) {
+		freemem();
+		throw std::runtime_error("cpu solver: out of memory");
+	}
+}
+
+void eq_cpu_context::freemem()
+{
+	if (!mem)
+		return;
+	free(mem->digits[0]);
+	free(mem->digits[1]);
+	for (int l = 1; l < WK; l++)
+		free(mem->pairs[l]);
+	free(mem->keys[0]);
+	free(mem->keys[1]);
+	free(mem);
+	mem = NULL;
+}
+
+eq_cpu_context::~eq_cpu_context()
+{
+	freemem();
+}
+
+// the leaves (level 0), row = index
+static void eq_cpu_leaves(eq_cpu_mem *m, const equi_midstate *ms)
+{
+	uint32_t groups[EQ_BATCH];
+	uint8_t hashes[EQ_BATCH][EQ_HASHOUT];
+	uint32_t *digits = m->digits[0];
+
+	for (uint32_t g = 0; g < EQ_GROUPS; g += EQ_BATCH) {
+		for (uint32_t b = 0; b < EQ_BATCH; b++)
+			groups[b] = g + b;
+		equi_blake2b_groups(ms, groups, EQ_BATCH, hashes[0]);
+		for (uint32_t b = 0; b < EQ_BATCH; b++) {
+			uint32_t *row = &digits[(size_t) 2 * (g + b) * EQ_DIGITS];
+			equi_expand_digits(hashes[b], row);
+			equi_expand_digits(&hashes[b][EQ_HASHOUT / 2], row + EQ_DIGITS);
+		}
+	}
+	m->rows = 2 * EQ_GROUPS;
+}
+
+// two 10 bits passes on the digit in the high word, the row order is kept
+static uint64_t* eq_cpu_sort(eq_cpu_mem *m)
+{
+	static const int bits = EQ_DIGIT_BITS / 2;
+	const uint32_t mask = (1U << bits) - 1;
+	uint64_t *src = m->keys[0], *dst = m->keys[1];
+
+	for (int pass = 0; pass < 2; pass++) {
+		const int shift = 32 + pass * bits;
+		uint32_t count[1 << bits] = { 0 };
+		uint32_t sum = 0;
+		for (uint32_t n = 0; n < m->rows; n++)
+			count[(src[n] >> shift) & mask]++;
+		for (uint32_t b = 0; b <= mask; b++) {
+			uint32_t c = count[b];
+			count[b] = sum;
+			sum += c;
+		}
+		for (uint32_t n = 0; n < m->rows; n++)
+			dst[count[(src[n] >> shift) & mask]++] = src[n];
+		std::swap(src, dst);
+	}
+	return src;
+}
+
+// 2^level indices of a row, the subtree with the lowest first index first
+static void eq_cpu_indices(const eq_cpu_mem *m, int level, uint32_t row, uint32_t *out)
+{
+	if (level == 0) {
+		out[0] = row;
+		return;
+	}
+	const uint32_t half = 1U << (level - 1);
+	const uint32_t *p = &m->pairs[level][2 * row];
+	eq_cpu_indices(m, level - 1, p[0], out);
+	eq_cpu_indices(m, level - 1, p[1], out + half);
+	if (out[0] > out[half])
+		std::swap_ranges(out, out + half, out + half);
+}
+
+static void eq_cpu_solution(eq_cpu_mem *m, uint32_t a, uint32_t b)
+{
+	uint32_t sorted[EQ_INDICES];
+	uint32_t *sol;
+
+	if (m->nsols >= MAXREALSOLS)
+		return;
+	sol = m->sols[m->nsols];
+	eq_cpu_indices(m, WK - 1, a, sol);
+	eq_cpu_indices(m, WK - 1, b, sol + EQ_INDICES / 2);
+	if (sol[0] > sol[EQ_INDICES / 2])
+		std::swap_ranges(sol, sol + EQ_INDICES / 2, sol + EQ_INDICES / 2);
+
+	// a same leaf used twice
+	memcpy(sorted, sol, sizeof(sorted));
+	std::sort(sorted, sorted + EQ_INDICES);
+	for (uint32_t i = 1; i < EQ_INDICES; i++) {
+		if (sorted[i] == sorted[i-1])
+			return;
+	}
+	m->nsols++;
+}
+
+// collisions on the first digit of the rows of level - 1
+static void eq_cpu_collide(eq_cpu_mem *m, int level)
+{
+	const uint32_t width = EQ_DIGITS - (level - 1);
+	const uint32_t *cur = m->digits[(level - 1) & 1];
+	uint32_t *next = m->digits[level & 1];
+	uint32_t *pairs = level < WK ? m->pairs[level] : NULL;
+	uint64_t *keys = m->keys[0];
+	uint32_t rows = 0;
+
+	for (uint32_t n = 0; n < m->rows; n++)
+		keys[n] = ((uint64_t) cur[(size_t) n * width] << 32) | n;
+	keys = eq_cpu_sort(m);
+
+	for (uint32_t s = 0, e; s < m->rows; s = e) {
+		const uint32_t digit = (uint32_t) (keys[s] >> 32);
+		for (e = s + 1; e < m->rows && (uint32_t) (keys[e] >> 32) == digit; e++);
+
+		for (uint32_t x = s; x < e; x++) {
+			const uint32_t a = (uint32_t) keys[x];
+			const uint32_t *da = &cur[(size_t) a * width];
+			for (uint32_t y = x + 1; y < e; y++) {
+				const uint32_t b = (uint32_t) keys[y];
+				const uint32_t *db = &cur[(size_t) b * width];
+				if (level == WK) {
+					if (da[1] == db[1])
+						eq_cpu_solution(m, a, b);
+					continue;
+				}
+				if (rows >= EQ_ROWS_MAX)
+					continue;
+				uint32_t *dn = &next[(size_t) rows * (width - 1)];
+				uint32_t any = 0;
+				for (uint32_t d = 1; d < width; d++)
+					any |= dn[d - 1] = da[d] ^ db[d];
+				// same remaining hash, only leads to duplicated indices
+				if (!any)
+					continue;
+				pairs[2 * rows] = a;
+				pairs[2 * rows + 1] = b;
+				rows++;
+			}
+		}
+	}
+	m->rows = rows;
+}
+
+void eq_cpu_context::solve(const char *tequihash_header,
+	unsigned int tequihash_header_len,
+	const char* nonce,
+	unsigned int nonce_len,
+	fn_cancel cancelf,
+	fn_solution solutionf,
+	fn_hashdone hashdonef)
+{
+	uint8_t hdr[140];
+	equi_midstate ms;
+
+	if (tequihash_header_len + nonce_len != sizeof(hdr))
+		throw std::runtime_error("cpu solver: bad header size");
+	memcpy(hdr, tequihash_header, tequihash_header_len);
+	memcpy(&hdr[tequihash_header_len], nonce, nonce_len);
+
+	equi_midstate_init(&ms, hdr);
+	mem->nsols = 0;
+	eq_cpu_leaves(mem, &ms);
+
+	for (int level = 1; level <= WK; level++) {
+		if (cancelf(thread_id)) return;
+		eq_cpu_collide(mem, level);
+	}
+
+	for (uint32_t s = 0; s < mem->nsols; s++) {
+		std::vector<uint32_t> index_vector(mem->sols[s], mem->sols[s] + EQ_INDICES);
+		solutionf(thread_id, index_vector, EQ_DIGIT_BITS, nullptr);
+	}
+
+	if (!mem->nsols)
+		hashdonef(thread_id);
+}
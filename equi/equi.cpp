@@ -16,41 +16,44 @@
 #include <stdbool.h>
 #include <assert.h>
 
-#include "equihash.h"
+#include <algorithm>
 
-//#define USE_LIBSODIUM
+#include "equihash.h"
 
-#ifdef USE_LIBSODIUM
-#include "sodium.h"
-#define blake2b_state crypto_generichash_blake2b_state
-#else
 #include "blake2/blake2.h"
-#define be32toh(x) swab32(x)
+#include "blake2/blake2-config.h"
+#ifndef htole32
 #define htole32(x) (x)
-#define HASHOUT 50
 #endif
 
 #include <miner.h>
 
+#include <emmintrin.h>
+#if defined(_MSC_VER) || defined(__clang__) || (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define EQUI_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#define EQUI_TARGET(x) __attribute__((target(x)))
+#else
+#define EQUI_TARGET(x)
+#endif
+
 static void digestInit(blake2b_state *S, const uint32_t n, const uint32_t k)
 {
 	uint32_t le_N = htole32(n);
 	uint32_t le_K = htole32(k);
-#ifdef USE_LIBSODIUM
-	uint8_t personalization[crypto_generichash_blake2b_PERSONALBYTES] = { 0 };
-
-	memcpy(personalization, "ZcashPoW", 8);
-	memcpy(personalization + 8,  &le_N, 4);
-	memcpy(personalization + 12, &le_K, 4);
-
-	crypto_generichash_blake2b_init_salt_personal(S,
-		NULL, 0, (512 / n) * n / 8, NULL, personalization);
-#else
 	unsigned char personal[] = "ZcashPoW01230123";
 	memcpy(personal + 8, &le_N, 4);
 	memcpy(personal + 12, &le_K, 4);
 	blake2b_param P[1];
-	P->digest_length = HASHOUT;
+	P->digest_length = EQ_HASHOUT;
 	P->key_length = 0;
 	P->fanout = 1;
 	P->depth = 1;
@@ -62,110 +65,396 @@ static void digestInit(blake2b_state *S, const uint32_t n, const uint32_t k)
 	memset(P->salt, 0, sizeof(P->salt));
 	memcpy(P->personal, (const uint8_t *)personal, 16);
 	eq_blake2b_init_param(S, P);
-#endif
 }
 
-static void expandArray(const unsigned char *in, const uint32_t in_len,
-	unsigned char *out, const uint32_t out_len,
-	const uint32_t bit_len, const uint32_t byte_pad)
+static void generateHash(blake2b_state *S, const uint32_t g, uint8_t *hash, const size_t hashLen)
 {
-	assert(bit_len >= 8);
-	assert(8 * sizeof(uint32_t) >= 7 + bit_len);
+	const uint32_t le_g = htole32(g);
+	blake2b_state digest = *S; /* copy */
+	eq_blake2b_update(&digest, (const uint8_t*) &le_g, sizeof(le_g));
+	eq_blake2b_final(&digest, hash, (uint8_t) (hashLen & 0xFF));
+}
 
-	const uint32_t out_width = (bit_len + 7) / 8 + byte_pad;
-	assert(out_len == 8 * out_width * in_len / bit_len);
+// the header fills the first block, the second one is the header tail,
+// the index group and zeros, 144 bytes in total
+void equi_midstate_init(equi_midstate *ms, const uint8_t *hdr)
+{
+	blake2b_state state;
+	digestInit(&state, WN, WK);
+	eq_blake2b_update(&state, hdr, 140);
+	memcpy(ms->h, state.h, sizeof(ms->h));
+	memcpy(ms->tail, &hdr[128], sizeof(ms->tail));
+}
 
-	const uint32_t bit_len_mask = ((uint32_t)1 << bit_len) - 1;
+static const uint64_t equi_blake2b_iv[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+	0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+	0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
 
-	// The acc_bits least-significant bits of acc_value represent a bit sequence
-	// in big-endian order.
-	uint32_t acc_bits = 0;
-	uint32_t acc_value = 0;
-	uint32_t j = 0;
+/*
+ * Last block compression of the group hashes. Only the message words 0
+ * (header tail) and 1 (tail and group) are not zero, the compiler drops
+ * the other additions once the rounds are unrolled.
+ */
+#define EQ_G(a, b, c, d, x, y) { \
+	a = ADD(ADD(a, b), x); d = ROR32(XOR(d, a)); \
+	c = ADD(c, d); b = ROR24(XOR(b, c)); \
+	a = ADD(ADD(a, b), y); d = ROR16(XOR(d, a)); \
+	c = ADD(c, d); b = ROR63(XOR(b, c)); \
+}
 
-	for (uint32_t i = 0; i < in_len; i++)
-	{
-		acc_value = (acc_value << 8) | in[i];
-		acc_bits += 8;
-
-		// When we have bit_len or more bits in the accumulator, write the next
-		// output element.
-		if (acc_bits >= bit_len) {
-			acc_bits -= bit_len;
-			for (uint32_t x = 0; x < byte_pad; x++) {
-				out[j + x] = 0;
-			}
-			for (uint32_t x = byte_pad; x < out_width; x++) {
-				out[j + x] = (
-					// Big-endian
-					acc_value >> (acc_bits + (8 * (out_width - x - 1)))
-				) & (
-					// Apply bit_len_mask across byte boundaries
-					(bit_len_mask >> (8 * (out_width - x - 1))) & 0xFF
-				);
-			}
-			j += out_width;
-		}
+static const uint8_t equi_sigma[10][16] = {
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+	{ 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+	{  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+	{  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+	{  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+	{ 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+	{ 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+	{  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+	{ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+};
+
+#define EQ_ROUND(v, m, r) { \
+	EQ_G(v[0], v[4], v[ 8], v[12], m[equi_sigma[(r)%10][ 0]], m[equi_sigma[(r)%10][ 1]]); \
+	EQ_G(v[1], v[5], v[ 9], v[13], m[equi_sigma[(r)%10][ 2]], m[equi_sigma[(r)%10][ 3]]); \
+	EQ_G(v[2], v[6], v[10], v[14], m[equi_sigma[(r)%10][ 4]], m[equi_sigma[(r)%10][ 5]]); \
+	EQ_G(v[3], v[7], v[11], v[15], m[equi_sigma[(r)%10][ 6]], m[equi_sigma[(r)%10][ 7]]); \
+	EQ_G(v[0], v[5], v[10], v[15], m[equi_sigma[(r)%10][ 8]], m[equi_sigma[(r)%10][ 9]]); \
+	EQ_G(v[1], v[6], v[11], v[12], m[equi_sigma[(r)%10][10]], m[equi_sigma[(r)%10][11]]); \
+	EQ_G(v[2], v[7], v[ 8], v[13], m[equi_sigma[(r)%10][12]], m[equi_sigma[(r)%10][13]]); \
+	EQ_G(v[3], v[4], v[ 9], v[14], m[equi_sigma[(r)%10][14]], m[equi_sigma[(r)%10][15]]); \
+}
+
+#define EQ_ROUNDS(v, m) { \
+	EQ_ROUND(v, m, 0); EQ_ROUND(v, m, 1); EQ_ROUND(v, m, 2); EQ_ROUND(v, m, 3); \
+	EQ_ROUND(v, m, 4); EQ_ROUND(v, m, 5); EQ_ROUND(v, m, 6); EQ_ROUND(v, m, 7); \
+	EQ_ROUND(v, m, 8); EQ_ROUND(v, m, 9); EQ_ROUND(v, m, 10); EQ_ROUND(v, m, 11); \
+}
+
+static inline uint64_t equi_tail64(const equi_midstate *ms)
+{
+	uint64_t m0;
+	memcpy(&m0, ms->tail, 8);
+	return m0;
+}
+
+static inline uint64_t equi_tail_group(const equi_midstate *ms, uint32_t group)
+{
+	uint32_t lo;
+	memcpy(&lo, &ms->tail[8], 4);
+	return ((uint64_t) htole32(group) << 32) | lo;
+}
+
+static void blake2b_group_1way(const equi_midstate *ms, uint32_t group, uint8_t *out)
+{
+	uint64_t v[16], m[16] = { 0 }, h[7];
+
+	m[0] = equi_tail64(ms);
+	m[1] = equi_tail_group(ms, group);
+	for (int i = 0; i < 8; i++) {
+		v[i] = ms->h[i];
+		v[i + 8] = equi_blake2b_iv[i];
 	}
+	v[12] ^= 144;
+	v[14] = ~v[14];
+
+#define ADD(a, b) ((a) + (b))
+#define XOR(a, b) ((a) ^ (b))
+#define ROR32(x) (((x) >> 32) | ((x) << 32))
+#define ROR24(x) (((x) >> 24) | ((x) << 40))
+#define ROR16(x) (((x) >> 16) | ((x) << 48))
+#define ROR63(x) (((x) >> 63) | ((x) << 1))
+	EQ_ROUNDS(v, m);
+#undef ADD
+#undef XOR
+#undef ROR32
+#undef ROR24
+#undef ROR16
+#undef ROR63
+
+	for (int i = 0; i < 7; i++)
+		h[i] = ms->h[i] ^ v[i] ^ v[i + 8];
+	memcpy(out, h, EQ_HASHOUT);
 }
 
-static void generateHash(blake2b_state *S, const uint32_t g, uint8_t *hash, const size_t hashLen)
+static void blake2b_group_sse2(const equi_midstate *ms, const uint32_t *groups, uint8_t *out)
 {
-	const uint32_t le_g = htole32(g);
-	blake2b_state digest = *S; /* copy */
-#ifdef USE_LIBSODIUM
-	crypto_generichash_blake2b_update(&digest, (uint8_t *)&le_g, sizeof(le_g));
-	crypto_generichash_blake2b_final(&digest, hash, hashLen);
-#else
-	eq_blake2b_update(&digest, (const uint8_t*) &le_g, sizeof(le_g));
-	eq_blake2b_final(&digest, hash, (uint8_t) (hashLen & 0xFF));
-#endif
+	__m128i v[16], m[16];
+	uint64_t h[7][2];
+
+	for (int i = 0; i < 16; i++)
+		m[i] = _mm_setzero_si128();
+	m[0] = _mm_set1_epi64x((long long) equi_tail64(ms));
+	m[1] = _mm_set_epi64x((long long) equi_tail_group(ms, groups[1]),
+		(long long) equi_tail_group(ms, groups[0]));
+	for (int i = 0; i < 8; i++) {
+		v[i] = _mm_set1_epi64x((long long) ms->h[i]);
+		v[i + 8] = _mm_set1_epi64x((long long) equi_blake2b_iv[i]);
+	}
+	v[12] = _mm_xor_si128(v[12], _mm_set1_epi64x(144));
+	v[14] = _mm_xor_si128(v[14], _mm_set1_epi32(-1));
+
+#define ADD(a, b) _mm_add_epi64(a, b)
+#define XOR(a, b) _mm_xor_si128(a, b)
+#define ROR32(x) _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1))
+#define ROR24(x) _mm_or_si128(_mm_srli_epi64(x, 24), _mm_slli_epi64(x, 40))
+#define ROR16(x) _mm_or_si128(_mm_srli_epi64(x, 16), _mm_slli_epi64(x, 48))
+#define ROR63(x) _mm_or_si128(_mm_srli_epi64(x, 63), _mm_add_epi64(x, x))
+	EQ_ROUNDS(v, m);
+#undef ADD
+#undef XOR
+#undef ROR32
+#undef ROR24
+#undef ROR16
+#undef ROR63
+
+	for (int i = 0; i < 7; i++) {
+		__m128i x = _mm_xor_si128(_mm_set1_epi64x((long long) ms->h[i]), _mm_xor_si128(v[i], v[i + 8]));
+		_mm_storeu_si128((__m128i*) h[i], x);
+	}
+	for (int l = 0; l < 2; l++) {
+		uint64_t lane[7];
+		for (int i = 0; i < 7; i++)
+			lane[i] = h[i][l];
+		memcpy(&out[l * EQ_HASHOUT], lane, EQ_HASHOUT);
+	}
 }
 
-static int isZero(const uint8_t *hash, size_t len)
+#if defined(EQUI_AVX2)
+EQUI_TARGET("avx2")
+static void blake2b_group_avx2(const equi_midstate *ms, const uint32_t *groups, uint8_t *out)
 {
-	// This doesn't need to be constant time.
-	for (size_t i = 0; i < len; i++) {
-		if (hash[i] != 0) return 0;
+	__m256i v[16], m[16];
+	uint64_t h[7][4];
+	const __m256i r24 = _mm256_setr_epi8(
+		3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+		3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+	const __m256i r16 = _mm256_setr_epi8(
+		2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+		2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+
+	for (int i = 0; i < 16; i++)
+		m[i] = _mm256_setzero_si256();
+	m[0] = _mm256_set1_epi64x((long long) equi_tail64(ms));
+	m[1] = _mm256_set_epi64x(
+		(long long) equi_tail_group(ms, groups[3]), (long long) equi_tail_group(ms, groups[2]),
+		(long long) equi_tail_group(ms, groups[1]), (long long) equi_tail_group(ms, groups[0]));
+	for (int i = 0; i < 8; i++) {
+		v[i] = _mm256_set1_epi64x((long long) ms->h[i]);
+		v[i + 8] = _mm256_set1_epi64x((long long) equi_blake2b_iv[i]);
+	}
+	v[12] = _mm256_xor_si256(v[12], _mm256_set1_epi64x(144));
+	v[14] = _mm256_xor_si256(v[14], _mm256_set1_epi32(-1));
+
+#define ADD(a, b) _mm256_add_epi64(a, b)
+#define XOR(a, b) _mm256_xor_si256(a, b)
+#define ROR32(x) _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1))
+#define ROR24(x) _mm256_shuffle_epi8(x, r24)
+#define ROR16(x) _mm256_shuffle_epi8(x, r16)
+#define ROR63(x) _mm256_or_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x))
+	EQ_ROUNDS(v, m);
+#undef ADD
+#undef XOR
+#undef ROR32
+#undef ROR24
+#undef ROR16
+#undef ROR63
+
+	for (int i = 0; i < 7; i++) {
+		__m256i x = _mm256_xor_si256(_mm256_set1_epi64x((long long) ms->h[i]), _mm256_xor_si256(v[i], v[i + 8]));
+		_mm256_storeu_si256((__m256i*) h[i], x);
+	}
+	for (int l = 0; l < 4; l++) {
+		uint64_t lane[7];
+		for (int i = 0; i < 7; i++)
+			lane[i] = h[i][l];
+		memcpy(&out[l * EQ_HASHOUT], lane, EQ_HASHOUT);
 	}
-	return 1;
 }
 
-// hdr -> header including nonce (140 bytes)
-// soln -> equihash solution (excluding 3 bytes with size, so 1344 bytes length)
-bool equi_verify(uint8_t* const hdr, uint8_t* const soln)
+static int equi_cpu_avx2(void)
 {
-	const uint32_t n = WN; // 200
-	const uint32_t k = WK; // 9
-	const uint32_t collisionBitLength = n / (k + 1);
-	const uint32_t collisionByteLength = (collisionBitLength + 7) / 8;
-	const uint32_t hashLength = (k + 1) * collisionByteLength;
-	const uint32_t indicesPerHashOutput = 512 / n;
-	const uint32_t hashOutput = indicesPerHashOutput * n / 8;
-	const uint32_t equihashSolutionSize = (1 << k) * (n / (k + 1) + 1) / 8;
-	const uint32_t solnr = 1 << k;
-
-	uint32_t indices[512] = { 0 };
-	uint8_t vHash[hashLength] = { 0 };
+	uint32_t r[4];
+	uint64_t xcr0 = 0;
+#ifdef _MSC_VER
+	int cr[4];
+	__cpuidex(cr, 0, 0);
+	if (cr[0] < 7) return 0;
+	__cpuidex(cr, 1, 0);
+	r[2] = cr[2];
+#else
+	if (__get_cpuid_max(0, NULL) < 7) return 0;
+	__cpuid_count(1, 0, r[0], r[1], r[2], r[3]);
+#endif
+	/* osxsave + avx, then the ymm state enabled by the os */
+	if (!(r[2] & (1 << 27)) || !(r[2] & (1 << 28)))
+		return 0;
+#ifdef _MSC_VER
+	xcr0 = _xgetbv(0);
+	__cpuidex(cr, 7, 0);
+	r[1] = cr[1];
+#else
+	{
+		uint32_t lo, hi;
+		__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(lo), "=d"(hi) : "c"(0));
+		xcr0 = ((uint64_t)hi << 32) | lo;
+	}
+	__cpuid_count(7, 0, r[0], r[1], r[2], r[3]);
+#endif
+	return (r[1] & (1 << 5)) && (xcr0 & 0x06) == 0x06;
+}
+#endif
 
+static volatile int equi_lanes = 0;
+
+// the lanes against the generic blake2b code
+static int equi_lanes_check(int lanes)
+{
+	uint8_t hdr[140], ref[4][EQ_HASHOUT], out[4][EQ_HASHOUT];
+	uint32_t groups[4] = { 0, 1, 0x7ffff, 0xfffff };
 	blake2b_state state;
-	digestInit(&state, n, k);
-#ifdef USE_LIBSODIUM
-	crypto_generichash_blake2b_update(&state, hdr, 140);
-#else
+	equi_midstate ms;
+
+	for (int i = 0; i < 140; i++)
+		hdr[i] = (uint8_t) (i * 7 + 3);
+	digestInit(&state, WN, WK);
 	eq_blake2b_update(&state, hdr, 140);
+	equi_midstate_init(&ms, hdr);
+	for (int n = 0; n < 4; n++)
+		generateHash(&state, groups[n], ref[n], EQ_HASHOUT);
+
+	if (lanes == 1) {
+		for (int n = 0; n < 4; n++)
+			blake2b_group_1way(&ms, groups[n], out[n]);
+	} else if (lanes == 2) {
+		blake2b_group_sse2(&ms, groups, out[0]);
+		blake2b_group_sse2(&ms, &groups[2], out[2]);
+	}
+#if defined(EQUI_AVX2)
+	else if (lanes == 4) {
+		blake2b_group_avx2(&ms, groups, out[0]);
+	}
 #endif
+	return !memcmp(ref, out, sizeof(ref));
+}
 
-	expandArray(soln, equihashSolutionSize, (uint8_t*) &indices, sizeof(indices), collisionBitLength + 1, 1);
+int equi_blake2b_lanes(void)
+{
+	if (!equi_lanes) {
+		int lanes = 1;
+		if (equi_lanes_check(2))
+			lanes = 2;
+#if defined(EQUI_AVX2)
+		if (equi_cpu_avx2() && equi_lanes_check(4))
+			lanes = 4;
+#endif
+		if (lanes == 1 && !equi_lanes_check(1))
+			applog(LOG_ERR, "equihash: blake2b group hash self-test failed!");
+		equi_lanes = lanes;
+	}
+	return equi_lanes;
+}
 
-	for (uint32_t j = 0; j < solnr; j++) {
-		uint8_t tmpHash[hashOutput];
-		uint8_t hash[hashLength];
-		uint32_t i = be32toh(indices[j]);
-		generateHash(&state, i / indicesPerHashOutput, tmpHash, hashOutput);
-		expandArray(tmpHash + (i % indicesPerHashOutput * n / 8), n / 8, hash, hashLength, collisionBitLength, 0);
-		for (uint32_t k = 0; k < hashLength; k++)
-			vHash[k] ^= hash[k];
+void equi_blake2b_groups(const equi_midstate *ms, const uint32_t *groups, uint32_t count, uint8_t *out)
+{
+	const int lanes = equi_blake2b_lanes();
+	uint32_t n = 0;
+#if defined(EQUI_AVX2)
+	if (lanes == 4) {
+		for (; n + 4 <= count; n += 4)
+			blake2b_group_avx2(ms, &groups[n], &out[n * EQ_HASHOUT]);
+	}
+#endif
+	if (lanes >= 2) {
+		for (; n + 2 <= count; n += 2)
+			blake2b_group_sse2(ms, &groups[n], &out[n * EQ_HASHOUT]);
+	}
+	for (; n < count; n++)
+		blake2b_group_1way(ms, groups[n], &out[n * EQ_HASHOUT]);
+}
+
+// two 20 bits digits in each 5 bytes, big-endian
+void equi_expand_digits(const uint8_t *hash, uint32_t *digits)
+{
+	for (int i = 0; i < EQ_DIGITS / 2; i++, hash += 5) {
+		uint64_t x = ((uint64_t) be32dec(hash) << 8) | hash[4];
+		digits[2*i] = (uint32_t) (x >> EQ_DIGIT_BITS);
+		digits[2*i + 1] = (uint32_t) x & ((1U << EQ_DIGIT_BITS) - 1);
+	}
+}
+
+// 21 bits big-endian indices, read with 32 bits loads (3 bytes at the end)
+void equi_unpack_indices(const uint8_t *soln, uint32_t *indices)
+{
+	const uint32_t mask = (1U << EQ_INDEX_BITS) - 1;
+	for (uint32_t j = 0; j < EQ_INDICES; j++) {
+		const uint32_t bit = j * EQ_INDEX_BITS;
+		const uint8_t *p = &soln[bit >> 3];
+		uint32_t w;
+		if ((bit >> 3) + 4 <= EQ_SOLSIZE)
+			w = be32dec(p);
+		else
+			w = ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8);
+		indices[j] = (w >> (32 - EQ_INDEX_BITS - (bit & 7))) & mask;
+	}
+}
+
+/*
+ * hdr -> header including nonce (140 bytes)
+ * soln -> equihash solution (excluding 3 bytes with size, so 1344 bytes length)
+ *
+ * The indices are sorted once to reject duplicates and to hash each group
+ * (pair of indices sharing a blake2b output) only once, then the tree is
+ * checked like zcashd does: at each level the two halves collide on the
+ * next digit and the first index of the left one is the lowest.
+ */
+bool equi_verify(uint8_t* const hdr, uint8_t* const soln)
+{
+	uint32_t indices[EQ_INDICES];
+	uint32_t order[EQ_INDICES];
+	uint32_t groups[EQ_INDICES];
+	uint16_t slot[EQ_INDICES];
+	uint32_t digits[EQ_INDICES][EQ_DIGITS];
+	uint8_t hashes[EQ_INDICES][EQ_HASHOUT];
+	uint32_t ngroups = 0;
+	equi_midstate ms;
+
+	equi_unpack_indices(soln, indices);
+
+	// index and position, 21 + 9 bits
+	for (uint32_t j = 0; j < EQ_INDICES; j++)
+		order[j] = (indices[j] << WK) | j;
+	std::sort(order, order + EQ_INDICES);
+
+	for (uint32_t n = 0; n < EQ_INDICES; n++) {
+		const uint32_t i = order[n] >> WK;
+		if (n && (order[n-1] >> WK) == i)
+			return false;
+		if (!ngroups || groups[ngroups-1] != i / 2)
+			groups[ngroups++] = i / 2;
+		slot[order[n] & (EQ_INDICES - 1)] = (uint16_t) (ngroups - 1);
+	}
+
+	equi_midstate_init(&ms, hdr);
+	equi_blake2b_groups(&ms, groups, ngroups, hashes[0]);
+
+	for (uint32_t j = 0; j < EQ_INDICES; j++)
+		equi_expand_digits(&hashes[slot[j]][(indices[j] & 1) * (EQ_HASHOUT / 2)], digits[j]);
+
+	for (uint32_t l = 1; l <= WK; l++) {
+		const uint32_t half = 1U << (l - 1);
+		for (uint32_t s = 0; s < EQ_INDICES; s += 2 * half) {
+			if (indices[s] >= indices[s + half])
+				return false;
+			for (uint32_t d = l - 1; d < EQ_DIGITS; d++)
+				digits[s][d] ^= digits[s + half][d];
+			if (digits[s][l - 1])
+				return false;
+		}
 	}
-	return isZero(vHash, sizeof(vHash));
+	return digits[0][EQ_DIGITS - 1] == 0;
 }
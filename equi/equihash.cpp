@@ -163,8 +163,11 @@ extern "C" int scanhash_equihash(int thr_id, struct work *work, uint32_t max_non
 
 	if (!init[thr_id]) {
 		try {
-			int mode = 1;
+			int mode = device_type[thr_id] == DEVICE_TYPE_CPU ? 0 : 1;
 			switch (mode) {
+			case 0:
+				solvers[thr_id] = new eq_cpu_context(thr_id);
+				break;
 			case 1:
 				solvers[thr_id] = new eq_cuda_context<CONFIG_MODE_1>(thr_id, device_map[thr_id]);
 				break;
@@ -185,7 +188,8 @@ extern "C" int scanhash_equihash(int thr_id, struct work *work, uint32_t max_non
 			size_t memSz = solvers[thr_id]->equi_mem_sz / (1024*1024);
 			api_set_throughput(thr_id, (uint32_t) solvers[thr_id]->throughput);
 			gpulog(LOG_DEBUG, thr_id, "Allocated %u MB of context memory", (u32) memSz);
-			cuda_get_arch(thr_id);
+			if (mode)
+				cuda_get_arch(thr_id);
 			init[thr_id] = true;
 		} catch (const std::exception & e) {
 			CUDA_LOG_ERROR();
@@ -280,6 +284,13 @@ void free_equihash(int thr_id)
 	if (!init[thr_id])
 		return;
 
+	if (device_type[thr_id] == DEVICE_TYPE_CPU) {
+		delete dynamic_cast<eq_cpu_context*>(solvers[thr_id]);
+		solvers[thr_id] = NULL;
+		init[thr_id] = false;
+		return;
+	}
+
 	// assume config 1 was used... interface destructor seems bad
 	eq_cuda_context<CONFIG_MODE_1>* ptr = dynamic_cast<eq_cuda_context<CONFIG_MODE_1>*>(solvers[thr_id]);
 	ptr->freemem();
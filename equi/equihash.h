@@ -10,10 +10,32 @@
 #define WN 200
 //#define CONFIG_MODE_1 9, 1248, 12, 640, packer_cantor /* eqcuda.hpp */
 
+#define EQ_DIGIT_BITS  (WN / (WK + 1))        // 20
+#define EQ_DIGITS      (WK + 1)               // 10
+#define EQ_INDICES     (1 << WK)              // 512 per solution
+#define EQ_INDEX_BITS  (EQ_DIGIT_BITS + 1)    // 21
+#define EQ_HASHOUT     (512 / WN * WN / 8)    // 50, 2 indices per blake2b
+#define EQ_SOLSIZE     (EQ_INDICES * EQ_INDEX_BITS / 8) // 1344
+
+// blake2b state after the first block of the 140 bytes header, the index
+// group (index / 2) completes the last block with the 12 remaining bytes
+typedef struct {
+	uint64_t h[8];
+	uint8_t tail[12];
+} equi_midstate;
+
 extern "C" {
 	void equi_hash(const void* input, void* output, int len);
 	int  equi_verify_sol(void* const hdr, void* const soln);
 	bool equi_verify(uint8_t* const hdr, uint8_t* const soln);
+
+	void equi_midstate_init(equi_midstate *ms, const uint8_t *hdr);
+	// EQ_HASHOUT bytes for each of the count groups, the lanes are filled in parallel
+	void equi_blake2b_groups(const equi_midstate *ms, const uint32_t *groups, uint32_t count, uint8_t *out);
+	// the 20 bits digits of one of the 25 bytes halves of a group hash
+	void equi_expand_digits(const uint8_t *hash, uint32_t *digits);
+	void equi_unpack_indices(const uint8_t *soln, uint32_t *indices);
+	int  equi_blake2b_lanes(void);
 }
 
 #endif
@@ -0,0 +1,156 @@
+/**
+ * Compiled cpu hash chains of the permutation algos
+ * (x16r, x16s, timetravel, bitcore, exosis, x11evo)
+ *
+ * The chain order only depends on the job (prevhash or ntime), so it is
+ * turned once into a flat array of sph update/close functions, with the
+ * initialized context of each stage copied instead of calling its init.
+ */
+#include <stdlib.h>
+#include <memory.h>
+
+extern "C" {
+#include "sph/sph_blake.h"
+#include "sph/sph_bmw.h"
+#include "sph/sph_groestl.h"
+#include "sph/sph_skein.h"
+#include "sph/sph_jh.h"
+#include "sph/sph_keccak.h"
+#include "sph/sph_luffa.h"
+#include "sph/sph_cubehash.h"
+#include "sph/sph_shavite.h"
+#include "sph/sph_simd.h"
+#include "sph/sph_echo.h"
+#include "sph/sph_hamsi.h"
+#include "sph/sph_fugue.h"
+#include "sph/sph_shabal.h"
+#include "sph/sph_whirlpool.h"
+#include "sph/sph_sha2.h"
+#include "sph/sph_midstate.h"
+}
+
+#include "miner.h"
+
+union hash_chain_ctx {
+	sph_blake512_context     blake;
+	sph_bmw512_context       bmw;
+	sph_groestl512_context   groestl;
+	sph_skein512_context     skein;
+	sph_jh512_context        jh;
+	sph_keccak512_context    keccak;
+	sph_luffa512_context     luffa;
+	sph_cubehash512_context  cubehash;
+	sph_shavite512_context   shavite;
+	sph_simd512_context      simd;
+	sph_echo512_context      echo;
+	sph_hamsi512_context     hamsi;
+	sph_fugue512_context     fugue;
+	sph_shabal512_context    shabal;
+	sph_whirlpool_context    whirlpool;
+	sph_sha512_context       sha512;
+};
+
+struct hash_chain_algo {
+	void (*init)(void *cc);
+	void (*update)(void *cc, const void *data, size_t len);
+	void (*close)(void *cc, void *dst);
+	size_t size;
+	size_t block;
+};
+
+// indexed by enum hash_chain_id
+static const struct hash_chain_algo hc_algos[HC_ALGO_COUNT] = {
+	{ sph_blake512_init, sph_blake512, sph_blake512_close, sizeof(sph_blake512_context), 128 },
+	{ sph_bmw512_init, sph_bmw512, sph_bmw512_close, sizeof(sph_bmw512_context), 128 },
+	{ sph_groestl512_init, sph_groestl512, sph_groestl512_close, sizeof(sph_groestl512_context), 128 },
+	{ sph_skein512_init, sph_skein512, sph_skein512_close, sizeof(sph_skein512_context), 64 },
+	{ sph_jh512_init, sph_jh512, sph_jh512_close, sizeof(sph_jh512_context), 64 },
+	{ sph_keccak512_init, sph_keccak512, sph_keccak512_close, sizeof(sph_keccak512_context), 72 },
+	{ sph_luffa512_init, sph_luffa512, sph_luffa512_close, sizeof(sph_luffa512_context), 32 },
+	{ sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close, sizeof(sph_cubehash512_context), 32 },
+	{ sph_shavite512_init, sph_shavite512, sph_shavite512_close, sizeof(sph_shavite512_context), 128 },
+	{ sph_simd512_init, sph_simd512, sph_simd512_close, sizeof(sph_simd512_context), 128 },
+	{ sph_echo512_init, sph_echo512, sph_echo512_close, sizeof(sph_echo512_context), 128 },
+	{ sph_hamsi512_init, sph_hamsi512, sph_hamsi512_close, sizeof(sph_hamsi512_context), 8 },
+	{ sph_fugue512_init, sph_fugue512, sph_fugue512_close, sizeof(sph_fugue512_context), 4 },
+	{ sph_shabal512_init, sph_shabal512, sph_shabal512_close, sizeof(sph_shabal512_context), 64 },
+	{ sph_whirlpool_init, sph_whirlpool, sph_whirlpool_close, sizeof(sph_whirlpool_context), 64 },
+	{ sph_sha512_init, sph_sha512, sph_sha512_close, sizeof(sph_sha512_context), 128 },
+};
+
+// initialized contexts, read only once set
+static union hash_chain_ctx hc_init_ctx[HC_ALGO_COUNT];
+static volatile bool hc_init_done = false;
+static pthread_mutex_t hc_init_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void hash_chain_init_contexts()
+{
+	pthread_mutex_lock(&hc_init_lock);
+	if (!hc_init_done) {
+		for (int n = 0; n < HC_ALGO_COUNT; n++)
+			hc_algos[n].init(&hc_init_ctx[n]);
+		hc_init_done = true;
+	}
+	pthread_mutex_unlock(&hc_init_lock);
+}
+
+/**
+ * Build the stages of a chain from the hash order string of an algo
+ * (hex digits of its own algo enum), ids maps this enum to the chain ids
+ * (NULL if they are the same). key identifies the order of the job
+ * (prevhash bits, permutation sequence)
+ */
+bool hash_chain_compile(struct hash_chain *hc, uint64_t key, const char *order, const uint8_t *ids)
+{
+	int count = 0;
+
+	if (!hc_init_done)
+		hash_chain_init_contexts();
+
+	hc->key = key;
+	hc->count = 0;
+
+	for (; order[count]; count++) {
+		const char elem = order[count];
+		uint8_t algo = elem >= 'A' ? elem - 'A' + 10 : elem - '0';
+		if (count >= HASH_CHAIN_MAX || algo >= HC_ALGO_COUNT)
+			return false;
+		if (ids) algo = ids[algo];
+		hc->stage[count].init = hc_algos[algo].init;
+		hc->stage[count].update = hc_algos[algo].update;
+		hc->stage[count].close = hc_algos[algo].close;
+		hc->stage[count].init_ctx = &hc_init_ctx[algo];
+		hc->stage[count].size = hc_algos[algo].size;
+		hc->stage[count].midstate = hc_algos[algo].block <= 64;
+	}
+	hc->count = count;
+	return count > 0;
+}
+
+// first stage of the 80 bytes headers, when the 76 bytes prefix fills a block
+static __thread sph_midstate80 hc_midstate;
+
+/**
+ * Hash len bytes through the chain, 64 bytes output
+ */
+void hash_chain_hash(const struct hash_chain *hc, void *output, const void *input, size_t len)
+{
+	union hash_chain_ctx ctx;
+	uint32_t _ALIGN(64) hash[64/4] = { 0 };
+	const void *in = input;
+
+	for (int i = 0; i < hc->count; i++) {
+		const struct hash_chain_stage *s = &hc->stage[i];
+		if (len == 80 && s->midstate) {
+			sph_midstate80_load(&hc_midstate, s->init, s->update, s->size, &ctx, in);
+		} else {
+			memcpy(&ctx, s->init_ctx, s->size);
+			s->update(&ctx, in, len);
+		}
+		s->close(&ctx, hash);
+		in = hash;
+		len = 64;
+	}
+
+	memcpy(output, hash, 64);
+}
@@ -2,13 +2,17 @@
  * Hash log of submitted job nonces
  * Prevent duplicate shares and remember shares diff
  *
+ * Records live in a fixed pool (hard memory cap), found by an open
+ * addressing table keyed by job << 32 | nonce. Each job keeps a list
+ * of its records and all records are chained by time, so job purges
+ * and expiry only touch the records they remove.
+ *
  * (to be merged later with stats)
  *
  * tpruvot@github 2014 - 2017
  */
 #include <stdlib.h>
 #include <memory.h>
-#include <map>
 
 #include "miner.h"
 
@@ -35,10 +39,52 @@ struct hashlog_data {
 };
 */
 
-static std::map<uint64_t, hashlog_data> tlastshares;
-
 #define LOG_PURGE_TIMEOUT 5*60
 
+/* hard limits, the oldest records are dropped when full */
+#define HASHLOG_MAX_RECORDS 4096
+#define HASHLOG_MAX_JOBS    1024
+
+/* index slots, twice the pool size to keep the load factor under 1/2 */
+#define HASHLOG_REC_BITS 13
+#define HASHLOG_JOB_BITS 11
+
+#define NIL -1
+
+struct hashlog_slot {
+	uint64_t key;
+	int32_t val; // pool index + 1, 0 if empty
+};
+
+struct hashlog_rec {
+	uint64_t key;
+	uint32_t stamp; // time of the last write, expiry order
+	int32_t job;
+	int32_t tprev, tnext; // time list, oldest first
+	int32_t jprev, jnext; // records of the same job
+	hashlog_data data;
+};
+
+struct hashlog_job {
+	uint32_t njobid;
+	int32_t first;
+	int32_t count;
+	int32_t next_free;
+};
+
+static struct hashlog_rec  hl_recs[HASHLOG_MAX_RECORDS];
+static struct hashlog_job  hl_jobs[HASHLOG_MAX_JOBS];
+static struct hashlog_slot hl_rec_index[1 << HASHLOG_REC_BITS];
+static struct hashlog_slot hl_job_index[1 << HASHLOG_JOB_BITS];
+
+// pool state, the never used tail (top) avoids any init
+static int32_t hl_rec_top = 0, hl_rec_free = NIL;
+static int32_t hl_job_top = 0, hl_job_free = NIL;
+static int32_t hl_oldest = NIL, hl_newest = NIL;
+static uint32_t hl_records = 0;
+
+static pthread_mutex_t hashlog_lock = PTHREAD_MUTEX_INITIALIZER;
+
 extern struct stratum_ctx stratum;
 
 /**
@@ -51,6 +97,184 @@ static uint64_t hextouint(char* jobid)
 	return (uint64_t) strtoul(jobid, &ptr, 16);
 }
 
+/**
+ * Open addressing index (linear probing, no tombstones)
+ */
+static inline uint32_t slot_hash(uint64_t key, int bits)
+{
+	return (uint32_t) ((key * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+static int32_t slot_find(const struct hashlog_slot *tab, int bits, uint64_t key)
+{
+	const uint32_t mask = (1U << bits) - 1;
+	uint32_t pos = slot_hash(key, bits);
+	while (tab[pos].val) {
+		if (tab[pos].key == key)
+			return (int32_t) pos;
+		pos = (pos + 1) & mask;
+	}
+	return NIL;
+}
+
+static void slot_insert(struct hashlog_slot *tab, int bits, uint64_t key, int32_t idx)
+{
+	const uint32_t mask = (1U << bits) - 1;
+	uint32_t pos = slot_hash(key, bits);
+	while (tab[pos].val)
+		pos = (pos + 1) & mask;
+	tab[pos].key = key;
+	tab[pos].val = idx + 1;
+}
+
+static void slot_erase(struct hashlog_slot *tab, int bits, uint32_t pos)
+{
+	const uint32_t mask = (1U << bits) - 1;
+	uint32_t next = (pos + 1) & mask;
+	// shift back the following entries which can't be reached anymore
+	while (tab[next].val) {
+		uint32_t home = slot_hash(tab[next].key, bits);
+		if (((next - home) & mask) >= ((next - pos) & mask)) {
+			tab[pos] = tab[next];
+			pos = next;
+		}
+		next = (next + 1) & mask;
+	}
+	tab[pos].val = 0;
+}
+
+static inline struct hashlog_rec* rec_find(uint64_t key)
+{
+	int32_t pos = slot_find(hl_rec_index, HASHLOG_REC_BITS, key);
+	return (pos == NIL) ? NULL : &hl_recs[hl_rec_index[pos].val - 1];
+}
+
+static inline struct hashlog_job* job_find(uint32_t njobid)
+{
+	int32_t pos = slot_find(hl_job_index, HASHLOG_JOB_BITS, njobid);
+	return (pos == NIL) ? NULL : &hl_jobs[hl_job_index[pos].val - 1];
+}
+
+static void job_release(struct hashlog_job *job)
+{
+	int32_t pos = slot_find(hl_job_index, HASHLOG_JOB_BITS, job->njobid);
+	slot_erase(hl_job_index, HASHLOG_JOB_BITS, (uint32_t) pos);
+	job->next_free = hl_job_free;
+	hl_job_free = (int32_t) (job - hl_jobs);
+}
+
+static void rec_remove(int32_t idx)
+{
+	struct hashlog_rec *r = &hl_recs[idx];
+	struct hashlog_job *job = &hl_jobs[r->job];
+	int32_t pos = slot_find(hl_rec_index, HASHLOG_REC_BITS, r->key);
+
+	slot_erase(hl_rec_index, HASHLOG_REC_BITS, (uint32_t) pos);
+
+	if (r->tprev != NIL) hl_recs[r->tprev].tnext = r->tnext;
+	else hl_oldest = r->tnext;
+	if (r->tnext != NIL) hl_recs[r->tnext].tprev = r->tprev;
+	else hl_newest = r->tprev;
+
+	if (r->jprev != NIL) hl_recs[r->jprev].jnext = r->jnext;
+	else job->first = r->jnext;
+	if (r->jnext != NIL) hl_recs[r->jnext].jprev = r->jprev;
+	if (--job->count == 0)
+		job_release(job);
+
+	r->tnext = hl_rec_free;
+	hl_rec_free = idx;
+	hl_records--;
+}
+
+/**
+ * Store a record as the newest one, replaces a previous one with the same key
+ */
+static void rec_store(uint64_t key, const hashlog_data *data, uint32_t stamp)
+{
+	const uint32_t njobid = HI_DWORD(key);
+	struct hashlog_rec *r = rec_find(key);
+	struct hashlog_job *job;
+	int32_t idx;
+
+	if (r) rec_remove((int32_t) (r - hl_recs));
+
+	// pool full, drop the oldest record
+	if (hl_rec_free == NIL && hl_rec_top == HASHLOG_MAX_RECORDS)
+		rec_remove(hl_oldest);
+
+	job = job_find(njobid);
+	while (!job && hl_job_free == NIL && hl_job_top == HASHLOG_MAX_JOBS)
+		rec_remove(hl_oldest); // too many jobs, drop the oldest records
+	if (!job) {
+		int32_t j = hl_job_free;
+		if (j != NIL) hl_job_free = hl_jobs[j].next_free;
+		else j = hl_job_top++;
+		job = &hl_jobs[j];
+		job->njobid = njobid;
+		job->first = NIL;
+		job->count = 0;
+		slot_insert(hl_job_index, HASHLOG_JOB_BITS, njobid, j);
+	}
+
+	idx = hl_rec_free;
+	if (idx != NIL) hl_rec_free = hl_recs[idx].tnext;
+	else idx = hl_rec_top++;
+
+	r = &hl_recs[idx];
+	r->key = key;
+	r->stamp = stamp;
+	r->job = (int32_t) (job - hl_jobs);
+	memcpy(&r->data, data, sizeof(hashlog_data));
+	r->data.njobid = njobid;
+	r->data.nonce = LO_DWORD(key);
+
+	r->tnext = NIL;
+	r->tprev = hl_newest;
+	if (hl_newest != NIL) hl_recs[hl_newest].tnext = idx;
+	else hl_oldest = idx;
+	hl_newest = idx;
+
+	r->jprev = NIL;
+	r->jnext = job->first;
+	if (job->first != NIL) hl_recs[job->first].jprev = idx;
+	job->first = idx;
+	job->count++;
+
+	slot_insert(hl_rec_index, HASHLOG_REC_BITS, key, idx);
+	hl_records++;
+}
+
+static uint32_t get_last_sent(uint32_t njobid)
+{
+	uint32_t nonce = 0;
+	struct hashlog_job *job = job_find(njobid);
+	for (int32_t i = job ? job->first : NIL; i != NIL; i = hl_recs[i].jnext) {
+		if (hl_recs[i].data.tm_sent && LO_DWORD(hl_recs[i].key) > nonce)
+			nonce = LO_DWORD(hl_recs[i].key);
+	}
+	return nonce;
+}
+
+static uint64_t get_scan_range(uint32_t njobid)
+{
+	uint64_t ret = 0;
+	uint32_t scanned_from = 0, scanned_to = 0;
+	struct hashlog_job *job = job_find(njobid);
+	for (int32_t i = job ? job->first : NIL; i != NIL; i = hl_recs[i].jnext) {
+		hashlog_data *data = &hl_recs[i].data;
+		if (data->scanned_to > 0) {
+			if (data->scanned_to > scanned_to)
+				scanned_to = data->scanned_to;
+			if (data->scanned_from < scanned_from || scanned_from == 0)
+				scanned_from = data->scanned_from;
+		}
+	}
+	ret = scanned_from;
+	ret += MK_HI64(scanned_to);
+	return ret;
+}
+
 /**
  * @return time of a job/nonce submission (or last nonce if nonce is 0)
  */
@@ -60,13 +284,15 @@ uint32_t hashlog_already_submittted(char* jobid, uint32_t nonce)
 	uint64_t njobid = hextouint(jobid);
 	uint64_t key = (njobid << 32) + nonce;
 
+	pthread_mutex_lock(&hashlog_lock);
 	if (nonce == 0) {
 		// search last submitted nonce for job
-		ret = hashlog_get_last_sent(jobid);
-	} else if (tlastshares.find(key) != tlastshares.end()) {
-		hashlog_data data = tlastshares[key];
-		ret = data.tm_sent;
+		ret = get_last_sent((uint32_t) njobid);
+	} else {
+		struct hashlog_rec *r = rec_find(key);
+		if (r) ret = r->data.tm_sent;
 	}
+	pthread_mutex_unlock(&hashlog_lock);
 	return ret;
 }
 /**
@@ -89,7 +315,10 @@ void hashlog_remember_submit(struct work* work, uint32_t nonce)
 	data.npool = (uint8_t) cur_pooln;
 	data.pool_type = pools[cur_pooln].type;
 	data.job_nonce_id = (uint8_t) stratum.job.shares_count;
-	tlastshares[key] = data;
+
+	pthread_mutex_lock(&hashlog_lock);
+	rec_store(key, &data, data.tm_sent);
+	pthread_mutex_unlock(&hashlog_lock);
 }
 
 /**
@@ -99,11 +328,17 @@ void hashlog_remember_scan_range(struct work* work)
 {
 	uint64_t njobid = hextouint(work->job_id);
 	uint64_t key = (njobid << 32);
-	uint64_t range = hashlog_get_scan_range(work->job_id);
+	uint64_t range;
+	struct hashlog_rec *r;
 	hashlog_data data;
 
+	pthread_mutex_lock(&hashlog_lock);
+	range = get_scan_range((uint32_t) njobid);
+
 	// global scan range of a job
-	data = tlastshares[key];
+	r = rec_find(key);
+	if (r) memcpy(&data, &r->data, sizeof(data));
+	else memset(&data, 0, sizeof(data));
 	if (range == 0) {
 		memset(&data, 0, sizeof(data));
 		data.njobid = (uint32_t) njobid;
@@ -129,7 +364,8 @@ void hashlog_remember_scan_range(struct work* work)
 
 	data.tm_upd = (uint32_t) time(NULL);
 
-	tlastshares[key] = data;
+	rec_store(key, &data, data.tm_upd);
+	pthread_mutex_unlock(&hashlog_lock);
 /* 	applog(LOG_BLUE, "job %s range : %x %x -> %x %x", jobid,
 		scanned_from, scanned_to, data.scanned_from, data.scanned_to); */
 }
@@ -140,26 +376,10 @@ void hashlog_remember_scan_range(struct work* work)
  */
 uint64_t hashlog_get_scan_range(char* jobid)
 {
-	uint64_t ret = 0;
-	uint64_t njobid = hextouint(jobid);
-	uint64_t keypfx = (njobid << 32);
-	uint64_t keymsk = (0xffffffffULL << 32);
-	hashlog_data data;
-
-	data.scanned_from = 0;
-	data.scanned_to = 0;
-	std::map<uint64_t, hashlog_data>::iterator i = tlastshares.begin();
-	while (i != tlastshares.end()) {
-		if ((keymsk & i->first) == keypfx && i->second.scanned_to > ret) {
-			if (i->second.scanned_to > data.scanned_to)
-				data.scanned_to = i->second.scanned_to;
-			if (i->second.scanned_from < data.scanned_from || data.scanned_from == 0)
-				data.scanned_from = i->second.scanned_from;
-		}
-		i++;
-	}
-	ret = data.scanned_from;
-	ret += MK_HI64(data.scanned_to);
+	uint64_t ret;
+	pthread_mutex_lock(&hashlog_lock);
+	ret = get_scan_range((uint32_t) hextouint(jobid));
+	pthread_mutex_unlock(&hashlog_lock);
 	return ret;
 }
 
@@ -169,17 +389,11 @@ uint64_t hashlog_get_scan_range(char* jobid)
  */
 uint32_t hashlog_get_last_sent(char* jobid)
 {
-	uint32_t nonce = 0;
+	uint32_t nonce;
 	uint64_t njobid = jobid ? hextouint(jobid) : UINT32_MAX;
-	uint64_t keypfx = (njobid << 32);
-	std::map<uint64_t, hashlog_data>::reverse_iterator i = tlastshares.rbegin();
-	while (i != tlastshares.rend()) {
-		if ((keypfx & i->first) == keypfx && i->second.tm_sent) {
-			nonce = LO_DWORD(i->first);
-			break;
-		}
-		i++;
-	}
+	pthread_mutex_lock(&hashlog_lock);
+	nonce = get_last_sent((uint32_t) njobid);
+	pthread_mutex_unlock(&hashlog_lock);
 	return nonce;
 }
 
@@ -190,39 +404,39 @@ double hashlog_get_sharediff(char* jobid, int job_nonceid, double defvalue)
 {
 	double diff = defvalue;
 	const uint64_t njobid = jobid ? hextouint(jobid) : UINT32_MAX;
-	const uint64_t keypfx = (njobid << 32);
-	const uint64_t keymsk = (0xffffffffULL << 32);
-
-	std::map<uint64_t, hashlog_data>::reverse_iterator it = tlastshares.rbegin();
-	while (it != tlastshares.rend()) {
-		if ((keymsk & it->first) == keypfx) {
-			if ((int) it->second.job_nonce_id == job_nonceid && it->second.tm_sent) {
-				diff = it->second.sharediff;
-				// applog(LOG_BLUE, "sharediff nonce %x:%d (%d) match %g",
-				//	njobid, (int) it->second.nonce_id, job_nonceid, diff);
-				break;
+	uint32_t best = 0;
+	bool found = false;
+
+	pthread_mutex_lock(&hashlog_lock);
+	struct hashlog_job *job = job_find((uint32_t) njobid);
+	for (int32_t i = job ? job->first : NIL; i != NIL; i = hl_recs[i].jnext) {
+		hashlog_data *data = &hl_recs[i].data;
+		// the highest nonce wins, like the previous (sorted) log
+		if ((int) data->job_nonce_id == job_nonceid && data->tm_sent) {
+			if (!found || data->nonce > best) {
+				diff = data->sharediff;
+				best = data->nonce;
+				found = true;
 			}
 		}
-		++it;
 	}
+	pthread_mutex_unlock(&hashlog_lock);
 	return diff;
 }
 
 /**
- * Export data for api calls
+ * Export data for api calls (newest first)
  */
 int hashlog_get_history(struct hashlog_data *data, int max_records)
 {
 	int records = 0;
 
-	std::map<uint64_t, hashlog_data>::reverse_iterator it = tlastshares.rbegin();
-	while (it != tlastshares.rend() && records < max_records) {
-		memcpy(&data[records], &(it->second), sizeof(struct hashlog_data));
-		data[records].nonce = LO_DWORD(it->first);
-		data[records].njobid = (uint32_t) HI_DWORD(it->first);
+	pthread_mutex_lock(&hashlog_lock);
+	for (int32_t i = hl_newest; i != NIL && records < max_records; i = hl_recs[i].tprev) {
+		memcpy(&data[records], &hl_recs[i].data, sizeof(struct hashlog_data));
 		records++;
-		++it;
 	}
+	pthread_mutex_unlock(&hashlog_lock);
 	return records;
 }
 
@@ -233,16 +447,18 @@ void hashlog_purge_job(char* jobid)
 {
 	int deleted = 0;
 	uint64_t njobid = hextouint(jobid);
-	uint64_t keypfx = (njobid << 32);
-	uint32_t sz = (uint32_t) tlastshares.size();
-	std::map<uint64_t, hashlog_data>::iterator i = tlastshares.begin();
-	while (i != tlastshares.end()) {
-		if ((keypfx & i->first) == keypfx) {
-			deleted++;
-			tlastshares.erase(i++);
-		}
-		else ++i;
+	uint32_t sz;
+
+	pthread_mutex_lock(&hashlog_lock);
+	sz = hl_records;
+	struct hashlog_job *job = job_find((uint32_t) njobid);
+	if (job) {
+		// the job slot is released with its last record
+		const int32_t count = job->count;
+		for (deleted = 0; deleted < count; deleted++)
+			rec_remove(job->first);
 	}
+	pthread_mutex_unlock(&hashlog_lock);
 	if (opt_debug && deleted) {
 		applog(LOG_DEBUG, "hashlog: purge job %s, del %d/%d", jobid, deleted, sz);
 	}
@@ -255,15 +471,15 @@ void hashlog_purge_old(void)
 {
 	int deleted = 0;
 	uint32_t now = (uint32_t) time(NULL);
-	uint32_t sz = (uint32_t) tlastshares.size();
-	std::map<uint64_t, hashlog_data>::iterator i = tlastshares.begin();
-	while (i != tlastshares.end()) {
-		if ((now - i->second.tm_sent) > LOG_PURGE_TIMEOUT) {
-			deleted++;
-			tlastshares.erase(i++);
-		}
-		else ++i;
+	uint32_t sz;
+
+	pthread_mutex_lock(&hashlog_lock);
+	sz = hl_records;
+	while (hl_oldest != NIL && (now - hl_recs[hl_oldest].stamp) > LOG_PURGE_TIMEOUT) {
+		rec_remove(hl_oldest);
+		deleted++;
 	}
+	pthread_mutex_unlock(&hashlog_lock);
 	if (opt_debug && deleted) {
 		applog(LOG_DEBUG, "hashlog: %d/%d purged", deleted, sz);
 	}
@@ -274,7 +490,14 @@ void hashlog_purge_old(void)
  */
 void hashlog_purge_all(void)
 {
-	tlastshares.clear();
+	pthread_mutex_lock(&hashlog_lock);
+	memset(hl_rec_index, 0, sizeof(hl_rec_index));
+	memset(hl_job_index, 0, sizeof(hl_job_index));
+	hl_rec_top = hl_job_top = 0;
+	hl_rec_free = hl_job_free = NIL;
+	hl_oldest = hl_newest = NIL;
+	hl_records = 0;
+	pthread_mutex_unlock(&hashlog_lock);
 }
 
 /**
@@ -282,8 +505,8 @@ void hashlog_purge_all(void)
  */
 void hashlog_getmeminfo(uint64_t *mem, uint32_t *records)
 {
-	(*records) = (uint32_t) tlastshares.size();
-	(*mem) = (*records) * sizeof(hashlog_data);
+	(*records) = hl_records;
+	(*mem) = (*records) * sizeof(struct hashlog_rec);
 }
 
 /**
@@ -294,17 +517,16 @@ void hashlog_dump_job(char* jobid)
 	if (opt_debug) {
 		uint64_t njobid = hextouint(jobid);
 		uint64_t keypfx = (njobid << 32);
-		// uint32_t sz = tlastshares.size();
-		std::map<uint64_t, hashlog_data>::iterator i = tlastshares.begin();
-		while (i != tlastshares.end()) {
-			if ((keypfx & i->first) == keypfx) {
-				if (i->first != keypfx)
-					applog(LOG_DEBUG, CL_YLW "job %s, found %08x ", jobid, LO_DWORD(i->first));
-				else
-					applog(LOG_DEBUG, CL_YLW "job %s(%u) range done: %08x-%08x", jobid,
-						i->second.height, i->second.scanned_from, i->second.scanned_to);
-			}
-			i++;
+		pthread_mutex_lock(&hashlog_lock);
+		struct hashlog_job *job = job_find((uint32_t) njobid);
+		for (int32_t i = job ? job->first : NIL; i != NIL; i = hl_recs[i].jnext) {
+			struct hashlog_rec *r = &hl_recs[i];
+			if (r->key != keypfx)
+				applog(LOG_DEBUG, CL_YLW "job %s, found %08x ", jobid, LO_DWORD(r->key));
+			else
+				applog(LOG_DEBUG, CL_YLW "job %s(%u) range done: %08x-%08x", jobid,
+					r->data.height, r->data.scanned_from, r->data.scanned_to);
 		}
+		pthread_mutex_unlock(&hashlog_lock);
 	}
 }
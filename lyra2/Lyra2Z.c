@@ -25,6 +25,9 @@
 #include "Lyra2Z.h"
 #include "Sponge.h"
 
+// row r of the memory matrix
+#define memRow(r) (wholeMatrix + (r) * ROW_LEN_INT64)
+
 /**
  * Executes Lyra2 based on the G function from Blake2b. This version supports salts and passwords
  * whose combined length is smaller than the size of the memory matrix, (i.e., (nRows x nCols x b) bits,
@@ -67,23 +70,11 @@ int LYRA2Z(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *s
 	const int64_t BLOCK_LEN = BLOCK_LEN_BLAKE2_SAFE_INT64;
 
 	size_t sz = (size_t)ROW_LEN_BYTES * nRows;
-	uint64_t *wholeMatrix = malloc(sz);
+	uint64_t *wholeMatrix = lyra2_matrix_alloc(sz);
 	if (wholeMatrix == NULL) {
 		return -1;
 	}
-	memset(wholeMatrix, 0, sz);
-
-	//Allocates pointers to each row of the matrix
-	uint64_t **memMatrix = malloc(sizeof(uint64_t*) * nRows);
-	if (memMatrix == NULL) {
-		return -1;
-	}
-	//Places the pointers in the correct positions
-	uint64_t *ptrWord = wholeMatrix;
-	for (i = 0; i < nRows; i++) {
-		memMatrix[i] = ptrWord;
-		ptrWord += ROW_LEN_INT64;
-	}
+	uint64_t *ptrWord;
 	//==========================================================================/
 
 	//============= Getting the password + salt + basil padded with 10*1 ===============//
@@ -93,6 +84,10 @@ int LYRA2Z(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *s
 	//First, we clean enough blocks for the password, salt, basil and padding
 	int64_t nBlocksInput = ((saltlen + pwdlen + 6 * sizeof(uint64_t)) / BLOCK_LEN_BLAKE2_SAFE_BYTES) + 1;
 
+	//The rows are written before being read, only the absorbed blocks need to be cleared
+	size_t szInput = (size_t) (nBlocksInput * BLOCK_LEN * 8);
+	memset(wholeMatrix, 0, szInput < sz ? szInput : sz);
+
 	byte *ptrByte = (byte*) wholeMatrix;
 
 	//Prepends the password
@@ -146,14 +141,14 @@ int LYRA2Z(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *s
 	}
 
 	//Initializes M[0] and M[1]
-	reducedSqueezeRow0(state, memMatrix[0], nCols); //The locally copied password is most likely overwritten here
+	reducedSqueezeRow0(state, memRow(0), nCols); //The locally copied password is most likely overwritten here
 
-	reducedDuplexRow1(state, memMatrix[0], memMatrix[1], nCols);
+	reducedDuplexRow1(state, memRow(0), memRow(1), nCols);
 
 	do {
 		//M[row] = rand; //M[row*] = M[row*] XOR rotW(rand)
 
-		reducedDuplexRowSetup(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
+		reducedDuplexRowSetup(state, memRow(prev), memRow(rowa), memRow(row), nCols);
 
 		//updates the value of row* (deterministically picked during Setup))
 		rowa = (rowa + step) & (window - 1);
@@ -185,7 +180,7 @@ int LYRA2Z(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *s
 			//------------------------------------------------------------------------------------------
 
 			//Performs a reduced-round duplexing operation over M[row*] XOR M[prev], updating both M[row*] and M[row]
-			reducedDuplexRow(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
+			reducedDuplexRow(state, memRow(prev), memRow(rowa), memRow(row), nCols);
 
 			//update prev: it now points to the last row ever computed
 			prev = row;
@@ -201,14 +196,13 @@ int LYRA2Z(void *K, int64_t kLen, const void *pwd, int32_t pwdlen, const void *s
 
 	//============================ Wrap-up Phase ===============================//
 	//Absorbs the last block of the memory matrix
-	absorbBlock(state, memMatrix[rowa]);
+	absorbBlock(state, memRow(rowa));
 
 	//Squeezes the key
 	squeeze(state, K, (unsigned int) kLen);
 
 	//========================= Freeing the memory =============================//
-	free(memMatrix);
-	free(wholeMatrix);
+	lyra2_matrix_free(wholeMatrix);
 
 	return 0;
 }
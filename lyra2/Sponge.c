@@ -20,10 +20,258 @@
  */
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
+#include <pthread.h>
+#include "compat.h"
 #include "Sponge.h"
 #include "Lyra2.h"
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#if defined(_MSC_VER) || defined(__clang__) || (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define SPONGE_AVX2
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#define SPONGE_TARGET __attribute__((target("avx2")))
+#else
+#define SPONGE_TARGET
+#endif
+
+#ifdef SPONGE_AVX2
+/*
+ * The reduced duplexing loops with the 16 words state in 4 avx2 registers,
+ * one row of the G functions each. The blocks of 12 words are 3 registers.
+ */
+
+#define LYRA_ROTR24 _mm256_setr_epi8(3,4,5,6,7,0,1,2, 11,12,13,14,15,8,9,10, \
+	3,4,5,6,7,0,1,2, 11,12,13,14,15,8,9,10)
+#define LYRA_ROTR16 _mm256_setr_epi8(2,3,4,5,6,7,0,1, 10,11,12,13,14,15,8,9, \
+	2,3,4,5,6,7,0,1, 10,11,12,13,14,15,8,9)
+
+#define G_AVX2(a,b,c,d) do { \
+	a = _mm256_add_epi64(a, b); \
+	d = _mm256_shuffle_epi32(_mm256_xor_si256(d, a), 0xB1); \
+	c = _mm256_add_epi64(c, d); \
+	b = _mm256_shuffle_epi8(_mm256_xor_si256(b, c), LYRA_ROTR24); \
+	a = _mm256_add_epi64(a, b); \
+	d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), LYRA_ROTR16); \
+	c = _mm256_add_epi64(c, d); \
+	b = _mm256_xor_si256(b, c); \
+	b = _mm256_xor_si256(_mm256_srli_epi64(b, 63), _mm256_add_epi64(b, b)); \
+  } while(0)
+
+/* one round, G on the columns then on the diagonals */
+#define ROUND_LYRA_AVX2(s) do { \
+	G_AVX2(s[0], s[1], s[2], s[3]); \
+	s[1] = _mm256_permute4x64_epi64(s[1], 0x39); \
+	s[2] = _mm256_permute4x64_epi64(s[2], 0x4E); \
+	s[3] = _mm256_permute4x64_epi64(s[3], 0x93); \
+	G_AVX2(s[0], s[1], s[2], s[3]); \
+	s[1] = _mm256_permute4x64_epi64(s[1], 0x93); \
+	s[2] = _mm256_permute4x64_epi64(s[2], 0x4E); \
+	s[3] = _mm256_permute4x64_epi64(s[3], 0x39); \
+  } while(0)
+
+#define LOAD_AVX2(p, i) _mm256_loadu_si256((const __m256i*) (p) + (i))
+#define STORE_AVX2(p, i, v) _mm256_storeu_si256((__m256i*) (p) + (i), v)
+
+/* rotW(rand): words 11, 0, 1 ... 10 of the state */
+#define ROTW_AVX2(r, s) do { \
+	__m256i t0 = _mm256_permute4x64_epi64(s[0], 0x93); \
+	__m256i t1 = _mm256_permute4x64_epi64(s[1], 0x93); \
+	__m256i t2 = _mm256_permute4x64_epi64(s[2], 0x93); \
+	r[0] = _mm256_blend_epi32(t0, t2, 0x03); \
+	r[1] = _mm256_blend_epi32(t1, t0, 0x03); \
+	r[2] = _mm256_blend_epi32(t2, t1, 0x03); \
+  } while(0)
+
+SPONGE_TARGET
+static void blake2bLyra_avx2(uint64_t *v)
+{
+	__m256i s[4];
+	int i;
+	for (i = 0; i < 4; i++) s[i] = LOAD_AVX2(v, i);
+	for (i = 0; i < 12; i++)
+		ROUND_LYRA_AVX2(s);
+	for (i = 0; i < 4; i++) STORE_AVX2(v, i, s[i]);
+}
+
+SPONGE_TARGET
+static void reducedSqueezeRow0_avx2(uint64_t* state, uint64_t* rowOut, const uint32_t nCols)
+{
+	uint64_t* ptrWord = rowOut + (nCols-1)*BLOCK_LEN_INT64;
+	__m256i s[4];
+	unsigned int i;
+
+	for (i = 0; i < 4; i++) s[i] = LOAD_AVX2(state, i);
+	for (i = 0; i < nCols; i++) {
+		STORE_AVX2(ptrWord, 0, s[0]);
+		STORE_AVX2(ptrWord, 1, s[1]);
+		STORE_AVX2(ptrWord, 2, s[2]);
+		ptrWord -= BLOCK_LEN_INT64;
+		ROUND_LYRA_AVX2(s);
+	}
+	for (i = 0; i < 4; i++) STORE_AVX2(state, i, s[i]);
+}
+
+SPONGE_TARGET
+static void reducedDuplexRow1_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, const uint32_t nCols)
+{
+	uint64_t* ptrWordIn = rowIn;
+	uint64_t* ptrWordOut = rowOut + (nCols-1)*BLOCK_LEN_INT64;
+	__m256i s[4], in[3];
+	unsigned int i, j;
+
+	for (i = 0; i < 4; i++) s[i] = LOAD_AVX2(state, i);
+	for (i = 0; i < nCols; i++) {
+		for (j = 0; j < 3; j++) {
+			in[j] = LOAD_AVX2(ptrWordIn, j);
+			s[j] = _mm256_xor_si256(s[j], in[j]);
+		}
+		ROUND_LYRA_AVX2(s);
+		for (j = 0; j < 3; j++)
+			STORE_AVX2(ptrWordOut, j, _mm256_xor_si256(in[j], s[j]));
+		ptrWordIn += BLOCK_LEN_INT64;
+		ptrWordOut -= BLOCK_LEN_INT64;
+	}
+	for (i = 0; i < 4; i++) STORE_AVX2(state, i, s[i]);
+}
+
+SPONGE_TARGET
+static void reducedDuplexRowSetup_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, const uint32_t nCols)
+{
+	uint64_t* ptrWordIn = rowIn;
+	uint64_t* ptrWordInOut = rowInOut;
+	uint64_t* ptrWordOut = rowOut + (nCols-1)*BLOCK_LEN_INT64;
+	__m256i s[4], in[3], r[3];
+	unsigned int i, j;
+
+	for (i = 0; i < 4; i++) s[i] = LOAD_AVX2(state, i);
+	for (i = 0; i < nCols; i++) {
+		for (j = 0; j < 3; j++) {
+			in[j] = LOAD_AVX2(ptrWordIn, j);
+			s[j] = _mm256_xor_si256(s[j], _mm256_add_epi64(in[j], LOAD_AVX2(ptrWordInOut, j)));
+		}
+		ROUND_LYRA_AVX2(s);
+		for (j = 0; j < 3; j++)
+			STORE_AVX2(ptrWordOut, j, _mm256_xor_si256(in[j], s[j]));
+		ROTW_AVX2(r, s);
+		for (j = 0; j < 3; j++)
+			STORE_AVX2(ptrWordInOut, j, _mm256_xor_si256(LOAD_AVX2(ptrWordInOut, j), r[j]));
+		ptrWordInOut += BLOCK_LEN_INT64;
+		ptrWordIn += BLOCK_LEN_INT64;
+		ptrWordOut -= BLOCK_LEN_INT64;
+	}
+	for (i = 0; i < 4; i++) STORE_AVX2(state, i, s[i]);
+}
+
+SPONGE_TARGET
+static void reducedDuplexRow_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, const uint32_t nCols)
+{
+	uint64_t* ptrWordInOut = rowInOut;
+	uint64_t* ptrWordIn = rowIn;
+	uint64_t* ptrWordOut = rowOut;
+	__m256i s[4], r[3];
+	unsigned int i, j;
+
+	for (i = 0; i < 4; i++) s[i] = LOAD_AVX2(state, i);
+	for (i = 0; i < nCols; i++) {
+		for (j = 0; j < 3; j++)
+			s[j] = _mm256_xor_si256(s[j], _mm256_add_epi64(LOAD_AVX2(ptrWordIn, j), LOAD_AVX2(ptrWordInOut, j)));
+		ROUND_LYRA_AVX2(s);
+		// rowOut can be rowInOut, both are reloaded after the previous store
+		for (j = 0; j < 3; j++)
+			STORE_AVX2(ptrWordOut, j, _mm256_xor_si256(LOAD_AVX2(ptrWordOut, j), s[j]));
+		ROTW_AVX2(r, s);
+		for (j = 0; j < 3; j++)
+			STORE_AVX2(ptrWordInOut, j, _mm256_xor_si256(LOAD_AVX2(ptrWordInOut, j), r[j]));
+		ptrWordOut += BLOCK_LEN_INT64;
+		ptrWordInOut += BLOCK_LEN_INT64;
+		ptrWordIn += BLOCK_LEN_INT64;
+	}
+	for (i = 0; i < 4; i++) STORE_AVX2(state, i, s[i]);
+}
+
+static int sponge_cpu_avx2(void)
+{
+	uint32_t r[4];
+	uint64_t xcr0 = 0;
+#ifdef _MSC_VER
+	int cr[4];
+	__cpuidex(cr, 0, 0);
+	if (cr[0] < 7) return 0;
+	__cpuidex(cr, 1, 0);
+	r[2] = cr[2];
+#else
+	if (__get_cpuid_max(0, NULL) < 7) return 0;
+	__cpuid_count(1, 0, r[0], r[1], r[2], r[3]);
+#endif
+	// osxsave + avx, then the ymm state enabled by the os
+	if (!(r[2] & (1 << 27)) || !(r[2] & (1 << 28)))
+		return 0;
+#ifdef _MSC_VER
+	xcr0 = _xgetbv(0);
+	__cpuidex(cr, 7, 0);
+	r[1] = cr[1];
+#else
+	{
+		uint32_t lo, hi;
+		__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(lo), "=d"(hi) : "c"(0));
+		xcr0 = ((uint64_t)hi << 32) | lo;
+	}
+	__cpuid_count(7, 0, r[0], r[1], r[2], r[3]);
+#endif
+	return (r[1] & (1 << 5)) && (xcr0 & 0x06) == 0x06;
+}
+
+static void blake2bLyra(uint64_t *v);
+static void reducedDuplexRow_scalar(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, const uint32_t nCols);
+
+/* a wandering row against the scalar code, with rowOut == rowInOut like it happens */
+static int sponge_avx2_check(void)
+{
+	uint64_t st1[16], st2[16], m1[3][24], m2[3][24];
+	uint64_t v1[16], v2[16];
+	int i;
+	for (i = 0; i < 16; i++) st1[i] = st2[i] = 0x9e3779b97f4a7c15ULL * (i + 1);
+	for (i = 0; i < 3*24; i++) m1[i/24][i%24] = m2[i/24][i%24] = 0xbf58476d1ce4e5b9ULL * (i + 7);
+	reducedDuplexRow_scalar(st1, m1[0], m1[1], m1[2], 2);
+	reducedDuplexRow_avx2(st2, m2[0], m2[1], m2[2], 2);
+	reducedDuplexRow_scalar(st1, m1[2], m1[1], m1[1], 2);
+	reducedDuplexRow_avx2(st2, m2[2], m2[1], m2[1], 2);
+	reducedDuplexRowSetup(st1, m1[0], m1[1], m1[2], 2);
+	reducedDuplexRowSetup_avx2(st2, m2[0], m2[1], m2[2], 2);
+	memcpy(v1, st1, sizeof(v1));
+	memcpy(v2, st2, sizeof(v2));
+	blake2bLyra(v1);
+	blake2bLyra_avx2(v2);
+	return !memcmp(st1, st2, sizeof(st1)) && !memcmp(m1, m2, sizeof(m1)) && !memcmp(v1, v2, sizeof(v1));
+}
+
+// set once from initState(), blake2bLyra() and the setup duplexing (run by the check) only test > 0
+static pthread_once_t sponge_avx2_once = PTHREAD_ONCE_INIT;
+static int sponge_avx2 = 0;
+
+static void sponge_avx2_init(void)
+{
+	sponge_avx2 = sponge_cpu_avx2() && sponge_avx2_check();
+}
+
+static int sponge_use_avx2(void)
+{
+	pthread_once(&sponge_avx2_once, sponge_avx2_init);
+	return sponge_avx2;
+}
+#endif /* SPONGE_AVX2 */
+
 
 /**
  * Initializes the Sponge State. The first 512 bits are set to zeros and the remainder
@@ -37,6 +285,9 @@
  * @param state         The 1024-bit array to be initialized
  */
 void initState(uint64_t state[/*16*/]) {
+#ifdef SPONGE_AVX2
+	sponge_use_avx2();
+#endif
 	//First 512 bis are zeros
 	memset(state, 0, 64);
 	//Remainder BLOCK_LEN_BLAKE2_SAFE_BYTES are reserved to the IV
@@ -56,6 +307,12 @@ void initState(uint64_t state[/*16*/]) {
  * @param v     A 1024-bit (16 uint64_t) array to be processed by Blake2b's G function
  */
 __inline static void blake2bLyra(uint64_t *v) {
+#ifdef SPONGE_AVX2
+	if (sponge_avx2 > 0) {
+		blake2bLyra_avx2(v);
+		return;
+	}
+#endif
 	ROUND_LYRA(0);
 	ROUND_LYRA(1);
 	ROUND_LYRA(2);
@@ -165,6 +422,12 @@ void reducedSqueezeRow0(uint64_t* state, uint64_t* rowOut, const uint32_t nCols)
 {
 	uint64_t* ptrWord = rowOut + (nCols-1)*BLOCK_LEN_INT64; //In Lyra2: pointer to M[0][C-1]
 	unsigned int i;
+#ifdef SPONGE_AVX2
+	if (sponge_use_avx2()) {
+		reducedSqueezeRow0_avx2(state, rowOut, nCols);
+		return;
+	}
+#endif
 	//M[row][C-1-col] = H.reduced_squeeze()
 	for (i = 0; i < nCols; i++) {
 		ptrWord[0] = state[0];
@@ -202,6 +465,12 @@ void reducedDuplexRow1(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, const
 	uint64_t* ptrWordIn = rowIn;				//In Lyra2: pointer to prev
 	uint64_t* ptrWordOut = rowOut + (nCols-1)*BLOCK_LEN_INT64; //In Lyra2: pointer to row
 	unsigned int i;
+#ifdef SPONGE_AVX2
+	if (sponge_use_avx2()) {
+		reducedDuplexRow1_avx2(state, rowIn, rowOut, nCols);
+		return;
+	}
+#endif
 
 	for (i = 0; i < nCols; i++) {
 
@@ -263,6 +532,12 @@ void reducedDuplexRowSetup(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut,
 	uint64_t* ptrWordInOut = rowInOut;				//In Lyra2: pointer to row*
 	uint64_t* ptrWordOut = rowOut + (nCols-1)*BLOCK_LEN_INT64; //In Lyra2: pointer to row
 	unsigned int i;
+#ifdef SPONGE_AVX2
+	if (sponge_avx2 > 0) {
+		reducedDuplexRowSetup_avx2(state, rowIn, rowInOut, rowOut, nCols);
+		return;
+	}
+#endif
 
 	for (i = 0; i < nCols; i++) {
 
@@ -333,7 +608,19 @@ void reducedDuplexRowSetup(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut,
  * @param rowOut         Row receiving the output
  *
  */
+#ifdef SPONGE_AVX2
+void reducedDuplexRow(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, const uint32_t nCols)
+{
+	if (sponge_use_avx2())
+		reducedDuplexRow_avx2(state, rowIn, rowInOut, rowOut, nCols);
+	else
+		reducedDuplexRow_scalar(state, rowIn, rowInOut, rowOut, nCols);
+}
+
+static void reducedDuplexRow_scalar(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, const uint32_t nCols)
+#else
 void reducedDuplexRow(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, const uint32_t nCols)
+#endif
 {
 	uint64_t* ptrWordInOut = rowInOut; //In Lyra2: pointer to row*
 	uint64_t* ptrWordIn = rowIn; //In Lyra2: pointer to prev
@@ -394,6 +681,25 @@ void reducedDuplexRow(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint
 	}
 }
 
+// per thread matrix, the rows are fully written before being read
+static __thread uint64_t lyra2_matrix[LYRA2_MATRIX_MAX_BYTES / 8];
+
+/**
+ * Memory matrix of a LYRA2() call, the thread buffer unless it is too small
+ */
+uint64_t* lyra2_matrix_alloc(size_t size)
+{
+	if (size <= sizeof(lyra2_matrix))
+		return lyra2_matrix;
+	return (uint64_t*) malloc(size);
+}
+
+void lyra2_matrix_free(uint64_t *matrix)
+{
+	if (matrix != lyra2_matrix)
+		free(matrix);
+}
+
 /**
  * Prints an array of unsigned chars
  */
@@ -23,6 +23,7 @@
 #define SPONGE_H_
 
 #include <stdint.h>
+#include <stddef.h>
 
 /* Blake2b IV Array */
 static const uint64_t blake2b_IV[8] =
@@ -85,4 +86,11 @@ void reducedDuplexRow(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint
 //---- Misc
 void printArray(unsigned char *array, unsigned int size, char *name);
 
+//---- Memory matrix
+// 8 rows x 8 columns of 96 bytes blocks (lyra2, lyra2z, allium, phi2), v2 and v3 use 4x4
+#define LYRA2_MATRIX_MAX_BYTES (8 * 8 * 96)
+
+uint64_t* lyra2_matrix_alloc(size_t size);
+void lyra2_matrix_free(uint64_t *matrix);
+
 #endif /* SPONGE_H_ */
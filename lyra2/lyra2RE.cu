@@ -3,6 +3,7 @@ extern "C" {
 #include "sph/sph_groestl.h"
 #include "sph/sph_skein.h"
 #include "sph/sph_keccak.h"
+#include "sph/sph_midstate.h"
 #include "lyra2/Lyra2.h"
 }
 
@@ -35,6 +36,8 @@ extern uint32_t groestl256_cpu_hash_32(int thr_id, uint32_t threads, uint32_t st
 extern uint32_t groestl256_getSecNonce(int thr_id, int num);
 
 
+static __thread sph_midstate80 s_midstate;
+
 extern "C" void lyra2re_hash(void *state, const void *input)
 {
 	uint32_t hashA[8], hashB[8];
@@ -46,8 +49,7 @@ extern "C" void lyra2re_hash(void *state, const void *input)
 
 	sph_blake256_set_rounds(14);
 
-	sph_blake256_init(&ctx_blake);
-	sph_blake256(&ctx_blake, input, 80);
+	SPH_MIDSTATE80(&s_midstate, blake256, &ctx_blake, input);
 	sph_blake256_close(&ctx_blake, hashA);
 
 	sph_keccak256_init(&ctx_keccak);
@@ -4,6 +4,7 @@ extern "C" {
 #include "sph/sph_skein.h"
 #include "sph/sph_keccak.h"
 #include "sph/sph_cubehash.h"
+#include "sph/sph_midstate.h"
 #include "lyra2/Lyra2.h"
 }
 
@@ -35,6 +36,8 @@ extern void bmw256_cpu_init(int thr_id, uint32_t threads);
 extern void bmw256_cpu_free(int thr_id);
 extern void bmw256_cpu_hash_32(int thr_id, uint32_t threads, uint32_t startNounce, uint64_t *g_hash, uint32_t *resultnonces);
 
+static __thread sph_midstate80 s_midstate;
+
 void lyra2v2_hash(void *state, const void *input)
 {
 	uint32_t hashA[8], hashB[8];
@@ -47,8 +50,7 @@ void lyra2v2_hash(void *state, const void *input)
 
 	sph_blake256_set_rounds(14);
 
-	sph_blake256_init(&ctx_blake);
-	sph_blake256(&ctx_blake, input, 80);
+	SPH_MIDSTATE80(&s_midstate, blake256, &ctx_blake, input);
 	sph_blake256_close(&ctx_blake, hashA);
 
 	sph_keccak256_init(&ctx_keccak);
@@ -151,6 +153,27 @@ extern "C" int scanhash_lyra2v2(int thr_id, struct work* work, uint32_t max_nonc
 		{
 			const uint32_t Htarg = ptarget[7];
 			uint32_t _ALIGN(64) vhash[8];
+			if (verify_nonce_async(thr_id, work, work->nonces[0])) {
+				// the cpu threads check them, launch the next batch
+				const uint32_t nonce2 = work->nonces[1];
+				pdata[19] = max(work->nonces[0], nonce2) + 1;
+				if (!nonce2 || verify_nonce_async(thr_id, work, nonce2))
+					continue;
+				// queue full, the second one is checked here
+				be32enc(&endiandata[19], nonce2);
+				lyra2v2_hash(vhash, endiandata);
+				if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
+					work->nonces[0] = nonce2;
+					work->nonces[1] = 0;
+					work->valid_nonces = 1;
+					bn_set_target_ratio(work, vhash, 0);
+					return work->valid_nonces;
+				}
+				gpu_increment_reject(thr_id);
+				if (!opt_quiet)
+				gpulog(LOG_WARNING, thr_id, "result for %08x does not validate on CPU!", nonce2);
+				continue;
+			}
 			be32enc(&endiandata[19], work->nonces[0]);
 			lyra2v2_hash(vhash, endiandata);
 
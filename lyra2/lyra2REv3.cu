@@ -2,6 +2,7 @@ extern "C" {
 #include "sph/sph_blake.h"
 #include "sph/sph_bmw.h"
 #include "sph/sph_cubehash.h"
+#include "sph/sph_midstate.h"
 #include "lyra2/Lyra2.h"
 }
 
@@ -28,6 +29,8 @@ extern void bmw256_cpu_init(int thr_id, uint32_t threads);
 extern void bmw256_cpu_free(int thr_id);
 extern void bmw256_cpu_hash_32(int thr_id, uint32_t threads, uint32_t startNounce, uint64_t *g_hash, uint32_t *resultnonces);
 
+static __thread sph_midstate80 s_midstate;
+
 extern "C" void lyra2v3_hash(void *state, const void *input)
 {
 	uint32_t hashA[8], hashB[8];
@@ -38,8 +41,7 @@ extern "C" void lyra2v3_hash(void *state, const void *input)
 
 	sph_blake256_set_rounds(14);
 
-	sph_blake256_init(&ctx_blake);
-	sph_blake256(&ctx_blake, input, 80);
+	SPH_MIDSTATE80(&s_midstate, blake256, &ctx_blake, input);
 	sph_blake256_close(&ctx_blake, hashA);
 
 	LYRA2_3(hashB, 32, hashA, 32, hashA, 32, 1, 4, 4);
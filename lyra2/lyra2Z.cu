@@ -1,5 +1,6 @@
 extern "C" {
 #include <sph/sph_blake.h>
+#include <sph/sph_midstate.h>
 #include "Lyra2Z.h"
 }
 
@@ -21,14 +22,15 @@ extern uint32_t lyra2Z_cpu_hash_32(int thr_id, uint32_t threads, uint32_t startN
 extern void lyra2Z_setTarget(const void *ptarget);
 extern uint32_t lyra2Z_getSecNonce(int thr_id, int num);
 
+static __thread sph_midstate80 s_midstate;
+
 extern "C" void lyra2Z_hash(void *state, const void *input)
 {
 	uint32_t _ALIGN(64) hashA[8], hashB[8];
 	sph_blake256_context ctx_blake;
 
 	sph_blake256_set_rounds(14);
-	sph_blake256_init(&ctx_blake);
-	sph_blake256(&ctx_blake, input, 80);
+	SPH_MIDSTATE80(&s_midstate, blake256, &ctx_blake, input);
 	sph_blake256_close(&ctx_blake, hashA);
 
 	LYRA2Z(hashB, 32, hashA, 32, hashA, 32, 8, 8, 8);
@@ -107,6 +109,31 @@ extern "C" int scanhash_lyra2Z(int thr_id, struct work* work, uint32_t max_nonce
 		{
 			uint32_t _ALIGN(64) vhash[8];
 
+			if (verify_nonce_async(thr_id, work, work->nonces[0])) {
+				// the cpu threads check them, launch the next batch
+				const uint32_t nonce2 = lyra2Z_getSecNonce(thr_id, 1);
+				if (nonce2 == UINT32_MAX) {
+					pdata[19] = work->nonces[0] + 1;
+					continue;
+				}
+				pdata[19] = max(work->nonces[0], nonce2) + 1;
+				if (verify_nonce_async(thr_id, work, nonce2))
+					continue;
+				// queue full, the second one is checked here
+				be32enc(&endiandata[19], nonce2);
+				lyra2Z_hash(vhash, endiandata);
+				if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
+					work->nonces[0] = nonce2;
+					work->nonces[1] = UINT32_MAX;
+					work->valid_nonces = 1;
+					bn_set_target_ratio(work, vhash, 0);
+					return work->valid_nonces;
+				}
+				gpu_increment_reject(thr_id);
+				if (!opt_quiet)	gpulog(LOG_WARNING, thr_id,
+					"result for %08x does not validate on CPU!", nonce2);
+				continue;
+			}
 			be32enc(&endiandata[19], work->nonces[0]);
 			lyra2Z_hash(vhash, endiandata);
 
@@ -267,6 +267,46 @@ json_t * json_load_url(char* cfg_url, json_error_t *err);
 void sha256_init(uint32_t *state);
 void sha256_transform(uint32_t *state, const uint32_t *block, int swap);
 void sha256d(unsigned char *hash, const unsigned char *data, int len);
+void sha256d_midstate(unsigned char *hash, const uint32_t *midstate,
+	const unsigned char *tail, int tail_len, int len);
+void sha256d_merkle(uint32_t *hash, const uint32_t *branch);
+
+// multi-buffer versions (sph/sha256_mb.c), arrays of count messages
+int sha256_mb_lanes(void);
+const char* sha256_mb_name(void);
+int sha256_shani_available(void);
+void sha256_transform_shani(uint32_t *state, const uint32_t *block, int swap);
+void sha256d_midstate_mb(unsigned char *hash, const uint32_t *midstate,
+	const unsigned char *tails, int tail_len, int len, int count);
+void sha256d_merkle_mb(uint32_t *hash, const uint32_t *branch, int count);
+void hmac_sha256_80_init_mb(const uint32_t *key, uint32_t *tstate, uint32_t *ostate, int count);
+void pbkdf2_sha256_80_128_mb(const uint32_t *tstate, const uint32_t *ostate,
+	const uint32_t *salt, uint32_t *output, int count);
+void pbkdf2_sha256_128_32_mb(const uint32_t *tstate, const uint32_t *ostate,
+	const uint32_t *salt, uint32_t *output, int count);
+
+// cpu hash chains of the permutation algos (hash_chain.cpp)
+enum hash_chain_id {
+	HC_BLAKE = 0, HC_BMW, HC_GROESTL, HC_SKEIN, HC_JH, HC_KECCAK, HC_LUFFA, HC_CUBEHASH,
+	HC_SHAVITE, HC_SIMD, HC_ECHO, HC_HAMSI, HC_FUGUE, HC_SHABAL, HC_WHIRLPOOL, HC_SHA512,
+	HC_ALGO_COUNT
+};
+#define HASH_CHAIN_MAX 16
+struct hash_chain_stage {
+	void (*init)(void *cc);
+	void (*update)(void *cc, const void *data, size_t len);
+	void (*close)(void *cc, void *dst);
+	const void *init_ctx;
+	size_t size;
+	bool midstate;
+};
+struct hash_chain {
+	uint64_t key;
+	int count;
+	struct hash_chain_stage stage[HASH_CHAIN_MAX];
+};
+bool hash_chain_compile(struct hash_chain *hc, uint64_t key, const char *order, const uint8_t *ids);
+void hash_chain_hash(const struct hash_chain *hc, void *output, const void *input, size_t len);
 
 #define HAVE_SHA256_4WAY 0
 #define HAVE_SHA256_8WAY 0
@@ -342,6 +382,8 @@ extern int scanhash_scrypt(int thr_id, struct work *work, uint32_t max_nonce, un
 	unsigned char *scratchbuf, struct timeval *tv_start, struct timeval *tv_end);
 extern int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsigned long *hashes_done,
 	unsigned char *scratchbuf, struct timeval *tv_start, struct timeval *tv_end, int block_version);
+extern int scanhash_scrypt_jane_cpu(int thr_id, struct work *work, uint32_t max_nonce, unsigned long *hashes_done,
+	struct timeval *tv_start, struct timeval *tv_end, int block_version);
 
 /* free device allocated memory per algo */
 void algo_free_all(int thr_id);
@@ -418,6 +460,7 @@ extern void free_scrypt_jane(int thr_id);
 /* api related */
 void *api_thread(void *userdata);
 void api_set_throughput(int thr_id, uint32_t throughput);
+void gpu_increment_accept(int thr_id, uint32_t nonces);
 void gpu_increment_reject(int thr_id);
 
 struct monitor_info {
@@ -546,6 +589,7 @@ extern bool opt_protocol;
 extern bool opt_showdiff;
 extern bool opt_tracegpu;
 extern int opt_n_threads;
+extern int opt_cpu_threads;
 extern int active_gpus;
 extern int gpu_threads;
 extern int opt_timeout;
@@ -576,9 +620,16 @@ extern double net_diff;
 extern double stratum_diff;
 
 #define MAX_GPUS 16
+
+/* kind of device behind a miner thread */
+#define DEVICE_TYPE_CUDA 0
+#define DEVICE_TYPE_CPU  1
+#define DEVICE_TYPE_SIM  2
+
 //#define MAX_THREADS 32 todo
 extern char* device_name[MAX_GPUS];
 extern short device_map[MAX_GPUS];
+extern uint8_t device_type[MAX_GPUS];
 extern short device_mpcount[MAX_GPUS];
 extern long  device_sm[MAX_GPUS];
 extern uint32_t device_plimit[MAX_GPUS];
@@ -652,6 +703,10 @@ extern bool fulltest(const uint32_t *hash, const uint32_t *target);
 extern char* get_target_string(const uint32_t *hash);
 void diff_to_target(uint32_t* target, double diff);
 void work_set_target(struct work* work, double diff);
+void stratum_set_target(struct work* work, double diff);
+struct work_txs* work_txs_alloc();
+void work_copy(struct work *dest, const struct work *src);
+void work_free(struct work *work);
 double target_to_diff(uint32_t* target);
 extern void get_currentalgo(char* buf, int sz);
 
@@ -671,6 +726,58 @@ bool bench_algo_switch_next(int thr_id);
 void bench_set_throughput(int thr_id, uint32_t throughput);
 void bench_display_results();
 
+// cpu hashes benchmark (cpu-bench.cpp)
+extern bool opt_cpu_bench;
+extern char *opt_cpu_bench_algos;
+extern char *opt_cpu_bench_json;
+extern int opt_cpu_bench_runs;
+int cpu_bench_run(void);
+
+// local stratum pool simulator (sim-pool.cpp)
+extern bool opt_sim_pool;
+extern int opt_sim_pool_interval;
+extern int opt_sim_pool_branches;
+extern double opt_sim_pool_diff;
+bool sim_pool_start(void);
+void sim_pool_job_hashing(const char *job_id);
+void sim_pool_share_answer(uint32_t usecs);
+void sim_pool_report(void);
+
+// virtual devices (sim-device.cpp)
+extern int opt_sim_devices;
+extern double opt_sim_rate;
+extern double opt_sim_share_prob;
+extern bool opt_sim_verify;
+bool sim_devices_init(void);
+int scanhash_sim(int thr_id, struct work *work, uint32_t max_nonce, unsigned long *hashes_done);
+
+// background cpu verification of the gpu nonces (verify.cpp)
+extern int opt_verify_threads;
+extern int opt_verify_queue;
+typedef bool (*verify_result_fn)(int thr_id, struct work *work);
+bool verify_pool_start(verify_result_fn result);
+bool verify_nonce_async(int thr_id, const struct work *work, uint32_t nonce);
+void verify_pool_stop(void);
+void verify_pool_report(void);
+
+// adaptive scan window of the miner threads (scan-window.cpp)
+extern double opt_scan_target;
+extern char *opt_scan_state;
+void scan_window_init(void);
+void scan_window_save(void);
+void scan_window_reset(int thr_id);
+void scan_window_new_job(int pooln);
+uint64_t scan_window_size(int thr_id, int pooln, double budget);
+void scan_window_update(int thr_id, uint64_t nonces, uint64_t hashes, double dtime, bool full);
+
+// nonce space leases of the stratum works (nonce-lease.cpp)
+bool nonce_lease_algo(void);
+uint32_t nonce_lease_key(const uint32_t *data, int len);
+bool nonce_lease_next(int thr_id, uint32_t key, uint64_t window, uint32_t *start, uint32_t *last);
+bool nonce_lease_left(int thr_id, uint32_t key);
+void nonce_lease_done(int thr_id, uint32_t key, uint32_t start, uint64_t next);
+void nonce_lease_report(void);
+
 struct stratum_job {
 	char *job_id;
 	unsigned char prevhash[32];
@@ -679,6 +786,9 @@ struct stratum_job {
 	unsigned char *xnonce2;
 	int merkle_count;
 	unsigned char **merkle;
+	uint32_t *merkle_be; // branches as sha256 words
+	uint32_t coinbase_ms[8]; // sha256 state of the coinbase start
+	int coinbase_ms_len; // coinbase bytes in coinbase_ms, before xnonce2
 	unsigned char version[4];
 	unsigned char nbits[4];
 	unsigned char ntime[4];
@@ -699,6 +809,13 @@ struct stratum_ctx {
 	curl_socket_t sock;
 	size_t sockbuf_size;
 	char *sockbuf;
+	size_t sockbuf_head; // unread data start
+	size_t sockbuf_tail; // received data end
+	size_t sockbuf_scan; // bytes after head without newline
+	size_t sendbuf_size;
+	size_t sendbuf_len;
+	size_t sendbuf_sent;
+	char *sendbuf;
 
 	double next_diff;
 	double sharediff;
@@ -726,6 +843,12 @@ struct tx {
 	uint32_t len;
 };
 
+/* pok getwork txs, read only and shared by the copies of a work */
+struct work_txs {
+	int refs;
+	struct tx tx[POK_MAX_TXS];
+};
+
 #define MAX_NONCES 2
 struct work {
 	uint32_t data[48];
@@ -758,7 +881,7 @@ struct work {
 
 	/* pok getwork txs */
 	uint32_t tx_count;
-	struct tx txs[POK_MAX_TXS];
+	struct work_txs *txs;
 	// zec solution
 	uint8_t extra[1388];
 };
@@ -834,12 +957,14 @@ json_t * json_rpc_longpoll(CURL *curl, char *lp_url, struct pool_infos*,
 bool stratum_socket_full(struct stratum_ctx *sctx, int timeout);
 bool stratum_send_line(struct stratum_ctx *sctx, char *s);
 char *stratum_recv_line(struct stratum_ctx *sctx);
+const char *stratum_recv_line_view(struct stratum_ctx *sctx);
 bool stratum_connect(struct stratum_ctx *sctx, const char *url);
 void stratum_disconnect(struct stratum_ctx *sctx);
 bool stratum_subscribe(struct stratum_ctx *sctx);
 bool stratum_authorize(struct stratum_ctx *sctx, const char *user, const char *pass);
 bool stratum_handle_method(struct stratum_ctx *sctx, const char *s);
 void stratum_free_job(struct stratum_ctx *sctx);
+bool stratum_merkle_roots(struct stratum_ctx *sctx, const uchar *xnonce2s, uint32_t *roots, int count);
 
 bool rpc2_stratum_authorize(struct stratum_ctx *sctx, const char *user, const char *pass);
 
@@ -867,6 +992,7 @@ void hashlog_getmeminfo(uint64_t *mem, uint32_t *records);
 
 void stats_remember_speed(int thr_id, uint32_t hashcount, double hashrate, uint8_t found, uint32_t height);
 double stats_get_speed(int thr_id, double def_speed);
+double stats_get_speed_ewma(int thr_id, double def_speed);
 double stats_get_gpu_speed(int gpu_id);
 int  stats_get_history(int thr_id, struct stats_data *data, int max_records);
 void stats_purge_old(void);
@@ -894,6 +1020,8 @@ extern void tq_thaw(struct thread_q *tq);
 void parse_arg(int key, char *arg);
 void proper_exit(int reason);
 void restart_threads(void);
+void g_work_changed(void);
+extern volatile uint32_t g_work_gen;
 
 size_t time2str(char* buf, time_t timer);
 char* atime2str(time_t timer);
@@ -904,6 +1032,8 @@ void applog_hash64(void *hash);
 void applog_compare_hash(void *hash, void *hash_ref);
 
 void print_hash_tests(void);
+typedef void (*cpu_hash_fn)(void *output, const void *input);
+cpu_hash_fn algo_cpu_hash(int algo);
 void allium_hash(void *state, const void *input);
 void bastionhash(void* output, const unsigned char* input);
 void blake256hash(void *output, const void *input, int8_t rounds);
@@ -912,8 +1042,10 @@ void blake2s_hash(void *output, const void *input);
 void bmw_hash(void *state, const void *input);
 void c11hash(void *output, const void *input);
 void cryptolight_hash_variant(void* output, const void* input, int len, int variant);
+void cryptolight_hash_variant_x2(void* output, const void* input, int len, int variant);
 void cryptolight_hash(void* output, const void* input);
 void cryptonight_hash_variant(void* output, const void* input, size_t len, int variant);
+void cryptonight_hash_variant_x2(void* output, const void* input, size_t len, int variant);
 void cryptonight_hash(void* output, const void* input);
 void monero_hash(void* output, const void* input);
 void stellite_hash(void* output, const void* input);
@@ -945,6 +1077,7 @@ void quarkhash(void *state, const void *input);
 void qubithash(void *state, const void *input);
 void scrypthash(void* output, const void* input);
 void scryptjane_hash(void* output, const void* input);
+void scryptjane_hash_free(void);
 void sha256d_hash(void *output, const void *input);
 void sha256t_hash(void *output, const void *input);
 void sha256q_hash(void *output, const void *input);
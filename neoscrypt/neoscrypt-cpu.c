@@ -297,6 +297,31 @@ static void neoscrypt_pbkdf2_sha256(const uint8_t *password, size_t password_len
 
 /* NeoScrypt */
 
+#if !defined(ASM) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define NEOSCRYPT_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER) || defined(__clang__) || (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define NEOSCRYPT_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+#endif
+
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#define NEOSCRYPT_TARGET(x) __attribute__((target(x)))
+#else
+#define NEOSCRYPT_TARGET(x)
+#endif
+
+/* Salsa20 of the SIMD code works on blocks in a tangled layout */
+#if defined(ASM) || defined(NEOSCRYPT_SSE2)
+#define NEOSCRYPT_TANGLE
+#endif
+
 #if defined(ASM)
 
 extern void neoscrypt_salsa(uint *X, uint rounds);
@@ -309,6 +334,120 @@ extern void neoscrypt_blkxor(void *dstp, const void *srcp, uint len);
 
 #else
 
+#if defined(NEOSCRYPT_SSE2)
+
+/* Double rounds on the 4 rows of a block, the rows are rotated to align the
+ * diagonals. The ops are those of the vector type, an avx2 register holds
+ * the same row of two blocks. */
+
+/* Salsa20, rows (x0,x5,x10,x15) (x12,x1,x6,x11) (x8,x13,x2,x7) (x4,x9,x14,x3) */
+#define SALSA_DOUBLEROUND(X0, X1, X2, X3, add, xor, rotl, shuf) do { \
+	X3 = xor(X3, rotl(add(X0, X1),  7)); \
+	X2 = xor(X2, rotl(add(X3, X0),  9)); \
+	X1 = xor(X1, rotl(add(X2, X3), 13)); \
+	X0 = xor(X0, rotl(add(X1, X2), 18)); \
+	X1 = shuf(X1, 0x39); X2 = shuf(X2, 0x4E); X3 = shuf(X3, 0x93); \
+	X1 = xor(X1, rotl(add(X0, X3),  7)); \
+	X2 = xor(X2, rotl(add(X1, X0),  9)); \
+	X3 = xor(X3, rotl(add(X2, X1), 13)); \
+	X0 = xor(X0, rotl(add(X3, X2), 18)); \
+	X1 = shuf(X1, 0x93); X2 = shuf(X2, 0x4E); X3 = shuf(X3, 0x39); \
+} while (0)
+
+/* ChaCha20, rows (x0..x3) (x4..x7) (x8..x11) (x12..x15) */
+#define CHACHA_DOUBLEROUND(X0, X1, X2, X3, add, xor, rotl, shuf) do { \
+	X0 = add(X0, X1); X3 = rotl(xor(X3, X0), 16); \
+	X2 = add(X2, X3); X1 = rotl(xor(X1, X2), 12); \
+	X0 = add(X0, X1); X3 = rotl(xor(X3, X0),  8); \
+	X2 = add(X2, X3); X1 = rotl(xor(X1, X2),  7); \
+	X1 = shuf(X1, 0x39); X2 = shuf(X2, 0x4E); X3 = shuf(X3, 0x93); \
+	X0 = add(X0, X1); X3 = rotl(xor(X3, X0), 16); \
+	X2 = add(X2, X3); X1 = rotl(xor(X1, X2), 12); \
+	X0 = add(X0, X1); X3 = rotl(xor(X3, X0),  8); \
+	X2 = add(X2, X3); X1 = rotl(xor(X1, X2),  7); \
+	X1 = shuf(X1, 0x93); X2 = shuf(X2, 0x4E); X3 = shuf(X3, 0x39); \
+} while (0)
+
+#define ADD_SSE2(a, b)  _mm_add_epi32(a, b)
+#define XOR_SSE2(a, b)  _mm_xor_si128(a, b)
+#define ROTL_SSE2(a, n) _mm_or_si128(_mm_slli_epi32(a, n), _mm_srli_epi32(a, 32 - (n)))
+#define SHUF_SSE2(a, n) _mm_shuffle_epi32(a, n)
+
+/* Salsa20 on a tangled block, rounds must be a multiple of 2 */
+static void neoscrypt_salsa(uint *X, uint rounds)
+{
+	__m128i *B = (__m128i *) X;
+	__m128i X0 = _mm_loadu_si128(&B[0]), X1 = _mm_loadu_si128(&B[1]);
+	__m128i X2 = _mm_loadu_si128(&B[2]), X3 = _mm_loadu_si128(&B[3]);
+
+	for(; rounds; rounds -= 2)
+		SALSA_DOUBLEROUND(X0, X1, X2, X3, ADD_SSE2, XOR_SSE2, ROTL_SSE2, SHUF_SSE2);
+
+	_mm_storeu_si128(&B[0], _mm_add_epi32(_mm_loadu_si128(&B[0]), X0));
+	_mm_storeu_si128(&B[1], _mm_add_epi32(_mm_loadu_si128(&B[1]), X1));
+	_mm_storeu_si128(&B[2], _mm_add_epi32(_mm_loadu_si128(&B[2]), X2));
+	_mm_storeu_si128(&B[3], _mm_add_epi32(_mm_loadu_si128(&B[3]), X3));
+}
+
+/* ChaCha20, rounds must be a multiple of 2 */
+static void neoscrypt_chacha(uint *X, uint rounds)
+{
+	__m128i *B = (__m128i *) X;
+	__m128i X0 = _mm_loadu_si128(&B[0]), X1 = _mm_loadu_si128(&B[1]);
+	__m128i X2 = _mm_loadu_si128(&B[2]), X3 = _mm_loadu_si128(&B[3]);
+
+	for(; rounds; rounds -= 2)
+		CHACHA_DOUBLEROUND(X0, X1, X2, X3, ADD_SSE2, XOR_SSE2, ROTL_SSE2, SHUF_SSE2);
+
+	_mm_storeu_si128(&B[0], _mm_add_epi32(_mm_loadu_si128(&B[0]), X0));
+	_mm_storeu_si128(&B[1], _mm_add_epi32(_mm_loadu_si128(&B[1]), X1));
+	_mm_storeu_si128(&B[2], _mm_add_epi32(_mm_loadu_si128(&B[2]), X2));
+	_mm_storeu_si128(&B[3], _mm_add_epi32(_mm_loadu_si128(&B[3]), X3));
+}
+
+/* ChaCha20 of X[0] and Salsa20 of X[1] in the same loop, they are independent
+ * and the rounds of one fill the latencies of the other */
+static void neoscrypt_chacha_salsa(uint **X, uint rounds)
+{
+	__m128i *C = (__m128i *) X[0], *S = (__m128i *) X[1];
+	__m128i C0 = _mm_loadu_si128(&C[0]), C1 = _mm_loadu_si128(&C[1]);
+	__m128i C2 = _mm_loadu_si128(&C[2]), C3 = _mm_loadu_si128(&C[3]);
+	__m128i S0 = _mm_loadu_si128(&S[0]), S1 = _mm_loadu_si128(&S[1]);
+	__m128i S2 = _mm_loadu_si128(&S[2]), S3 = _mm_loadu_si128(&S[3]);
+
+	for(; rounds; rounds -= 2) {
+		CHACHA_DOUBLEROUND(C0, C1, C2, C3, ADD_SSE2, XOR_SSE2, ROTL_SSE2, SHUF_SSE2);
+		SALSA_DOUBLEROUND(S0, S1, S2, S3, ADD_SSE2, XOR_SSE2, ROTL_SSE2, SHUF_SSE2);
+	}
+
+	_mm_storeu_si128(&C[0], _mm_add_epi32(_mm_loadu_si128(&C[0]), C0));
+	_mm_storeu_si128(&C[1], _mm_add_epi32(_mm_loadu_si128(&C[1]), C1));
+	_mm_storeu_si128(&C[2], _mm_add_epi32(_mm_loadu_si128(&C[2]), C2));
+	_mm_storeu_si128(&C[3], _mm_add_epi32(_mm_loadu_si128(&C[3]), C3));
+	_mm_storeu_si128(&S[0], _mm_add_epi32(_mm_loadu_si128(&S[0]), S0));
+	_mm_storeu_si128(&S[1], _mm_add_epi32(_mm_loadu_si128(&S[1]), S1));
+	_mm_storeu_si128(&S[2], _mm_add_epi32(_mm_loadu_si128(&S[2]), S2));
+	_mm_storeu_si128(&S[3], _mm_add_epi32(_mm_loadu_si128(&S[3]), S3));
+}
+
+/* Swaps count blocks between the natural and the Salsa20 layouts,
+ * the word used by integerify stays in place */
+static void neoscrypt_salsa_tangle(uint *X, uint count)
+{
+	uint i, t;
+
+	for(i = 0; i < count; i++, X += 16) {
+		t = X[1];  X[1]  = X[5];  X[5]  = t;
+		t = X[2];  X[2]  = X[10]; X[10] = t;
+		t = X[3];  X[3]  = X[15]; X[15] = t;
+		t = X[4];  X[4]  = X[12]; X[12] = t;
+		t = X[7];  X[7]  = X[11]; X[11] = t;
+		t = X[9];  X[9]  = X[13]; X[13] = t;
+	}
+}
+
+#else
+
 /* Salsa20, rounds must be a multiple of 2 */
 static void neoscrypt_salsa(uint *X, uint rounds)
 {
@@ -380,6 +519,8 @@ static void neoscrypt_chacha(uint *X, uint rounds)
 }
 
 
+#endif /* NEOSCRYPT_SSE2 */
+
 /* Fast 32-bit / 64-bit memcpy();
  * len must be a multiple of 32 bytes */
 static void neoscrypt_blkcpy(void *dstp, const void *srcp, uint len)
@@ -459,25 +600,6 @@ static void neoscrypt_copy(void *dstp, const void *srcp, uint len)
 	}
 }
 
-/* 32-bit / 64-bit optimised memory erase aka memset() to zero */
-static void neoscrypt_erase(void *dstp, uint len)
-{
-	const ulong null = 0;
-	ulong *dst = (ulong *) dstp;
-	uint i, tail;
-
-	for (i = 0; i < (len / sizeof(ulong)); i++)
-		dst[i] = null;
-
-	tail = len & (sizeof(ulong) - 1);
-	if (tail) {
-		uchar *dstb = (uchar *) dstp;
-
-		for(i = len - tail; i < len; i++)
-			dstb[i] = (uchar)null;
-	}
-}
-
 /* 32-bit / 64-bit optimised XOR engine */
 static void neoscrypt_xor(void *dstp, const void *srcp, uint len)
 {
@@ -505,28 +627,8 @@ static void neoscrypt_xor(void *dstp, const void *srcp, uint len)
 #define BLAKE2S_OUT_SIZE      32U
 #define BLAKE2S_KEY_SIZE      32U
 
-/* Parameter block of 32 bytes */
-typedef struct blake2s_param_t {
-	uchar digest_length;
-	uchar key_length;
-	uchar fanout;
-	uchar depth;
-	uint  leaf_length;
-	uchar node_offset[6];
-	uchar node_depth;
-	uchar inner_length;
-	uchar salt[8];
-	uchar personal[8];
-} blake2s_param;
-
-/* State block of 180 bytes */
-typedef struct blake2s_state_t {
-	uint  h[8];
-	uint  t[2];
-	uint  f[2];
-	uchar buf[2 * BLAKE2S_BLOCK_SIZE];
-	uint  buflen;
-} blake2s_state;
+/* First parameter word: digest and key lengths of 32, fanout and depth of 1 */
+#define BLAKE2S_PARAM_0 0x01012020U
 
 static const uint blake2s_IV[8] = {
 	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
@@ -546,24 +648,6 @@ static const uint8_t blake2s_sigma[10][16] = {
 	{ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13 , 0 } ,
 };
 
-static void blake2s_compress(blake2s_state *S, const uint *buf)
-{
-	uint i;
-	uint m[16];
-	uint v[16];
-
-	neoscrypt_copy(m, buf, 64);
-	neoscrypt_copy(v, S, 32);
-
-	v[ 8] = blake2s_IV[0];
-	v[ 9] = blake2s_IV[1];
-	v[10] = blake2s_IV[2];
-	v[11] = blake2s_IV[3];
-	v[12] = S->t[0] ^ blake2s_IV[4];
-	v[13] = S->t[1] ^ blake2s_IV[5];
-	v[14] = S->f[0] ^ blake2s_IV[6];
-	v[15] = S->f[1] ^ blake2s_IV[7];
-
 #define G(r,i,a,b,c,d) do { \
 	a = a + b + m[blake2s_sigma[r][2*i+0]]; \
 	d = ROTR32(d ^ a, 16); \
@@ -586,6 +670,24 @@ static void blake2s_compress(blake2s_state *S, const uint *buf)
 	G(r, 7, v[ 3], v[ 4], v[ 9], v[14]); \
 } while(0)
 
+/* t0 is the byte counter, f0 the last block flag */
+static void blake2s_compress(uint *h, const uint *m, uint t0, uint f0)
+{
+	uint i;
+	uint v[16];
+
+	for (i = 0; i < 8; i++)
+		v[i] = h[i];
+
+	v[ 8] = blake2s_IV[0];
+	v[ 9] = blake2s_IV[1];
+	v[10] = blake2s_IV[2];
+	v[11] = blake2s_IV[3];
+	v[12] = t0 ^ blake2s_IV[4];
+	v[13] = blake2s_IV[5];
+	v[14] = f0 ^ blake2s_IV[6];
+	v[15] = blake2s_IV[7];
+
 	ROUND(0);
 	ROUND(1);
 	ROUND(2);
@@ -598,85 +700,116 @@ static void blake2s_compress(blake2s_state *S, const uint *buf)
 	ROUND(9);
 
 	for (i = 0; i < 8; i++)
-		S->h[i] = S->h[i] ^ v[i] ^ v[i + 8];
+		h[i] = h[i] ^ v[i] ^ v[i + 8];
+}
 
 #undef G
 #undef ROUND
-}
 
-static void blake2s_update(blake2s_state *S, const uchar *input, uint input_size)
-{
-	uint left, fill;
-
-	while(input_size > 0) {
-		left = S->buflen;
-		fill = 2 * BLAKE2S_BLOCK_SIZE - left;
-		if(input_size > fill) {
-			/* Buffer fill */
-			neoscrypt_copy(S->buf + left, input, fill);
-			S->buflen += fill;
-			/* Counter increment */
-			S->t[0] += BLAKE2S_BLOCK_SIZE;
-			/* Compress */
-			blake2s_compress(S, (uint *) S->buf);
-			/* Shift buffer left */
-			neoscrypt_copy(S->buf, S->buf + BLAKE2S_BLOCK_SIZE, BLAKE2S_BLOCK_SIZE);
-			S->buflen -= BLAKE2S_BLOCK_SIZE;
-			input += fill;
-			input_size -= fill;
-		} else {
-			neoscrypt_copy(S->buf + left, input, input_size);
-			S->buflen += input_size;
-			/* Do not compress */
-			input += input_size;
-			input_size = 0;
-		}
-	}
+/* The PRF of FastKDF, always a 32 bytes key and a 64 bytes input: the
+ * zero padded key block, then the input as the last block */
+static void neoscrypt_blake2s(const void *input, const void *key, void *output)
+{
+	uint h[8], m[16];
+
+	memcpy(h, blake2s_IV, 32);
+	h[0] ^= BLAKE2S_PARAM_0;
+
+	memcpy(m, key, BLAKE2S_KEY_SIZE);
+	memset(&m[8], 0, BLAKE2S_BLOCK_SIZE - BLAKE2S_KEY_SIZE);
+	blake2s_compress(h, m, BLAKE2S_BLOCK_SIZE, 0);
+
+	memcpy(m, input, BLAKE2S_BLOCK_SIZE);
+	blake2s_compress(h, m, 2 * BLAKE2S_BLOCK_SIZE, ~0U);
+
+	memcpy(output, h, BLAKE2S_OUT_SIZE);
 }
 
-static void neoscrypt_blake2s(const void *input, const uint input_size, const void *key, const uchar key_size,
-	void *output, const uchar output_size)
+#if defined(NEOSCRYPT_SSE2)
+
+#define ROTR_SSE2(a, n) _mm_or_si128(_mm_srli_epi32(a, n), _mm_slli_epi32(a, 32 - (n)))
+
+#define G4(r,i,a,b,c,d) do { \
+	a = _mm_add_epi32(_mm_add_epi32(a, b), m[blake2s_sigma[r][2*i+0]]); \
+	d = ROTR_SSE2(_mm_xor_si128(d, a), 16); \
+	c = _mm_add_epi32(c, d); \
+	b = ROTR_SSE2(_mm_xor_si128(b, c), 12); \
+	a = _mm_add_epi32(_mm_add_epi32(a, b), m[blake2s_sigma[r][2*i+1]]); \
+	d = ROTR_SSE2(_mm_xor_si128(d, a), 8); \
+	c = _mm_add_epi32(c, d); \
+	b = ROTR_SSE2(_mm_xor_si128(b, c), 7); \
+} while(0)
+
+/* 4 states in the lanes of the words */
+static void blake2s_compress_4way(__m128i *h, const __m128i *m, uint t0, uint f0)
 {
-	uchar block[BLAKE2S_BLOCK_SIZE];
-	blake2s_param P[1];
-	blake2s_state S[1];
+	uint r, i;
+	__m128i v[16];
 
-	/* Initialise */
-	neoscrypt_erase(P, 32);
-	P->digest_length = output_size;
-	P->key_length    = key_size;
-	P->fanout        = 1;
-	P->depth         = 1;
+	for (i = 0; i < 8; i++) {
+		v[i] = h[i];
+		v[i + 8] = _mm_set1_epi32((int) blake2s_IV[i]);
+	}
+	v[12] = _mm_set1_epi32((int) (t0 ^ blake2s_IV[4]));
+	v[14] = _mm_set1_epi32((int) (f0 ^ blake2s_IV[6]));
+
+	for (r = 0; r < 10; r++) {
+		G4(r, 0, v[ 0], v[ 4], v[ 8], v[12]);
+		G4(r, 1, v[ 1], v[ 5], v[ 9], v[13]);
+		G4(r, 2, v[ 2], v[ 6], v[10], v[14]);
+		G4(r, 3, v[ 3], v[ 7], v[11], v[15]);
+		G4(r, 4, v[ 0], v[ 5], v[10], v[15]);
+		G4(r, 5, v[ 1], v[ 6], v[11], v[12]);
+		G4(r, 6, v[ 2], v[ 7], v[ 8], v[13]);
+		G4(r, 7, v[ 3], v[ 4], v[ 9], v[14]);
+	}
 
-	neoscrypt_erase(S, 180);
-	neoscrypt_copy(S, blake2s_IV, 32);
-	neoscrypt_xor(S, P, 32);
+	for (i = 0; i < 8; i++)
+		h[i] = _mm_xor_si128(h[i], _mm_xor_si128(v[i], v[i + 8]));
+}
 
-	neoscrypt_erase(block, BLAKE2S_BLOCK_SIZE);
-	neoscrypt_copy(block, key, key_size);
-	blake2s_update(S, (uchar *) block, BLAKE2S_BLOCK_SIZE);
+#undef G4
 
-	/* Update */
-	blake2s_update(S, (uchar *) input, input_size);
+/* word i of the 4 (unaligned) buffers */
+static __inline __m128i neoscrypt_gather4(const uchar * const *p, uint i)
+{
+	uint w[4];
+	memcpy(&w[0], p[0] + 4 * i, 4);
+	memcpy(&w[1], p[1] + 4 * i, 4);
+	memcpy(&w[2], p[2] + 4 * i, 4);
+	memcpy(&w[3], p[3] + 4 * i, 4);
+	return _mm_setr_epi32((int) w[0], (int) w[1], (int) w[2], (int) w[3]);
+}
+
+/* neoscrypt_blake2s() of 4 inputs and keys */
+static void neoscrypt_blake2s_4way(const uchar * const *input, const uchar * const *key, uint output[4][8])
+{
+	uint i, k;
+	uint w[4];
+	__m128i h[8], m[16];
 
-	/* Finish */
-	if(S->buflen > BLAKE2S_BLOCK_SIZE) {
-		S->t[0] += BLAKE2S_BLOCK_SIZE;
-		blake2s_compress(S, (uint *) S->buf);
-		S->buflen -= BLAKE2S_BLOCK_SIZE;
-		neoscrypt_copy(S->buf, S->buf + BLAKE2S_BLOCK_SIZE, S->buflen);
+	for (i = 0; i < 8; i++)
+		h[i] = _mm_set1_epi32((int) (blake2s_IV[i] ^ (i ? 0 : BLAKE2S_PARAM_0)));
+
+	for (i = 0; i < 8; i++) {
+		m[i] = neoscrypt_gather4(key, i);
+		m[i + 8] = _mm_setzero_si128();
 	}
-	S->t[0] += S->buflen;
-	S->f[0] = ~0U;
-	neoscrypt_erase(S->buf + S->buflen, 2 * BLAKE2S_BLOCK_SIZE - S->buflen);
-	blake2s_compress(S, (uint *) S->buf);
+	blake2s_compress_4way(h, m, BLAKE2S_BLOCK_SIZE, 0);
 
-	/* Write back */
-	neoscrypt_copy(output, S, output_size);
+	for (i = 0; i < 16; i++)
+		m[i] = neoscrypt_gather4(input, i);
+	blake2s_compress_4way(h, m, 2 * BLAKE2S_BLOCK_SIZE, ~0U);
 
-	//for (int k = 0; k<4; k++) { printf("cpu blake   %d %08x %08x\n", k, ((unsigned int*)output)[2 * k], ((unsigned int*)output)[2 * k + 1]); }
+	for (i = 0; i < 8; i++) {
+		_mm_storeu_si128((__m128i *) w, h[i]);
+		for (k = 0; k < 4; k++)
+			output[k][i] = w[k];
+	}
 }
 
+#endif /* NEOSCRYPT_SSE2 */
+
 
 #define FASTKDF_BUFFER_SIZE 256U
 
@@ -684,25 +817,22 @@ static void neoscrypt_blake2s(const void *input, const uint input_size, const vo
  * FASTKDF_BUFFER_SIZE must be a power of 2;
  * password_len, salt_len and output_len should not exceed FASTKDF_BUFFER_SIZE;
  * prf_output_size must be <= prf_key_size; */
-static void neoscrypt_fastkdf(const uchar *password, uint password_len, const uchar *salt, uint salt_len,
-	uint N, uchar *output, uint output_len)
-{
-	//for (int i = 0; i<10; i++) { printf("cpu password %d %08x %08x\n", i, ((unsigned int*)password)[2 * i], ((unsigned int*)password)[2 * i+1]); }
-	const uint stack_align =  0x40;
-	const uint kdf_buf_size = 256U; //FASTKDF_BUFFER_SIZE
-	const uint prf_input_size = 64U; //BLAKE2S_BLOCK_SIZE
-	const uint prf_key_size = 32U; //BLAKE2S_KEY_SIZE
-	const uint prf_output_size = 32U; //BLAKE2S_OUT_SIZE
-	uint bufptr, a, b, i, j;
-	uchar *A, *B, *prf_input, *prf_key, *prf_output;
-	uchar *stack;
-	stack = (uchar*)malloc(sizeof(uchar) * 2 * kdf_buf_size + prf_input_size + prf_key_size + prf_output_size + stack_align);
-	/* Align and set up the buffers in stack */
-	//uchar stack[2 * kdf_buf_size + prf_input_size + prf_key_size + prf_output_size + stack_align];
 
-	A          = &stack[stack_align & ~(stack_align - 1)];
-	B          = &A[kdf_buf_size + prf_input_size];
-	prf_output = &A[2 * kdf_buf_size + prf_input_size + prf_key_size];
+/* Password buffer followed by the PRF input size, salt buffer followed by the key size */
+typedef struct fastkdf_buf_t {
+	uchar A[FASTKDF_BUFFER_SIZE + BLAKE2S_BLOCK_SIZE];
+	uchar B[FASTKDF_BUFFER_SIZE + BLAKE2S_KEY_SIZE];
+	uint bufptr;
+} fastkdf_buf;
+
+static void neoscrypt_fastkdf_init(fastkdf_buf *kdf, const uchar *password, uint password_len,
+	const uchar *salt, uint salt_len)
+{
+	const uint kdf_buf_size = FASTKDF_BUFFER_SIZE;
+	const uint prf_input_size = BLAKE2S_BLOCK_SIZE;
+	const uint prf_key_size = BLAKE2S_KEY_SIZE;
+	uchar *A = kdf->A, *B = kdf->B;
+	uint a, b, i;
 
 	/* Initialise the password buffer */
 	if(password_len > kdf_buf_size)
@@ -728,36 +858,43 @@ static void neoscrypt_fastkdf(const uchar *password, uint password_len, const uc
 		neoscrypt_copy(&B[a * salt_len], &salt[0], b);
 	neoscrypt_copy(&B[kdf_buf_size], &salt[0], prf_key_size);
 
-	/* The primary iteration */
-	for(i = 0, bufptr = 0; i < N; i++) {
+	kdf->bufptr = 0;
+}
 
-		/* Map the PRF input buffer */
-		prf_input = &A[bufptr];
+/* Salt buffer update of an iteration with the PRF output */
+static void neoscrypt_fastkdf_step(fastkdf_buf *kdf, const uchar *prf_output)
+{
+	const uint kdf_buf_size = FASTKDF_BUFFER_SIZE;
+	const uint prf_key_size = BLAKE2S_KEY_SIZE;
+	const uint prf_output_size = BLAKE2S_OUT_SIZE;
+	uchar *B = kdf->B;
+	uint bufptr, j;
 
-		/* Map the PRF key buffer */
-		prf_key = &B[bufptr];
+	/* Calculate the next buffer pointer */
+	for(j = 0, bufptr = 0; j < prf_output_size; j++)
+		bufptr += prf_output[j];
+	bufptr &= (kdf_buf_size - 1);
 
-		/* PRF */
-		// for (int k = 0; k<(prf_input_size/4); k++) { printf("cpu bufptr %08x before blake %d  %d %08x \n",bufptr, i, k, ((unsigned int*)prf_input)[k]); }
-		neoscrypt_blake2s(prf_input, prf_input_size, prf_key, prf_key_size, prf_output, prf_output_size);
-		// for (int k = 0; k<(prf_output_size/4); k++) { printf("cpu after blake %d  %d %08x \n", i, k, ((unsigned int*)prf_output)[k]); }
+	/* Modify the salt buffer */
+	neoscrypt_xor(&B[bufptr], &prf_output[0], prf_output_size);
 
-		/* Calculate the next buffer pointer */
-		for(j = 0, bufptr = 0; j < prf_output_size; j++)
-			bufptr += prf_output[j];
-		bufptr &= (kdf_buf_size - 1);
+	/* Head modified, tail updated */
+	if(bufptr < prf_key_size)
+		neoscrypt_copy(&B[kdf_buf_size + bufptr], &B[bufptr], MIN(prf_output_size, prf_key_size - bufptr));
 
-		/* Modify the salt buffer */
-		neoscrypt_xor(&B[bufptr], &prf_output[0], prf_output_size);
+	/* Tail modified, head updated */
+	if((kdf_buf_size - bufptr) < prf_output_size)
+		neoscrypt_copy(&B[0], &B[kdf_buf_size], prf_output_size - (kdf_buf_size - bufptr));
 
-		/* Head modified, tail updated */
-		if(bufptr < prf_key_size)
-			neoscrypt_copy(&B[kdf_buf_size + bufptr], &B[bufptr], MIN(prf_output_size, prf_key_size - bufptr));
+	kdf->bufptr = bufptr;
+}
 
-		/* Tail modified, head updated */
-		if((kdf_buf_size - bufptr) < prf_output_size)
-			neoscrypt_copy(&B[0], &B[kdf_buf_size], prf_output_size - (kdf_buf_size - bufptr));
-	}
+static void neoscrypt_fastkdf_final(fastkdf_buf *kdf, uchar *output, uint output_len)
+{
+	const uint kdf_buf_size = FASTKDF_BUFFER_SIZE;
+	const uint bufptr = kdf->bufptr;
+	uchar *A = kdf->A, *B = kdf->B;
+	uint a;
 
 	/* Modify and copy into the output buffer */
 	if(output_len > kdf_buf_size)
@@ -773,9 +910,54 @@ static void neoscrypt_fastkdf(const uchar *password, uint password_len, const uc
 		neoscrypt_copy(&output[0], &B[bufptr], a);
 		neoscrypt_copy(&output[a], &B[0], output_len - a);
 	}
-	// for (int i = 0; i<10; i++) { printf("cpu fastkdf %d %08x %08x\n", i, ((unsigned int*)output)[2 * i], ((unsigned int*)output)[2 * i + 1]); }
 }
 
+static void neoscrypt_fastkdf(const uchar *password, uint password_len, const uchar *salt, uint salt_len,
+	uint N, uchar *output, uint output_len)
+{
+	fastkdf_buf kdf;
+	uint prf_output[BLAKE2S_OUT_SIZE / 4];
+	uint i;
+
+	neoscrypt_fastkdf_init(&kdf, password, password_len, salt, salt_len);
+
+	/* The primary iteration */
+	for(i = 0; i < N; i++) {
+		neoscrypt_blake2s(&kdf.A[kdf.bufptr], &kdf.B[kdf.bufptr], prf_output);
+		neoscrypt_fastkdf_step(&kdf, (uchar *) prf_output);
+	}
+
+	neoscrypt_fastkdf_final(&kdf, output, output_len);
+}
+
+#if defined(NEOSCRYPT_SSE2)
+/* 4 FastKDF in lockstep, only the PRF is vectorised */
+static void neoscrypt_fastkdf_4way(const uchar * const *password, uint password_len,
+	const uchar * const *salt, uint salt_len, uint N, uchar **output, uint output_len)
+{
+	fastkdf_buf kdf[4];
+	uint prf_output[4][BLAKE2S_OUT_SIZE / 4];
+	const uchar *prf_input[4], *prf_key[4];
+	uint i, k;
+
+	for(k = 0; k < 4; k++)
+		neoscrypt_fastkdf_init(&kdf[k], password[k], password_len, salt[k], salt_len);
+
+	for(i = 0; i < N; i++) {
+		for(k = 0; k < 4; k++) {
+			prf_input[k] = &kdf[k].A[kdf[k].bufptr];
+			prf_key[k] = &kdf[k].B[kdf[k].bufptr];
+		}
+		neoscrypt_blake2s_4way(prf_input, prf_key, prf_output);
+		for(k = 0; k < 4; k++)
+			neoscrypt_fastkdf_step(&kdf[k], (uchar *) prf_output[k]);
+	}
+
+	for(k = 0; k < 4; k++)
+		neoscrypt_fastkdf_final(&kdf[k], output[k], output_len);
+}
+#endif
+
 
 /* Configurable optimised block mixer */
 static void neoscrypt_blkmix(uint *X, uint *Y, uint r, uint mixmode)
@@ -848,6 +1030,260 @@ static void neoscrypt_blkmix(uint *X, uint *Y, uint r, uint mixmode)
 		neoscrypt_blkcpy(&X[16 * (i + r)], &Y[16 * (2 * i + 1)], SCRYPT_BLOCK_SIZE);
 }
 
+
+/* X = SMix(X), V of N * r * 2 * SCRYPT_BLOCK_SIZE */
+static void neoscrypt_smix(uint *X, uint *Y, uint *V, uint N, uint r, uint mixmode)
+{
+	uint i, j;
+
+	for(i = 0; i < N; i++) {
+		/* blkcpy(V, X) */
+		neoscrypt_blkcpy(&V[i * (32 * r)], &X[0], r * 2 * SCRYPT_BLOCK_SIZE);
+		/* blkmix(X, Y) */
+		neoscrypt_blkmix(&X[0], &Y[0], r, mixmode);
+	}
+	for(i = 0; i < N; i++) {
+		/* integerify(X) mod N */
+		j = (32 * r) * (X[16 * (2 * r - 1)] & (N - 1));
+		/* blkxor(X, V) */
+		neoscrypt_blkxor(&X[0], &V[j], r * 2 * SCRYPT_BLOCK_SIZE);
+		/* blkmix(X, Y) */
+		neoscrypt_blkmix(&X[0], &Y[0], r, mixmode);
+	}
+}
+
+#if defined(NEOSCRYPT_SSE2)
+/*
+ * n independent SMix in lockstep, mix processes a block of each: the ChaCha
+ * and Salsa passes of a hash, or the same pass of two hashes per avx2
+ * register. Only for r of 1 and 2 (the NeoScrypt profiles).
+ */
+#define NEOSCRYPT_SMIX_MAX 4
+
+typedef void (*neoscrypt_mixn_fn)(uint **X, uint rounds);
+
+static void neoscrypt_blkmixn(uint **X, uint n, uint r, neoscrypt_mixn_fn mix, uint rounds)
+{
+	uint *B[NEOSCRYPT_SMIX_MAX];
+	uint i, k, last = 16 * (2 * r - 1);
+
+	for(i = 0; i < 2 * r; i++) {
+		const uint prev = i ? 16 * (i - 1) : last;
+		for(k = 0; k < n; k++) {
+			neoscrypt_blkxor(&X[k][16 * i], &X[k][prev], SCRYPT_BLOCK_SIZE);
+			B[k] = &X[k][16 * i];
+		}
+		mix(B, rounds);
+	}
+	if(r == 2) {
+		for(k = 0; k < n; k++)
+			neoscrypt_blkswp(&X[k][16], &X[k][32], SCRYPT_BLOCK_SIZE);
+	}
+}
+
+static void neoscrypt_smixn(uint **X, uint **V, uint n, uint N, uint r, neoscrypt_mixn_fn mix, uint rounds)
+{
+	const uint size = r * 2 * SCRYPT_BLOCK_SIZE;
+	uint i, j, k;
+
+	for(i = 0; i < N; i++) {
+		for(k = 0; k < n; k++)
+			neoscrypt_blkcpy(&V[k][i * (32 * r)], &X[k][0], size);
+		neoscrypt_blkmixn(X, n, r, mix, rounds);
+	}
+	for(i = 0; i < N; i++) {
+		for(k = 0; k < n; k++) {
+			j = (32 * r) * (X[k][16 * (2 * r - 1)] & (N - 1));
+			neoscrypt_blkxor(&X[k][0], &V[k][j], size);
+		}
+		neoscrypt_blkmixn(X, n, r, mix, rounds);
+	}
+}
+#endif /* NEOSCRYPT_SSE2 */
+
+#if defined(NEOSCRYPT_AVX2)
+/* the same block of two hashes in the 128 bits halves of the avx2 registers */
+
+#define ADD_AVX2(a, b)  _mm256_add_epi32(a, b)
+#define XOR_AVX2(a, b)  _mm256_xor_si256(a, b)
+#define ROTL_AVX2(a, n) _mm256_or_si256(_mm256_slli_epi32(a, n), _mm256_srli_epi32(a, 32 - (n)))
+#define SHUF_AVX2(a, n) _mm256_shuffle_epi32(a, n)
+
+#define LOAD_X2(A, B, i) _mm256_inserti128_si256(_mm256_castsi128_si256( \
+	_mm_loadu_si128((const __m128i *) (A) + (i))), _mm_loadu_si128((const __m128i *) (B) + (i)), 1)
+
+#define ADD_STORE_X2(A, B, i, v) do { \
+	__m256i s = _mm256_add_epi32(LOAD_X2(A, B, i), v); \
+	_mm_storeu_si128((__m128i *) (A) + (i), _mm256_castsi256_si128(s)); \
+	_mm_storeu_si128((__m128i *) (B) + (i), _mm256_extracti128_si256(s, 1)); \
+} while (0)
+
+NEOSCRYPT_TARGET("avx2")
+static void neoscrypt_salsa_x2(uint **X, uint rounds)
+{
+	__m256i X0 = LOAD_X2(X[0], X[1], 0), X1 = LOAD_X2(X[0], X[1], 1);
+	__m256i X2 = LOAD_X2(X[0], X[1], 2), X3 = LOAD_X2(X[0], X[1], 3);
+
+	for(; rounds; rounds -= 2)
+		SALSA_DOUBLEROUND(X0, X1, X2, X3, ADD_AVX2, XOR_AVX2, ROTL_AVX2, SHUF_AVX2);
+
+	ADD_STORE_X2(X[0], X[1], 0, X0);
+	ADD_STORE_X2(X[0], X[1], 1, X1);
+	ADD_STORE_X2(X[0], X[1], 2, X2);
+	ADD_STORE_X2(X[0], X[1], 3, X3);
+}
+
+/* ChaCha20 of X[0] and X[1], Salsa20 of X[2] and X[3] */
+NEOSCRYPT_TARGET("avx2")
+static void neoscrypt_chacha_salsa_x2(uint **X, uint rounds)
+{
+	__m256i C0 = LOAD_X2(X[0], X[1], 0), C1 = LOAD_X2(X[0], X[1], 1);
+	__m256i C2 = LOAD_X2(X[0], X[1], 2), C3 = LOAD_X2(X[0], X[1], 3);
+	__m256i S0 = LOAD_X2(X[2], X[3], 0), S1 = LOAD_X2(X[2], X[3], 1);
+	__m256i S2 = LOAD_X2(X[2], X[3], 2), S3 = LOAD_X2(X[2], X[3], 3);
+
+	for(; rounds; rounds -= 2) {
+		CHACHA_DOUBLEROUND(C0, C1, C2, C3, ADD_AVX2, XOR_AVX2, ROTL_AVX2, SHUF_AVX2);
+		SALSA_DOUBLEROUND(S0, S1, S2, S3, ADD_AVX2, XOR_AVX2, ROTL_AVX2, SHUF_AVX2);
+	}
+
+	ADD_STORE_X2(X[0], X[1], 0, C0);
+	ADD_STORE_X2(X[0], X[1], 1, C1);
+	ADD_STORE_X2(X[0], X[1], 2, C2);
+	ADD_STORE_X2(X[0], X[1], 3, C3);
+	ADD_STORE_X2(X[2], X[3], 0, S0);
+	ADD_STORE_X2(X[2], X[3], 1, S1);
+	ADD_STORE_X2(X[2], X[3], 2, S2);
+	ADD_STORE_X2(X[2], X[3], 3, S3);
+}
+
+static int neoscrypt_cpu_avx2(void)
+{
+	uint32_t r[4];
+	uint64_t xcr0 = 0;
+#ifdef _MSC_VER
+	int cr[4];
+	__cpuidex(cr, 0, 0);
+	if (cr[0] < 7) return 0;
+	__cpuidex(cr, 1, 0);
+	r[2] = cr[2];
+#else
+	if (__get_cpuid_max(0, NULL) < 7) return 0;
+	__cpuid_count(1, 0, r[0], r[1], r[2], r[3]);
+#endif
+	/* osxsave + avx, then the ymm state enabled by the os */
+	if (!(r[2] & (1 << 27)) || !(r[2] & (1 << 28)))
+		return 0;
+#ifdef _MSC_VER
+	xcr0 = _xgetbv(0);
+	__cpuidex(cr, 7, 0);
+	r[1] = cr[1];
+#else
+	{
+		uint32_t lo, hi;
+		__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(lo), "=d"(hi) : "c"(0));
+		xcr0 = ((uint64_t)hi << 32) | lo;
+	}
+	__cpuid_count(7, 0, r[0], r[1], r[2], r[3]);
+#endif
+	return (r[1] & (1 << 5)) && (xcr0 & 0x06) == 0x06;
+}
+
+/* the avx2 mixers against neoscrypt_smix(), ChaCha on 0 and 1 then Salsa on 2 and 3 */
+static int neoscrypt_avx2_check(void)
+{
+	uint X[8][64], V[8][8 * 64], Y[64];
+	uint *XV[4], *VV[4];
+	uint r, k, i;
+
+	for(r = 1; r <= 2; r++) {
+		for(i = 0; i < 8 * 64; i++)
+			X[i / 64][i % 64] = 0x9E3779B9U * (i % 256 + r);
+		for(k = 0; k < 4; k++) {
+			neoscrypt_smix(X[k], Y, V[k], 8, r, k < 2 ? 0x0114 : 0x14);
+			XV[k] = X[k + 4];
+			VV[k] = V[k + 4];
+		}
+		neoscrypt_smixn(XV, VV, 4, 8, r, neoscrypt_chacha_salsa_x2, 20);
+		neoscrypt_smixn(&XV[2], &VV[2], 2, 8, r, neoscrypt_salsa_x2, 20);
+		neoscrypt_smix(X[2], Y, V[2], 8, r, 0x14);
+		neoscrypt_smix(X[3], Y, V[3], 8, r, 0x14);
+		if(memcmp(X[0], X[4], sizeof(X) / 2))
+			return 0;
+	}
+	return 1;
+}
+
+/* -1 until checked */
+static volatile int neoscrypt_avx2 = -1;
+
+static int neoscrypt_use_avx2(void)
+{
+	if(neoscrypt_avx2 < 0)
+		neoscrypt_avx2 = neoscrypt_cpu_avx2() && neoscrypt_avx2_check();
+	return neoscrypt_avx2;
+}
+#endif /* NEOSCRYPT_AVX2 */
+
+/* N, r, double mixing and mixmode of a profile, see below */
+static void neoscrypt_profile(uint profile, uint *N, uint *r, uint *dblmix, uint *mixmode)
+{
+	*N = 128; *r = 2; *dblmix = 1; *mixmode = 0x14;
+
+	if(profile & 0x1) {
+		*N = 1024;        /* N = (1 << (Nfactor + 1)); */
+		*r = 1;           /* r = (1 << rfactor); */
+		*dblmix = 0;      /* Salsa only */
+		*mixmode = 0x08;  /* 8 rounds */
+	}
+
+	if(profile >> 31) {
+		*N = (1 << (((profile >> 8) & 0x1F) + 1));
+		*r = (1 << ((profile >> 5) & 0x7));
+	}
+}
+
+/* Mixing of X between the two KDF, Z is the ChaCha copy with dblmix.
+ * VZ (optional) lets the ChaCha pass run along the Salsa one */
+static void neoscrypt_mix(uint *X, uint *Y, uint *Z, uint *V, uint *VZ, uint N, uint r,
+	uint dblmix, uint mixmode)
+{
+	/* Process ChaCha 1st, Salsa 2nd and XOR them into FastKDF; otherwise Salsa only */
+
+	if(dblmix)
+		/* blkcpy(Z, X) */
+		neoscrypt_blkcpy(&Z[0], &X[0], r * 2 * SCRYPT_BLOCK_SIZE);
+
+#if defined(NEOSCRYPT_TANGLE)
+	/* Must be called before and after SSE2 Salsa */
+	neoscrypt_salsa_tangle(&X[0], r * 2);
+#endif
+
+#if defined(NEOSCRYPT_SSE2)
+	if(dblmix && VZ && r <= 2) {
+		/* Z = SMix(Z) and X = SMix(X) interleaved */
+		uint *XZ[2] = { Z, X }, *VV[2] = { VZ, V };
+		neoscrypt_smixn(XZ, VV, 2, N, r, neoscrypt_chacha_salsa, mixmode & 0xFF);
+	} else
+#endif
+	{
+		/* Z = SMix(Z) */
+		if(dblmix)
+			neoscrypt_smix(Z, Y, V, N, r, (mixmode | 0x0100));
+
+		/* X = SMix(X) */
+		neoscrypt_smix(X, Y, V, N, r, mixmode);
+	}
+
+#if defined(NEOSCRYPT_TANGLE)
+	neoscrypt_salsa_tangle(&X[0], r * 2);
+#endif
+
+	if(dblmix)
+		/* blkxor(X, Z) */
+		neoscrypt_blkxor(&X[0], &Z[0], r * 2 * SCRYPT_BLOCK_SIZE);
+}
+
 /* NeoScrypt core engine:
  * p = 1, salt = password;
  * Basic customisation (required):
@@ -880,23 +1316,14 @@ static void neoscrypt_blkmix(uint *X, uint *Y, uint r, uint mixmode)
  *   profile bits 30 to 13 are reserved */
 void neoscrypt(unsigned char *output, const unsigned char *input, unsigned int profile)
 {
-	uint N = 128, r = 2, dblmix = 1, mixmode = 0x14, stack_align = 0x40;
-	uint kdf, i, j;
-	uint *X, *Y, *Z, *V;
+	uint N, r, dblmix, mixmode, stack_align = 0x40;
+	uint kdf;
+	uint *X, *Y, *Z, *V, *VZ;
 
-	if(profile & 0x1) {
-		N = 1024;        /* N = (1 << (Nfactor + 1)); */
-		r = 1;           /* r = (1 << rfactor); */
-		dblmix = 0;      /* Salsa only */
-		mixmode = 0x08;  /* 8 rounds */
-	}
+	neoscrypt_profile(profile, &N, &r, &dblmix, &mixmode);
 
-	if(profile >> 31) {
-		N = (1 << (((profile >> 8) & 0x1F) + 1));
-		r = (1 << ((profile >> 5) & 0x7));
-	}
 	uchar *stack;
-	stack = (uchar*)malloc(((N + 3) * r * 2 * SCRYPT_BLOCK_SIZE + stack_align)*sizeof(uchar));
+	stack = (uchar*)malloc(((N * (dblmix + 1) + 3) * r * 2 * SCRYPT_BLOCK_SIZE + stack_align)*sizeof(uchar));
 	/* X = r * 2 * SCRYPT_BLOCK_SIZE */
 	X = (uint *) &stack[stack_align & ~(stack_align - 1)];
 	/* Z is a copy of X for ChaCha */
@@ -905,6 +1332,8 @@ void neoscrypt(unsigned char *output, const unsigned char *input, unsigned int p
 	Y = &X[64 * r];
 	/* V = N * r * 2 * SCRYPT_BLOCK_SIZE */
 	V = &X[96 * r];
+	/* VZ, the same for ChaCha */
+	VZ = dblmix ? &V[N * 32 * r] : NULL;
 
 	/* X = KDF(password, salt) */
 	kdf = (profile >> 1) & 0xF;
@@ -921,57 +1350,7 @@ void neoscrypt(unsigned char *output, const unsigned char *input, unsigned int p
 		break;
 	}
 
-	/* Process ChaCha 1st, Salsa 2nd and XOR them into FastKDF; otherwise Salsa only */
-
-	if(dblmix) {
-		/* blkcpy(Z, X) */
-		neoscrypt_blkcpy(&Z[0], &X[0], r * 2 * SCRYPT_BLOCK_SIZE);
-
-		/* Z = SMix(Z) */
-		for(i = 0; i < N; i++) {
-			/* blkcpy(V, Z) */
-			neoscrypt_blkcpy(&V[i * (32 * r)], &Z[0], r * 2 * SCRYPT_BLOCK_SIZE);
-			/* blkmix(Z, Y) */
-			neoscrypt_blkmix(&Z[0], &Y[0], r, (mixmode | 0x0100));
-		}
-		for(i = 0; i < N; i++) {
-			/* integerify(Z) mod N */
-			j = (32 * r) * (Z[16 * (2 * r - 1)] & (N - 1));
-			/* blkxor(Z, V) */
-			neoscrypt_blkxor(&Z[0], &V[j], r * 2 * SCRYPT_BLOCK_SIZE);
-			/* blkmix(Z, Y) */
-			neoscrypt_blkmix(&Z[0], &Y[0], r, (mixmode | 0x0100));
-		}
-	}
-
-#if (ASM)
-	/* Must be called before and after SSE2 Salsa */
-	neoscrypt_salsa_tangle(&X[0], r * 2);
-#endif
-
-	/* X = SMix(X) */
-	for(i = 0; i < N; i++) {
-		/* blkcpy(V, X) */
-		neoscrypt_blkcpy(&V[i * (32 * r)], &X[0], r * 2 * SCRYPT_BLOCK_SIZE);
-		/* blkmix(X, Y) */
-		neoscrypt_blkmix(&X[0], &Y[0], r, mixmode);
-	}
-	for(i = 0; i < N; i++) {
-		/* integerify(X) mod N */
-		j = (32 * r) * (X[16 * (2 * r - 1)] & (N - 1));
-		/* blkxor(X, V) */
-		neoscrypt_blkxor(&X[0], &V[j], r * 2 * SCRYPT_BLOCK_SIZE);
-		/* blkmix(X, Y) */
-		neoscrypt_blkmix(&X[0], &Y[0], r, mixmode);
-	}
-
-#if (ASM)
-	neoscrypt_salsa_tangle(&X[0], r * 2);
-#endif
-
-	if(dblmix)
-		/* blkxor(X, Z) */
-		neoscrypt_blkxor(&X[0], &Z[0], r * 2 * SCRYPT_BLOCK_SIZE);
+	neoscrypt_mix(X, Y, Z, V, VZ, N, r, dblmix, mixmode);
 
 	/* output = KDF(password, X) */
 	switch(kdf) {
@@ -985,5 +1364,85 @@ void neoscrypt(unsigned char *output, const unsigned char *input, unsigned int p
 		neoscrypt_pbkdf2_sha256(input, 80, (uchar *) X, r * 2 * SCRYPT_BLOCK_SIZE, 1, output, 32);
 		break;
 	}
+
+	free(stack);
 }
 
+/* 4 headers of 80 bytes in lockstep, output[4][32] of input[4][80]:
+ * the FastKDF PRF in sse2 lanes, the SMix of two hashes per avx2 register */
+void neoscrypt_4way(unsigned char *output, const unsigned char *input, unsigned int profile)
+{
+#if defined(NEOSCRYPT_SSE2)
+	uint N, r, dblmix, mixmode, stack_align = 0x40;
+	uint k, size;
+	uint *X[4], *Y, *Z[4], *V[4], *VZ[4];
+	const uchar *in[4], *salt[4];
+	uchar *out[4];
+	uchar *stack;
+
+	neoscrypt_profile(profile, &N, &r, &dblmix, &mixmode);
+
+	/* the PBKDF2 profiles are not vectorised */
+	if((profile >> 1) & 0xF) {
+		for(k = 0; k < 4; k++)
+			neoscrypt(&output[32 * k], &input[80 * k], profile);
+		return;
+	}
+
+	/* X, Z, V and VZ of each hash, then a shared Y */
+	size = (N * (dblmix + 1) + 2) * r * 2 * SCRYPT_BLOCK_SIZE;
+	stack = (uchar*)malloc((4 * size + r * 2 * SCRYPT_BLOCK_SIZE + stack_align)*sizeof(uchar));
+	for(k = 0; k < 4; k++) {
+		X[k] = (uint *) &stack[(stack_align & ~(stack_align - 1)) + k * size];
+		Z[k] = &X[k][32 * r];
+		V[k] = &X[k][64 * r];
+		VZ[k] = dblmix ? &V[k][N * 32 * r] : NULL;
+		in[k] = &input[80 * k];
+		out[k] = (uchar *) X[k];
+	}
+	Y = (uint *) &stack[(stack_align & ~(stack_align - 1)) + 4 * size];
+
+	/* X = KDF(password, salt) */
+	neoscrypt_fastkdf_4way(in, 80, in, 80, 32, out, r * 2 * SCRYPT_BLOCK_SIZE);
+
+#if defined(NEOSCRYPT_AVX2)
+	if(r <= 2 && neoscrypt_use_avx2()) {
+		for(k = 0; k < 4; k++) {
+			if(dblmix)
+				neoscrypt_blkcpy(&Z[k][0], &X[k][0], r * 2 * SCRYPT_BLOCK_SIZE);
+			neoscrypt_salsa_tangle(&X[k][0], r * 2);
+		}
+		for(k = 0; k < 4; k += 2) {
+			/* ChaCha of two hashes along their Salsa, or the Salsa only */
+			uint *XX[4] = { Z[k], Z[k + 1], X[k], X[k + 1] };
+			uint *VV[4] = { VZ[k], VZ[k + 1], V[k], V[k + 1] };
+			if(dblmix)
+				neoscrypt_smixn(XX, VV, 4, N, r, neoscrypt_chacha_salsa_x2, mixmode & 0xFF);
+			else
+				neoscrypt_smixn(&XX[2], &VV[2], 2, N, r, neoscrypt_salsa_x2, mixmode & 0xFF);
+		}
+		for(k = 0; k < 4; k++) {
+			neoscrypt_salsa_tangle(&X[k][0], r * 2);
+			if(dblmix)
+				neoscrypt_blkxor(&X[k][0], &Z[k][0], r * 2 * SCRYPT_BLOCK_SIZE);
+		}
+	} else
+#endif
+	for(k = 0; k < 4; k++)
+		neoscrypt_mix(X[k], Y, Z[k], V[k], VZ[k], N, r, dblmix, mixmode);
+
+	for(k = 0; k < 4; k++) {
+		salt[k] = (uchar *) X[k];
+		out[k] = &output[32 * k];
+	}
+
+	/* output = KDF(password, X) */
+	neoscrypt_fastkdf_4way(in, 80, salt, r * 2 * SCRYPT_BLOCK_SIZE, 32, out, 32);
+
+	free(stack);
+#else
+	uint k;
+	for(k = 0; k < 4; k++)
+		neoscrypt(&output[32 * k], &input[80 * k], profile);
+#endif
+}
@@ -3,6 +3,7 @@ extern "C" {
 #endif
 
 void neoscrypt(unsigned char *output, const unsigned char *input, unsigned int profile);
+void neoscrypt_4way(unsigned char *output, const unsigned char *input, unsigned int profile);
 
 #if (__cplusplus)
 }
@@ -0,0 +1,275 @@
+/**
+ * Nonce space leases of the miner threads (stratum)
+ *
+ * The 32-bit nonce range of a stratum work (a header, so an extranonce2)
+ * is shared by all the threads. Each one leases a chunk of a few scan
+ * windows on demand, so the fast devices get more of it. When the range
+ * is all leased, a thread steals the unscanned half of the largest
+ * lease of another thread (never the range in flight), and when nothing
+ * is left the caller rolls extranonce2 to open a new space, no device
+ * waits for the slow ones to end their slice.
+ *
+ * The scanned ranges are merged per space, to report the coverage of the
+ * exhausted spaces and the nonces scanned twice at exit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+
+#include "miner.h"
+#include "algos.h"
+
+#define LEASE_SPACES  8   /* spaces followed, current and late scans */
+#define LEASE_WINDOWS 4   /* scan windows per lease, the stealable part */
+#define LEASE_MIN     256
+#define NONCE_SPACE   0x100000000ULL
+
+struct lease_space {
+	uint32_t key;
+	uint32_t seq;     /* open order */
+	bool used;
+	bool exhausted;
+	uint64_t next;    /* first nonce never leased */
+	uint64_t covered; /* nonces scanned */
+	std::map<uint64_t, uint64_t> scanned; /* start -> end, merged */
+};
+
+struct lease_thread {
+	uint32_t key;
+	uint64_t cur;      /* next nonce to scan */
+	uint64_t scan_end; /* end of the range in flight, cur if none */
+	uint64_t end;      /* lease end */
+};
+
+static struct lease_space lease_spaces[LEASE_SPACES];
+static struct lease_thread lease_thr[MAX_GPUS];
+static pthread_mutex_t lease_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* stats, under lease_lock */
+static uint32_t lease_opened = 0; /* also the spaces seq */
+static uint32_t lease_exhausted = 0;
+static uint32_t lease_left = 0;   /* spaces left for a new job */
+static uint32_t lease_steals = 0;
+static uint64_t lease_exhausted_covered = 0;
+static uint64_t lease_twice = 0;  /* nonces scanned twice */
+
+/* the algos with a plain nonce in the header, the others have their own ranges */
+bool nonce_lease_algo(void)
+{
+	if (opt_benchmark)
+		return false;
+	switch (opt_algo) {
+	case ALGO_CRYPTOLIGHT:
+	case ALGO_CRYPTONIGHT:
+	case ALGO_DECRED:
+	case ALGO_EQUIHASH:
+	case ALGO_SCRYPT_JANE:
+	case ALGO_SIA:
+	case ALGO_WILDKECCAK:
+	case ALGO_ZR5:
+		return false;
+	default:
+		return true;
+	}
+}
+
+static void lease_space_close(struct lease_space *sp)
+{
+	if (sp->exhausted) {
+		lease_exhausted++;
+		lease_exhausted_covered += sp->covered;
+	} else {
+		lease_left++;
+	}
+	sp->scanned.clear();
+	sp->used = false;
+}
+
+/* space key of a work, the header bytes before the nonce (fnv-1a) */
+uint32_t nonce_lease_key(const uint32_t *data, int len)
+{
+	const uchar *p = (const uchar*) data;
+	uint32_t h = 0x811c9dc5;
+	for (int i = 0; i < len; i++)
+		h = (h ^ p[i]) * 0x01000193;
+	return h;
+}
+
+static struct lease_space* lease_space_find(uint32_t key)
+{
+	for (int i = 0; i < LEASE_SPACES; i++) {
+		if (lease_spaces[i].used && lease_spaces[i].key == key)
+			return &lease_spaces[i];
+	}
+	return NULL;
+}
+
+static struct lease_space* lease_space_get(uint32_t key)
+{
+	struct lease_space *sp = lease_space_find(key);
+
+	if (sp)
+		return sp;
+	// a free slot, else the oldest space
+	for (int i = 0; i < LEASE_SPACES; i++) {
+		struct lease_space *s = &lease_spaces[i];
+		if (!s->used) {
+			sp = s;
+			break;
+		}
+		if (!sp || (int32_t) (s->seq - sp->seq) < 0)
+			sp = s;
+	}
+	if (sp->used)
+		lease_space_close(sp);
+
+	sp->key = key;
+	sp->seq = lease_opened;
+	sp->used = true;
+	sp->exhausted = false;
+	sp->next = 0;
+	sp->covered = 0;
+	lease_opened++;
+	return sp;
+}
+
+/* merge the scanned range [a, b) */
+static void lease_cover(struct lease_space *sp, uint64_t a, uint64_t b)
+{
+	std::map<uint64_t, uint64_t>::iterator it = sp->scanned.upper_bound(a);
+	uint64_t lo = a, hi = b;
+
+	if (it != sp->scanned.begin()) {
+		--it;
+		if (it->second < a) ++it;
+	}
+	while (it != sp->scanned.end() && it->first <= b) {
+		uint64_t from = max(it->first, a), to = min(it->second, b);
+		if (to > from)
+			lease_twice += to - from;
+		lo = min(lo, it->first);
+		hi = max(hi, it->second);
+		sp->covered -= it->second - it->first;
+		sp->scanned.erase(it++);
+	}
+	sp->scanned[lo] = hi;
+	sp->covered += hi - lo;
+}
+
+/* steal the unscanned half of the largest lease of the space */
+static bool lease_steal(int thr_id, uint32_t key)
+{
+	struct lease_thread *th = &lease_thr[thr_id];
+	struct lease_thread *victim = NULL;
+	uint64_t left = 0, split;
+
+	for (int i = 0; i < opt_n_threads && i < MAX_GPUS; i++) {
+		struct lease_thread *v = &lease_thr[i];
+		if (i == thr_id || v->key != key || v->end <= v->scan_end)
+			continue;
+		if (v->end - v->scan_end > left) {
+			left = v->end - v->scan_end;
+			victim = v;
+		}
+	}
+	if (!victim)
+		return false;
+
+	split = victim->scan_end;
+	if (left >= 2 * LEASE_MIN)
+		split += left / 2;
+	th->cur = th->scan_end = split;
+	th->end = victim->end;
+	victim->end = split;
+	lease_steals++;
+	return true;
+}
+
+/**
+ * next range of the thread in the space key, window is the wanted size.
+ * false when the space is exhausted, extranonce2 must then be rolled.
+ */
+bool nonce_lease_next(int thr_id, uint32_t key, uint64_t window, uint32_t *start, uint32_t *last)
+{
+	struct lease_thread *th = &lease_thr[thr_id];
+	struct lease_space *sp;
+	uint64_t n;
+
+	window = max((uint64_t) LEASE_MIN, window);
+
+	pthread_mutex_lock(&lease_lock);
+	if (th->key != key) {
+		th->key = key;
+		th->cur = th->scan_end = th->end = 0;
+	}
+	// the space is only opened (or evicted) to take a new lease
+	if (th->cur >= th->end) {
+		sp = lease_space_get(key);
+		if (sp->next < NONCE_SPACE) {
+			th->cur = th->scan_end = sp->next;
+			th->end = min(NONCE_SPACE, sp->next + window * LEASE_WINDOWS);
+			sp->next = th->end;
+		} else if (!lease_steal(thr_id, key)) {
+			sp->exhausted = true;
+			pthread_mutex_unlock(&lease_lock);
+			return false;
+		}
+	}
+	n = min(window, th->end - th->cur);
+	th->scan_end = th->cur + n;
+	*start = (uint32_t) th->cur;
+	*last = (uint32_t) (th->scan_end - 1);
+	pthread_mutex_unlock(&lease_lock);
+	return true;
+}
+
+/* nonces left in the lease of the thread */
+bool nonce_lease_left(int thr_id, uint32_t key)
+{
+	struct lease_thread *th = &lease_thr[thr_id];
+	bool left;
+
+	pthread_mutex_lock(&lease_lock);
+	left = (th->key == key && th->cur < th->end);
+	pthread_mutex_unlock(&lease_lock);
+	return left;
+}
+
+/* the range [start, next) was scanned, next is the scanhash cursor */
+void nonce_lease_done(int thr_id, uint32_t key, uint32_t start, uint64_t next)
+{
+	struct lease_thread *th = &lease_thr[thr_id];
+	struct lease_space *sp;
+
+	pthread_mutex_lock(&lease_lock);
+	if (th->key == key) {
+		// an interrupted scan continues its lease
+		th->cur = th->scan_end = next;
+	}
+	sp = lease_space_find(key);
+	if (sp && next > start)
+		lease_cover(sp, start, next);
+	pthread_mutex_unlock(&lease_lock);
+}
+
+void nonce_lease_report(void)
+{
+	pthread_mutex_lock(&lease_lock);
+	if (!lease_opened) {
+		pthread_mutex_unlock(&lease_lock);
+		return;
+	}
+	for (int i = 0; i < LEASE_SPACES; i++) {
+		if (lease_spaces[i].used && lease_spaces[i].exhausted)
+			lease_space_close(&lease_spaces[i]);
+	}
+	applog(LOG_INFO, "nonce leases: %u spaces, %u exhausted, %u left on new jobs, %u steals",
+		lease_opened, lease_exhausted, lease_left, lease_steals);
+	if (lease_exhausted)
+		applog(LOG_INFO, "nonce leases: %.4f%% of the exhausted spaces scanned, %llu nonces scanned twice",
+			100. * lease_exhausted_covered / ((double) NONCE_SPACE * lease_exhausted),
+			(unsigned long long) lease_twice);
+	pthread_mutex_unlock(&lease_lock);
+}
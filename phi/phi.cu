@@ -15,6 +15,7 @@ extern "C" {
 #include "sph/sph_fugue.h"
 #include "sph/sph_streebog.h"
 #include "sph/sph_echo.h"
+#include "sph/sph_midstate.h"
 }
 
 #include "miner.h"
@@ -38,6 +39,8 @@ extern void tribus_echo512_final(int thr_id, uint32_t threads, uint32_t *d_hash,
 static uint32_t *d_hash[MAX_GPUS];
 static uint32_t *d_resNonce[MAX_GPUS];
 
+static __thread sph_midstate80 s_midstate;
+
 extern "C" void phi_hash(void *output, const void *input)
 {
 	unsigned char _ALIGN(128) hash[128] = { 0 };
@@ -49,8 +52,7 @@ extern "C" void phi_hash(void *output, const void *input)
 	sph_gost512_context ctx_gost;
 	sph_echo512_context ctx_echo;
 
-	sph_skein512_init(&ctx_skein);
-	sph_skein512(&ctx_skein, input, 80);
+	SPH_MIDSTATE80(&s_midstate, skein512, &ctx_skein, input);
 	sph_skein512_close(&ctx_skein, (void*)hash);
 
 	sph_jh512_init(&ctx_jh);
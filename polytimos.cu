@@ -9,6 +9,7 @@ extern "C"
 #include "sph/sph_luffa.h"
 #include "sph/sph_fugue.h"
 #include "sph/sph_streebog.h"
+#include "sph/sph_midstate.h"
 }
 
 #include "miner.h"
@@ -32,6 +33,8 @@ extern void streebog_sm3_hash_64_final(int thr_id, uint32_t threads, uint32_t *d
 extern void skunk_streebog_set_target(uint32_t* ptarget);
 extern void skunk_cuda_streebog(int thr_id, uint32_t threads, uint32_t *d_hash, uint32_t* d_resNonce);
 
+static __thread sph_midstate80 s_midstate;
+
 // CPU Hash
 extern "C" void polytimos_hash(void *output, const void *input)
 {
@@ -45,8 +48,7 @@ extern "C" void polytimos_hash(void *output, const void *input)
 	uint32_t _ALIGN(128) hash[16];
 	memset(hash, 0, sizeof hash);
 
-	sph_skein512_init(&ctx_skein);
-	sph_skein512(&ctx_skein, input, 80);
+	SPH_MIDSTATE80(&s_midstate, skein512, &ctx_skein, input);
 	sph_skein512_close(&ctx_skein, (void*) hash);
 
 	sph_shabal512_init(&ctx_shabal);
@@ -218,8 +218,10 @@ bool pool_switch(int thr_id, int pooln)
 			algo_switch = true;
 
 			pthread_mutex_lock(&stats_lock);
-			for (int n=0; n<opt_n_threads; n++)
+			for (int n=0; n<opt_n_threads; n++) {
 				thr_hashrates[n] = 0.;
+				scan_window_reset(n);
+			}
 			stats_purge_all();
 			if (check_dups)
 				hashlog_purge_all();
@@ -235,6 +237,7 @@ bool pool_switch(int thr_id, int pooln)
 		net_diff = 0;
 		g_work_time = 0;
 		g_work.data[0] = 0;
+		g_work_changed();
 		pool_is_switching = true;
 		stratum_need_reset = true;
 		// used to get the pool uptime
@@ -273,6 +276,7 @@ bool pool_switch(int thr_id, int pooln)
 			// will issue a lp_url request to unlock the longpoll thread
 			have_longpoll = false;
 			get_work(&thr_info[0], &g_work);
+			g_work_changed();
 			pthread_mutex_unlock(&stratum_work_lock);
 		}
 
@@ -8,6 +8,7 @@ extern "C" {
 #include "sph/sph_shavite.h"
 #include "sph/sph_simd.h"
 #include "sph/sph_echo.h"
+#include "sph/sph_midstate.h"
 }
 
 #include "miner.h"
@@ -21,6 +22,8 @@ extern void qubit_luffa512_cpu_init(int thr_id, uint32_t threads);
 extern void qubit_luffa512_cpu_setBlock_80(void *pdata);
 extern void qubit_luffa512_cpu_hash_80(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *d_hash, int order);
 
+static __thread sph_midstate80 s_midstate;
+
 extern "C" void deephash(void *state, const void *input)
 {
 	uint8_t _ALIGN(64) hash[64];
@@ -30,8 +33,7 @@ extern "C" void deephash(void *state, const void *input)
 	sph_cubehash512_context ctx_cubehash;
 	sph_echo512_context ctx_echo;
 
-	sph_luffa512_init(&ctx_luffa);
-	sph_luffa512 (&ctx_luffa, input, 80);
+	SPH_MIDSTATE80(&s_midstate, luffa512, &ctx_luffa, input);
 	sph_luffa512_close(&ctx_luffa, (void*) hash);
 
 	sph_cubehash512_init(&ctx_cubehash);
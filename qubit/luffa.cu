@@ -3,6 +3,7 @@
  */
 extern "C" {
 #include "sph/sph_luffa.h"
+#include "sph/sph_midstate.h"
 }
 
 #include "miner.h"
@@ -15,14 +16,15 @@ extern void qubit_luffa512_cpu_init(int thr_id, uint32_t threads);
 extern void qubit_luffa512_cpu_setBlock_80(void *pdata);
 extern void qubit_luffa512_cpu_hash_80(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *d_hash, int order);
 
+static __thread sph_midstate80 s_midstate;
+
 extern "C" void luffa_hash(void *state, const void *input)
 {
 	uint8_t _ALIGN(64) hash[64];
 
 	sph_luffa512_context ctx_luffa;
 
-	sph_luffa512_init(&ctx_luffa);
-	sph_luffa512 (&ctx_luffa, input, 80);
+	SPH_MIDSTATE80(&s_midstate, luffa512, &ctx_luffa, input);
 	sph_luffa512_close(&ctx_luffa, (void*) hash);
 
 	memcpy(state, hash, 32);
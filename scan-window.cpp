@@ -0,0 +1,314 @@
+/**
+ * Adaptive scan window of the miner threads
+ *
+ * The nonces given to a scanhash call are sized to last --scan-target
+ * seconds at the thread rate. The rate mean and variance are smoothed,
+ * the window uses the low side of the rate (mean - stddev) and a gain,
+ * corrected after each full scan by the ratio of the expected and real
+ * scan times (kernel batches, launch overhead). The new jobs which don't
+ * restart the threads are only seen at the end of a scan, so the window
+ * is also kept under a quarter of the jobs lifetime seen on the pool.
+ *
+ * With --scan-state=FILE the learned rate and gain of each algo and
+ * device are saved at exit and reloaded on start, the first scans are
+ * then well sized, else a first scan of the old fixed algo size (0x100
+ * on the cpu device) measures the rate.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "miner.h"
+#include "algos.h"
+
+double opt_scan_target = 5.; /* seconds */
+char *opt_scan_state = NULL;
+
+#define SCAN_MIN_TIME   0.2      /* seconds, lower windows cost more than they save */
+#define SCAN_ALPHA      0.2      /* weight of a new rate sample */
+#define SCAN_JOB_ALPHA  0.25     /* weight of a new job lifetime */
+#define SCAN_GAIN_MIN   0.5
+#define SCAN_GAIN_MAX   2.0
+
+struct scan_window {
+	uint32_t samples;
+	double rate;     /* H/s */
+	double variance;
+	double gain;
+	double planned;  /* mean rate when the last window was sized */
+};
+
+static struct scan_window scan_win[MAX_GPUS];
+
+/* jobs lifetime per pool, updated by the stratum thread */
+static double scan_job_life[MAX_POOLS];
+static struct timeval scan_job_tv[MAX_POOLS];
+
+static const char* scan_device_name(int thr_id)
+{
+	const char *name = device_name[device_map[thr_id]];
+	if (device_type[thr_id] == DEVICE_TYPE_CPU || !name)
+		return "host cpu";
+	return name;
+}
+
+static double scan_rate_low(struct scan_window *sw)
+{
+	double low = sw->rate - sqrt(sw->variance);
+	return max(low, sw->rate / 2.);
+}
+
+/* forget the rate of the thread, on an algo switch */
+void scan_window_reset(int thr_id)
+{
+	if (thr_id < 0 || thr_id >= MAX_GPUS)
+		return;
+	memset(&scan_win[thr_id], 0, sizeof(struct scan_window));
+	scan_win[thr_id].gain = 1.;
+}
+
+/* load the learned windows, once the devices are known */
+void scan_window_init(void)
+{
+	char line[256];
+	FILE *fp;
+	int loaded = 0;
+
+	for (int thr_id = 0; thr_id < MAX_GPUS; thr_id++)
+		scan_window_reset(thr_id);
+
+	if (!opt_scan_state)
+		return;
+	fp = fopen(opt_scan_state, "r");
+	if (!fp)
+		return;
+
+	// algo <tab> device id <tab> device name <tab> rate <tab> stddev <tab> gain
+	while (fgets(line, sizeof(line), fp)) {
+		char algo[64], name[128];
+		int dev_id;
+		double rate, stddev, gain;
+		if (sscanf(line, "%63[^\t]\t%d\t%127[^\t]\t%lf\t%lf\t%lf", algo, &dev_id, name,
+			&rate, &stddev, &gain) != 6)
+			continue;
+		if (strcmp(algo, algo_names[opt_algo]) || rate <= 0.)
+			continue;
+		for (int thr_id = 0; thr_id < opt_n_threads; thr_id++) {
+			struct scan_window *sw = &scan_win[thr_id];
+			if (device_map[thr_id] != dev_id || strcmp(scan_device_name(thr_id), name))
+				continue;
+			sw->samples = 2; // a sample, but not the first scan one
+			sw->rate = rate;
+			sw->variance = stddev * stddev;
+			sw->gain = min(SCAN_GAIN_MAX, max(SCAN_GAIN_MIN, gain));
+			loaded++;
+		}
+	}
+	fclose(fp);
+
+	if (loaded && opt_debug)
+		applog(LOG_DEBUG, "%d scan windows loaded from %s", loaded, opt_scan_state);
+}
+
+/* rewrite the state file, the lines of the other algos are kept */
+void scan_window_save(void)
+{
+	char line[256], prefix[72];
+	char *others = NULL;
+	size_t len = 0;
+	FILE *fp;
+
+	if (!opt_scan_state)
+		return;
+
+	snprintf(prefix, sizeof(prefix), "%s\t", algo_names[opt_algo]);
+	fp = fopen(opt_scan_state, "r");
+	if (fp) {
+		while (fgets(line, sizeof(line), fp)) {
+			size_t n = strlen(line);
+			if (!strncmp(line, prefix, strlen(prefix)))
+				continue;
+			others = (char*) realloc(others, len + n + 1);
+			memcpy(&others[len], line, n + 1);
+			len += n;
+		}
+		fclose(fp);
+	}
+
+	fp = fopen(opt_scan_state, "w");
+	if (!fp) {
+		applog(LOG_WARNING, "unable to write the scan state in %s", opt_scan_state);
+		free(others);
+		return;
+	}
+	if (others) {
+		fputs(others, fp);
+		free(others);
+	}
+	for (int thr_id = 0; thr_id < opt_n_threads; thr_id++) {
+		struct scan_window *sw = &scan_win[thr_id];
+		if (sw->samples < 2)
+			continue;
+		fprintf(fp, "%s\t%d\t%s\t%.0f\t%.0f\t%.3f\n", algo_names[opt_algo], (int) device_map[thr_id],
+			scan_device_name(thr_id), sw->rate, sqrt(sw->variance), sw->gain);
+	}
+	fclose(fp);
+}
+
+/* a new job was received from the pool */
+void scan_window_new_job(int pooln)
+{
+	struct timeval now, diff;
+
+	if (pooln < 0 || pooln >= MAX_POOLS)
+		return;
+	gettimeofday(&now, NULL);
+	if (scan_job_tv[pooln].tv_sec) {
+		double life;
+		timeval_subtract(&diff, &now, &scan_job_tv[pooln]);
+		life = (double) diff.tv_sec + 1e-6 * diff.tv_usec;
+		if (scan_job_life[pooln] > 0.)
+			scan_job_life[pooln] += SCAN_JOB_ALPHA * (life - scan_job_life[pooln]);
+		else
+			scan_job_life[pooln] = life;
+	}
+	scan_job_tv[pooln] = now;
+}
+
+/* first window of an unknown device, the old minimum scan of the algo */
+static uint64_t scan_probe(int thr_id)
+{
+	// the host cores are a lot slower
+	if (device_type[thr_id] == DEVICE_TYPE_CPU)
+		return 0x100;
+
+	switch (opt_algo) {
+	case ALGO_BLAKECOIN:
+	case ALGO_BLAKE2S:
+	case ALGO_VANILLA:
+		return 0x80000000U;
+	case ALGO_BLAKE:
+	case ALGO_BMW:
+	case ALGO_DECRED:
+	case ALGO_SHA256D:
+	case ALGO_SHA256T:
+	case ALGO_SHA256Q:
+		return 0x40000000U;
+	case ALGO_BLAKE2B:
+	case ALGO_KECCAK:
+	case ALGO_KECCAKC:
+	case ALGO_LBRY:
+	case ALGO_LUFFA:
+	case ALGO_SIA:
+	case ALGO_SKEIN:
+	case ALGO_SKEIN2:
+	case ALGO_TRIBUS:
+		return 0x1000000;
+	case ALGO_ALLIUM:
+	case ALGO_C11:
+	case ALGO_DEEP:
+	case ALGO_HEAVY:
+	case ALGO_JACKPOT:
+	case ALGO_JHA:
+	case ALGO_HSR:
+	case ALGO_LYRA2v2:
+	case ALGO_LYRA2v3:
+	case ALGO_PHI:
+	case ALGO_PHI2:
+	case ALGO_POLYTIMOS:
+	case ALGO_S3:
+	case ALGO_SKUNK:
+	case ALGO_TIMETRAVEL:
+	case ALGO_BITCORE:
+	case ALGO_EXOSIS:
+	case ALGO_X11EVO:
+	case ALGO_X11:
+	case ALGO_X12:
+	case ALGO_X13:
+	case ALGO_WHIRLCOIN:
+	case ALGO_WHIRLPOOL:
+		return 0x400000;
+	case ALGO_X14:
+	case ALGO_X15:
+		return 0x300000;
+	case ALGO_LYRA2:
+	case ALGO_LYRA2Z:
+	case ALGO_NEOSCRYPT:
+	case ALGO_SIB:
+	case ALGO_SCRYPT:
+	case ALGO_SONOA:
+	case ALGO_VELTOR:
+		return 0x80000;
+	case ALGO_CRYPTOLIGHT:
+	case ALGO_CRYPTONIGHT:
+	case ALGO_SCRYPT_JANE:
+		return 0x1000;
+	default:
+		return 0x100000;
+	}
+}
+
+/* nonces to scan, budget is the max scan time in seconds */
+uint64_t scan_window_size(int thr_id, int pooln, double budget)
+{
+	struct scan_window *sw = &scan_win[thr_id];
+	double secs = min(budget, opt_scan_target);
+	double life = (pooln >= 0 && pooln < MAX_POOLS) ? scan_job_life[pooln] : 0.;
+	double rate, nonces;
+
+	if (life > 0.)
+		secs = min(secs, life / 4.);
+	secs = max(secs, min(budget, SCAN_MIN_TIME));
+
+	if (!sw->samples) {
+		sw->planned = 0.;
+		return scan_probe(thr_id);
+	}
+
+	rate = scan_rate_low(sw);
+	sw->planned = sw->rate;
+	nonces = rate * secs * sw->gain;
+	// the gain can't take the scan over the budget at the mean rate
+	nonces = min(nonces, sw->rate * budget);
+	if (nonces < 256.)
+		return 256;
+	if (nonces >= (double) UINT32_MAX)
+		return UINT32_MAX;
+	return (uint64_t) nonces;
+}
+
+/* result of a scan, full when the window was scanned to its end */
+void scan_window_update(int thr_id, uint64_t nonces, uint64_t hashes, double dtime, bool full)
+{
+	struct scan_window *sw = &scan_win[thr_id];
+	double rate, diff;
+
+	if (dtime <= 0. || !hashes)
+		return;
+	rate = (double) hashes / dtime;
+
+	// the first scan includes the device init, only keep it as a probe
+	if (sw->samples < 2) {
+		sw->rate = rate;
+		sw->variance = 0.;
+		sw->samples++;
+		return;
+	}
+
+	if (full && sw->planned > 0.) {
+		// time expected at the mean rate against the real one, the
+		// gain only corrects the bias, the stddev margin is kept
+		double ratio = ((double) nonces / sw->planned) / (dtime * sw->gain);
+		if (ratio > 0.) {
+			sw->gain *= sqrt(ratio);
+			sw->gain = min(SCAN_GAIN_MAX, max(SCAN_GAIN_MIN, sw->gain));
+		}
+	}
+
+	diff = rate - sw->rate;
+	sw->rate += SCAN_ALPHA * diff;
+	sw->variance = (1. - SCAN_ALPHA) * (sw->variance + SCAN_ALPHA * diff * diff);
+	sw->samples++;
+}
@@ -286,6 +286,8 @@ void scrypt_set_fatal_error_default(scrypt_fatal_errorfn fn) {
 
 typedef struct scrypt_aligned_alloc_t {
 	uint8_t *mem, *ptr;
+	uint64_t size;
+	bool mapped;
 } scrypt_aligned_alloc;
 
 #if defined(SCRYPT_TEST_SPEED)
@@ -304,6 +306,8 @@ static scrypt_aligned_alloc scrypt_alloc(uint64_t size)
 	}
 	aa.mem = mem_base + mem_bump;
 	aa.ptr = aa.mem;
+	aa.size = size;
+	aa.mapped = false;
 	mem_bump += (size_t)size;
 	return aa;
 }
@@ -317,6 +321,8 @@ static scrypt_aligned_alloc scrypt_alloc(uint64_t size)
 {
 	static const size_t max_alloc = (size_t)-1;
 	scrypt_aligned_alloc aa;
+	aa.size = size;
+	aa.mapped = false;
 	size += (SCRYPT_BLOCK_BYTES - 1);
 	if (size > max_alloc)
 		scrypt_fatal_error("scrypt: not enough address space on this CPU to allocate required memory");
@@ -327,12 +333,99 @@ static scrypt_aligned_alloc scrypt_alloc(uint64_t size)
 	return aa;
 }
 
+/* big scratchpads (V) are mapped, with huge pages if the system allows it */
+static scrypt_aligned_alloc scrypt_alloc_large(uint64_t size)
+{
+#if defined(OS_LINUX)
+	static const size_t max_alloc = (size_t)-1;
+	scrypt_aligned_alloc aa;
+	if (size < (2U << 20) || size > max_alloc)
+		return scrypt_alloc(size);
+	size = (size + (2U << 20) - 1) & ~((2ULL << 20) - 1);
+	aa.mem = (uint8_t *)mmap(0, (size_t)size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (aa.mem == MAP_FAILED) {
+		aa.mem = (uint8_t *)mmap(0, (size_t)size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (aa.mem == MAP_FAILED)
+			return scrypt_alloc(size);
+		madvise(aa.mem, (size_t)size, MADV_HUGEPAGE);
+		if (opt_debug) applog(LOG_DEBUG, "scrypt-jane: hugetlb not available");
+	} else {
+		if (opt_debug) applog(LOG_DEBUG, "scrypt-jane: using hugetlb");
+	}
+	aa.ptr = aa.mem;
+	aa.size = size;
+	aa.mapped = true;
+	return aa;
+#else
+	return scrypt_alloc(size);
+#endif
+}
+
 static void scrypt_free(scrypt_aligned_alloc *aa)
 {
+#if defined(OS_LINUX)
+	if (aa->mapped && aa->mem)
+		munmap(aa->mem, (size_t)aa->size);
+	else
+#endif
 	free(aa->mem);
+	memset(aa, 0, sizeof(*aa));
 }
 #endif
 
+/* keep an allocation if it is large enough, else replace it */
+static void scrypt_realloc(scrypt_aligned_alloc *aa, uint64_t size, bool large)
+{
+	if (aa->mem && aa->size >= size)
+		return;
+	if (aa->mem)
+		scrypt_free(aa);
+#if defined(SCRYPT_TEST_SPEED)
+	*aa = scrypt_alloc(size);
+#else
+	*aa = large ? scrypt_alloc_large(size) : scrypt_alloc(size);
+#endif
+}
+
+/*
+ * Scratch memory of a scrypt-jane thread, allocated on first use and kept
+ * between the scans. The scratchpad V only grows with the N-factor.
+ */
+typedef struct scrypt_jane_arena_t {
+	scrypt_aligned_alloc V;
+	scrypt_aligned_alloc X[2];
+	scrypt_aligned_alloc Y;
+	scrypt_aligned_alloc data[2];
+} scrypt_jane_arena;
+
+static void scrypt_arena_reserve(scrypt_jane_arena *arena, uint32_t N, uint32_t throughput, int header_size)
+{
+	const uint64_t chunk_bytes = 2ULL * SCRYPT_BLOCK_BYTES * SCRYPT_R;
+	if (arena->V.size < N * chunk_bytes && opt_debug)
+		applog(LOG_DEBUG, "scrypt-jane: scratchpad set to %u MB", (uint32_t) ((N * chunk_bytes) >> 20));
+	scrypt_realloc(&arena->V, N * chunk_bytes, true);
+	scrypt_realloc(&arena->Y, (SCRYPT_P + 1) * chunk_bytes, false);
+	for (int k = 0; k < 2; k++) {
+		scrypt_realloc(&arena->X[k], chunk_bytes * throughput, false);
+		scrypt_realloc(&arena->data[k], (uint64_t) header_size * throughput, false);
+	}
+}
+
+static void scrypt_arena_free(scrypt_jane_arena *arena)
+{
+	if (arena->V.mem) scrypt_free(&arena->V);
+	if (arena->Y.mem) scrypt_free(&arena->Y);
+	for (int k = 0; k < 2; k++) {
+		if (arena->X[k].mem) scrypt_free(&arena->X[k]);
+		if (arena->data[k].mem) scrypt_free(&arena->data[k]);
+	}
+}
+
+static scrypt_jane_arena jane_arena[MAX_GPUS] = { 0 };
+// cpu hash memory of the thread, freed by the key destructor at its exit
+static __thread scrypt_jane_arena *cpu_arena = NULL;
+static pthread_key_t cpu_arena_key;
+static pthread_once_t cpu_arena_once = PTHREAD_ONCE_INIT;
 
 // yacoin: increasing Nfactor gradually
 unsigned char GetNfactor(unsigned int nTimestamp)
@@ -431,11 +524,21 @@ unsigned char GetNfactor(unsigned int nTimestamp)
 
 static bool init[MAX_GPUS] = { 0 };
 
+static void jane_cpu_stop();
+
 // cleanup
 void free_scrypt_jane(int thr_id)
 {
 	int dev_id = device_map[thr_id];
 
+	// the inline nonce checks of the miner thread
+	scryptjane_hash_free();
+
+	if (device_type[thr_id] == DEVICE_TYPE_CPU) {
+		jane_cpu_stop();
+		return;
+	}
+
 	if (!init[thr_id])
 		return;
 
@@ -443,6 +546,8 @@ void free_scrypt_jane(int thr_id)
 	cudaDeviceSynchronize();
 	cudaDeviceReset(); // well, simple way to free ;)
 
+	scrypt_arena_free(&jane_arena[thr_id]);
+
 	init[thr_id] = false;
 }
 
@@ -456,6 +561,61 @@ void free_scrypt_jane(int thr_id)
 
 static int s_Nfactor = 0;
 
+// N of the job, and the header size (84 bytes since the yacoin hardfork)
+static uint32_t scrypt_jane_params(const uint32_t *pdata, int block_version, int *header_size)
+{
+	if (s_Nfactor == 0 && strlen(jane_params) > 0)
+		applog(LOG_INFO, "Given scrypt-jane parameters: %s", jane_params);
+
+	// Default value is from after hardfork block case
+	int Nfactor = 21; // Nfactor is fixed after hardfork
+	*header_size = 84;
+	if (block_version < 7)
+	{
+		// Get nFactor based on block version
+		Nfactor = GetNfactor(bswap_32x4(pdata[17]));
+		*header_size = 80;
+	}
+
+	if (Nfactor > scrypt_maxN) {
+		scrypt_fatal_error("scrypt: N out of range");
+	}
+	uint32_t N = (1 << (Nfactor + 1));
+
+	if (Nfactor != s_Nfactor)
+	{
+		opt_nfactor = Nfactor;
+		applog(LOG_INFO, "N-factor is %d (%d)!", Nfactor, N);
+		if (s_Nfactor != 0) {
+			// handle N-factor increase at runtime
+			// by adjusting the lookup_gap by factor 2
+			if (s_Nfactor == Nfactor-1)
+				for (int i=0; i < 8; ++i)
+					device_lookup_gap[i] *= 2;
+		}
+		s_Nfactor = Nfactor;
+	}
+
+	return N;
+}
+
+// check once the cpu mixers used to verify the gpu results
+static void scrypt_jane_check_cpu()
+{
+	static bool checked = false;
+	uint32_t lanes = 1;
+
+	if (checked)
+		return;
+	checked = true;
+
+	if (!scrypt_test_mix())
+		applog(LOG_ERR, "scrypt-jane: cpu chunkmix self test failed!");
+	scrypt_getROMix_lanes(&lanes);
+	if (opt_debug)
+		applog(LOG_DEBUG, "scrypt-jane: cpu ROMix uses %u lanes", lanes);
+}
+
 int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsigned long *hashes_done,
 	unsigned char *scratchbuf, struct timeval *tv_start, struct timeval *tv_end, int block_version)
 {
@@ -546,37 +706,8 @@ int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsi
     }
     /* END print received data */
 
-	if (s_Nfactor == 0 && strlen(jane_params) > 0)
-		applog(LOG_INFO, "Given scrypt-jane parameters: %s", jane_params);
-
-	// Default value is from after hardfork block case
-	int Nfactor = 21; // Nfactor is fixed after hardfork
-	int block_header_size = 84;
-	if (block_version < 7)
-	{
-		// Get nFactor based on block version
-		Nfactor = GetNfactor(bswap_32x4(pdata[17]));
-		block_header_size = 80;
-	}
-
-	if (Nfactor > scrypt_maxN) {
-		scrypt_fatal_error("scrypt: N out of range");
-	}
-	N = (1 << (Nfactor + 1));
-
-	if (Nfactor != s_Nfactor)
-	{
-		opt_nfactor = Nfactor;
-		applog(LOG_INFO, "N-factor is %d (%d)!", Nfactor, N);
-		if (s_Nfactor != 0) {
-			// handle N-factor increase at runtime
-			// by adjusting the lookup_gap by factor 2
-			if (s_Nfactor == Nfactor-1)
-				for (int i=0; i < 8; ++i)
-					device_lookup_gap[i] *= 2;
-		}
-		s_Nfactor = Nfactor;
-	}
+	int block_header_size;
+	N = scrypt_jane_params(pdata, block_version, &block_header_size);
 
 
 
@@ -591,6 +722,7 @@ int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsi
 
 		throughput = cuda_throughput(thr_id);
 		gpulog(LOG_INFO, thr_id, "Intensity set to %g, %u cuda threads", throughput2intensity(throughput), throughput);
+		scrypt_jane_check_cpu();
 
 		init[thr_id] = true;
 	}
@@ -600,7 +732,10 @@ int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsi
 
 	gettimeofday(tv_start, NULL);
 
-	uint32_t *data[2] = { new uint32_t[(block_header_size/4)*throughput], new uint32_t[(block_header_size/4)*throughput] };
+	scrypt_jane_arena *arena = &jane_arena[thr_id];
+	scrypt_arena_reserve(arena, N, throughput, block_header_size);
+
+	uint32_t *data[2] = { (uint32_t*) arena->data[0].ptr, (uint32_t*) arena->data[1].ptr };
 	uint32_t* hash[2]   = { cuda_hashbuffer(thr_id,0), cuda_hashbuffer(thr_id,1) };
 
 	uint32_t n = pdata[(block_header_size/4 - 1)];
@@ -611,7 +746,7 @@ int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsi
 		char *target_str = get_target_string(ptarget);
 		applog(LOG_DEBUG,
 				"TACA => scanhash_scrypt_jane[%d], Nfactor = %d, target = %s, Htarg = %x, throughput = %d, parallel = %d, nNonce = %u",
-				thr_id, Nfactor, target_str, Htarg, throughput, parallel,
+				thr_id, s_Nfactor, target_str, Htarg, throughput, parallel,
 				nNonce);
 		free(target_str);
     }
@@ -623,9 +758,9 @@ int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsi
 	}
 	if (parallel == 2) prepare_keccak512(thr_id, pdata, block_header_size);
 
-	scrypt_aligned_alloc Xbuf[2] = { scrypt_alloc(128 * throughput), scrypt_alloc(128 * throughput) };
-	scrypt_aligned_alloc Vbuf = scrypt_alloc(N * 128);
-	scrypt_aligned_alloc Ybuf = scrypt_alloc(128);
+	scrypt_aligned_alloc *Xbuf = arena->X;
+	scrypt_aligned_alloc &Vbuf = arena->V;
+	scrypt_aligned_alloc &Ybuf = arena->Y;
 
 	uint32_t nonce[2];
 	uint32_t* cuda_X[2]      = { cuda_transferbuffer(thr_id,0), cuda_transferbuffer(thr_id,1) };
@@ -633,6 +768,7 @@ int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsi
 #if !defined(SCRYPT_CHOOSE_COMPILETIME)
 	scrypt_ROMixfn scrypt_ROMix = scrypt_getROMix();
 #endif
+	scrypt_ROMix_1fn scrypt_ROMix_1 = scrypt_getROMix_1();
 
 	int cur = 0, nxt = 1;
 	int iteration = 0;
@@ -795,10 +931,6 @@ int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsi
 					work_set_target_ratio(work, thash);
 					*hashes_done = n - pdata[(block_header_size / 4 - 1)];
 					pdata[(block_header_size / 4 - 1)] = tmp_nonce;
-					scrypt_free(&Vbuf);
-					scrypt_free(&Ybuf);
-					scrypt_free(&Xbuf[0]); scrypt_free(&Xbuf[1]);
-					delete[] data[0]; delete[] data[1];
 					gettimeofday(tv_end, NULL);
 					return 1;
 				} else {
@@ -817,11 +949,6 @@ int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsi
 		++iteration;
 	} while (n <= max_nonce && !work_restart[thr_id].restart);
 
-	scrypt_free(&Vbuf);
-	scrypt_free(&Ybuf);
-	scrypt_free(&Xbuf[0]); scrypt_free(&Xbuf[1]);
-	delete[] data[0]; delete[] data[1];
-
 	*hashes_done = n - pdata[(block_header_size / 4 - 1)];
 	pdata[(block_header_size / 4 - 1)] = n;
 	gettimeofday(tv_end, NULL);
@@ -838,6 +965,7 @@ static void scrypt_jane_hash_1_1(const uchar *password, size_t password_len, con
 #if !defined(SCRYPT_CHOOSE_COMPILETIME)
 	scrypt_ROMixfn scrypt_ROMix = scrypt_getROMix();
 #endif
+	scrypt_ROMix_1fn scrypt_ROMix_1 = scrypt_getROMix_1();
 
 	chunk_bytes = SCRYPT_BLOCK_BYTES * SCRYPT_R * 2;
 
@@ -857,25 +985,332 @@ static void scrypt_jane_hash_1_1(const uchar *password, size_t password_len, con
 #endif
 }
 
+static void cpu_arena_release(void *arena)
+{
+	scrypt_arena_free((scrypt_jane_arena*) arena);
+	free(arena);
+}
+
+static void cpu_arena_key_init(void)
+{
+	pthread_key_create(&cpu_arena_key, cpu_arena_release);
+}
+
 /* for cpu hash test */
 void scryptjane_hash(void* output, const void* input)
 {
 	uint32_t Nsize = 1UL << (opt_nfactor + 1);
 	uint64_t chunk_bytes;
 	uint8_t *X, *Y;
-	scrypt_aligned_alloc YX, V;
 
 	chunk_bytes = 2ULL * SCRYPT_BLOCK_BYTES * SCRYPT_R;
-	V  = scrypt_alloc(Nsize * chunk_bytes);
-	YX = scrypt_alloc((SCRYPT_P + 1) * chunk_bytes);
 
-	memset(V.ptr, 0, (size_t) (Nsize * chunk_bytes));
+	// V is fully written by ROMix before being read, no need to clear it
+	if (!cpu_arena) {
+		pthread_once(&cpu_arena_once, cpu_arena_key_init);
+		cpu_arena = (scrypt_jane_arena*) calloc(1, sizeof(scrypt_jane_arena));
+		if (!cpu_arena)
+			scrypt_fatal_error("scrypt: out of memory");
+		pthread_setspecific(cpu_arena_key, cpu_arena);
+	}
+	scrypt_realloc(&cpu_arena->V, Nsize * chunk_bytes, true);
+	scrypt_realloc(&cpu_arena->Y, (SCRYPT_P + 1) * chunk_bytes, false);
 
-	Y = YX.ptr;
+	Y = cpu_arena->Y.ptr;
 	X = Y + chunk_bytes;
 
-	scrypt_jane_hash_1_1((uchar*)input, 80, (uchar*)input, 80, (uint32_t) Nsize, (uchar*)output, 32, X, Y, V.ptr);
+	scrypt_jane_hash_1_1((uchar*)input, 80, (uchar*)input, 80, (uint32_t) Nsize, (uchar*)output, 32, X, Y, cpu_arena->V.ptr);
+}
+
+/* release the cpu hash memory of the calling thread */
+void scryptjane_hash_free(void)
+{
+	if (!cpu_arena)
+		return;
+	pthread_setspecific(cpu_arena_key, NULL);
+	cpu_arena_release(cpu_arena);
+	cpu_arena = NULL;
+}
+
+// ---------------------------- cpu device ------------------------------------
+
+/*
+ * scrypt-jane on the host cores. The miner thread of the cpu device
+ * publishes the header of the job, a pool of workers takes small nonce
+ * ranges from it until the range is done, a nonce is found or the work
+ * is restarted. Each worker is pinned before it allocates its scratchpad,
+ * so the memory is first touched (and placed) on its own numa node.
+ */
+
+extern int num_cpus;
+extern int64_t opt_affinity;
+
+typedef struct jane_cpu_job_t {
+	uint32_t data[21]; // byte swapped header, nonce excluded
+	uint32_t target[8];
+	int header_size;
+	uint32_t N;
+	uint32_t lanes;    // lanes per ROMix call allowed by the memory budget
+	uint64_t next_nonce;
+	uint64_t max_nonce;
+	uint32_t found_nonce;
+	uint32_t found_hash[8];
+	bool found;
+	int thr_id;
+} jane_cpu_job;
+
+static struct jane_cpu_pool_t {
+	pthread_mutex_t lock;
+	pthread_cond_t job_cond;
+	pthread_cond_t done_cond;
+	pthread_t *threads;
+	int workers;
+	int busy;         // workers still on the current job
+	uint32_t job_id;  // incremented on each new job
+	bool stop;
+	uint64_t hashes;
+	uint64_t mem_budget;
+	uint32_t max_lanes;
+	scrypt_ROMix_lanesfn romix_lanes;
+	jane_cpu_job job;
+} jane_pool;
+
+/* half of the physical memory, 0 if unknown */
+static uint64_t jane_cpu_mem_budget()
+{
+#if defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+	long pages = sysconf(_SC_PHYS_PAGES);
+	long psize = sysconf(_SC_PAGESIZE);
+	if (pages > 0 && psize > 0)
+		return ((uint64_t) pages * psize) / 2;
+#endif
+	return 0;
+}
+
+static void jane_cpu_affinity(int cpu)
+{
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(WIN32)
+	SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+#endif
+}
+
+/* hash lanes consecutive nonces, data has the job header */
+static int jane_cpu_hash(const jane_cpu_job *job, scrypt_jane_arena *arena, uint32_t first, uint32_t count,
+	scrypt_ROMix_1fn romix_1, uint32_t *found_nonce, uint32_t *found_hash)
+{
+	const uint32_t Htarg = job->target[7];
+	const int nonce_idx = job->header_size / 4 - 1;
+	uint32_t _ALIGN(64) tdata[21], thash[8];
+	uint8_t *X = arena->X[0].ptr;
+	int found = 0;
+
+	memcpy(tdata, job->data, job->header_size);
+	for (uint32_t l = 0; l < job->lanes; l++) {
+		// unused lanes of the last range are mixed with the last nonce
+		tdata[nonce_idx] = bswap_32x4(first + min(l, count - 1));
+		scrypt_pbkdf2_1((uchar*) tdata, job->header_size, (uchar*) tdata, job->header_size, X + 128 * l, 128);
+	}
 
-	scrypt_free(&V);
-	scrypt_free(&YX);
+	if (job->lanes > 1)
+		jane_pool.romix_lanes((scrypt_mix_word_t *) X, (scrypt_mix_word_t *) arena->V.ptr, job->N);
+	else
+		romix_1((scrypt_mix_word_t *) X, (scrypt_mix_word_t *) arena->Y.ptr, (scrypt_mix_word_t *) arena->V.ptr, job->N);
+
+	for (uint32_t l = 0; l < count; l++) {
+		tdata[nonce_idx] = bswap_32x4(first + l);
+		scrypt_pbkdf2_1((uchar*) tdata, job->header_size, X + 128 * l, 128, (uchar*) thash, 32);
+		if (thash[7] <= Htarg && fulltest(thash, job->target)) {
+			*found_nonce = first + l;
+			memcpy(found_hash, thash, 32);
+			found = 1;
+			break;
+		}
+	}
+	return found;
+}
+
+static void *jane_cpu_worker(void *arg)
+{
+	const int id = (int)(size_t) arg;
+	const uint64_t chunk_bytes = 2ULL * SCRYPT_BLOCK_BYTES * SCRYPT_R;
+	scrypt_ROMix_1fn romix_1 = scrypt_getROMix_1();
+	scrypt_jane_arena arena = { 0 };
+	jane_cpu_job job;
+	uint32_t seen = 0;
+
+	if (opt_affinity == -1L && num_cpus > 1) {
+		// from the last core, the first ones feed the gpus
+		jane_cpu_affinity((num_cpus - 1) - (id % num_cpus));
+	}
+
+	pthread_mutex_lock(&jane_pool.lock);
+	while (!jane_pool.stop) {
+		if (jane_pool.job_id == seen) {
+			pthread_cond_wait(&jane_pool.job_cond, &jane_pool.lock);
+			continue;
+		}
+		seen = jane_pool.job_id;
+		memcpy(&job, &jane_pool.job, sizeof(job));
+		pthread_mutex_unlock(&jane_pool.lock);
+
+		scrypt_realloc(&arena.V, (uint64_t) job.lanes * job.N * chunk_bytes, true);
+		scrypt_realloc(&arena.X[0], job.lanes * chunk_bytes, false);
+		scrypt_realloc(&arena.Y, (SCRYPT_P + 1) * chunk_bytes, false);
+
+		uint64_t hashes = 0;
+		for (;;) {
+			uint32_t first, count, nonce, hash[8];
+
+			pthread_mutex_lock(&jane_pool.lock);
+			if (jane_pool.stop || jane_pool.job.found || jane_pool.job.next_nonce > jane_pool.job.max_nonce
+				|| work_restart[job.thr_id].restart) {
+				pthread_mutex_unlock(&jane_pool.lock);
+				break;
+			}
+			first = (uint32_t) jane_pool.job.next_nonce;
+			count = (uint32_t) min((uint64_t) job.lanes, jane_pool.job.max_nonce + 1 - jane_pool.job.next_nonce);
+			jane_pool.job.next_nonce += count;
+			pthread_mutex_unlock(&jane_pool.lock);
+
+			hashes += count;
+			if (jane_cpu_hash(&job, &arena, first, count, romix_1, &nonce, hash)) {
+				pthread_mutex_lock(&jane_pool.lock);
+				if (!jane_pool.job.found) {
+					jane_pool.job.found = true;
+					jane_pool.job.found_nonce = nonce;
+					memcpy(jane_pool.job.found_hash, hash, 32);
+				}
+				pthread_mutex_unlock(&jane_pool.lock);
+			}
+		}
+
+		pthread_mutex_lock(&jane_pool.lock);
+		jane_pool.hashes += hashes;
+		if (--jane_pool.busy == 0)
+			pthread_cond_signal(&jane_pool.done_cond);
+	}
+	pthread_mutex_unlock(&jane_pool.lock);
+
+	scrypt_arena_free(&arena);
+	return NULL;
+}
+
+static bool jane_cpu_start(int thr_id, uint32_t N)
+{
+	const uint64_t vbytes = (uint64_t) N * 2ULL * SCRYPT_BLOCK_BYTES * SCRYPT_R;
+	int workers = opt_cpu_threads;
+
+	jane_pool.mem_budget = jane_cpu_mem_budget();
+	if (!workers) {
+		// the free cores, without more scratchpads than the memory allows
+		workers = max(1, num_cpus - (opt_n_threads - 1));
+		if (jane_pool.mem_budget && (uint64_t) workers * vbytes > jane_pool.mem_budget)
+			workers = (int) max((uint64_t) 1, jane_pool.mem_budget / vbytes);
+	}
+
+	jane_pool.romix_lanes = scrypt_getROMix_lanes(&jane_pool.max_lanes);
+	jane_pool.threads = (pthread_t*) calloc(workers, sizeof(pthread_t));
+	if (!jane_pool.threads)
+		return false;
+
+	pthread_mutex_init(&jane_pool.lock, NULL);
+	pthread_cond_init(&jane_pool.job_cond, NULL);
+	pthread_cond_init(&jane_pool.done_cond, NULL);
+	jane_pool.stop = false;
+	jane_pool.job_id = 0;
+
+	for (int i = 0; i < workers; i++) {
+		if (pthread_create(&jane_pool.threads[i], NULL, jane_cpu_worker, (void*)(size_t) i)) {
+			gpulog(LOG_ERR, thr_id, "scrypt-jane worker %d create failed", i);
+			break;
+		}
+		jane_pool.workers++;
+	}
+	if (!jane_pool.workers) {
+		free(jane_pool.threads);
+		jane_pool.threads = NULL;
+		return false;
+	}
+
+	gpulog(LOG_INFO, thr_id, "%d scrypt-jane workers, up to %u lanes per ROMix", jane_pool.workers, jane_pool.max_lanes);
+	return true;
+}
+
+static void jane_cpu_stop()
+{
+	if (!jane_pool.workers)
+		return;
+
+	pthread_mutex_lock(&jane_pool.lock);
+	jane_pool.stop = true;
+	pthread_cond_broadcast(&jane_pool.job_cond);
+	pthread_mutex_unlock(&jane_pool.lock);
+
+	for (int i = 0; i < jane_pool.workers; i++)
+		pthread_join(jane_pool.threads[i], NULL);
+
+	free(jane_pool.threads);
+	jane_pool.threads = NULL;
+	jane_pool.workers = 0;
+	pthread_cond_destroy(&jane_pool.done_cond);
+	pthread_cond_destroy(&jane_pool.job_cond);
+	pthread_mutex_destroy(&jane_pool.lock);
+}
+
+int scanhash_scrypt_jane_cpu(int thr_id, struct work *work, uint32_t max_nonce, unsigned long *hashes_done,
+	struct timeval *tv_start, struct timeval *tv_end, int block_version)
+{
+	uint32_t *pdata = work->data;
+	const uint64_t chunk_bytes = 2ULL * SCRYPT_BLOCK_BYTES * SCRYPT_R;
+	int header_size;
+	uint32_t N = scrypt_jane_params(pdata, block_version, &header_size);
+	const int nonce_idx = header_size / 4 - 1;
+	jane_cpu_job *job = &jane_pool.job;
+	int rc = 0;
+
+	if (!jane_pool.workers && !jane_cpu_start(thr_id, N))
+		return -1;
+
+	gettimeofday(tv_start, NULL);
+
+	pthread_mutex_lock(&jane_pool.lock);
+	memset(job, 0, sizeof(*job));
+	for (int z = 0; z < nonce_idx; z++)
+		job->data[z] = bswap_32x4(pdata[z]);
+	memcpy(job->target, work->target, sizeof(job->target));
+	job->header_size = header_size;
+	job->N = N;
+	job->lanes = 1;
+	if (jane_pool.max_lanes > 1 && jane_pool.mem_budget &&
+		(uint64_t) jane_pool.workers * jane_pool.max_lanes * N * chunk_bytes <= jane_pool.mem_budget)
+		job->lanes = jane_pool.max_lanes;
+	job->next_nonce = pdata[nonce_idx];
+	job->max_nonce = max_nonce;
+	job->thr_id = thr_id;
+
+	jane_pool.hashes = 0;
+	jane_pool.busy = jane_pool.workers;
+	jane_pool.job_id++;
+	pthread_cond_broadcast(&jane_pool.job_cond);
+
+	while (jane_pool.busy > 0)
+		pthread_cond_wait(&jane_pool.done_cond, &jane_pool.lock);
+
+	*hashes_done = (unsigned long) jane_pool.hashes;
+	if (job->found) {
+		work_set_target_ratio(work, job->found_hash);
+		pdata[nonce_idx] = job->found_nonce;
+		rc = 1;
+	} else {
+		pdata[nonce_idx] = (uint32_t) min(job->next_nonce, (uint64_t) UINT32_MAX);
+	}
+	pthread_mutex_unlock(&jane_pool.lock);
+
+	gettimeofday(tv_end, NULL);
+	return rc;
 }
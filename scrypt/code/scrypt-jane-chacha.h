@@ -13,24 +13,146 @@ typedef uint32_t scrypt_mix_word_t;
 /* must have these here in case block bytes is ever != 64 */
 #include "scrypt-jane-romix-basic.h"
 
+#include "scrypt-jane-mix_chacha-sse2.h"
 #include "scrypt-jane-mix_chacha.h"
 
+#if defined(SCRYPT_CHACHA_SSE2)
+	#define SCRYPT_CHUNKMIX_FN scrypt_ChunkMix_sse2
+	#define SCRYPT_CHUNKMIX_1_FN scrypt_ChunkMix_1_sse2
+	#define SCRYPT_CHUNKMIX_1_XOR_FN scrypt_ChunkMix_1_xor_sse2
+	#define SCRYPT_ROMIX_FN scrypt_ROMix_sse2
+	#define SCRYPT_ROMIX_1_FN scrypt_ROMix_1_sse2
+	#define SCRYPT_ROMIX_TANGLE_FN scrypt_romix_nop
+	#define SCRYPT_ROMIX_UNTANGLE_FN scrypt_romix_nop
+	#include "scrypt-jane-romix-template.h"
+#endif
+
 /* cpu agnostic */
 #define SCRYPT_ROMIX_FN scrypt_ROMix_basic
+#define SCRYPT_ROMIX_1_FN scrypt_ROMix_1_basic
 #define SCRYPT_MIX_FN chacha_core_basic
 #define SCRYPT_ROMIX_TANGLE_FN scrypt_romix_convert_endian
 #define SCRYPT_ROMIX_UNTANGLE_FN scrypt_romix_convert_endian
 #include "scrypt-jane-romix-template.h"
 
+#include "scrypt-jane-mix_chacha-lanes.h"
+
 #if !defined(SCRYPT_CHOOSE_COMPILETIME)
 static scrypt_ROMixfn
 scrypt_getROMix() {
 	size_t cpuflags = detect_cpu();
 
+#if defined(SCRYPT_CHACHA_SSE2)
+	if (cpuflags & cpu_sse2)
+		return scrypt_ROMix_sse2;
+	else
+#endif
+
 	return scrypt_ROMix_basic;
 }
 #endif
 
+/* function type of the r = 1 versions, used to verify single hashes */
+typedef void (FASTCALL *scrypt_ROMix_1fn)(scrypt_mix_word_t *X/*[chunkWords]*/, scrypt_mix_word_t *Y/*[chunkWords]*/, scrypt_mix_word_t *V/*[chunkWords * N]*/, uint32_t N);
+
+static scrypt_ROMix_1fn
+scrypt_getROMix_1() {
+	size_t cpuflags = detect_cpu();
+
+#if defined(SCRYPT_CHACHA_SSE2)
+	if (cpuflags & cpu_sse2)
+		return scrypt_ROMix_1_sse2;
+	else
+#endif
+
+	return scrypt_ROMix_1_basic;
+}
+
+/*
+	multi-buffer version, lanes chunks of X are mixed at once,
+	V must hold lanes scratchpads of N chunks, one after the other
+*/
+typedef void (*scrypt_ROMix_lanesfn)(scrypt_mix_word_t *X/*[lanes][chunkWords]*/, scrypt_mix_word_t *V/*[lanes][N][chunkWords]*/, uint32_t N);
+
+static void
+scrypt_ROMix_1_x1(scrypt_mix_word_t *X, scrypt_mix_word_t *V, uint32_t N) {
+	scrypt_mix_word_t MM16 Y[SCRYPT_BLOCK_WORDS * 2];
+	scrypt_ROMix_1fn scrypt_ROMix_1 = scrypt_getROMix_1();
+	scrypt_ROMix_1(X, Y, V, N);
+}
+
+static scrypt_ROMix_lanesfn
+scrypt_getROMix_lanes_impl(size_t cpuflags, uint32_t *lanes) {
+#if defined(SCRYPT_CHACHA_AVX512)
+	if (cpuflags & cpu_avx512) {
+		*lanes = 16;
+		return scrypt_ROMix_1_x16_avx512;
+	}
+#endif
+#if defined(SCRYPT_CHACHA_AVX2)
+	if (cpuflags & cpu_avx2) {
+		*lanes = 8;
+		return scrypt_ROMix_1_x8_avx2;
+	}
+#endif
+#if defined(SCRYPT_CHACHA_SSE2)
+	if (cpuflags & cpu_sse2) {
+		*lanes = 4;
+		return scrypt_ROMix_1_x4_sse2;
+	}
+#endif
+	*lanes = 1;
+	return scrypt_ROMix_1_x1;
+}
+
+/* compare a lanes implementation with the scalar ROMix, on small N */
+static int
+scrypt_test_romix_lanes(scrypt_ROMix_lanesfn fn, uint32_t lanes) {
+	const uint32_t N = 64, chunkWords = SCRYPT_BLOCK_WORDS * 2;
+	scrypt_mix_word_t MM16 Y[SCRYPT_BLOCK_WORDS * 2];
+	scrypt_mix_word_t *X, *Xref, *V;
+	uint32_t i;
+	int ret;
+
+	X = (scrypt_mix_word_t *)malloc(lanes * chunkWords * sizeof(scrypt_mix_word_t) * 2);
+	V = (scrypt_mix_word_t *)malloc((size_t)lanes * N * chunkWords * sizeof(scrypt_mix_word_t));
+	if (!X || !V) {
+		free(X); free(V);
+		return 0;
+	}
+	Xref = X + lanes * chunkWords;
+
+	for (i = 0; i < lanes * chunkWords; i++)
+		X[i] = Xref[i] = (scrypt_mix_word_t)(i * 0x9e3779b9u + 0x01234567u);
+
+	fn(X, V, N);
+	for (i = 0; i < lanes; i++)
+		scrypt_ROMix_1_basic(Xref + i * chunkWords, Y, V, N);
+
+	ret = scrypt_verify((uint8_t *)X, (uint8_t *)Xref, lanes * chunkWords * sizeof(scrypt_mix_word_t));
+	free(X);
+	free(V);
+	return ret;
+}
+
+/*
+	best multi-buffer ROMix for this cpu, the wide versions must give
+	the same results as the scalar one or they are skipped
+*/
+static scrypt_ROMix_lanesfn
+scrypt_getROMix_lanes(uint32_t *lanes) {
+	size_t cpuflags = detect_cpu();
+	scrypt_ROMix_lanesfn fn = scrypt_getROMix_lanes_impl(cpuflags, lanes);
+
+	while (*lanes > 1 && !scrypt_test_romix_lanes(fn, *lanes)) {
+		if (*lanes == 16) cpuflags &= ~(size_t)cpu_avx512;
+		else if (*lanes == 8) cpuflags &= ~(size_t)cpu_avx2;
+		else cpuflags &= ~(size_t)cpu_sse2;
+		fn = scrypt_getROMix_lanes_impl(cpuflags, lanes);
+	}
+	return fn;
+}
+
 
 #if defined(SCRYPT_TEST_SPEED)
 static size_t
@@ -38,6 +160,19 @@ available_implementations() {
 	size_t cpuflags = detect_cpu();
 	size_t flags = 0;
 
+#if defined(SCRYPT_CHACHA_SSE2)
+	if (cpuflags & cpu_sse2)
+		flags |= cpu_sse2;
+#endif
+#if defined(SCRYPT_CHACHA_AVX2)
+	if (cpuflags & cpu_avx2)
+		flags |= cpu_avx2;
+#endif
+#if defined(SCRYPT_CHACHA_AVX512)
+	if (cpuflags & cpu_avx512)
+		flags |= cpu_avx512;
+#endif
+
 	return flags;
 }
 #endif
@@ -51,10 +186,14 @@ scrypt_test_mix() {
 	int ret = 1;
 	size_t cpuflags = detect_cpu();
 
+#if defined(SCRYPT_CHACHA_SSE2)
+	if (cpuflags & cpu_sse2)
+		ret &= scrypt_test_mix_instance(scrypt_ChunkMix_sse2, scrypt_romix_nop, scrypt_romix_nop, expected);
+#endif
+
 #if defined(SCRYPT_CHACHA_BASIC)
 	ret &= scrypt_test_mix_instance(scrypt_ChunkMix_basic, scrypt_romix_convert_endian, scrypt_romix_convert_endian, expected);
 #endif
 
 	return ret;
 }
-
@@ -0,0 +1,48 @@
+/* x86 multi-buffer chacha ROMix: 4 (sse2), 8 (avx2) or 16 (avx-512) chunks at once */
+#if defined(X86_INTRINSIC) && !defined(SCRYPT_CHACHA_LANES_INCLUDED)
+
+#define SCRYPT_CHACHA_LANES_INCLUDED
+
+#if defined(SCRYPT_CHACHA_SSE2)
+#define SCRYPT_LANES 4
+#define SCRYPT_LANES_TARGET SCRYPT_TARGET("sse2")
+#define SCRYPT_ROMIX_LANES_FN scrypt_ROMix_1_x4_sse2
+#define SCRYPT_CHACHA_LANES_FN chacha_core_x4_sse2
+#define lane_t __m128i
+#define lane_add(a, b) _mm_add_epi32(a, b)
+#define lane_xor(a, b) _mm_xor_si128(a, b)
+#define lane_rotl(a, n) _mm_or_si128(_mm_slli_epi32(a, n), _mm_srli_epi32(a, 32 - (n)))
+#define lane_load(p) _mm_loadu_si128((const __m128i *)(p))
+#define lane_store(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#include "scrypt-jane-romix-lanes-template.h"
+#endif
+
+#if defined(SCRYPT_CHACHA_AVX2)
+#define SCRYPT_LANES 8
+#define SCRYPT_LANES_TARGET SCRYPT_TARGET("avx2")
+#define SCRYPT_ROMIX_LANES_FN scrypt_ROMix_1_x8_avx2
+#define SCRYPT_CHACHA_LANES_FN chacha_core_x8_avx2
+#define lane_t __m256i
+#define lane_add(a, b) _mm256_add_epi32(a, b)
+#define lane_xor(a, b) _mm256_xor_si256(a, b)
+#define lane_rotl(a, n) _mm256_or_si256(_mm256_slli_epi32(a, n), _mm256_srli_epi32(a, 32 - (n)))
+#define lane_load(p) _mm256_loadu_si256((const __m256i *)(p))
+#define lane_store(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#include "scrypt-jane-romix-lanes-template.h"
+#endif
+
+#if defined(SCRYPT_CHACHA_AVX512)
+#define SCRYPT_LANES 16
+#define SCRYPT_LANES_TARGET SCRYPT_TARGET("avx512f")
+#define SCRYPT_ROMIX_LANES_FN scrypt_ROMix_1_x16_avx512
+#define SCRYPT_CHACHA_LANES_FN chacha_core_x16_avx512
+#define lane_t __m512i
+#define lane_add(a, b) _mm512_add_epi32(a, b)
+#define lane_xor(a, b) _mm512_xor_si512(a, b)
+#define lane_rotl(a, n) _mm512_or_si512(_mm512_slli_epi32(a, n), _mm512_srli_epi32(a, 32 - (n)))
+#define lane_load(p) _mm512_loadu_si512((const void *)(p))
+#define lane_store(p, v) _mm512_storeu_si512((void *)(p), v)
+#include "scrypt-jane-romix-lanes-template.h"
+#endif
+
+#endif /* X86_INTRINSIC */
@@ -0,0 +1,131 @@
+/* x86 */
+#if defined(X86_INTRINSIC) && defined(SCRYPT_CHACHA_SSE2) && !defined(SCRYPT_CHACHA_SSE2_INCLUDED)
+
+#define SCRYPT_CHACHA_SSE2_INCLUDED
+
+#undef SCRYPT_MIX
+#define SCRYPT_MIX "ChaCha/8-SSE2"
+
+typedef __m128i xmmi;
+
+/* the block is kept in rows: x0 = words 0..3, x1 = 4..7, x2 = 8..11, x3 = 12..15 */
+
+#define xmm_rotl32(x, n) _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - (n)))
+
+#define chacha_quarter_sse2(a, b, c, d) \
+	a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = xmm_rotl32(d, 16); \
+	c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = xmm_rotl32(b, 12); \
+	a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = xmm_rotl32(d,  8); \
+	c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = xmm_rotl32(b,  7);
+
+/* 8 rounds: column round, then diagonal round on the rotated rows */
+#define chacha_core_sse2(x0, x1, x2, x3) { \
+	xmmi t0 = x0, t1 = x1, t2 = x2, t3 = x3; \
+	size_t rounds; \
+	for (rounds = 8; rounds; rounds -= 2) { \
+		chacha_quarter_sse2(x0, x1, x2, x3) \
+		x1 = _mm_shuffle_epi32(x1, 0x39); \
+		x2 = _mm_shuffle_epi32(x2, 0x4e); \
+		x3 = _mm_shuffle_epi32(x3, 0x93); \
+		chacha_quarter_sse2(x0, x1, x2, x3) \
+		x1 = _mm_shuffle_epi32(x1, 0x93); \
+		x2 = _mm_shuffle_epi32(x2, 0x4e); \
+		x3 = _mm_shuffle_epi32(x3, 0x39); \
+	} \
+	x0 = _mm_add_epi32(x0, t0); \
+	x1 = _mm_add_epi32(x1, t1); \
+	x2 = _mm_add_epi32(x2, t2); \
+	x3 = _mm_add_epi32(x3, t3); \
+}
+
+#define xmm_load_block(p, x0, x1, x2, x3) \
+	x0 = _mm_loadu_si128((p) + 0); x1 = _mm_loadu_si128((p) + 1); \
+	x2 = _mm_loadu_si128((p) + 2); x3 = _mm_loadu_si128((p) + 3);
+
+#define xmm_xor_block(p, x0, x1, x2, x3) \
+	x0 = _mm_xor_si128(x0, _mm_loadu_si128((p) + 0)); x1 = _mm_xor_si128(x1, _mm_loadu_si128((p) + 1)); \
+	x2 = _mm_xor_si128(x2, _mm_loadu_si128((p) + 2)); x3 = _mm_xor_si128(x3, _mm_loadu_si128((p) + 3));
+
+#define xmm_store_block(p, x0, x1, x2, x3) \
+	_mm_storeu_si128((p) + 0, x0); _mm_storeu_si128((p) + 1, x1); \
+	_mm_storeu_si128((p) + 2, x2); _mm_storeu_si128((p) + 3, x3);
+
+/*
+	Bout = ChunkMix(Bin)
+
+	2*r: number of blocks in the chunk
+*/
+static void asm_calling_convention SCRYPT_TARGET("sse2")
+scrypt_ChunkMix_sse2(uint32_t *Bout/*[chunkWords]*/, uint32_t *Bin/*[chunkWords]*/, uint32_t *Bxor/*[chunkWords]*/, uint32_t r) {
+	uint32_t i, blocksPerChunk = r * 2, half = 0;
+	xmmi *xmmp, x0, x1, x2, x3;
+
+	/* 1: X = B_{2r - 1} */
+	xmmp = (xmmi *)scrypt_block(Bin, blocksPerChunk - 1);
+	xmm_load_block(xmmp, x0, x1, x2, x3)
+
+	if (Bxor) {
+		xmmp = (xmmi *)scrypt_block(Bxor, blocksPerChunk - 1);
+		xmm_xor_block(xmmp, x0, x1, x2, x3)
+	}
+
+	/* 2: for i = 0 to 2r - 1 do */
+	for (i = 0; i < blocksPerChunk; i++, half ^= r) {
+		/* 3: X = H(X ^ B_i) */
+		xmmp = (xmmi *)scrypt_block(Bin, i);
+		xmm_xor_block(xmmp, x0, x1, x2, x3)
+
+		if (Bxor) {
+			xmmp = (xmmi *)scrypt_block(Bxor, i);
+			xmm_xor_block(xmmp, x0, x1, x2, x3)
+		}
+
+		chacha_core_sse2(x0, x1, x2, x3)
+
+		/* 4: Y_i = X */
+		/* 6: B'[0..r-1] = Y_even */
+		/* 6: B'[r..2r-1] = Y_odd */
+		xmmp = (xmmi *)scrypt_block(Bout, (i / 2) + half);
+		xmm_store_block(xmmp, x0, x1, x2, x3)
+	}
+}
+
+/* r = 1: Y_0 goes to B'_0, Y_1 to B'_1 */
+static void asm_calling_convention SCRYPT_TARGET("sse2")
+scrypt_ChunkMix_1_sse2(uint32_t *Bout/*[chunkWords]*/, uint32_t *Bin/*[chunkWords]*/) {
+	xmmi *in = (xmmi *)Bin, *out = (xmmi *)Bout, x0, x1, x2, x3;
+
+	xmm_load_block(in + 4, x0, x1, x2, x3)
+
+	xmm_xor_block(in, x0, x1, x2, x3)
+	chacha_core_sse2(x0, x1, x2, x3)
+	xmm_store_block(out, x0, x1, x2, x3)
+
+	xmm_xor_block(in + 4, x0, x1, x2, x3)
+	chacha_core_sse2(x0, x1, x2, x3)
+	xmm_store_block(out + 4, x0, x1, x2, x3)
+}
+
+static void asm_calling_convention SCRYPT_TARGET("sse2")
+scrypt_ChunkMix_1_xor_sse2(uint32_t *Bout/*[chunkWords]*/, uint32_t *Bin/*[chunkWords]*/, uint32_t *Bxor/*[chunkWords]*/) {
+	xmmi *in = (xmmi *)Bin, *out = (xmmi *)Bout, *xp = (xmmi *)Bxor, x0, x1, x2, x3;
+
+	xmm_load_block(in + 4, x0, x1, x2, x3)
+	xmm_xor_block(xp + 4, x0, x1, x2, x3)
+
+	xmm_xor_block(in, x0, x1, x2, x3)
+	xmm_xor_block(xp, x0, x1, x2, x3)
+	chacha_core_sse2(x0, x1, x2, x3)
+	xmm_store_block(out, x0, x1, x2, x3)
+
+	xmm_xor_block(in + 4, x0, x1, x2, x3)
+	xmm_xor_block(xp + 4, x0, x1, x2, x3)
+	chacha_core_sse2(x0, x1, x2, x3)
+	xmm_store_block(out + 4, x0, x1, x2, x3)
+}
+
+#undef xmm_load_block
+#undef xmm_xor_block
+#undef xmm_store_block
+
+#endif /* SCRYPT_CHACHA_SSE2 */
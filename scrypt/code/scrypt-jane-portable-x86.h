@@ -1,5 +1,37 @@
+#if defined(CPU_X86) || defined(CPU_X86_64)
+	#define X86_INTRINSIC
+	#if defined(COMPILER_MSVC)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+	#include <immintrin.h>
+#endif
+
+/* allow simd code in a generic build, the code paths are selected at runtime */
+#if defined(COMPILER_GCC) && !defined(COMPILER_INTEL)
+	#define SCRYPT_TARGET(x) __attribute__((target(x)))
+#else
+	#define SCRYPT_TARGET(x)
+#endif
 
-typedef enum cpu_flags_x86_t { }cpu_flags_x86;
+#if defined(X86_INTRINSIC)
+	#define SCRYPT_CHACHA_SSE2
+	#if defined(COMPILER_MSVC) || (COMPILER_GCC >= 40900) || defined(__clang__)
+		#define SCRYPT_CHACHA_AVX2
+	#endif
+	#if (defined(COMPILER_MSVC) && (COMPILER_MSVC >= 1910)) || (COMPILER_GCC >= 50000) || defined(__clang__)
+		#define SCRYPT_CHACHA_AVX512
+	#endif
+#endif
+
+typedef enum cpu_flags_x86_t {
+	cpu_sse2 = 1 << 0,
+	cpu_ssse3 = 1 << 1,
+	cpu_avx = 1 << 2,
+	cpu_avx2 = 1 << 3,
+	cpu_avx512 = 1 << 4
+} cpu_flags_x86;
 
 typedef enum cpu_vendors_x86_t {
 	cpu_nobody,
@@ -16,15 +48,82 @@ typedef struct x86_regs_t {
 size_t cpu_detect_mask = (size_t)-1;
 #endif
 
+#if defined(X86_INTRINSIC)
+static void
+get_cpuid(x86_regs *regs, uint32_t flags, uint32_t subleaf) {
+#if defined(COMPILER_MSVC)
+	int r[4];
+	__cpuidex(r, (int)flags, (int)subleaf);
+	regs->eax = (uint32_t)r[0];
+	regs->ebx = (uint32_t)r[1];
+	regs->ecx = (uint32_t)r[2];
+	regs->edx = (uint32_t)r[3];
+#else
+	__cpuid_count(flags, subleaf, regs->eax, regs->ebx, regs->ecx, regs->edx);
+#endif
+}
+
+/* register state enabled by the os (XCR0) */
+static uint64_t
+get_xgetbv(uint32_t flags) {
+#if defined(COMPILER_MSVC)
+	return _xgetbv(flags);
+#else
+	uint32_t lo, hi;
+	__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(lo), "=d"(hi) : "c"(flags));
+	return ((uint64_t)hi << 32) | lo;
+#endif
+}
+#endif
+
 static size_t
 detect_cpu(void) {
 	size_t cpu_flags = 0;
+#if defined(X86_INTRINSIC)
+	static size_t cached = (size_t)-1;
+	x86_regs regs;
+	uint32_t max_level;
+	uint64_t xcr0 = 0;
+
+	if (cached != (size_t)-1)
+		return cached;
+
+	get_cpuid(&regs, 0, 0);
+	max_level = regs.eax;
+
+	get_cpuid(&regs, 1, 0);
+	if (regs.edx & (1 << 26)) cpu_flags |= cpu_sse2;
+	if (regs.ecx & (1 << 9)) cpu_flags |= cpu_ssse3;
+
+	/* osxsave + avx */
+	if ((regs.ecx & (1 << 27)) && (regs.ecx & (1 << 28))) {
+		xcr0 = get_xgetbv(0);
+		if ((xcr0 & 0x06) == 0x06)
+			cpu_flags |= cpu_avx;
+	}
+
+	if (max_level >= 7 && (cpu_flags & cpu_avx)) {
+		get_cpuid(&regs, 7, 0);
+		if (regs.ebx & (1 << 5)) cpu_flags |= cpu_avx2;
+		/* avx512f with opmask and zmm state enabled */
+		if ((regs.ebx & (1 << 16)) && (xcr0 & 0xe6) == 0xe6)
+			cpu_flags |= cpu_avx512;
+	}
+
+#if defined(SCRYPT_TEST_SPEED)
+	cpu_flags &= cpu_detect_mask;
+#endif
+	cached = cpu_flags;
+#endif
 	return cpu_flags;
 }
 
 #if defined(SCRYPT_TEST_SPEED)
 static const char *
 get_top_cpuflag_desc(size_t flag) {
+	if (flag & cpu_avx512) return "AVX-512";
+	else if (flag & cpu_avx2) return "AVX2";
+	else if (flag & cpu_sse2) return "SSE2";
 	return "Basic";
 }
 #endif
@@ -280,5 +280,6 @@ scrypt_ensure_zero(void *p, size_t len) {
 #endif
 }
 
+#include "scrypt-conf.h"
 #include "scrypt-jane-portable-x86.h"
 
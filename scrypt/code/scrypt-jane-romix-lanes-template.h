@@ -0,0 +1,131 @@
+/*
+	Multi-buffer ROMix with r = 1, SCRYPT_LANES independent chunks
+
+	The chunks are mixed in lockstep, word w of every lane in the same
+	vector register. V stays lane-major (one scratchpad per lane) so
+	the random reads of a lane only touch its own 128 bytes chunk.
+
+	required macros:
+	SCRYPT_LANES            number of lanes in lane_t
+	SCRYPT_LANES_TARGET     function attribute for the instruction set
+	SCRYPT_ROMIX_LANES_FN   name of the generated ROMix
+	SCRYPT_CHACHA_LANES_FN  name of the generated chacha core
+	lane_t, lane_add, lane_xor, lane_rotl, lane_load, lane_store
+*/
+
+static inline void SCRYPT_LANES_TARGET
+SCRYPT_CHACHA_LANES_FN(lane_t *B/*[16]*/) {
+	lane_t x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
+	size_t rounds;
+
+	x0 = B[0]; x1 = B[1]; x2 = B[2]; x3 = B[3];
+	x4 = B[4]; x5 = B[5]; x6 = B[6]; x7 = B[7];
+	x8 = B[8]; x9 = B[9]; x10 = B[10]; x11 = B[11];
+	x12 = B[12]; x13 = B[13]; x14 = B[14]; x15 = B[15];
+
+	#define quarter(a,b,c,d) \
+		a = lane_add(a, b); d = lane_rotl(lane_xor(d, a), 16); \
+		c = lane_add(c, d); b = lane_rotl(lane_xor(b, c), 12); \
+		a = lane_add(a, b); d = lane_rotl(lane_xor(d, a),  8); \
+		c = lane_add(c, d); b = lane_rotl(lane_xor(b, c),  7);
+
+	for (rounds = 8; rounds; rounds -= 2) {
+		quarter( x0, x4, x8,x12)
+		quarter( x1, x5, x9,x13)
+		quarter( x2, x6,x10,x14)
+		quarter( x3, x7,x11,x15)
+		quarter( x0, x5,x10,x15)
+		quarter( x1, x6,x11,x12)
+		quarter( x2, x7, x8,x13)
+		quarter( x3, x4, x9,x14)
+	}
+
+	#undef quarter
+
+	B[0] = lane_add(B[0], x0); B[1] = lane_add(B[1], x1);
+	B[2] = lane_add(B[2], x2); B[3] = lane_add(B[3], x3);
+	B[4] = lane_add(B[4], x4); B[5] = lane_add(B[5], x5);
+	B[6] = lane_add(B[6], x6); B[7] = lane_add(B[7], x7);
+	B[8] = lane_add(B[8], x8); B[9] = lane_add(B[9], x9);
+	B[10] = lane_add(B[10], x10); B[11] = lane_add(B[11], x11);
+	B[12] = lane_add(B[12], x12); B[13] = lane_add(B[13], x13);
+	B[14] = lane_add(B[14], x14); B[15] = lane_add(B[15], x15);
+}
+
+static void NOINLINE SCRYPT_LANES_TARGET
+SCRYPT_ROMIX_LANES_FN(scrypt_mix_word_t *X/*[lanes][chunkWords]*/, scrypt_mix_word_t *V/*[lanes][N][chunkWords]*/, uint32_t N) {
+	const uint32_t chunkWords = SCRYPT_BLOCK_WORDS * 2;
+	const size_t laneWords = (size_t)N * chunkWords;
+	scrypt_mix_word_t stage[SCRYPT_BLOCK_WORDS * 2 * SCRYPT_LANES];
+	scrypt_mix_word_t integer[SCRYPT_LANES];
+	lane_t B[SCRYPT_BLOCK_WORDS * 2];
+	uint32_t i, j, l, w;
+
+	/* 1: X = B (lanes to columns) */
+	for (l = 0; l < SCRYPT_LANES; l++)
+		for (w = 0; w < chunkWords; w++)
+			stage[w * SCRYPT_LANES + l] = X[l * chunkWords + w];
+	for (w = 0; w < chunkWords; w++)
+		B[w] = lane_load(&stage[w * SCRYPT_LANES]);
+
+	/* 2: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i++) {
+		/* 3: V_i = X */
+		for (w = 0; w < chunkWords; w++)
+			lane_store(&stage[w * SCRYPT_LANES], B[w]);
+		for (l = 0; l < SCRYPT_LANES; l++) {
+			scrypt_mix_word_t *v = V + l * laneWords + (size_t)i * chunkWords;
+			for (w = 0; w < chunkWords; w++)
+				v[w] = stage[w * SCRYPT_LANES + l];
+		}
+
+		/* 4: X = H(X), in place: B_0 = H(B_0 ^ B_1), B_1 = H(B_1 ^ B_0) */
+		for (w = 0; w < SCRYPT_BLOCK_WORDS; w++)
+			B[w] = lane_xor(B[w], B[SCRYPT_BLOCK_WORDS + w]);
+		SCRYPT_CHACHA_LANES_FN(B);
+		for (w = 0; w < SCRYPT_BLOCK_WORDS; w++)
+			B[SCRYPT_BLOCK_WORDS + w] = lane_xor(B[SCRYPT_BLOCK_WORDS + w], B[w]);
+		SCRYPT_CHACHA_LANES_FN(B + SCRYPT_BLOCK_WORDS);
+	}
+
+	/* 6: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i++) {
+		/* 7: j = Integerify(X) % N */
+		lane_store(integer, B[SCRYPT_BLOCK_WORDS]);
+		for (l = 0; l < SCRYPT_LANES; l++) {
+			const scrypt_mix_word_t *v;
+			j = integer[l] & (N - 1);
+			v = V + l * laneWords + (size_t)j * chunkWords;
+			for (w = 0; w < chunkWords; w++)
+				stage[w * SCRYPT_LANES + l] = v[w];
+		}
+
+		/* 8: X = H(X ^ V_j) */
+		for (w = 0; w < chunkWords; w++)
+			B[w] = lane_xor(B[w], lane_load(&stage[w * SCRYPT_LANES]));
+		for (w = 0; w < SCRYPT_BLOCK_WORDS; w++)
+			B[w] = lane_xor(B[w], B[SCRYPT_BLOCK_WORDS + w]);
+		SCRYPT_CHACHA_LANES_FN(B);
+		for (w = 0; w < SCRYPT_BLOCK_WORDS; w++)
+			B[SCRYPT_BLOCK_WORDS + w] = lane_xor(B[SCRYPT_BLOCK_WORDS + w], B[w]);
+		SCRYPT_CHACHA_LANES_FN(B + SCRYPT_BLOCK_WORDS);
+	}
+
+	/* 10: B' = X (columns to lanes) */
+	for (w = 0; w < chunkWords; w++)
+		lane_store(&stage[w * SCRYPT_LANES], B[w]);
+	for (l = 0; l < SCRYPT_LANES; l++)
+		for (w = 0; w < chunkWords; w++)
+			X[l * chunkWords + w] = stage[w * SCRYPT_LANES + l];
+}
+
+#undef SCRYPT_LANES
+#undef SCRYPT_LANES_TARGET
+#undef SCRYPT_ROMIX_LANES_FN
+#undef SCRYPT_CHACHA_LANES_FN
+#undef lane_t
+#undef lane_add
+#undef lane_xor
+#undef lane_rotl
+#undef lane_load
+#undef lane_store
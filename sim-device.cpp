@@ -0,0 +1,192 @@
+/**
+ * Virtual devices (--sim-devices)
+ *
+ * Each miner thread drives a fake gpu which "hashes" at --sim-rate, in
+ * batches of about SIM_BATCH_MS like a kernel launch, and finds the
+ * candidate nonces with the probability of the work target (or with
+ * --sim-share-prob). With --sim-verify the candidates are checked with
+ * the algo cpu hash, like the scanhash functions do (or queued to the
+ * --verify-threads), else they are sent as found. No cuda or nvml call
+ * is made, so the whole host side of the miner (scan ranges, stats,
+ * hashlog, submits, restarts) can be profiled with up to MAX_GPUS
+ * devices on hosts without gpu.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "miner.h"
+#include "algos.h"
+
+int opt_sim_devices = 0;
+double opt_sim_rate = 100e6; /* H/s per device */
+double opt_sim_share_prob = 0.;
+bool opt_sim_verify = false;
+
+#define SIM_BATCH_MS 10
+
+struct sim_device {
+	uint64_t rng;
+	double next_share; /* hashes before the next candidate */
+};
+
+static struct sim_device sim_dev[MAX_GPUS];
+static cpu_hash_fn sim_verify_hash = NULL;
+
+static uint64_t sim_usecs()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// xorshift64*, a state per device
+static double sim_uniform(struct sim_device *dev)
+{
+	dev->rng ^= dev->rng >> 12;
+	dev->rng ^= dev->rng << 25;
+	dev->rng ^= dev->rng >> 27;
+	return ((dev->rng * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// hashes before a candidate, exponential law of the share probability
+static double sim_draw_share(struct sim_device *dev, double prob)
+{
+	double u = sim_uniform(dev);
+	if (prob >= 1.)
+		return 0.;
+	return -log(1. - u) / prob;
+}
+
+static double sim_share_prob(const uint32_t *target)
+{
+	double prob = opt_sim_share_prob;
+	if (prob <= 0.)
+		prob = ((double) target[7] * 4294967296.0 + target[6] + 1.) / 18446744073709551616.0;
+	return min(prob, 1.);
+}
+
+/* replace the cuda devices by the virtual ones, after the options parsing */
+bool sim_devices_init(void)
+{
+	if (opt_sim_verify) {
+		sim_verify_hash = algo_cpu_hash(opt_algo);
+		if (!sim_verify_hash) {
+			applog(LOG_ERR, "--sim-verify is not available with the %s algo", algo_names[opt_algo]);
+			return false;
+		}
+	}
+
+	opt_n_threads = opt_sim_devices;
+	for (int n = 0; n < opt_sim_devices; n++) {
+		device_type[n] = DEVICE_TYPE_SIM;
+		device_map[n] = n;
+		free(device_name[n]);
+		device_name[n] = strdup("virtual device");
+		sim_dev[n].rng = 0x9E3779B97F4A7C15ULL * (n + 1) ^ sim_usecs();
+		sim_dev[n].next_share = -1.;
+	}
+
+	if (!opt_quiet) {
+		char rate[32];
+		format_hashrate(opt_sim_rate, rate);
+		applog(LOG_INFO, "%d virtual devices at %s%s", opt_sim_devices, rate,
+			opt_sim_verify ? ", cpu verified nonces" : "");
+	}
+	return true;
+}
+
+// the cursor resumes after the nonce, false at the end of the range
+static bool sim_next_nonce(uint32_t *pdata, uint32_t nonce, uint32_t max_nonce)
+{
+	if (nonce >= max_nonce) {
+		pdata[19] = max_nonce;
+		return false;
+	}
+	pdata[19] = nonce + 1;
+	return true;
+}
+
+int scanhash_sim(int thr_id, struct work *work, uint32_t max_nonce, unsigned long *hashes_done)
+{
+	struct sim_device *dev = &sim_dev[thr_id];
+	uint32_t *pdata = work->data;
+	uint32_t *ptarget = work->target;
+	const uint32_t first_nonce = pdata[19];
+	const double batch = max(1., opt_sim_rate * SIM_BATCH_MS / 1000.);
+	const uint64_t start = sim_usecs();
+	uint32_t _ALIGN(64) endiandata[20];
+
+	if (opt_benchmark)
+		ptarget[7] = 0x5;
+
+	const double prob = sim_share_prob(ptarget);
+
+	if (sim_verify_hash) {
+		for (int k = 0; k < 20; k++)
+			be32enc(&endiandata[k], pdata[k]);
+	}
+	if (dev->next_share < 0.)
+		dev->next_share = sim_draw_share(dev, prob);
+
+	do {
+		uint32_t throughput = (uint32_t) min(batch, (double) (max_nonce - pdata[19]) + 1.);
+		uint64_t done = (uint64_t) pdata[19] - first_nonce + throughput;
+		int64_t wait = (int64_t) (start + 1e6 * done / opt_sim_rate) - (int64_t) sim_usecs();
+
+		// the batch "kernel" time
+		if (wait > 0)
+			usleep((useconds_t) wait);
+
+		// like a kernel, the whole batch was hashed, the cursor resumes after the nonce
+		*hashes_done = (unsigned long) done;
+
+		if (dev->next_share < throughput) {
+			uint32_t nonce = pdata[19] + (uint32_t) dev->next_share;
+			uint32_t _ALIGN(64) vhash[8];
+
+			dev->next_share = sim_draw_share(dev, prob);
+			work->nonces[0] = nonce;
+			if (!sim_verify_hash) {
+				work->valid_nonces = 1;
+				work->sharediff[work->submit_nonce_id] = work->targetdiff;
+				work->shareratio[work->submit_nonce_id] = 1.;
+				sim_next_nonce(pdata, nonce, max_nonce);
+				return 1;
+			}
+			if (verify_nonce_async(thr_id, work, nonce)) {
+				if (!sim_next_nonce(pdata, nonce, max_nonce))
+					break;
+				continue;
+			}
+			be32enc(&endiandata[19], nonce);
+			sim_verify_hash(vhash, endiandata);
+			if (fulltest(vhash, ptarget)) {
+				work->valid_nonces = 1;
+				work_set_target_ratio(work, vhash);
+				sim_next_nonce(pdata, nonce, max_nonce);
+				return 1;
+			}
+			gpu_increment_reject(thr_id);
+			if (!opt_quiet)
+				gpulog(LOG_WARNING, thr_id, "result for %08x does not validate on CPU!", nonce);
+			if (!sim_next_nonce(pdata, nonce, max_nonce))
+				break;
+			continue;
+		}
+		dev->next_share -= throughput;
+
+		if ((uint64_t) throughput + pdata[19] >= max_nonce) {
+			pdata[19] = max_nonce;
+			break;
+		}
+		pdata[19] += throughput;
+
+	} while (!work_restart[thr_id].restart);
+
+	*hashes_done = pdata[19] - first_nonce;
+	return 0;
+}
@@ -0,0 +1,672 @@
+/**
+ * Local stratum pool simulator (--sim-pool)
+ *
+ * A stratum server on a 127.0.0.1 ephemeral port, used as the pool url.
+ * It answers mining.subscribe/authorize/submit, sends set_difficulty and
+ * a new job every --sim-pool ms (a new block each 4 jobs) with the
+ * --sim-pool-branches merkle branches of a real block. The shares are
+ * checked like a pool does, with the algo cpu hash of the header rebuilt
+ * from the job, and the notify to first hash and submit to answer
+ * latencies are reported at exit. So the stratum thread, the job switch
+ * and the submit path can be timed without network or pool.
+ */
+
+#include <ccminer-config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <set>
+#include <jansson.h>
+#include <openssl/sha.h>
+
+#ifdef WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define sim_socket SOCKET
+#define SIM_INVSOCK INVALID_SOCKET
+#define sim_close closesocket
+#else
+#include <errno.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#define sim_socket int
+#define SIM_INVSOCK -1
+#define sim_close close
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#include "miner.h"
+#include "algos.h"
+
+bool opt_sim_pool = false;
+int opt_sim_pool_interval = 10000; /* ms */
+int opt_sim_pool_branches = 12;
+double opt_sim_pool_diff = 1.;
+
+extern char *rpc_url;
+extern char *rpc_user;
+extern volatile bool abort_flag;
+
+#define SIM_JOBS         8    /* jobs kept to check the late shares */
+#define SIM_BLOCK_JOBS   4    /* jobs per block */
+#define SIM_MAX_BRANCHES 32
+#define SIM_XNONCE2_SIZE 4
+#define SIM_LATENCIES    4096 /* last samples kept for the percentiles */
+#define SIM_BUF_SIZE     16384
+
+struct sim_job {
+	uint32_t id;
+	uint32_t height;
+	bool clean;
+	double diff;
+	uchar prevhash[32];
+	uchar version[4];
+	uchar nbits[4];
+	uchar ntime[4];
+	uchar coinb1[64];
+	int coinb1_len;
+	uchar coinb2[64];
+	int coinb2_len;
+	uchar merkle[SIM_MAX_BRANCHES][32];
+	int merkle_count;
+	uint64_t tm_notify;
+	bool hashed;
+	std::set<uint64_t> shares; /* xnonce2 << 32 | nonce */
+};
+
+struct sim_latency {
+	uint32_t usecs[SIM_LATENCIES];
+	uint32_t count;
+};
+
+enum sim_reject {
+	SIM_ACCEPTED = 0,
+	SIM_INVALID,
+	SIM_STALE,
+	SIM_DUPLICATE,
+	SIM_LOW_DIFF,
+	SIM_REJECT_COUNT
+};
+
+static const char *sim_reject_reasons[SIM_REJECT_COUNT] = {
+	"accepted", "invalid", "stale", "duplicate", "low diff"
+};
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t sim_thread;
+static sim_socket sim_listen = SIM_INVSOCK;
+static cpu_hash_fn sim_hash = NULL;
+static bool sim_started = false;
+
+// jobs are written by the server thread only, under sim_lock
+static struct sim_job sim_jobs[SIM_JOBS];
+static uint32_t sim_job_id = 0;
+static uint32_t sim_height = 0;
+static uchar sim_xnonce1[4];
+
+static struct sim_latency sim_lat_notify; /* notify to first hash */
+static struct sim_latency sim_lat_answer; /* submit to answer (miner side) */
+static struct sim_latency sim_lat_check;  /* share check */
+static uint32_t sim_shares[SIM_REJECT_COUNT];
+static uint32_t sim_jobs_sent = 0;
+static uint32_t sim_connections = 0;
+
+static uint64_t sim_usecs()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void sim_latency_add(struct sim_latency *lat, uint32_t usecs)
+{
+	lat->usecs[lat->count % SIM_LATENCIES] = usecs;
+	lat->count++;
+}
+
+static int sim_cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+	return (x > y) - (x < y);
+}
+
+// sim_lock held
+static void sim_latency_log(const char *name, struct sim_latency *lat)
+{
+	uint32_t n = min(lat->count, (uint32_t) SIM_LATENCIES);
+	uint32_t *v;
+
+	if (!n) {
+		applog(LOG_INFO, "sim-pool %s: no samples", name);
+		return;
+	}
+	v = (uint32_t*) malloc(n * sizeof(uint32_t));
+	memcpy(v, lat->usecs, n * sizeof(uint32_t));
+	qsort(v, n, sizeof(uint32_t), sim_cmp_u32);
+	applog(LOG_INFO, "sim-pool %s: %u samples, median %.3f ms, p99 %.3f ms, max %.3f ms",
+		name, lat->count, 0.001 * v[n / 2], 0.001 * v[(n * 99) / 100], 0.001 * v[n - 1]);
+	free(v);
+}
+
+/* coinbase with a BIP34 height, parsed by the miner to show the block */
+static void sim_build_coinbase(struct sim_job *job)
+{
+	static const char tag[] = "/ccminer-sim/";
+	const int taglen = (int) sizeof(tag) - 1;
+	uchar *p = job->coinb1;
+
+	le32enc(p, 1); p += 4;           // tx version
+	*p++ = 1;                        // inputs
+	memset(p, 0, 32); p += 32;       // prevout hash
+	memset(p, 0xff, 4); p += 4;      // prevout index
+	*p++ = (uchar) (4 + taglen + 4 + SIM_XNONCE2_SIZE); // script length
+	*p++ = 3;                        // height
+	*p++ = job->height & 0xff;
+	*p++ = (job->height >> 8) & 0xff;
+	*p++ = (job->height >> 16) & 0xff;
+	memcpy(p, tag, taglen); p += taglen;
+	job->coinb1_len = (int) (p - job->coinb1);
+
+	// extranonce1 and extranonce2 go here
+	p = job->coinb2;
+	memset(p, 0xff, 4); p += 4;      // sequence
+	*p++ = 1;                        // outputs
+	le32enc(p, 5000000000ULL & 0xffffffff); p += 4;
+	le32enc(p, 5000000000ULL >> 32); p += 4;
+	*p++ = 25;                       // p2pkh script
+	*p++ = 0x76; *p++ = 0xa9; *p++ = 0x14;
+	for (int i = 0; i < 20; i++) *p++ = (uchar) rand();
+	*p++ = 0x88; *p++ = 0xac;
+	memset(p, 0, 4); p += 4;         // lock time
+	job->coinb2_len = (int) (p - job->coinb2);
+}
+
+static struct sim_job* sim_new_job()
+{
+	struct sim_job *prev = &sim_jobs[sim_job_id % SIM_JOBS];
+	struct sim_job *job;
+	uint32_t id = sim_job_id + 1;
+	bool clean = ((id - 1) % SIM_BLOCK_JOBS) == 0;
+
+	pthread_mutex_lock(&sim_lock);
+	job = &sim_jobs[id % SIM_JOBS];
+	if (clean) {
+		sim_height++;
+		for (int i = 0; i < 32; i++)
+			job->prevhash[i] = (uchar) rand();
+		memset(&job->prevhash[28], 0, 4); // some zeros, like a block hash
+	} else {
+		memcpy(job->prevhash, prev->prevhash, 32);
+	}
+	job->id = id;
+	job->height = sim_height;
+	job->clean = clean;
+	job->diff = opt_sim_pool_diff;
+	be32enc(job->version, 0x20000000);
+	be32enc(job->nbits, 0x1d00ffff);
+	be32enc(job->ntime, (uint32_t) time(NULL));
+	sim_build_coinbase(job);
+	job->merkle_count = opt_sim_pool_branches;
+	for (int n = 0; n < job->merkle_count; n++)
+		for (int i = 0; i < 32; i++)
+			job->merkle[n][i] = (uchar) rand();
+	job->tm_notify = 0;
+	job->hashed = false;
+	job->shares.clear();
+	sim_job_id = id;
+	pthread_mutex_unlock(&sim_lock);
+
+	return job;
+}
+
+static bool sim_send(sim_socket sock, json_t *val)
+{
+	char *s = json_dumps(val, JSON_COMPACT);
+	size_t len, sent = 0;
+	bool ret = false;
+
+	json_decref(val);
+	if (!s)
+		return false;
+	len = strlen(s);
+	s = (char*) realloc(s, len + 2);
+	strcpy(s + len, "\n");
+	len++;
+	if (opt_protocol)
+		applog(LOG_DEBUG, "sim-pool > %s", s);
+	while (sent < len) {
+		int n = (int) send(sock, s + sent, (int) (len - sent), MSG_NOSIGNAL);
+		if (n <= 0)
+			goto out;
+		sent += n;
+	}
+	ret = true;
+out:
+	free(s);
+	return ret;
+}
+
+static bool sim_reply(sim_socket sock, json_t *id, json_t *result, int code, const char *reason)
+{
+	json_t *val = json_object();
+	json_object_set(val, "id", id ? id : json_null());
+	json_object_set_new(val, "result", result);
+	if (code) {
+		json_t *err = json_array();
+		json_array_append_new(err, json_integer(code));
+		json_array_append_new(err, json_string(reason));
+		json_array_append_new(err, json_null());
+		json_object_set_new(val, "error", err);
+	} else {
+		json_object_set_new(val, "error", json_null());
+	}
+	return sim_send(sock, val);
+}
+
+static bool sim_notify(sim_socket sock, struct sim_job *job)
+{
+	json_t *val = json_object();
+	json_t *params = json_array();
+	json_t *merkle = json_array();
+	char id[16];
+	char *hex;
+
+	snprintf(id, sizeof(id), "%x", job->id);
+	json_array_append_new(params, json_string(id));
+	hex = bin2hex(job->prevhash, 32); json_array_append_new(params, json_string(hex)); free(hex);
+	hex = bin2hex(job->coinb1, job->coinb1_len); json_array_append_new(params, json_string(hex)); free(hex);
+	hex = bin2hex(job->coinb2, job->coinb2_len); json_array_append_new(params, json_string(hex)); free(hex);
+	for (int n = 0; n < job->merkle_count; n++) {
+		hex = bin2hex(job->merkle[n], 32);
+		json_array_append_new(merkle, json_string(hex));
+		free(hex);
+	}
+	json_array_append_new(params, merkle);
+	hex = bin2hex(job->version, 4); json_array_append_new(params, json_string(hex)); free(hex);
+	hex = bin2hex(job->nbits, 4); json_array_append_new(params, json_string(hex)); free(hex);
+	hex = bin2hex(job->ntime, 4); json_array_append_new(params, json_string(hex)); free(hex);
+	json_array_append_new(params, json_boolean(job->clean));
+
+	json_object_set_new(val, "id", json_null());
+	json_object_set_new(val, "method", json_string("mining.notify"));
+	json_object_set_new(val, "params", params);
+
+	pthread_mutex_lock(&sim_lock);
+	job->tm_notify = sim_usecs();
+	sim_jobs_sent++;
+	pthread_mutex_unlock(&sim_lock);
+
+	return sim_send(sock, val);
+}
+
+static bool sim_set_difficulty(sim_socket sock, double diff)
+{
+	json_t *val = json_object();
+	json_t *params = json_array();
+	json_array_append_new(params, json_real(diff));
+	json_object_set_new(val, "id", json_null());
+	json_object_set_new(val, "method", json_string("mining.set_difficulty"));
+	json_object_set_new(val, "params", params);
+	return sim_send(sock, val);
+}
+
+/* check a share like a pool, server thread */
+static enum sim_reject sim_check_share(json_t *params)
+{
+	const char *job_id = json_string_value(json_array_get(params, 1));
+	const char *xnonce2 = json_string_value(json_array_get(params, 2));
+	const char *stime = json_string_value(json_array_get(params, 3));
+	const char *snonce = json_string_value(json_array_get(params, 4));
+	uint32_t _ALIGN(64) data[20], endiandata[20], hash[8];
+	uchar coinbase[160], merkle_root[64];
+	uchar x2[SIM_XNONCE2_SIZE], ntime[4], nonce[4];
+	struct sim_job *job;
+	struct work work;
+	uint32_t id;
+	uint64_t key;
+	int len;
+
+	if (!job_id || !xnonce2 || !stime || !snonce ||
+	    strlen(xnonce2) != 2 * SIM_XNONCE2_SIZE || strlen(stime) != 8 || strlen(snonce) != 8)
+		return SIM_INVALID;
+	if (!hex2bin(x2, xnonce2, SIM_XNONCE2_SIZE) || !hex2bin(ntime, stime, 4) || !hex2bin(nonce, snonce, 4))
+		return SIM_INVALID;
+
+	id = (uint32_t) strtoul(job_id, NULL, 16);
+	job = &sim_jobs[id % SIM_JOBS];
+	if (!id || job->id != id || job->height != sim_height)
+		return SIM_STALE;
+
+	if (be32dec(ntime) < be32dec(job->ntime) || be32dec(ntime) > be32dec(job->ntime) + 7200)
+		return SIM_INVALID;
+
+	key = ((uint64_t) le32dec(x2) << 32) | le32dec(nonce);
+	if (!job->shares.insert(key).second)
+		return SIM_DUPLICATE;
+
+	len = job->coinb1_len;
+	memcpy(coinbase, job->coinb1, len);
+	memcpy(coinbase + len, sim_xnonce1, sizeof(sim_xnonce1)); len += sizeof(sim_xnonce1);
+	memcpy(coinbase + len, x2, SIM_XNONCE2_SIZE); len += SIM_XNONCE2_SIZE;
+	memcpy(coinbase + len, job->coinb2, job->coinb2_len); len += job->coinb2_len;
+
+	switch (opt_algo) {
+	case ALGO_FUGUE256:
+	case ALGO_GROESTL:
+	case ALGO_KECCAK:
+	case ALGO_BLAKECOIN:
+	case ALGO_WHIRLCOIN:
+		SHA256(coinbase, len, merkle_root);
+		break;
+	default:
+		sha256d(merkle_root, coinbase, len);
+	}
+	for (int i = 0; i < job->merkle_count; i++) {
+		memcpy(merkle_root + 32, job->merkle[i], 32);
+		sha256d(merkle_root, merkle_root, 64);
+	}
+
+	// same header words as stratum_gen_work(), hashed like the scanhash functions
+	data[0] = le32dec(job->version);
+	for (int i = 0; i < 8; i++)
+		data[1 + i] = le32dec(job->prevhash + i * 4);
+	for (int i = 0; i < 8; i++)
+		data[9 + i] = be32dec(merkle_root + i * 4);
+	data[17] = le32dec(ntime);
+	data[18] = le32dec(job->nbits);
+	data[19] = le32dec(nonce);
+	for (int k = 0; k < 20; k++)
+		be32enc(&endiandata[k], data[k]);
+	sim_hash(hash, endiandata);
+
+	memset(&work, 0, sizeof(work));
+	stratum_set_target(&work, job->diff);
+	return fulltest(hash, work.target) ? SIM_ACCEPTED : SIM_LOW_DIFF;
+}
+
+static bool sim_handle_line(sim_socket sock, const char *line, bool *authorized)
+{
+	json_t *val, *id, *params;
+	json_error_t err;
+	const char *method;
+	bool ret = true;
+
+	if (opt_protocol)
+		applog(LOG_DEBUG, "sim-pool < %s", line);
+
+	val = JSON_LOADS(line, &err);
+	if (!val) {
+		applog(LOG_WARNING, "sim-pool: JSON decode failed(%d): %s", err.line, err.text);
+		return false;
+	}
+	id = json_object_get(val, "id");
+	params = json_object_get(val, "params");
+	method = json_string_value(json_object_get(val, "method"));
+	if (!method) {
+		json_decref(val);
+		return true;
+	}
+
+	if (!strcasecmp(method, "mining.subscribe")) {
+		json_t *res = json_array(), *subs = json_array(), *sub;
+		char *xn1;
+		char sid[16];
+		for (int i = 0; i < 4; i++)
+			sim_xnonce1[i] = (uchar) rand();
+		snprintf(sid, sizeof(sid), "%08x", (uint32_t) rand());
+		sub = json_array();
+		json_array_append_new(sub, json_string("mining.set_difficulty"));
+		json_array_append_new(sub, json_string(sid));
+		json_array_append_new(subs, sub);
+		sub = json_array();
+		json_array_append_new(sub, json_string("mining.notify"));
+		json_array_append_new(sub, json_string(sid));
+		json_array_append_new(subs, sub);
+		json_array_append_new(res, subs);
+		xn1 = bin2hex(sim_xnonce1, sizeof(sim_xnonce1));
+		json_array_append_new(res, json_string(xn1));
+		free(xn1);
+		json_array_append_new(res, json_integer(SIM_XNONCE2_SIZE));
+		ret = sim_reply(sock, id, res, 0, NULL);
+	}
+	else if (!strcasecmp(method, "mining.authorize")) {
+		ret = sim_reply(sock, id, json_true(), 0, NULL);
+		// a new block for each connection
+		sim_job_id += (SIM_BLOCK_JOBS - sim_job_id % SIM_BLOCK_JOBS) % SIM_BLOCK_JOBS;
+		struct sim_job *job = sim_new_job();
+		ret = ret && sim_set_difficulty(sock, job->diff);
+		ret = ret && sim_notify(sock, job);
+		*authorized = true;
+	}
+	else if (!strcasecmp(method, "mining.extranonce.subscribe")) {
+		ret = sim_reply(sock, id, json_true(), 0, NULL);
+	}
+	else if (!strcasecmp(method, "mining.submit")) {
+		uint64_t start = sim_usecs();
+		enum sim_reject rc = *authorized ? sim_check_share(params) : SIM_INVALID;
+		uint32_t usecs = (uint32_t) (sim_usecs() - start);
+
+		pthread_mutex_lock(&sim_lock);
+		sim_shares[rc]++;
+		sim_latency_add(&sim_lat_check, usecs);
+		pthread_mutex_unlock(&sim_lock);
+
+		switch (rc) {
+		case SIM_ACCEPTED:
+			ret = sim_reply(sock, id, json_true(), 0, NULL);
+			break;
+		case SIM_STALE:
+			ret = sim_reply(sock, id, json_false(), 21, "Job not found");
+			break;
+		case SIM_DUPLICATE:
+			ret = sim_reply(sock, id, json_false(), 22, "Duplicate share");
+			break;
+		case SIM_LOW_DIFF:
+			ret = sim_reply(sock, id, json_false(), 23, "Low difficulty share");
+			break;
+		default:
+			ret = sim_reply(sock, id, json_false(), 20, "Invalid share");
+		}
+	}
+	else {
+		ret = sim_reply(sock, id, json_null(), 20, "Unsupported method");
+	}
+
+	json_decref(val);
+	return ret;
+}
+
+static void sim_serve(sim_socket sock)
+{
+	char *buf = (char*) malloc(SIM_BUF_SIZE);
+	size_t len = 0;
+	bool authorized = false;
+	uint64_t next_job = 0;
+
+	while (!abort_flag) {
+		uint64_t now = sim_usecs();
+		uint64_t wait = 1000000;
+		struct timeval tv;
+		fd_set rd;
+		char *line, *nl;
+		int n;
+
+		if (authorized) {
+			if (now >= next_job) {
+				if (next_job && !sim_notify(sock, sim_new_job()))
+					break;
+				next_job = now + 1000ULL * opt_sim_pool_interval;
+			}
+			wait = min(wait, next_job - now);
+		}
+
+		FD_ZERO(&rd);
+		FD_SET(sock, &rd);
+		tv.tv_sec = (long) (wait / 1000000);
+		tv.tv_usec = (long) (wait % 1000000);
+		n = select((int) sock + 1, &rd, NULL, NULL, &tv);
+		if (n < 0)
+			break;
+		if (n == 0)
+			continue;
+
+		n = (int) recv(sock, buf + len, (int) (SIM_BUF_SIZE - 1 - len), 0);
+		if (n <= 0)
+			break;
+		len += n;
+		buf[len] = '\0';
+
+		line = buf;
+		while ((nl = strchr(line, '\n')) != NULL) {
+			*nl = '\0';
+			if (*line && !sim_handle_line(sock, line, &authorized))
+				goto out;
+			line = nl + 1;
+		}
+		len -= (line - buf);
+		memmove(buf, line, len + 1);
+		if (len == SIM_BUF_SIZE - 1) {
+			applog(LOG_WARNING, "sim-pool: line too long, disconnecting");
+			break;
+		}
+	}
+out:
+	free(buf);
+	sim_close(sock);
+}
+
+static void *sim_pool_thread(void *userdata)
+{
+	while (!abort_flag) {
+		struct timeval tv = { 1, 0 };
+		sim_socket client;
+		fd_set rd;
+
+		FD_ZERO(&rd);
+		FD_SET(sim_listen, &rd);
+		if (select((int) sim_listen + 1, &rd, NULL, NULL, &tv) <= 0)
+			continue;
+
+		client = accept(sim_listen, NULL, NULL);
+		if (client == SIM_INVSOCK)
+			continue;
+
+		pthread_mutex_lock(&sim_lock);
+		sim_connections++;
+		pthread_mutex_unlock(&sim_lock);
+		if (opt_debug)
+			applog(LOG_DEBUG, "sim-pool: miner connected");
+		sim_serve(client);
+	}
+	sim_close(sim_listen);
+	return NULL;
+}
+
+/* listen on a local port and set it as the pool, before the config file lookup */
+bool sim_pool_start(void)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	char url[64];
+
+	sim_hash = algo_cpu_hash(opt_algo);
+	if (!sim_hash) {
+		applog(LOG_ERR, "The simulated pool doesn't support the %s algo", algo_names[opt_algo]);
+		return false;
+	}
+	if (opt_benchmark || strlen(rpc_url)) {
+		applog(LOG_ERR, "--sim-pool replaces the pool, remove --benchmark and the url");
+		return false;
+	}
+
+#ifdef WIN32
+	WSADATA wsa;
+	WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+	sim_listen = socket(AF_INET, SOCK_STREAM, 0);
+	if (sim_listen == SIM_INVSOCK) {
+		applog(LOG_ERR, "sim-pool: socket failed");
+		return false;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	if (bind(sim_listen, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+	    listen(sim_listen, 1) < 0 ||
+	    getsockname(sim_listen, (struct sockaddr*) &addr, &addrlen) < 0) {
+		applog(LOG_ERR, "sim-pool: unable to listen on a local port");
+		sim_close(sim_listen);
+		return false;
+	}
+
+	if (pthread_create(&sim_thread, NULL, sim_pool_thread, NULL)) {
+		applog(LOG_ERR, "sim-pool: thread create failed");
+		sim_close(sim_listen);
+		return false;
+	}
+	sim_started = true;
+
+	snprintf(url, sizeof(url), "stratum+tcp://127.0.0.1:%u", (uint32_t) ntohs(addr.sin_port));
+	if (!strlen(rpc_user))
+		parse_arg('u', (char*) "sim");
+	parse_arg('o', url);
+
+	applog(LOG_INFO, "Simulated pool on %s, job every %d ms, %d merkle branches, diff %g",
+		url + 14, opt_sim_pool_interval, opt_sim_pool_branches, opt_sim_pool_diff);
+	return true;
+}
+
+/* first scan of a job by a miner thread (job_id is the work one) */
+void sim_pool_job_hashing(const char *job_id)
+{
+	uint32_t id;
+	struct sim_job *job;
+
+	if (strlen(job_id) <= 8)
+		return;
+	id = (uint32_t) strtoul(job_id + 8, NULL, 16);
+	pthread_mutex_lock(&sim_lock);
+	job = &sim_jobs[id % SIM_JOBS];
+	if (job->id == id && job->tm_notify && !job->hashed) {
+		job->hashed = true;
+		sim_latency_add(&sim_lat_notify, (uint32_t) (sim_usecs() - job->tm_notify));
+	}
+	pthread_mutex_unlock(&sim_lock);
+}
+
+/* pool answer of a submit, timed by the stratum thread */
+void sim_pool_share_answer(uint32_t usecs)
+{
+	pthread_mutex_lock(&sim_lock);
+	sim_latency_add(&sim_lat_answer, usecs);
+	pthread_mutex_unlock(&sim_lock);
+}
+
+void sim_pool_report(void)
+{
+	uint32_t total = 0;
+
+	if (!sim_started)
+		return;
+
+	pthread_mutex_lock(&sim_lock);
+	for (int i = 0; i < SIM_REJECT_COUNT; i++)
+		total += sim_shares[i];
+	applog(LOG_INFO, "sim-pool: %u connections, %u jobs, %u blocks, %u shares", sim_connections,
+		sim_jobs_sent, sim_height, total);
+	for (int i = 1; i < SIM_REJECT_COUNT; i++) {
+		if (sim_shares[i])
+			applog(LOG_INFO, "sim-pool: %u shares %s", sim_shares[i], sim_reject_reasons[i]);
+	}
+	sim_latency_log("notify to first hash", &sim_lat_notify);
+	sim_latency_log("submit to answer", &sim_lat_answer);
+	sim_latency_log("share check", &sim_lat_check);
+	pthread_mutex_unlock(&sim_lock);
+}
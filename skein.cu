@@ -4,6 +4,7 @@
  */
 
 #include "sph/sph_skein.h"
+#include "sph/sph_midstate.h"
 
 #include "miner.h"
 #include "cuda_helper.h"
@@ -324,6 +325,8 @@ void sha2_cpu_hash_64(int thr_id, uint32_t threads, uint32_t startNounce, uint32
 	MyStreamSynchronize(NULL, 0, thr_id);
 }
 
+static __thread sph_midstate80 s_midstate;
+
 extern "C" void skeincoinhash(void *output, const void *input)
 {
 	sph_skein512_context ctx_skein;
@@ -331,8 +334,7 @@ extern "C" void skeincoinhash(void *output, const void *input)
 
 	uint32_t hash[16];
 
-	sph_skein512_init(&ctx_skein);
-	sph_skein512(&ctx_skein, input, 80);
+	SPH_MIDSTATE80(&s_midstate, skein512, &ctx_skein, input);
 	sph_skein512_close(&ctx_skein, hash);
 
 	SHA256_Init(&sha256);
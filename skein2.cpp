@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "sph/sph_skein.h"
+#include "sph/sph_midstate.h"
 
 #include "miner.h"
 #include "cuda_helper.h"
@@ -17,13 +18,14 @@ extern void skein512_cpu_hash_80(int thr_id, uint32_t threads, uint32_t startNou
 extern void quark_skein512_cpu_init(int thr_id, uint32_t threads);
 extern void quark_skein512_cpu_hash_64(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *d_nonceVector, uint32_t *d_hash, int order);
 
+static __thread sph_midstate80 s_midstate;
+
 void skein2hash(void *output, const void *input)
 {
 	uint32_t _ALIGN(64) hash[16];
 	sph_skein512_context ctx_skein;
 
-	sph_skein512_init(&ctx_skein);
-	sph_skein512(&ctx_skein, input, 80);
+	SPH_MIDSTATE80(&s_midstate, skein512, &ctx_skein, input);
 	sph_skein512_close(&ctx_skein, hash);
 
 	sph_skein512_init(&ctx_skein);
@@ -9,6 +9,7 @@ extern "C" {
 #include "sph/sph_cubehash.h"
 #include "sph/sph_fugue.h"
 #include "sph/sph_streebog.h"
+#include "sph/sph_midstate.h"
 }
 
 #include "miner.h"
@@ -40,6 +41,8 @@ extern void skunk_cuda_streebog(int thr_id, uint32_t threads, uint32_t *d_hash,
 static uint32_t *d_hash[MAX_GPUS];
 static uint32_t *d_resNonce[MAX_GPUS];
 
+static __thread sph_midstate80 s_midstate;
+
 // CPU Hash
 extern "C" void skunk_hash(void *output, const void *input)
 {
@@ -50,8 +53,7 @@ extern "C" void skunk_hash(void *output, const void *input)
 	sph_fugue512_context ctx_fugue;
 	sph_gost512_context ctx_gost;
 
-	sph_skein512_init(&ctx_skein);
-	sph_skein512(&ctx_skein, input, 80);
+	SPH_MIDSTATE80(&s_midstate, skein512, &ctx_skein, input);
 	sph_skein512_close(&ctx_skein, (void*) hash);
 
 	sph_cubehash512_init(&ctx_cubehash);
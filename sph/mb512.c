@@ -0,0 +1,1003 @@
+/*
+ * Multi-buffer 512 bits sph hashes (see sph_mb512.h)
+ *
+ * The padding is done per lane in scalar code, the blocks are then
+ * interleaved and compressed in avx2 or avx-512 registers (mb512_lanes.h).
+ * Each implementation is checked against the scalar sph functions before
+ * use, on single and multi blocks inputs.
+ */
+
+#include "miner.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sph_blake.h"
+#include "sph_bmw.h"
+#include "sph_keccak.h"
+#include "sph_skein.h"
+#include "sph_jh.h"
+#include "sph_sha2.h"
+#include "sph_cubehash.h"
+#include "sph_shabal.h"
+#include "sph_luffa.h"
+#include "sph_mb512.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MB512_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#define MB512_TARGET(x) __attribute__((target(x)))
+#else
+#define MB512_TARGET(x)
+#endif
+
+#if defined(MB512_X86)
+#if defined(_MSC_VER) || defined(__clang__) || (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define MB512_AVX2
+#define MB512_VECTOR
+#endif
+#if (defined(_MSC_VER) && _MSC_VER >= 1910) || defined(__clang__) || (__GNUC__ >= 5)
+#define MB512_AVX512
+#endif
+#endif
+
+#define CPU_AVX2   1
+#define CPU_AVX512 2
+
+static int mb512_cpu(void)
+{
+	int flags = 0;
+#if defined(MB512_X86)
+	uint32_t r[4], max_level;
+	uint64_t xcr0 = 0;
+#ifdef _MSC_VER
+	int cr[4];
+	#define cpuid(leaf, sub) { __cpuidex(cr, leaf, sub); r[0] = cr[0]; r[1] = cr[1]; r[2] = cr[2]; r[3] = cr[3]; }
+#else
+	#define cpuid(leaf, sub) __cpuid_count(leaf, sub, r[0], r[1], r[2], r[3])
+#endif
+	cpuid(0, 0);
+	max_level = r[0];
+	cpuid(1, 0);
+	// osxsave + avx, then the os enabled register state
+	if ((r[2] & (1 << 27)) && (r[2] & (1 << 28))) {
+#ifdef _MSC_VER
+		xcr0 = _xgetbv(0);
+#else
+		uint32_t lo, hi;
+		__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(lo), "=d"(hi) : "c"(0));
+		xcr0 = ((uint64_t)hi << 32) | lo;
+#endif
+	}
+	if (max_level >= 7) {
+		cpuid(7, 0);
+		if ((r[1] & (1 << 5)) && (xcr0 & 0x06) == 0x06)
+			flags |= CPU_AVX2;
+		if ((r[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6)
+			flags |= CPU_AVX512;
+	}
+	#undef cpuid
+#endif
+	return flags;
+}
+
+#define MB512_MAX_LANES 16
+
+#if defined(MB512_VECTOR)
+
+/* constants of the sph implementations, jh ones are byte swapped like in jh.c */
+#define C64e(x)  ((SPH_C64(x) >> 56) \
+	| ((SPH_C64(x) >> 40) & SPH_C64(0x000000000000FF00)) \
+	| ((SPH_C64(x) >> 24) & SPH_C64(0x0000000000FF0000)) \
+	| ((SPH_C64(x) >>  8) & SPH_C64(0x00000000FF000000)) \
+	| ((SPH_C64(x) <<  8) & SPH_C64(0x000000FF00000000)) \
+	| ((SPH_C64(x) << 24) & SPH_C64(0x0000FF0000000000)) \
+	| ((SPH_C64(x) << 40) & SPH_C64(0x00FF000000000000)) \
+	| ((SPH_C64(x) << 56) & SPH_C64(0xFF00000000000000)))
+
+static const uint64_t mb_blake512_iv[8] = {
+	SPH_C64(0x6A09E667F3BCC908), SPH_C64(0xBB67AE8584CAA73B),
+	SPH_C64(0x3C6EF372FE94F82B), SPH_C64(0xA54FF53A5F1D36F1),
+	SPH_C64(0x510E527FADE682D1), SPH_C64(0x9B05688C2B3E6C1F),
+	SPH_C64(0x1F83D9ABFB41BD6B), SPH_C64(0x5BE0CD19137E2179)
+};
+
+static const uint64_t mb_blake512_cb[16] = {
+	SPH_C64(0x243F6A8885A308D3), SPH_C64(0x13198A2E03707344),
+	SPH_C64(0xA4093822299F31D0), SPH_C64(0x082EFA98EC4E6C89),
+	SPH_C64(0x452821E638D01377), SPH_C64(0xBE5466CF34E90C6C),
+	SPH_C64(0xC0AC29B7C97C50DD), SPH_C64(0x3F84D5B5B5470917),
+	SPH_C64(0x9216D5D98979FB1B), SPH_C64(0xD1310BA698DFB5AC),
+	SPH_C64(0x2FFD72DBD01ADFB7), SPH_C64(0xB8E1AFED6A267E96),
+	SPH_C64(0xBA7C9045F12C7F99), SPH_C64(0x24A19947B3916CF7),
+	SPH_C64(0x0801F2E2858EFC16), SPH_C64(0x636920D871574E69)
+};
+
+static const uint8_t mb_blake512_sigma[10][16] = {
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+	{ 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+	{  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+	{  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+	{  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+	{ 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+	{ 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+	{  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+	{ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 }
+};
+
+static const uint64_t mb_bmw512_iv[16] = {
+	SPH_C64(0x8081828384858687), SPH_C64(0x88898A8B8C8D8E8F),
+	SPH_C64(0x9091929394959697), SPH_C64(0x98999A9B9C9D9E9F),
+	SPH_C64(0xA0A1A2A3A4A5A6A7), SPH_C64(0xA8A9AAABACADAEAF),
+	SPH_C64(0xB0B1B2B3B4B5B6B7), SPH_C64(0xB8B9BABBBCBDBEBF),
+	SPH_C64(0xC0C1C2C3C4C5C6C7), SPH_C64(0xC8C9CACBCCCDCECF),
+	SPH_C64(0xD0D1D2D3D4D5D6D7), SPH_C64(0xD8D9DADBDCDDDEDF),
+	SPH_C64(0xE0E1E2E3E4E5E6E7), SPH_C64(0xE8E9EAEBECEDEEEF),
+	SPH_C64(0xF0F1F2F3F4F5F6F7), SPH_C64(0xF8F9FAFBFCFDFEFF)
+};
+
+static const uint64_t mb_bmw512_final[16] = {
+	SPH_C64(0xaaaaaaaaaaaaaaa0), SPH_C64(0xaaaaaaaaaaaaaaa1),
+	SPH_C64(0xaaaaaaaaaaaaaaa2), SPH_C64(0xaaaaaaaaaaaaaaa3),
+	SPH_C64(0xaaaaaaaaaaaaaaa4), SPH_C64(0xaaaaaaaaaaaaaaa5),
+	SPH_C64(0xaaaaaaaaaaaaaaa6), SPH_C64(0xaaaaaaaaaaaaaaa7),
+	SPH_C64(0xaaaaaaaaaaaaaaa8), SPH_C64(0xaaaaaaaaaaaaaaa9),
+	SPH_C64(0xaaaaaaaaaaaaaaaa), SPH_C64(0xaaaaaaaaaaaaaaab),
+	SPH_C64(0xaaaaaaaaaaaaaaac), SPH_C64(0xaaaaaaaaaaaaaaad),
+	SPH_C64(0xaaaaaaaaaaaaaaae), SPH_C64(0xaaaaaaaaaaaaaaaf)
+};
+
+static const uint64_t mb_keccak_rc[24] = {
+	SPH_C64(0x0000000000000001), SPH_C64(0x0000000000008082),
+	SPH_C64(0x800000000000808A), SPH_C64(0x8000000080008000),
+	SPH_C64(0x000000000000808B), SPH_C64(0x0000000080000001),
+	SPH_C64(0x8000000080008081), SPH_C64(0x8000000000008009),
+	SPH_C64(0x000000000000008A), SPH_C64(0x0000000000000088),
+	SPH_C64(0x0000000080008009), SPH_C64(0x000000008000000A),
+	SPH_C64(0x000000008000808B), SPH_C64(0x800000000000008B),
+	SPH_C64(0x8000000000008089), SPH_C64(0x8000000000008003),
+	SPH_C64(0x8000000000008002), SPH_C64(0x8000000000000080),
+	SPH_C64(0x000000000000800A), SPH_C64(0x800000008000000A),
+	SPH_C64(0x8000000080008081), SPH_C64(0x8000000000008080),
+	SPH_C64(0x0000000080000001), SPH_C64(0x8000000080008008)
+};
+
+static const uint64_t mb_skein512_iv[8] = {
+	SPH_C64(0x4903ADFF749C51CE), SPH_C64(0x0D95DE399746DF03),
+	SPH_C64(0x8FD1934127C79BCE), SPH_C64(0x9A255629FF352CB1),
+	SPH_C64(0x5DB62599DF6CA7B0), SPH_C64(0xEABE394CA9D5C3F4),
+	SPH_C64(0x991112C71A75B523), SPH_C64(0xAE18A40B660FCC33)
+};
+
+static const uint64_t mb_jh512_c[168] = {
+	C64e(0x72d5dea2df15f867), C64e(0x7b84150ab7231557),
+	C64e(0x81abd6904d5a87f6), C64e(0x4e9f4fc5c3d12b40),
+	C64e(0xea983ae05c45fa9c), C64e(0x03c5d29966b2999a),
+	C64e(0x660296b4f2bb538a), C64e(0xb556141a88dba231),
+	C64e(0x03a35a5c9a190edb), C64e(0x403fb20a87c14410),
+	C64e(0x1c051980849e951d), C64e(0x6f33ebad5ee7cddc),
+	C64e(0x10ba139202bf6b41), C64e(0xdc786515f7bb27d0),
+	C64e(0x0a2c813937aa7850), C64e(0x3f1abfd2410091d3),
+	C64e(0x422d5a0df6cc7e90), C64e(0xdd629f9c92c097ce),
+	C64e(0x185ca70bc72b44ac), C64e(0xd1df65d663c6fc23),
+	C64e(0x976e6c039ee0b81a), C64e(0x2105457e446ceca8),
+	C64e(0xeef103bb5d8e61fa), C64e(0xfd9697b294838197),
+	C64e(0x4a8e8537db03302f), C64e(0x2a678d2dfb9f6a95),
+	C64e(0x8afe7381f8b8696c), C64e(0x8ac77246c07f4214),
+	C64e(0xc5f4158fbdc75ec4), C64e(0x75446fa78f11bb80),
+	C64e(0x52de75b7aee488bc), C64e(0x82b8001e98a6a3f4),
+	C64e(0x8ef48f33a9a36315), C64e(0xaa5f5624d5b7f989),
+	C64e(0xb6f1ed207c5ae0fd), C64e(0x36cae95a06422c36),
+	C64e(0xce2935434efe983d), C64e(0x533af974739a4ba7),
+	C64e(0xd0f51f596f4e8186), C64e(0x0e9dad81afd85a9f),
+	C64e(0xa7050667ee34626a), C64e(0x8b0b28be6eb91727),
+	C64e(0x47740726c680103f), C64e(0xe0a07e6fc67e487b),
+	C64e(0x0d550aa54af8a4c0), C64e(0x91e3e79f978ef19e),
+	C64e(0x8676728150608dd4), C64e(0x7e9e5a41f3e5b062),
+	C64e(0xfc9f1fec4054207a), C64e(0xe3e41a00cef4c984),
+	C64e(0x4fd794f59dfa95d8), C64e(0x552e7e1124c354a5),
+	C64e(0x5bdf7228bdfe6e28), C64e(0x78f57fe20fa5c4b2),
+	C64e(0x05897cefee49d32e), C64e(0x447e9385eb28597f),
+	C64e(0x705f6937b324314a), C64e(0x5e8628f11dd6e465),
+	C64e(0xc71b770451b920e7), C64e(0x74fe43e823d4878a),
+	C64e(0x7d29e8a3927694f2), C64e(0xddcb7a099b30d9c1),
+	C64e(0x1d1b30fb5bdc1be0), C64e(0xda24494ff29c82bf),
+	C64e(0xa4e7ba31b470bfff), C64e(0x0d324405def8bc48),
+	C64e(0x3baefc3253bbd339), C64e(0x459fc3c1e0298ba0),
+	C64e(0xe5c905fdf7ae090f), C64e(0x947034124290f134),
+	C64e(0xa271b701e344ed95), C64e(0xe93b8e364f2f984a),
+	C64e(0x88401d63a06cf615), C64e(0x47c1444b8752afff),
+	C64e(0x7ebb4af1e20ac630), C64e(0x4670b6c5cc6e8ce6),
+	C64e(0xa4d5a456bd4fca00), C64e(0xda9d844bc83e18ae),
+	C64e(0x7357ce453064d1ad), C64e(0xe8a6ce68145c2567),
+	C64e(0xa3da8cf2cb0ee116), C64e(0x33e906589a94999a),
+	C64e(0x1f60b220c26f847b), C64e(0xd1ceac7fa0d18518),
+	C64e(0x32595ba18ddd19d3), C64e(0x509a1cc0aaa5b446),
+	C64e(0x9f3d6367e4046bba), C64e(0xf6ca19ab0b56ee7e),
+	C64e(0x1fb179eaa9282174), C64e(0xe9bdf7353b3651ee),
+	C64e(0x1d57ac5a7550d376), C64e(0x3a46c2fea37d7001),
+	C64e(0xf735c1af98a4d842), C64e(0x78edec209e6b6779),
+	C64e(0x41836315ea3adba8), C64e(0xfac33b4d32832c83),
+	C64e(0xa7403b1f1c2747f3), C64e(0x5940f034b72d769a),
+	C64e(0xe73e4e6cd2214ffd), C64e(0xb8fd8d39dc5759ef),
+	C64e(0x8d9b0c492b49ebda), C64e(0x5ba2d74968f3700d),
+	C64e(0x7d3baed07a8d5584), C64e(0xf5a5e9f0e4f88e65),
+	C64e(0xa0b8a2f436103b53), C64e(0x0ca8079e753eec5a),
+	C64e(0x9168949256e8884f), C64e(0x5bb05c55f8babc4c),
+	C64e(0xe3bb3b99f387947b), C64e(0x75daf4d6726b1c5d),
+	C64e(0x64aeac28dc34b36d), C64e(0x6c34a550b828db71),
+	C64e(0xf861e2f2108d512a), C64e(0xe3db643359dd75fc),
+	C64e(0x1cacbcf143ce3fa2), C64e(0x67bbd13c02e843b0),
+	C64e(0x330a5bca8829a175), C64e(0x7f34194db416535c),
+	C64e(0x923b94c30e794d1e), C64e(0x797475d7b6eeaf3f),
+	C64e(0xeaa8d4f7be1a3921), C64e(0x5cf47e094c232751),
+	C64e(0x26a32453ba323cd2), C64e(0x44a3174a6da6d5ad),
+	C64e(0xb51d3ea6aff2c908), C64e(0x83593d98916b3c56),
+	C64e(0x4cf87ca17286604d), C64e(0x46e23ecc086ec7f6),
+	C64e(0x2f9833b3b1bc765e), C64e(0x2bd666a5efc4e62a),
+	C64e(0x06f4b6e8bec1d436), C64e(0x74ee8215bcef2163),
+	C64e(0xfdc14e0df453c969), C64e(0xa77d5ac406585826),
+	C64e(0x7ec1141606e0fa16), C64e(0x7e90af3d28639d3f),
+	C64e(0xd2c9f2e3009bd20c), C64e(0x5faace30b7d40c30),
+	C64e(0x742a5116f2e03298), C64e(0x0deb30d8e3cef89a),
+	C64e(0x4bc59e7bb5f17992), C64e(0xff51e66e048668d3),
+	C64e(0x9b234d57e6966731), C64e(0xcce6a6f3170a7505),
+	C64e(0xb17681d913326cce), C64e(0x3c175284f805a262),
+	C64e(0xf42bcbb378471547), C64e(0xff46548223936a48),
+	C64e(0x38df58074e5e6565), C64e(0xf2fc7c89fc86508e),
+	C64e(0x31702e44d00bca86), C64e(0xf04009a23078474e),
+	C64e(0x65a0ee39d1f73883), C64e(0xf75ee937e42c3abd),
+	C64e(0x2197b2260113f86f), C64e(0xa344edd1ef9fdee7),
+	C64e(0x8ba0df15762592d9), C64e(0x3c85f7f612dc42be),
+	C64e(0xd8a7ec7cab27b07e), C64e(0x538d7ddaaa3ea8de),
+	C64e(0xaa25ce93bd0269d8), C64e(0x5af643fd1a7308f9),
+	C64e(0xc05fefda174a19a5), C64e(0x974d66334cfd216a),
+	C64e(0x35b49831db411570), C64e(0xea1e0fbbedcd549b),
+	C64e(0x9ad063a151974072), C64e(0xf6759dbf91476fe2)
+};
+
+static const uint64_t mb_jh512_iv[16] = {
+	C64e(0x6fd14b963e00aa17), C64e(0x636a2e057a15d543),
+	C64e(0x8a225e8d0c97ef0b), C64e(0xe9341259f2b3c361),
+	C64e(0x891da0c1536f801e), C64e(0x2aa9056bea2b6d80),
+	C64e(0x588eccdb2075baa6), C64e(0xa90f3a76baf83bf7),
+	C64e(0x0169e60541e34a69), C64e(0x46b58a8e2e6fe65a),
+	C64e(0x1047a7d0c1843c24), C64e(0x3b6e71b12d5ac199),
+	C64e(0xcf57f6ec9db1f856), C64e(0xa706887c5716b156),
+	C64e(0xe3c2fcdfe68517fb), C64e(0x545a4678cc8cdd4b)
+};
+
+static const uint64_t mb_sha512_k[80] = {
+	SPH_C64(0x428A2F98D728AE22), SPH_C64(0x7137449123EF65CD),
+	SPH_C64(0xB5C0FBCFEC4D3B2F), SPH_C64(0xE9B5DBA58189DBBC),
+	SPH_C64(0x3956C25BF348B538), SPH_C64(0x59F111F1B605D019),
+	SPH_C64(0x923F82A4AF194F9B), SPH_C64(0xAB1C5ED5DA6D8118),
+	SPH_C64(0xD807AA98A3030242), SPH_C64(0x12835B0145706FBE),
+	SPH_C64(0x243185BE4EE4B28C), SPH_C64(0x550C7DC3D5FFB4E2),
+	SPH_C64(0x72BE5D74F27B896F), SPH_C64(0x80DEB1FE3B1696B1),
+	SPH_C64(0x9BDC06A725C71235), SPH_C64(0xC19BF174CF692694),
+	SPH_C64(0xE49B69C19EF14AD2), SPH_C64(0xEFBE4786384F25E3),
+	SPH_C64(0x0FC19DC68B8CD5B5), SPH_C64(0x240CA1CC77AC9C65),
+	SPH_C64(0x2DE92C6F592B0275), SPH_C64(0x4A7484AA6EA6E483),
+	SPH_C64(0x5CB0A9DCBD41FBD4), SPH_C64(0x76F988DA831153B5),
+	SPH_C64(0x983E5152EE66DFAB), SPH_C64(0xA831C66D2DB43210),
+	SPH_C64(0xB00327C898FB213F), SPH_C64(0xBF597FC7BEEF0EE4),
+	SPH_C64(0xC6E00BF33DA88FC2), SPH_C64(0xD5A79147930AA725),
+	SPH_C64(0x06CA6351E003826F), SPH_C64(0x142929670A0E6E70),
+	SPH_C64(0x27B70A8546D22FFC), SPH_C64(0x2E1B21385C26C926),
+	SPH_C64(0x4D2C6DFC5AC42AED), SPH_C64(0x53380D139D95B3DF),
+	SPH_C64(0x650A73548BAF63DE), SPH_C64(0x766A0ABB3C77B2A8),
+	SPH_C64(0x81C2C92E47EDAEE6), SPH_C64(0x92722C851482353B),
+	SPH_C64(0xA2BFE8A14CF10364), SPH_C64(0xA81A664BBC423001),
+	SPH_C64(0xC24B8B70D0F89791), SPH_C64(0xC76C51A30654BE30),
+	SPH_C64(0xD192E819D6EF5218), SPH_C64(0xD69906245565A910),
+	SPH_C64(0xF40E35855771202A), SPH_C64(0x106AA07032BBD1B8),
+	SPH_C64(0x19A4C116B8D2D0C8), SPH_C64(0x1E376C085141AB53),
+	SPH_C64(0x2748774CDF8EEB99), SPH_C64(0x34B0BCB5E19B48A8),
+	SPH_C64(0x391C0CB3C5C95A63), SPH_C64(0x4ED8AA4AE3418ACB),
+	SPH_C64(0x5B9CCA4F7763E373), SPH_C64(0x682E6FF3D6B2B8A3),
+	SPH_C64(0x748F82EE5DEFB2FC), SPH_C64(0x78A5636F43172F60),
+	SPH_C64(0x84C87814A1F0AB72), SPH_C64(0x8CC702081A6439EC),
+	SPH_C64(0x90BEFFFA23631E28), SPH_C64(0xA4506CEBDE82BDE9),
+	SPH_C64(0xBEF9A3F7B2C67915), SPH_C64(0xC67178F2E372532B),
+	SPH_C64(0xCA273ECEEA26619C), SPH_C64(0xD186B8C721C0C207),
+	SPH_C64(0xEADA7DD6CDE0EB1E), SPH_C64(0xF57D4F7FEE6ED178),
+	SPH_C64(0x06F067AA72176FBA), SPH_C64(0x0A637DC5A2C898A6),
+	SPH_C64(0x113F9804BEF90DAE), SPH_C64(0x1B710B35131C471B),
+	SPH_C64(0x28DB77F523047D84), SPH_C64(0x32CAAB7B40C72493),
+	SPH_C64(0x3C9EBE0A15C9BEBC), SPH_C64(0x431D67C49C100D4C),
+	SPH_C64(0x4CC5D4BECB3E42B6), SPH_C64(0x597F299CFC657E2A),
+	SPH_C64(0x5FCB6FAB3AD6FAEC), SPH_C64(0x6C44198C4A475817)
+};
+
+static const uint64_t mb_sha512_iv[8] = {
+	SPH_C64(0x6A09E667F3BCC908), SPH_C64(0xBB67AE8584CAA73B),
+	SPH_C64(0x3C6EF372FE94F82B), SPH_C64(0xA54FF53A5F1D36F1),
+	SPH_C64(0x510E527FADE682D1), SPH_C64(0x9B05688C2B3E6C1F),
+	SPH_C64(0x1F83D9ABFB41BD6B), SPH_C64(0x5BE0CD19137E2179)
+};
+
+static const uint32_t mb_cubehash512_iv[32] = {
+	SPH_C32(0x2AEA2A61), SPH_C32(0x50F494D4), SPH_C32(0x2D538B8B),
+	SPH_C32(0x4167D83E), SPH_C32(0x3FEE2313), SPH_C32(0xC701CF8C),
+	SPH_C32(0xCC39968E), SPH_C32(0x50AC5695), SPH_C32(0x4D42C787),
+	SPH_C32(0xA647A8B3), SPH_C32(0x97CF0BEF), SPH_C32(0x825B4537),
+	SPH_C32(0xEEF864D2), SPH_C32(0xF22090C4), SPH_C32(0xD0E5CD33),
+	SPH_C32(0xA23911AE), SPH_C32(0xFCD398D9), SPH_C32(0x148FE485),
+	SPH_C32(0x1B017BEF), SPH_C32(0xB6444532), SPH_C32(0x6A536159),
+	SPH_C32(0x2FF5781C), SPH_C32(0x91FA7934), SPH_C32(0x0DBADEA9),
+	SPH_C32(0xD65C8A2B), SPH_C32(0xA5A70E75), SPH_C32(0xB1C62456),
+	SPH_C32(0xBC796576), SPH_C32(0x1921C8F7), SPH_C32(0xE7989AF1),
+	SPH_C32(0x7795D246), SPH_C32(0xD43E3B44)
+};
+
+static const uint32_t mb_shabal512_a[12] = {
+	SPH_C32(0x20728DFD), SPH_C32(0x46C0BD53), SPH_C32(0xE782B699), SPH_C32(0x55304632),
+	SPH_C32(0x71B4EF90), SPH_C32(0x0EA9E82C), SPH_C32(0xDBB930F1), SPH_C32(0xFAD06B8B),
+	SPH_C32(0xBE0CAE40), SPH_C32(0x8BD14410), SPH_C32(0x76D2ADAC), SPH_C32(0x28ACAB7F)
+};
+
+static const uint32_t mb_shabal512_b[16] = {
+	SPH_C32(0xC1099CB7), SPH_C32(0x07B385F3), SPH_C32(0xE7442C26), SPH_C32(0xCC8AD640),
+	SPH_C32(0xEB6F56C7), SPH_C32(0x1EA81AA9), SPH_C32(0x73B9D314), SPH_C32(0x1DE85D08),
+	SPH_C32(0x48910A5A), SPH_C32(0x893B22DB), SPH_C32(0xC5A0DF44), SPH_C32(0xBBC4324E),
+	SPH_C32(0x72D2F240), SPH_C32(0x75941D99), SPH_C32(0x6D8BDE82), SPH_C32(0xA1A7502B)
+};
+
+static const uint32_t mb_shabal512_c[16] = {
+	SPH_C32(0xD9BF68D1), SPH_C32(0x58BAD750), SPH_C32(0x56028CB2), SPH_C32(0x8134F359),
+	SPH_C32(0xB5D469D8), SPH_C32(0x941A8CC2), SPH_C32(0x418B2A6E), SPH_C32(0x04052780),
+	SPH_C32(0x7F07D787), SPH_C32(0x5194358F), SPH_C32(0x3C60D665), SPH_C32(0xBE97D79A),
+	SPH_C32(0x950C3434), SPH_C32(0xAED9A06D), SPH_C32(0x2537DC8D), SPH_C32(0x7CDB5969)
+};
+
+static const uint32_t mb_luffa512_iv[5][8] = {
+	{
+		SPH_C32(0x6d251e69), SPH_C32(0x44b051e0),
+		SPH_C32(0x4eaa6fb4), SPH_C32(0xdbf78465),
+		SPH_C32(0x6e292011), SPH_C32(0x90152df4),
+		SPH_C32(0xee058139), SPH_C32(0xdef610bb)
+	}, {
+		SPH_C32(0xc3b44b95), SPH_C32(0xd9d2f256),
+		SPH_C32(0x70eee9a0), SPH_C32(0xde099fa3),
+		SPH_C32(0x5d9b0557), SPH_C32(0x8fc944b3),
+		SPH_C32(0xcf1ccf0e), SPH_C32(0x746cd581)
+	}, {
+		SPH_C32(0xf7efc89d), SPH_C32(0x5dba5781),
+		SPH_C32(0x04016ce5), SPH_C32(0xad659c05),
+		SPH_C32(0x0306194f), SPH_C32(0x666d1836),
+		SPH_C32(0x24aa230a), SPH_C32(0x8b264ae7)
+	}, {
+		SPH_C32(0x858075d5), SPH_C32(0x36d79cce),
+		SPH_C32(0xe571f7d7), SPH_C32(0x204b1f67),
+		SPH_C32(0x35870c6a), SPH_C32(0x57e9e923),
+		SPH_C32(0x14bcb808), SPH_C32(0x7cde72ce)
+	}, {
+		SPH_C32(0x6c68e9be), SPH_C32(0x5ec41e22),
+		SPH_C32(0xc825b7c7), SPH_C32(0xaffb4363),
+		SPH_C32(0xf5df3999), SPH_C32(0x0fc688f1),
+		SPH_C32(0xb07224cc), SPH_C32(0x03e86cea)
+	}
+};
+
+static const uint32_t mb_luffa_rc00[8] = {
+	SPH_C32(0x303994a6), SPH_C32(0xc0e65299),
+	SPH_C32(0x6cc33a12), SPH_C32(0xdc56983e),
+	SPH_C32(0x1e00108f), SPH_C32(0x7800423d),
+	SPH_C32(0x8f5b7882), SPH_C32(0x96e1db12)
+};
+
+static const uint32_t mb_luffa_rc04[8] = {
+	SPH_C32(0xe0337818), SPH_C32(0x441ba90d),
+	SPH_C32(0x7f34d442), SPH_C32(0x9389217f),
+	SPH_C32(0xe5a8bce6), SPH_C32(0x5274baf4),
+	SPH_C32(0x26889ba7), SPH_C32(0x9a226e9d)
+};
+
+static const uint32_t mb_luffa_rc10[8] = {
+	SPH_C32(0xb6de10ed), SPH_C32(0x70f47aae),
+	SPH_C32(0x0707a3d4), SPH_C32(0x1c1e8f51),
+	SPH_C32(0x707a3d45), SPH_C32(0xaeb28562),
+	SPH_C32(0xbaca1589), SPH_C32(0x40a46f3e)
+};
+
+static const uint32_t mb_luffa_rc14[8] = {
+	SPH_C32(0x01685f3d), SPH_C32(0x05a17cf4),
+	SPH_C32(0xbd09caca), SPH_C32(0xf4272b28),
+	SPH_C32(0x144ae5cc), SPH_C32(0xfaa7ae2b),
+	SPH_C32(0x2e48f1c1), SPH_C32(0xb923c704)
+};
+
+static const uint32_t mb_luffa_rc20[8] = {
+	SPH_C32(0xfc20d9d2), SPH_C32(0x34552e25),
+	SPH_C32(0x7ad8818f), SPH_C32(0x8438764a),
+	SPH_C32(0xbb6de032), SPH_C32(0xedb780c8),
+	SPH_C32(0xd9847356), SPH_C32(0xa2c78434)
+};
+
+static const uint32_t mb_luffa_rc24[8] = {
+	SPH_C32(0xe25e72c1), SPH_C32(0xe623bb72),
+	SPH_C32(0x5c58a4a4), SPH_C32(0x1e38e2e7),
+	SPH_C32(0x78e38b9d), SPH_C32(0x27586719),
+	SPH_C32(0x36eda57f), SPH_C32(0x703aace7)
+};
+
+static const uint32_t mb_luffa_rc30[8] = {
+	SPH_C32(0xb213afa5), SPH_C32(0xc84ebe95),
+	SPH_C32(0x4e608a22), SPH_C32(0x56d858fe),
+	SPH_C32(0x343b138f), SPH_C32(0xd0ec4e3d),
+	SPH_C32(0x2ceb4882), SPH_C32(0xb3ad2208)
+};
+
+static const uint32_t mb_luffa_rc34[8] = {
+	SPH_C32(0xe028c9bf), SPH_C32(0x44756f91),
+	SPH_C32(0x7e8fce32), SPH_C32(0x956548be),
+	SPH_C32(0xfe191be2), SPH_C32(0x3cb226e5),
+	SPH_C32(0x5944a28e), SPH_C32(0xa1c4c355)
+};
+
+static const uint32_t mb_luffa_rc40[8] = {
+	SPH_C32(0xf0d2e9e3), SPH_C32(0xac11d7fa),
+	SPH_C32(0x1bcb66f2), SPH_C32(0x6f2d9bc9),
+	SPH_C32(0x78602649), SPH_C32(0x8edae952),
+	SPH_C32(0x3b6ba548), SPH_C32(0xedae9520)
+};
+
+static const uint32_t mb_luffa_rc44[8] = {
+	SPH_C32(0x5090d577), SPH_C32(0x2d1925ab),
+	SPH_C32(0xb46496ac), SPH_C32(0xd1925ab0),
+	SPH_C32(0x29131ab6), SPH_C32(0x0fc053c3),
+	SPH_C32(0x3f014f0c), SPH_C32(0xfc053c31)
+};
+
+#undef C64e
+
+/* compression functions of a vector width */
+typedef struct {
+	int lanes64, lanes32;
+	void (*blake512)(uint64_t *h, const uint64_t *m, uint64_t t0);
+	void (*bmw512)(uint64_t *h, const uint64_t *m);
+	void (*bmw512_final)(uint64_t *h);
+	void (*keccak512)(uint64_t *a, const uint64_t *m);
+	void (*skein512)(uint64_t *h, const uint64_t *m, uint64_t t0, uint64_t t1);
+	void (*jh512)(uint64_t *h, const uint64_t *m);
+	void (*sha512)(uint64_t *h, const uint64_t *m);
+	void (*cubehash512)(uint32_t *x, const uint32_t *m, int n);
+	void (*shabal512)(uint32_t *st, const uint32_t *m, uint32_t wlow, uint32_t whigh, int last);
+	void (*luffa512)(uint32_t *v, const uint32_t *m);
+} mb512_impl;
+
+#if defined(MB512_AVX2)
+#define MB_LANES64 4
+#define MB_LANES32 8
+#define MB_TARGET MB512_TARGET("avx2")
+#define MB_FN(name) mb512_ ## name ## _avx2
+#define vec __m256i
+#define v_load(p) _mm256_loadu_si256((const __m256i *)(p))
+#define v_store(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#define v_xor(a, b) _mm256_xor_si256(a, b)
+#define v_and(a, b) _mm256_and_si256(a, b)
+#define v_or(a, b) _mm256_or_si256(a, b)
+#define v_andnot(a, b) _mm256_andnot_si256(a, b)
+#define v_not(a) _mm256_xor_si256(a, _mm256_set1_epi32(-1))
+#define v64_add(a, b) _mm256_add_epi64(a, b)
+#define v64_sub(a, b) _mm256_sub_epi64(a, b)
+#define v64_set1(x) _mm256_set1_epi64x((long long) (x))
+#define v64_shl(a, n) _mm256_slli_epi64(a, n)
+#define v64_shr(a, n) _mm256_srli_epi64(a, n)
+#define v64_rotl(a, n) _mm256_or_si256(_mm256_slli_epi64(a, n), _mm256_srli_epi64(a, 64 - (n)))
+#define v32_add(a, b) _mm256_add_epi32(a, b)
+#define v32_sub(a, b) _mm256_sub_epi32(a, b)
+#define v32_set1(x) _mm256_set1_epi32((int) (x))
+#define v32_shl(a, n) _mm256_slli_epi32(a, n)
+#define v32_shr(a, n) _mm256_srli_epi32(a, n)
+#define v32_rotl(a, n) _mm256_or_si256(_mm256_slli_epi32(a, n), _mm256_srli_epi32(a, 32 - (n)))
+#include "mb512_lanes.h"
+#endif
+
+#if defined(MB512_AVX512)
+#define MB_LANES64 8
+#define MB_LANES32 16
+#define MB_TARGET MB512_TARGET("avx512f")
+#define MB_FN(name) mb512_ ## name ## _avx512
+#define vec __m512i
+#define v_load(p) _mm512_loadu_si512((const void *)(p))
+#define v_store(p, v) _mm512_storeu_si512((void *)(p), v)
+#define v_xor(a, b) _mm512_xor_si512(a, b)
+#define v_and(a, b) _mm512_and_si512(a, b)
+#define v_or(a, b) _mm512_or_si512(a, b)
+#define v_andnot(a, b) _mm512_andnot_si512(a, b)
+#define v_not(a) _mm512_xor_si512(a, _mm512_set1_epi32(-1))
+#define v64_add(a, b) _mm512_add_epi64(a, b)
+#define v64_sub(a, b) _mm512_sub_epi64(a, b)
+#define v64_set1(x) _mm512_set1_epi64((long long) (x))
+#define v64_shl(a, n) _mm512_slli_epi64(a, n)
+#define v64_shr(a, n) _mm512_srli_epi64(a, n)
+#define v64_rotl(a, n) _mm512_rol_epi64(a, n)
+#define v32_add(a, b) _mm512_add_epi32(a, b)
+#define v32_sub(a, b) _mm512_sub_epi32(a, b)
+#define v32_set1(x) _mm512_set1_epi32((int) (x))
+#define v32_shl(a, n) _mm512_slli_epi32(a, n)
+#define v32_shr(a, n) _mm512_srli_epi32(a, n)
+#define v32_rotl(a, n) _mm512_rol_epi32(a, n)
+#include "mb512_lanes.h"
+#endif
+
+/* bytes [off, off + size) of the message followed by its padding */
+static inline void mb512_block(unsigned char *blk, const unsigned char *msg, size_t len,
+	const unsigned char *pad, size_t off, size_t size)
+{
+	size_t n = 0;
+	if (off < len) {
+		n = len - off < size ? len - off : size;
+		memcpy(blk, msg + off, n);
+	}
+	memcpy(blk + n, pad + (off + n - len), size - n);
+}
+
+/* padded blocks <-> interleaved lanes */
+static void mb512_load64(uint64_t *w, int words, const unsigned char **src, size_t len,
+	const unsigned char *pad, size_t off, int lanes, int be)
+{
+	unsigned char blk[128];
+	for (int l = 0; l < lanes; l++) {
+		mb512_block(blk, src[l], len, pad, off, words * 8);
+		for (int i = 0; i < words; i++)
+			w[i * lanes + l] = be ? sph_dec64be(blk + 8 * i) : sph_dec64le(blk + 8 * i);
+	}
+}
+
+static void mb512_load32(uint32_t *w, int words, const unsigned char **src, size_t len,
+	const unsigned char *pad, size_t off, int lanes, int be)
+{
+	unsigned char blk[64];
+	for (int l = 0; l < lanes; l++) {
+		mb512_block(blk, src[l], len, pad, off, words * 4);
+		for (int i = 0; i < words; i++)
+			w[i * lanes + l] = be ? sph_dec32be(blk + 4 * i) : sph_dec32le(blk + 4 * i);
+	}
+}
+
+static void mb512_store64(unsigned char **dst, const uint64_t *w, int first, int words, int lanes, int be)
+{
+	for (int l = 0; l < lanes; l++)
+		for (int i = 0; i < words; i++) {
+			if (be) sph_enc64be(dst[l] + 8 * i, w[(first + i) * lanes + l]);
+			else sph_enc64le(dst[l] + 8 * i, w[(first + i) * lanes + l]);
+		}
+}
+
+static void mb512_store32(unsigned char **dst, const uint32_t *w, int first, int words, int lanes, int be)
+{
+	for (int l = 0; l < lanes; l++)
+		for (int i = 0; i < words; i++) {
+			if (be) sph_enc32be(dst[l] + 4 * i, w[(first + i) * lanes + l]);
+			else sph_enc32le(dst[l] + 4 * i, w[(first + i) * lanes + l]);
+		}
+}
+
+static inline void mb512_set64(uint64_t *w, const uint64_t *words, int count, int lanes)
+{
+	for (int i = 0; i < count; i++)
+		for (int l = 0; l < lanes; l++)
+			w[i * lanes + l] = words[i];
+}
+
+static inline void mb512_set32(uint32_t *w, const uint32_t *words, int count, int lanes)
+{
+	for (int i = 0; i < count; i++)
+		for (int l = 0; l < lanes; l++)
+			w[i * lanes + l] = words[i];
+}
+
+/*
+ * one chunk of lanes messages of len bytes, all the lanes have the same
+ * padding and number of blocks. pad holds the bytes after the message.
+ */
+typedef void (*mb512_chunk_fn)(const mb512_impl *im, int lanes, unsigned char **dst,
+	const unsigned char **src, size_t len);
+
+static void mb512_blake512(const mb512_impl *im, int lanes, unsigned char **dst,
+	const unsigned char **src, size_t len)
+{
+	uint64_t _ALIGN(64) H[8*8], M[16*8];
+	unsigned char pad[256];
+	const size_t total = (len + 17 + 127) & ~(size_t) 127;
+
+	memset(pad, 0, total - len);
+	pad[0] = 0x80;
+	pad[total - len - 17] |= 1;
+	sph_enc64be(pad + total - len - 8, (sph_u64) len << 3);
+	mb512_set64(H, mb_blake512_iv, 8, lanes);
+	for (size_t off = 0; off < total; off += 128) {
+		// message bits up to this block, 0 for a padding only block
+		uint64_t t0 = off < len ? (uint64_t) (off + 128 < len ? off + 128 : len) << 3 : 0;
+		mb512_load64(M, 16, src, len, pad, off, lanes, 1);
+		im->blake512(H, M, t0);
+	}
+	mb512_store64(dst, H, 0, 8, lanes, 1);
+}
+
+static void mb512_bmw512(const mb512_impl *im, int lanes, unsigned char **dst,
+	const unsigned char **src, size_t len)
+{
+	uint64_t _ALIGN(64) H[16*8], M[16*8];
+	unsigned char pad[256];
+	const size_t total = (len + 9 + 127) & ~(size_t) 127;
+
+	memset(pad, 0, total - len);
+	pad[0] = 0x80;
+	sph_enc64le(pad + total - len - 8, (sph_u64) len << 3);
+	mb512_set64(H, mb_bmw512_iv, 16, lanes);
+	for (size_t off = 0; off < total; off += 128) {
+		mb512_load64(M, 16, src, len, pad, off, lanes, 0);
+		im->bmw512(H, M);
+	}
+	im->bmw512_final(H);
+	mb512_store64(dst, H, 8, 8, lanes, 0);
+}
+
+static void mb512_keccak512(const mb512_impl *im, int lanes, unsigned char **dst,
+	const unsigned char **src, size_t len)
+{
+	uint64_t _ALIGN(64) A[25*8], M[9*8];
+	unsigned char pad[256];
+	const size_t total = (len / 72 + 1) * 72;
+
+	memset(pad, 0, total - len);
+	pad[0] = 0x01;
+	pad[total - len - 1] |= 0x80;
+	memset(A, 0, sizeof(A));
+	for (size_t off = 0; off < total; off += 72) {
+		mb512_load64(M, 9, src, len, pad, off, lanes, 0);
+		im->keccak512(A, M);
+	}
+	mb512_store64(dst, A, 0, 8, lanes, 0);
+}
+
+#define SKEIN_T1_FIRST  0x4000000000000000ULL
+#define SKEIN_T1_MSG    0x3000000000000000ULL
+#define SKEIN_T1_FINAL  0x8000000000000000ULL
+#define SKEIN_T1_OUT    0xFF00000000000000ULL
+
+static void mb512_skein512(const mb512_impl *im, int lanes, unsigned char **dst,
+	const unsigned char **src, size_t len)
+{
+	uint64_t _ALIGN(64) H[8*8], M[8*8];
+	unsigned char pad[64];
+	// no padding bit, the last block (at least one) is completed with zeros
+	const size_t blocks = len ? (len + 63) / 64 : 1;
+
+	memset(pad, 0, sizeof(pad));
+	mb512_set64(H, mb_skein512_iv, 8, lanes);
+	for (size_t b = 0; b < blocks; b++) {
+		const bool last = (b == blocks - 1);
+		uint64_t t1 = SKEIN_T1_MSG | (b ? 0 : SKEIN_T1_FIRST) | (last ? SKEIN_T1_FINAL : 0);
+		mb512_load64(M, 8, src, len, pad, b * 64, lanes, 0);
+		im->skein512(H, M, last ? (uint64_t) len : (uint64_t) (b + 1) * 64, t1);
+	}
+	memset(M, 0, sizeof(M));
+	im->skein512(H, M, 8, SKEIN_T1_OUT);
+	mb512_store64(dst, H, 0, 8, lanes, 0);
+}
+
+static void mb512_jh512(const mb512_impl *im, int lanes, unsigned char **dst,
+	const unsigned char **src, size_t len)
+{
+	uint64_t _ALIGN(64) H[16*8], M[8*8];
+	unsigned char pad[256];
+	const size_t total = (len & ~(size_t) 63) + ((len & 63) ? 128 : 64);
+
+	memset(pad, 0, total - len);
+	pad[0] = 0x80;
+	sph_enc64be(pad + total - len - 8, (sph_u64) len << 3);
+	mb512_set64(H, mb_jh512_iv, 16, lanes);
+	for (size_t off = 0; off < total; off += 64) {
+		mb512_load64(M, 8, src, len, pad, off, lanes, 0);
+		im->jh512(H, M);
+	}
+	mb512_store64(dst, H, 8, 8, lanes, 0);
+}
+
+static void mb512_sha512(const mb512_impl *im, int lanes, unsigned char **dst,
+	const unsigned char **src, size_t len)
+{
+	uint64_t _ALIGN(64) H[8*8], M[16*8];
+	unsigned char pad[256];
+	const size_t total = (len + 17 + 127) & ~(size_t) 127;
+
+	memset(pad, 0, total - len);
+	pad[0] = 0x80;
+	sph_enc64be(pad + total - len - 8, (sph_u64) len << 3);
+	mb512_set64(H, mb_sha512_iv, 8, lanes);
+	for (size_t off = 0; off < total; off += 128) {
+		mb512_load64(M, 16, src, len, pad, off, lanes, 1);
+		im->sha512(H, M);
+	}
+	mb512_store64(dst, H, 0, 8, lanes, 1);
+}
+
+static void mb512_cubehash512(const mb512_impl *im, int lanes, unsigned char **dst,
+	const unsigned char **src, size_t len)
+{
+	uint32_t _ALIGN(64) X[32*16], M[8*16];
+	unsigned char pad[64];
+	const size_t total = (len / 32 + 1) * 32;
+
+	memset(pad, 0, sizeof(pad));
+	pad[0] = 0x80;
+	mb512_set32(X, mb_cubehash512_iv, 32, lanes);
+	for (size_t off = 0; off < total; off += 32) {
+		mb512_load32(M, 8, src, len, pad, off, lanes, 0);
+		im->cubehash512(X, M, 1);
+	}
+	for (int l = 0; l < lanes; l++)
+		X[31 * lanes + l] ^= 1;
+	im->cubehash512(X, NULL, 10);
+	mb512_store32(dst, X, 0, 16, lanes, 0);
+}
+
+static void mb512_shabal512(const mb512_impl *im, int lanes, unsigned char **dst,
+	const unsigned char **src, size_t len)
+{
+	uint32_t _ALIGN(64) S[44*16], M[16*16];
+	unsigned char pad[64];
+	const size_t total = (len / 64 + 1) * 64;
+	uint64_t w = 1;
+
+	memset(pad, 0, sizeof(pad));
+	pad[0] = 0x80;
+	mb512_set32(S, mb_shabal512_a, 12, lanes);
+	mb512_set32(S + 12 * lanes, mb_shabal512_b, 16, lanes);
+	mb512_set32(S + 28 * lanes, mb_shabal512_c, 16, lanes);
+	for (size_t off = 0; off < total; off += 64, w++) {
+		mb512_load32(M, 16, src, len, pad, off, lanes, 0);
+		im->shabal512(S, M, (uint32_t) w, (uint32_t) (w >> 32), off + 64 == total);
+	}
+	mb512_store32(dst, S, 12, 16, lanes, 0);
+}
+
+static void mb512_luffa512(const mb512_impl *im, int lanes, unsigned char **dst,
+	const unsigned char **src, size_t len)
+{
+	uint32_t _ALIGN(64) V[40*16], M[8*16];
+	unsigned char pad[64];
+	const size_t total = (len / 32 + 1) * 32;
+
+	memset(pad, 0, sizeof(pad));
+	pad[0] = 0x80;
+	mb512_set32(V, &mb_luffa512_iv[0][0], 40, lanes);
+	for (size_t off = 0; off < total; off += 32) {
+		mb512_load32(M, 8, src, len, pad, off, lanes, 1);
+		im->luffa512(V, M);
+	}
+	// two blank rounds, 32 bytes of output each
+	for (int k = 0; k < 2; k++) {
+		im->luffa512(V, NULL);
+		for (int l = 0; l < lanes; l++)
+			for (int i = 0; i < 8; i++) {
+				uint32_t x = 0;
+				for (int j = 0; j < 5; j++)
+					x ^= V[(j * 8 + i) * lanes + l];
+				sph_enc32be(dst[l] + 32 * k + 4 * i, x);
+			}
+	}
+}
+
+#define MB512_CHUNK(fn) fn
+
+#else
+
+typedef struct { int lanes64, lanes32; } mb512_impl;
+typedef void (*mb512_chunk_fn)(const mb512_impl *im, int lanes, unsigned char **dst,
+	const unsigned char **src, size_t len);
+#define MB512_CHUNK(fn) NULL
+
+#endif /* MB512_VECTOR */
+
+union mb512_ctx {
+	sph_blake512_context     blake;
+	sph_bmw512_context       bmw;
+	sph_keccak512_context    keccak;
+	sph_skein512_context     skein;
+	sph_jh512_context        jh;
+	sph_sha512_context       sha512;
+	sph_cubehash512_context  cubehash;
+	sph_shabal512_context    shabal;
+	sph_luffa512_context     luffa;
+};
+
+enum mb512_id {
+	MB512_BLAKE = 0,
+	MB512_BMW,
+	MB512_KECCAK,
+	MB512_SKEIN,
+	MB512_JH,
+	MB512_SHA512,
+	MB512_CUBEHASH,
+	MB512_SHABAL,
+	MB512_LUFFA,
+	MB512_COUNT
+};
+
+static const struct mb512_algo {
+	void (*init)(void *cc);
+	void (*update)(void *cc, const void *data, size_t len);
+	void (*close)(void *cc, void *dst);
+	bool wide32;  // 32 bits words, twice more lanes
+	mb512_chunk_fn chunk;
+} mb512_algos[MB512_COUNT] = {
+	{ sph_blake512_init, sph_blake512, sph_blake512_close, false, MB512_CHUNK(mb512_blake512) },
+	{ sph_bmw512_init, sph_bmw512, sph_bmw512_close, false, MB512_CHUNK(mb512_bmw512) },
+	{ sph_keccak512_init, sph_keccak512, sph_keccak512_close, false, MB512_CHUNK(mb512_keccak512) },
+	{ sph_skein512_init, sph_skein512, sph_skein512_close, false, MB512_CHUNK(mb512_skein512) },
+	{ sph_jh512_init, sph_jh512, sph_jh512_close, false, MB512_CHUNK(mb512_jh512) },
+	{ sph_sha512_init, sph_sha512, sph_sha512_close, false, MB512_CHUNK(mb512_sha512) },
+	{ sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close, true, MB512_CHUNK(mb512_cubehash512) },
+	{ sph_shabal512_init, sph_shabal512, sph_shabal512_close, true, MB512_CHUNK(mb512_shabal512) },
+	{ sph_luffa512_init, sph_luffa512, sph_luffa512_close, true, MB512_CHUNK(mb512_luffa512) },
+};
+
+static void mb512_scalar(const struct mb512_algo *a, void *dst, const void *src, size_t len)
+{
+	union mb512_ctx ctx;
+	a->init(&ctx);
+	a->update(&ctx, src, len);
+	a->close(&ctx, dst);
+}
+
+static struct {
+	const mb512_impl *impl;
+	char name[32];
+} mb512;
+static pthread_once_t mb512_once = PTHREAD_ONCE_INIT;
+
+#if defined(MB512_VECTOR)
+/* all the algos of an implementation against sph, on lengths around the block sizes */
+static bool mb512_check(const mb512_impl *im)
+{
+	static const size_t lens[] = { 0, 31, 64, 80, 111, 112, 127, 128, 144, 200 };
+	unsigned char in[MB512_MAX_LANES][200], out[MB512_MAX_LANES][64], ref[64];
+	const unsigned char *src[MB512_MAX_LANES];
+	unsigned char *dst[MB512_MAX_LANES];
+
+	for (int a = 0; a < MB512_COUNT; a++) {
+		const int lanes = mb512_algos[a].wide32 ? im->lanes32 : im->lanes64;
+		for (int l = 0; l < lanes; l++) {
+			for (int i = 0; i < 200; i++)
+				in[l][i] = (unsigned char) (i * 0x9d + l * 0x3b + a);
+			src[l] = in[l];
+			dst[l] = out[l];
+		}
+		for (int n = 0; n < ARRAY_SIZE(lens); n++) {
+			mb512_algos[a].chunk(im, lanes, dst, src, lens[n]);
+			for (int l = 0; l < lanes; l++) {
+				mb512_scalar(&mb512_algos[a], ref, in[l], lens[n]);
+				if (memcmp(ref, out[l], 64))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+#endif
+
+static void mb512_init(void)
+{
+	const mb512_impl *impl = NULL;
+	int flags;
+
+	flags = mb512_cpu();
+#if defined(MB512_AVX512)
+	if ((flags & CPU_AVX512) && mb512_check(&mb512_impl_avx512))
+		impl = &mb512_impl_avx512;
+#endif
+#if defined(MB512_AVX2)
+	if (!impl && (flags & CPU_AVX2) && mb512_check(&mb512_impl_avx2))
+		impl = &mb512_impl_avx2;
+#endif
+	if (impl)
+		snprintf(mb512.name, sizeof(mb512.name), "%s x%d",
+			impl->lanes64 == 8 ? "AVX-512" : "AVX2", impl->lanes64);
+	else
+		snprintf(mb512.name, sizeof(mb512.name), "scalar");
+	(void) flags;
+	mb512.impl = impl;
+}
+
+int sph_mb512_lanes(void)
+{
+	pthread_once(&mb512_once, mb512_init);
+	return mb512.impl ? mb512.impl->lanes64 : 1;
+}
+
+const char* sph_mb512_name(void)
+{
+	pthread_once(&mb512_once, mb512_init);
+	return mb512.name;
+}
+
+static void mb512_hash(int id, void *dst, const void *src, size_t len, int count)
+{
+	const struct mb512_algo *a = &mb512_algos[id];
+	const unsigned char *in = (const unsigned char *) src;
+	unsigned char *out = (unsigned char *) dst;
+	int n = 0;
+
+	pthread_once(&mb512_once, mb512_init);
+
+	if (mb512.impl && a->chunk) {
+		const int lanes = a->wide32 ? mb512.impl->lanes32 : mb512.impl->lanes64;
+		unsigned char _ALIGN(64) spare[64];
+		// a partial chunk repeats the last message, while it is still
+		// faster than the remaining ones one by one
+		while ((count - n) * 2 >= lanes) {
+			const unsigned char *s[MB512_MAX_LANES];
+			unsigned char *d[MB512_MAX_LANES];
+			for (int l = 0; l < lanes; l++) {
+				const int k = n + l < count ? n + l : count - 1;
+				s[l] = in + (size_t) k * len;
+				d[l] = n + l < count ? out + (size_t) k * 64 : spare;
+			}
+			a->chunk(mb512.impl, lanes, d, s, len);
+			n += lanes;
+		}
+	}
+
+	for (; n < count; n++)
+		mb512_scalar(a, out + (size_t) n * 64, in + (size_t) n * len, len);
+}
+
+void sph_blake512_mb(void *dst, const void *src, size_t len, int count)
+{
+	mb512_hash(MB512_BLAKE, dst, src, len, count);
+}
+
+void sph_bmw512_mb(void *dst, const void *src, size_t len, int count)
+{
+	mb512_hash(MB512_BMW, dst, src, len, count);
+}
+
+void sph_keccak512_mb(void *dst, const void *src, size_t len, int count)
+{
+	mb512_hash(MB512_KECCAK, dst, src, len, count);
+}
+
+void sph_skein512_mb(void *dst, const void *src, size_t len, int count)
+{
+	mb512_hash(MB512_SKEIN, dst, src, len, count);
+}
+
+void sph_jh512_mb(void *dst, const void *src, size_t len, int count)
+{
+	mb512_hash(MB512_JH, dst, src, len, count);
+}
+
+void sph_sha512_mb(void *dst, const void *src, size_t len, int count)
+{
+	mb512_hash(MB512_SHA512, dst, src, len, count);
+}
+
+void sph_cubehash512_mb(void *dst, const void *src, size_t len, int count)
+{
+	mb512_hash(MB512_CUBEHASH, dst, src, len, count);
+}
+
+void sph_shabal512_mb(void *dst, const void *src, size_t len, int count)
+{
+	mb512_hash(MB512_SHABAL, dst, src, len, count);
+}
+
+void sph_luffa512_mb(void *dst, const void *src, size_t len, int count)
+{
+	mb512_hash(MB512_LUFFA, dst, src, len, count);
+}
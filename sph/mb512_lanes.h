@@ -0,0 +1,687 @@
+/*
+ * Multi-buffer compression functions of the 512 bits sph hashes, word i
+ * of lane l at [i * lanes + l]. The 64 bits primitives (blake, bmw,
+ * keccak, skein, jh, sha512) use MB_LANES64 lanes, the 32 bits ones
+ * (cubehash, shabal, luffa) MB_LANES32 lanes of the same registers.
+ *
+ * required macros:
+ * MB_LANES64, MB_LANES32, MB_TARGET, MB_FN
+ * vec, v_load, v_store, v_xor, v_and, v_or, v_andnot (~a & b), v_not,
+ * v64_add, v64_sub, v64_set1, v64_shl, v64_shr, v64_rotl,
+ * v32_add, v32_sub, v32_set1, v32_shl, v32_shr, v32_rotl
+ */
+
+#define v64_rotr(a, n)   v64_rotl(a, 64 - (n))
+
+/* blake512 */
+
+#define MB_BLAKE_G(a, b, c, d, i) { \
+	V[a] = v64_add(v64_add(V[a], V[b]), v_xor(M[s[2*(i)]], v64_set1(mb_blake512_cb[s[2*(i)+1]]))); \
+	V[d] = v64_rotr(v_xor(V[d], V[a]), 32); \
+	V[c] = v64_add(V[c], V[d]); \
+	V[b] = v64_rotr(v_xor(V[b], V[c]), 25); \
+	V[a] = v64_add(v64_add(V[a], V[b]), v_xor(M[s[2*(i)+1]], v64_set1(mb_blake512_cb[s[2*(i)]]))); \
+	V[d] = v64_rotr(v_xor(V[d], V[a]), 16); \
+	V[c] = v64_add(V[c], V[d]); \
+	V[b] = v64_rotr(v_xor(V[b], V[c]), 11); \
+}
+
+/* one block, t0 is the bit counter (the high word is always 0 here) */
+static void MB_TARGET MB_FN(blake512)(uint64_t *h, const uint64_t *m, uint64_t t0)
+{
+	vec M[16], V[16];
+	int i, r;
+
+	for (i = 0; i < 16; i++)
+		M[i] = v_load(m + i * MB_LANES64);
+	for (i = 0; i < 8; i++) {
+		V[i] = v_load(h + i * MB_LANES64);
+		V[i + 8] = v64_set1(mb_blake512_cb[i]);
+	}
+	V[12] = v64_set1(t0 ^ mb_blake512_cb[4]);
+	V[13] = v64_set1(t0 ^ mb_blake512_cb[5]);
+
+	for (r = 0; r < 16; r++) {
+		const uint8_t *s = mb_blake512_sigma[r % 10];
+		MB_BLAKE_G(0, 4,  8, 12, 0);
+		MB_BLAKE_G(1, 5,  9, 13, 1);
+		MB_BLAKE_G(2, 6, 10, 14, 2);
+		MB_BLAKE_G(3, 7, 11, 15, 3);
+		MB_BLAKE_G(0, 5, 10, 15, 4);
+		MB_BLAKE_G(1, 6, 11, 12, 5);
+		MB_BLAKE_G(2, 7,  8, 13, 6);
+		MB_BLAKE_G(3, 4,  9, 14, 7);
+	}
+
+	for (i = 0; i < 8; i++)
+		v_store(h + i * MB_LANES64, v_xor(v_load(h + i * MB_LANES64), v_xor(V[i], V[i + 8])));
+}
+
+/* bmw512 */
+
+#define mb_sb0(x)  v_xor(v_xor(v64_shr(x, 1), v64_shl(x, 3)), v_xor(v64_rotl(x,  4), v64_rotl(x, 37)))
+#define mb_sb1(x)  v_xor(v_xor(v64_shr(x, 1), v64_shl(x, 2)), v_xor(v64_rotl(x, 13), v64_rotl(x, 43)))
+#define mb_sb2(x)  v_xor(v_xor(v64_shr(x, 2), v64_shl(x, 1)), v_xor(v64_rotl(x, 19), v64_rotl(x, 53)))
+#define mb_sb3(x)  v_xor(v_xor(v64_shr(x, 2), v64_shl(x, 2)), v_xor(v64_rotl(x, 28), v64_rotl(x, 59)))
+#define mb_sb4(x)  v_xor(v64_shr(x, 1), x)
+#define mb_sb5(x)  v_xor(v64_shr(x, 2), x)
+
+/* (M ^ H) combinations of the first 16 qt words */
+#define MB_BMW_W(i0, o1, i1, o2, i2, o3, i3, o4, i4) \
+	o4(o3(o2(o1(X[i0], X[i1]), X[i2]), X[i3]), X[i4])
+
+#define MB_BMW_ROL(j, off)  v64_rotl(M[((j) + (off)) & 15], (((j) + (off)) & 15) + 1)
+
+#define MB_BMW_ELT(j) v_xor(v64_add(v64_sub(v64_add(MB_BMW_ROL(j, 0), MB_BMW_ROL(j, 3)), \
+	MB_BMW_ROL(j, 10)), v64_set1(((uint64_t) (j) + 16) * 0x0555555555555555ULL)), H[((j) + 7) & 15])
+
+#define MB_BMW_EXPAND1(i) \
+	qt[i] = v64_add(v64_add(v64_add(v64_add(mb_sb1(qt[(i) - 16]), mb_sb2(qt[(i) - 15])), \
+		v64_add(mb_sb3(qt[(i) - 14]), mb_sb0(qt[(i) - 13]))), \
+		v64_add(v64_add(mb_sb1(qt[(i) - 12]), mb_sb2(qt[(i) - 11])), \
+		v64_add(mb_sb3(qt[(i) - 10]), mb_sb0(qt[(i) - 9])))), \
+		v64_add(v64_add(v64_add(v64_add(mb_sb1(qt[(i) - 8]), mb_sb2(qt[(i) - 7])), \
+		v64_add(mb_sb3(qt[(i) - 6]), mb_sb0(qt[(i) - 5]))), \
+		v64_add(v64_add(mb_sb1(qt[(i) - 4]), mb_sb2(qt[(i) - 3])), \
+		v64_add(mb_sb3(qt[(i) - 2]), mb_sb0(qt[(i) - 1])))), MB_BMW_ELT((i) - 16)))
+
+#define MB_BMW_EXPAND2(i) \
+	qt[i] = v64_add(v64_add(v64_add(v64_add(qt[(i) - 16], v64_rotl(qt[(i) - 15], 5)), \
+		v64_add(qt[(i) - 14], v64_rotl(qt[(i) - 13], 11))), \
+		v64_add(v64_add(qt[(i) - 12], v64_rotl(qt[(i) - 11], 27)), \
+		v64_add(qt[(i) - 10], v64_rotl(qt[(i) - 9], 32)))), \
+		v64_add(v64_add(v64_add(v64_add(qt[(i) - 8], v64_rotl(qt[(i) - 7], 37)), \
+		v64_add(qt[(i) - 6], v64_rotl(qt[(i) - 5], 43))), \
+		v64_add(v64_add(qt[(i) - 4], v64_rotl(qt[(i) - 3], 53)), \
+		v64_add(mb_sb4(qt[(i) - 2]), mb_sb5(qt[(i) - 1])))), MB_BMW_ELT((i) - 16)))
+
+/* dh = compress(M, H) */
+static inline void MB_TARGET MB_FN(bmw512_compress)(vec *dh, const vec *M, const vec *H)
+{
+	vec X[16], qt[32], xl, xh;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		X[i] = v_xor(M[i], H[i]);
+
+	qt[ 0] = v64_add(mb_sb0(MB_BMW_W( 5, v64_sub,  7, v64_add, 10, v64_add, 13, v64_add, 14)), H[ 1]);
+	qt[ 1] = v64_add(mb_sb1(MB_BMW_W( 6, v64_sub,  8, v64_add, 11, v64_add, 14, v64_sub, 15)), H[ 2]);
+	qt[ 2] = v64_add(mb_sb2(MB_BMW_W( 0, v64_add,  7, v64_add,  9, v64_sub, 12, v64_add, 15)), H[ 3]);
+	qt[ 3] = v64_add(mb_sb3(MB_BMW_W( 0, v64_sub,  1, v64_add,  8, v64_sub, 10, v64_add, 13)), H[ 4]);
+	qt[ 4] = v64_add(mb_sb4(MB_BMW_W( 1, v64_add,  2, v64_add,  9, v64_sub, 11, v64_sub, 14)), H[ 5]);
+	qt[ 5] = v64_add(mb_sb0(MB_BMW_W( 3, v64_sub,  2, v64_add, 10, v64_sub, 12, v64_add, 15)), H[ 6]);
+	qt[ 6] = v64_add(mb_sb1(MB_BMW_W( 4, v64_sub,  0, v64_sub,  3, v64_sub, 11, v64_add, 13)), H[ 7]);
+	qt[ 7] = v64_add(mb_sb2(MB_BMW_W( 1, v64_sub,  4, v64_sub,  5, v64_sub, 12, v64_sub, 14)), H[ 8]);
+	qt[ 8] = v64_add(mb_sb3(MB_BMW_W( 2, v64_sub,  5, v64_sub,  6, v64_add, 13, v64_sub, 15)), H[ 9]);
+	qt[ 9] = v64_add(mb_sb4(MB_BMW_W( 0, v64_sub,  3, v64_add,  6, v64_sub,  7, v64_add, 14)), H[10]);
+	qt[10] = v64_add(mb_sb0(MB_BMW_W( 8, v64_sub,  1, v64_sub,  4, v64_sub,  7, v64_add, 15)), H[11]);
+	qt[11] = v64_add(mb_sb1(MB_BMW_W( 8, v64_sub,  0, v64_sub,  2, v64_sub,  5, v64_add,  9)), H[12]);
+	qt[12] = v64_add(mb_sb2(MB_BMW_W( 1, v64_add,  3, v64_sub,  6, v64_sub,  9, v64_add, 10)), H[13]);
+	qt[13] = v64_add(mb_sb3(MB_BMW_W( 2, v64_add,  4, v64_add,  7, v64_add, 10, v64_add, 11)), H[14]);
+	qt[14] = v64_add(mb_sb4(MB_BMW_W( 3, v64_sub,  5, v64_add,  8, v64_sub, 11, v64_sub, 12)), H[15]);
+	qt[15] = v64_add(mb_sb0(MB_BMW_W(12, v64_sub,  4, v64_sub,  6, v64_sub,  9, v64_add, 13)), H[ 0]);
+
+	MB_BMW_EXPAND1(16); MB_BMW_EXPAND1(17);
+	MB_BMW_EXPAND2(18); MB_BMW_EXPAND2(19); MB_BMW_EXPAND2(20); MB_BMW_EXPAND2(21);
+	MB_BMW_EXPAND2(22); MB_BMW_EXPAND2(23); MB_BMW_EXPAND2(24); MB_BMW_EXPAND2(25);
+	MB_BMW_EXPAND2(26); MB_BMW_EXPAND2(27); MB_BMW_EXPAND2(28); MB_BMW_EXPAND2(29);
+	MB_BMW_EXPAND2(30); MB_BMW_EXPAND2(31);
+
+	xl = v_xor(v_xor(v_xor(qt[16], qt[17]), v_xor(qt[18], qt[19])),
+		v_xor(v_xor(qt[20], qt[21]), v_xor(qt[22], qt[23])));
+	xh = v_xor(xl, v_xor(v_xor(v_xor(qt[24], qt[25]), v_xor(qt[26], qt[27])),
+		v_xor(v_xor(qt[28], qt[29]), v_xor(qt[30], qt[31]))));
+
+	dh[0] = v64_add(v_xor(v_xor(v64_shl(xh, 5), v64_shr(qt[16], 5)), M[0]), v_xor(v_xor(xl, qt[24]), qt[0]));
+	dh[1] = v64_add(v_xor(v_xor(v64_shr(xh, 7), v64_shl(qt[17], 8)), M[1]), v_xor(v_xor(xl, qt[25]), qt[1]));
+	dh[2] = v64_add(v_xor(v_xor(v64_shr(xh, 5), v64_shl(qt[18], 5)), M[2]), v_xor(v_xor(xl, qt[26]), qt[2]));
+	dh[3] = v64_add(v_xor(v_xor(v64_shr(xh, 1), v64_shl(qt[19], 5)), M[3]), v_xor(v_xor(xl, qt[27]), qt[3]));
+	dh[4] = v64_add(v_xor(v_xor(v64_shr(xh, 3), qt[20]), M[4]), v_xor(v_xor(xl, qt[28]), qt[4]));
+	dh[5] = v64_add(v_xor(v_xor(v64_shl(xh, 6), v64_shr(qt[21], 6)), M[5]), v_xor(v_xor(xl, qt[29]), qt[5]));
+	dh[6] = v64_add(v_xor(v_xor(v64_shr(xh, 4), v64_shl(qt[22], 6)), M[6]), v_xor(v_xor(xl, qt[30]), qt[6]));
+	dh[7] = v64_add(v_xor(v_xor(v64_shr(xh, 11), v64_shl(qt[23], 2)), M[7]), v_xor(v_xor(xl, qt[31]), qt[7]));
+	dh[ 8] = v64_add(v64_add(v64_rotl(dh[4],  9), v_xor(v_xor(xh, qt[24]), M[ 8])), v_xor(v_xor(v64_shl(xl, 8), qt[23]), qt[ 8]));
+	dh[ 9] = v64_add(v64_add(v64_rotl(dh[5], 10), v_xor(v_xor(xh, qt[25]), M[ 9])), v_xor(v_xor(v64_shr(xl, 6), qt[16]), qt[ 9]));
+	dh[10] = v64_add(v64_add(v64_rotl(dh[6], 11), v_xor(v_xor(xh, qt[26]), M[10])), v_xor(v_xor(v64_shl(xl, 6), qt[17]), qt[10]));
+	dh[11] = v64_add(v64_add(v64_rotl(dh[7], 12), v_xor(v_xor(xh, qt[27]), M[11])), v_xor(v_xor(v64_shl(xl, 4), qt[18]), qt[11]));
+	dh[12] = v64_add(v64_add(v64_rotl(dh[0], 13), v_xor(v_xor(xh, qt[28]), M[12])), v_xor(v_xor(v64_shr(xl, 3), qt[19]), qt[12]));
+	dh[13] = v64_add(v64_add(v64_rotl(dh[1], 14), v_xor(v_xor(xh, qt[29]), M[13])), v_xor(v_xor(v64_shr(xl, 4), qt[20]), qt[13]));
+	dh[14] = v64_add(v64_add(v64_rotl(dh[2], 15), v_xor(v_xor(xh, qt[30]), M[14])), v_xor(v_xor(v64_shr(xl, 7), qt[21]), qt[14]));
+	dh[15] = v64_add(v64_add(v64_rotl(dh[3], 16), v_xor(v_xor(xh, qt[31]), M[15])), v_xor(v_xor(v64_shr(xl, 2), qt[22]), qt[15]));
+}
+
+static void MB_TARGET MB_FN(bmw512)(uint64_t *h, const uint64_t *m)
+{
+	vec M[16], H[16], dh[16];
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		M[i] = v_load(m + i * MB_LANES64);
+		H[i] = v_load(h + i * MB_LANES64);
+	}
+	MB_FN(bmw512_compress)(dh, M, H);
+	for (i = 0; i < 16; i++)
+		v_store(h + i * MB_LANES64, dh[i]);
+}
+
+/* last compression, the state as message and the final constants as state */
+static void MB_TARGET MB_FN(bmw512_final)(uint64_t *h)
+{
+	vec M[16], H[16], dh[16];
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		M[i] = v_load(h + i * MB_LANES64);
+		H[i] = v64_set1(mb_bmw512_final[i]);
+	}
+	MB_FN(bmw512_compress)(dh, M, H);
+	for (i = 0; i < 16; i++)
+		v_store(h + i * MB_LANES64, dh[i]);
+}
+
+/* keccak512, absorbs 72 bytes and runs the permutation */
+
+#define MB_KECCAK_RHO_PI { \
+	B[ 0] = A[ 0];                B[ 1] = v64_rotl(A[ 6], 44); \
+	B[ 2] = v64_rotl(A[12], 43);  B[ 3] = v64_rotl(A[18], 21); \
+	B[ 4] = v64_rotl(A[24], 14);  B[ 5] = v64_rotl(A[ 3], 28); \
+	B[ 6] = v64_rotl(A[ 9], 20);  B[ 7] = v64_rotl(A[10],  3); \
+	B[ 8] = v64_rotl(A[16], 45);  B[ 9] = v64_rotl(A[22], 61); \
+	B[10] = v64_rotl(A[ 1],  1);  B[11] = v64_rotl(A[ 7],  6); \
+	B[12] = v64_rotl(A[13], 25);  B[13] = v64_rotl(A[19],  8); \
+	B[14] = v64_rotl(A[20], 18);  B[15] = v64_rotl(A[ 4], 27); \
+	B[16] = v64_rotl(A[ 5], 36);  B[17] = v64_rotl(A[11], 10); \
+	B[18] = v64_rotl(A[17], 15);  B[19] = v64_rotl(A[23], 56); \
+	B[20] = v64_rotl(A[ 2], 62);  B[21] = v64_rotl(A[ 8], 55); \
+	B[22] = v64_rotl(A[14], 39);  B[23] = v64_rotl(A[15], 41); \
+	B[24] = v64_rotl(A[21],  2); \
+}
+
+static void MB_TARGET MB_FN(keccak512)(uint64_t *a, const uint64_t *m)
+{
+	vec A[25], B[25], C[5], D;
+	int i, x, r;
+
+	for (i = 0; i < 25; i++)
+		A[i] = v_load(a + i * MB_LANES64);
+	for (i = 0; i < 9; i++)
+		A[i] = v_xor(A[i], v_load(m + i * MB_LANES64));
+
+	for (r = 0; r < 24; r++) {
+		for (x = 0; x < 5; x++)
+			C[x] = v_xor(v_xor(v_xor(A[x], A[x + 5]), v_xor(A[x + 10], A[x + 15])), A[x + 20]);
+		for (x = 0; x < 5; x++) {
+			D = v_xor(C[(x + 4) % 5], v64_rotl(C[(x + 1) % 5], 1));
+			for (i = x; i < 25; i += 5)
+				A[i] = v_xor(A[i], D);
+		}
+		MB_KECCAK_RHO_PI;
+		for (i = 0; i < 25; i += 5)
+			for (x = 0; x < 5; x++)
+				A[i + x] = v_xor(B[i + x], v_andnot(B[i + (x + 1) % 5], B[i + (x + 2) % 5]));
+		A[0] = v_xor(A[0], v64_set1(mb_keccak_rc[r]));
+	}
+
+	for (i = 0; i < 25; i++)
+		v_store(a + i * MB_LANES64, A[i]);
+}
+
+/* skein512 UBI block, the same tweak for all lanes */
+
+#define MB_SKEIN_MIX(a, b, rc) { \
+	p[a] = v64_add(p[a], p[b]); \
+	p[b] = v_xor(v64_rotl(p[b], rc), p[a]); \
+}
+
+#define MB_SKEIN_MIX8(a0, a1, a2, a3, a4, a5, a6, a7, r0, r1, r2, r3) { \
+	MB_SKEIN_MIX(a0, a1, r0); MB_SKEIN_MIX(a2, a3, r1); \
+	MB_SKEIN_MIX(a4, a5, r2); MB_SKEIN_MIX(a6, a7, r3); \
+}
+
+#define MB_SKEIN_ADDKEY(s) { \
+	for (i = 0; i < 8; i++) \
+		p[i] = v64_add(p[i], k[((s) + i) % 9]); \
+	p[5] = v64_add(p[5], v64_set1(t[(s) % 3])); \
+	p[6] = v64_add(p[6], v64_set1(t[((s) + 1) % 3])); \
+	p[7] = v64_add(p[7], v64_set1((uint64_t) (s))); \
+}
+
+static void MB_TARGET MB_FN(skein512)(uint64_t *h, const uint64_t *m, uint64_t t0, uint64_t t1)
+{
+	vec k[9], p[8], mv[8];
+	const uint64_t t[3] = { t0, t1, t0 ^ t1 };
+	int i, s;
+
+	k[8] = v64_set1(0x1BD11BDAA9FC1A22ULL);
+	for (i = 0; i < 8; i++) {
+		k[i] = v_load(h + i * MB_LANES64);
+		k[8] = v_xor(k[8], k[i]);
+		mv[i] = p[i] = v_load(m + i * MB_LANES64);
+	}
+
+	for (s = 0; s < 18; s += 2) {
+		MB_SKEIN_ADDKEY(s);
+		MB_SKEIN_MIX8(0, 1, 2, 3, 4, 5, 6, 7, 46, 36, 19, 37);
+		MB_SKEIN_MIX8(2, 1, 4, 7, 6, 5, 0, 3, 33, 27, 14, 42);
+		MB_SKEIN_MIX8(4, 1, 6, 3, 0, 5, 2, 7, 17, 49, 36, 39);
+		MB_SKEIN_MIX8(6, 1, 0, 7, 2, 5, 4, 3, 44,  9, 54, 56);
+		MB_SKEIN_ADDKEY(s + 1);
+		MB_SKEIN_MIX8(0, 1, 2, 3, 4, 5, 6, 7, 39, 30, 34, 24);
+		MB_SKEIN_MIX8(2, 1, 4, 7, 6, 5, 0, 3, 13, 50, 10, 17);
+		MB_SKEIN_MIX8(4, 1, 6, 3, 0, 5, 2, 7, 25, 29, 39, 43);
+		MB_SKEIN_MIX8(6, 1, 0, 7, 2, 5, 4, 3,  8, 35, 56, 22);
+	}
+	MB_SKEIN_ADDKEY(18);
+
+	for (i = 0; i < 8; i++)
+		v_store(h + i * MB_LANES64, v_xor(mv[i], p[i]));
+}
+
+/* jh512, H[2*i] and H[2*i+1] are the high and low halves of the sph h<i> */
+
+#define MB_JH_SB(x0, x1, x2, x3, c) { \
+	x3 = v_not(x3); \
+	x0 = v_xor(x0, v_andnot(x2, c)); \
+	tmp = v_xor(c, v_and(x0, x1)); \
+	x0 = v_xor(x0, v_and(x2, x3)); \
+	x3 = v_xor(x3, v_andnot(x1, x2)); \
+	x1 = v_xor(x1, v_and(x0, x2)); \
+	x2 = v_xor(x2, v_andnot(x3, x0)); \
+	x0 = v_xor(x0, v_or(x1, x3)); \
+	x3 = v_xor(x3, v_and(x1, x2)); \
+	x1 = v_xor(x1, v_and(tmp, x0)); \
+	x2 = v_xor(x2, tmp); \
+}
+
+#define MB_JH_LB(x0, x1, x2, x3, x4, x5, x6, x7) { \
+	x4 = v_xor(x4, x1); \
+	x5 = v_xor(x5, x2); \
+	x6 = v_xor(x6, v_xor(x3, x0)); \
+	x7 = v_xor(x7, x0); \
+	x0 = v_xor(x0, x5); \
+	x1 = v_xor(x1, x6); \
+	x2 = v_xor(x2, v_xor(x7, x4)); \
+	x3 = v_xor(x3, x4); \
+}
+
+#define MB_JH_WZ(x, c, n) { \
+	x = v_or(v_and(v64_shr(x, n), v64_set1(c)), v64_shl(v_and(x, v64_set1(c)), n)); \
+}
+
+#define MB_JH_W0(x)  MB_JH_WZ(x, 0x5555555555555555ULL, 1)
+#define MB_JH_W1(x)  MB_JH_WZ(x, 0x3333333333333333ULL, 2)
+#define MB_JH_W2(x)  MB_JH_WZ(x, 0x0F0F0F0F0F0F0F0FULL, 4)
+#define MB_JH_W3(x)  MB_JH_WZ(x, 0x00FF00FF00FF00FFULL, 8)
+#define MB_JH_W4(x)  MB_JH_WZ(x, 0x0000FFFF0000FFFFULL, 16)
+#define MB_JH_W5(x)  MB_JH_WZ(x, 0x00000000FFFFFFFFULL, 32)
+#define MB_JH_W6(x)  { tmp = x ## h; x ## h = x ## l; x ## l = tmp; }
+
+#define MB_JH_WX(ro, x) { MB_JH_W ## ro(x ## h); MB_JH_W ## ro(x ## l); }
+#define MB_JH_W6X(ro, x) MB_JH_W6(x)
+
+#define MB_JH_SL(ro, W) { \
+	const uint64_t *c = &mb_jh512_c[(r + ro) << 2]; \
+	MB_JH_SB(h0h, h2h, h4h, h6h, v64_set1(c[0])); \
+	MB_JH_SB(h0l, h2l, h4l, h6l, v64_set1(c[1])); \
+	MB_JH_SB(h1h, h3h, h5h, h7h, v64_set1(c[2])); \
+	MB_JH_SB(h1l, h3l, h5l, h7l, v64_set1(c[3])); \
+	MB_JH_LB(h0h, h2h, h4h, h6h, h1h, h3h, h5h, h7h); \
+	MB_JH_LB(h0l, h2l, h4l, h6l, h1l, h3l, h5l, h7l); \
+	W(ro, h1); W(ro, h3); W(ro, h5); W(ro, h7); \
+}
+
+static void MB_TARGET MB_FN(jh512)(uint64_t *h, const uint64_t *m)
+{
+	vec h0h, h0l, h1h, h1l, h2h, h2l, h3h, h3l;
+	vec h4h, h4l, h5h, h5l, h6h, h6l, h7h, h7l;
+	vec M[8], tmp;
+	int i, r;
+
+	for (i = 0; i < 8; i++)
+		M[i] = v_load(m + i * MB_LANES64);
+#define MB_JH_LD(x, n) { x ## h = v_load(h + (2*(n)) * MB_LANES64); x ## l = v_load(h + (2*(n)+1) * MB_LANES64); }
+	MB_JH_LD(h0, 0); MB_JH_LD(h1, 1); MB_JH_LD(h2, 2); MB_JH_LD(h3, 3);
+	MB_JH_LD(h4, 4); MB_JH_LD(h5, 5); MB_JH_LD(h6, 6); MB_JH_LD(h7, 7);
+
+	h0h = v_xor(h0h, M[0]); h0l = v_xor(h0l, M[1]);
+	h1h = v_xor(h1h, M[2]); h1l = v_xor(h1l, M[3]);
+	h2h = v_xor(h2h, M[4]); h2l = v_xor(h2l, M[5]);
+	h3h = v_xor(h3h, M[6]); h3l = v_xor(h3l, M[7]);
+
+	for (r = 0; r < 42; r += 7) {
+		MB_JH_SL(0, MB_JH_WX);
+		MB_JH_SL(1, MB_JH_WX);
+		MB_JH_SL(2, MB_JH_WX);
+		MB_JH_SL(3, MB_JH_WX);
+		MB_JH_SL(4, MB_JH_WX);
+		MB_JH_SL(5, MB_JH_WX);
+		MB_JH_SL(6, MB_JH_W6X);
+	}
+
+	h4h = v_xor(h4h, M[0]); h4l = v_xor(h4l, M[1]);
+	h5h = v_xor(h5h, M[2]); h5l = v_xor(h5l, M[3]);
+	h6h = v_xor(h6h, M[4]); h6l = v_xor(h6l, M[5]);
+	h7h = v_xor(h7h, M[6]); h7l = v_xor(h7l, M[7]);
+
+#define MB_JH_ST(x, n) { v_store(h + (2*(n)) * MB_LANES64, x ## h); v_store(h + (2*(n)+1) * MB_LANES64, x ## l); }
+	MB_JH_ST(h0, 0); MB_JH_ST(h1, 1); MB_JH_ST(h2, 2); MB_JH_ST(h3, 3);
+	MB_JH_ST(h4, 4); MB_JH_ST(h5, 5); MB_JH_ST(h6, 6); MB_JH_ST(h7, 7);
+#undef MB_JH_LD
+#undef MB_JH_ST
+}
+
+/* sha512, big endian words already decoded */
+
+#define mb_S0(x)  v_xor(v_xor(v64_rotr(x, 28), v64_rotr(x, 34)), v64_rotr(x, 39))
+#define mb_S1(x)  v_xor(v_xor(v64_rotr(x, 14), v64_rotr(x, 18)), v64_rotr(x, 41))
+#define mb_s0(x)  v_xor(v_xor(v64_rotr(x, 1), v64_rotr(x, 8)), v64_shr(x, 7))
+#define mb_s1(x)  v_xor(v_xor(v64_rotr(x, 19), v64_rotr(x, 61)), v64_shr(x, 6))
+
+static void MB_TARGET MB_FN(sha512)(uint64_t *h, const uint64_t *m)
+{
+	vec W[80], S[8], t0, t1;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		W[i] = v_load(m + i * MB_LANES64);
+	for (i = 16; i < 80; i++)
+		W[i] = v64_add(v64_add(mb_s1(W[i - 2]), W[i - 7]), v64_add(mb_s0(W[i - 15]), W[i - 16]));
+	for (i = 0; i < 8; i++)
+		S[i] = v_load(h + i * MB_LANES64);
+
+	for (i = 0; i < 80; i++) {
+		// Ch(e, f, g) and Maj(a, b, c)
+		t0 = v64_add(v64_add(S[7], mb_S1(S[4])), v64_add(v_xor(v_and(S[4], v_xor(S[5], S[6])), S[6]),
+			v64_add(v64_set1(mb_sha512_k[i]), W[i])));
+		t1 = v64_add(mb_S0(S[0]), v_or(v_and(S[0], v_or(S[1], S[2])), v_and(S[1], S[2])));
+		S[7] = S[6]; S[6] = S[5]; S[5] = S[4];
+		S[4] = v64_add(S[3], t0);
+		S[3] = S[2]; S[2] = S[1]; S[1] = S[0];
+		S[0] = v64_add(t0, t1);
+	}
+
+	for (i = 0; i < 8; i++)
+		v_store(h + i * MB_LANES64, v64_add(v_load(h + i * MB_LANES64), S[i]));
+}
+
+/* cubehash512, the 32 bytes block m (if any) then n times 16 rounds */
+static void MB_TARGET MB_FN(cubehash512)(uint32_t *x, const uint32_t *m, int n)
+{
+	vec X[32], T[16];
+	int i, r;
+
+	for (i = 0; i < 32; i++)
+		X[i] = v_load(x + i * MB_LANES32);
+	if (m) {
+		for (i = 0; i < 8; i++)
+			X[i] = v_xor(X[i], v_load(m + i * MB_LANES32));
+	}
+
+	for (r = 0; r < 16 * n; r++) {
+		for (i = 0; i < 16; i++) {
+			X[i + 16] = v32_add(X[i + 16], X[i]);
+			T[i ^ 8] = v32_rotl(X[i], 7);
+		}
+		for (i = 0; i < 16; i++)
+			X[i] = v_xor(T[i], X[i + 16]);
+		// the upper half swaps are folded into the indexes
+		for (i = 0; i < 16; i++)
+			T[i] = v32_add(X[(i ^ 2) + 16], X[i]);
+		for (i = 0; i < 16; i++)
+			X[i + 16] = v32_rotl(X[i ^ 4], 11);
+		for (i = 0; i < 16; i++) {
+			X[i] = v_xor(X[i + 16], T[i]);
+			X[i + 16] = T[i ^ 1];
+		}
+	}
+
+	for (i = 0; i < 32; i++)
+		v_store(x + i * MB_LANES32, X[i]);
+}
+
+/*
+ * shabal512, st holds A[12], B[16], C[16]. A block with the counter w,
+ * or the last one (no C update) and the 3 final permutations
+ */
+
+#define MB_SHABAL_P { \
+	for (i = 0; i < 16; i++) \
+		B[i] = v32_rotl(B[i], 17); \
+	for (k = 0; k < 48; k++) { \
+		const int a = k % 12, j = k & 15; \
+		vec u = v32_rotl(A[(k + 11) % 12], 15); \
+		u = v_xor(v_xor(A[a], v32_add(v32_shl(u, 2), u)), C[(8 - j) & 15]); \
+		A[a] = v_xor(v_xor(v32_add(v32_shl(u, 1), u), B[(j + 13) & 15]), \
+			v_xor(v_andnot(B[(j + 6) & 15], B[(j + 9) & 15]), M[j])); \
+		B[j] = v_not(v_xor(v32_rotl(B[j], 1), A[a])); \
+	} \
+	for (k = 0; k < 36; k++) \
+		A[(47 - k) % 12] = v32_add(A[(47 - k) % 12], C[(54 - k) & 15]); \
+}
+
+#define MB_SHABAL_XOR_W { \
+	A[0] = v_xor(A[0], v32_set1(wlow)); \
+	A[1] = v_xor(A[1], v32_set1(whigh)); \
+}
+
+#define MB_SHABAL_SWAP_BC { \
+	for (i = 0; i < 16; i++) { \
+		vec u = B[i]; B[i] = C[i]; C[i] = u; \
+	} \
+}
+
+static void MB_TARGET MB_FN(shabal512)(uint32_t *st, const uint32_t *m, uint32_t wlow, uint32_t whigh, int last)
+{
+	vec A[12], B[16], C[16], M[16];
+	int i, k;
+
+	for (i = 0; i < 12; i++)
+		A[i] = v_load(st + i * MB_LANES32);
+	for (i = 0; i < 16; i++) {
+		B[i] = v_load(st + (12 + i) * MB_LANES32);
+		C[i] = v_load(st + (28 + i) * MB_LANES32);
+		M[i] = v_load(m + i * MB_LANES32);
+		B[i] = v32_add(B[i], M[i]);
+	}
+
+	MB_SHABAL_XOR_W;
+	MB_SHABAL_P;
+	if (!last) {
+		for (i = 0; i < 16; i++)
+			C[i] = v32_sub(C[i], M[i]);
+		MB_SHABAL_SWAP_BC;
+	} else {
+		for (int f = 0; f < 3; f++) {
+			MB_SHABAL_SWAP_BC;
+			MB_SHABAL_XOR_W;
+			MB_SHABAL_P;
+		}
+	}
+
+	for (i = 0; i < 12; i++)
+		v_store(st + i * MB_LANES32, A[i]);
+	for (i = 0; i < 16; i++) {
+		v_store(st + (12 + i) * MB_LANES32, B[i]);
+		v_store(st + (28 + i) * MB_LANES32, C[i]);
+	}
+}
+
+/* luffa512, V[j][i] at index j * 8 + i, the block m (big endian words decoded) or zeros */
+
+static inline void MB_TARGET MB_FN(luffa_m2)(vec *d, const vec *s)
+{
+	vec t = s[7];
+	d[7] = s[6]; d[6] = s[5]; d[5] = s[4];
+	d[4] = v_xor(s[3], t);
+	d[3] = v_xor(s[2], t);
+	d[2] = s[1];
+	d[1] = v_xor(s[0], t);
+	d[0] = t;
+}
+
+#define MB_LUFFA_XOR(d, s) { for (i = 0; i < 8; i++) d[i] = v_xor(d[i], s[i]); }
+
+#define MB_LUFFA_SUB_CRUMB(a0, a1, a2, a3) { \
+	vec t = a0; \
+	a0 = v_or(a0, a1); \
+	a2 = v_xor(a2, a3); \
+	a1 = v_not(a1); \
+	a0 = v_xor(a0, a3); \
+	a3 = v_and(a3, t); \
+	a1 = v_xor(a1, a3); \
+	a3 = v_xor(a3, a2); \
+	a2 = v_and(a2, a0); \
+	a0 = v_not(a0); \
+	a2 = v_xor(a2, a1); \
+	a1 = v_or(a1, a3); \
+	t = v_xor(t, a1); \
+	a3 = v_xor(a3, a2); \
+	a2 = v_and(a2, a1); \
+	a1 = v_xor(a1, a0); \
+	a0 = t; \
+}
+
+#define MB_LUFFA_MIX_WORD(u, v) { \
+	v = v_xor(v, u); \
+	u = v_xor(v32_rotl(u, 2), v); \
+	v = v_xor(v32_rotl(v, 14), u); \
+	u = v_xor(v32_rotl(u, 10), v); \
+	v = v32_rotl(v, 1); \
+}
+
+static void MB_TARGET MB_FN(luffa512)(uint32_t *v, const uint32_t *m)
+{
+	static const uint32_t *rc[5][2] = {
+		{ mb_luffa_rc00, mb_luffa_rc04 }, { mb_luffa_rc10, mb_luffa_rc14 },
+		{ mb_luffa_rc20, mb_luffa_rc24 }, { mb_luffa_rc30, mb_luffa_rc34 },
+		{ mb_luffa_rc40, mb_luffa_rc44 }
+	};
+	vec V[5][8], M[8], a[8], b[8];
+	int i, j, r;
+
+	for (j = 0; j < 5; j++)
+		for (i = 0; i < 8; i++)
+			V[j][i] = v_load(v + (j * 8 + i) * MB_LANES32);
+	for (i = 0; i < 8; i++)
+		M[i] = m ? v_load(m + i * MB_LANES32) : v_xor(V[0][0], V[0][0]);
+
+	// message injection (MI5)
+	for (i = 0; i < 8; i++)
+		a[i] = v_xor(v_xor(V[0][i], V[1][i]), v_xor(v_xor(V[2][i], V[3][i]), V[4][i]));
+	MB_FN(luffa_m2)(a, a);
+	for (j = 0; j < 5; j++)
+		MB_LUFFA_XOR(V[j], a);
+	MB_FN(luffa_m2)(b, V[0]); MB_LUFFA_XOR(b, V[1]);
+	MB_FN(luffa_m2)(V[1], V[1]); MB_LUFFA_XOR(V[1], V[2]);
+	MB_FN(luffa_m2)(V[2], V[2]); MB_LUFFA_XOR(V[2], V[3]);
+	MB_FN(luffa_m2)(V[3], V[3]); MB_LUFFA_XOR(V[3], V[4]);
+	MB_FN(luffa_m2)(V[4], V[4]); MB_LUFFA_XOR(V[4], V[0]);
+	MB_FN(luffa_m2)(V[0], b); MB_LUFFA_XOR(V[0], V[4]);
+	MB_FN(luffa_m2)(V[4], V[4]); MB_LUFFA_XOR(V[4], V[3]);
+	MB_FN(luffa_m2)(V[3], V[3]); MB_LUFFA_XOR(V[3], V[2]);
+	MB_FN(luffa_m2)(V[2], V[2]); MB_LUFFA_XOR(V[2], V[1]);
+	MB_FN(luffa_m2)(V[1], V[1]); MB_LUFFA_XOR(V[1], b);
+	MB_LUFFA_XOR(V[0], M);
+	for (j = 1; j < 5; j++) {
+		MB_FN(luffa_m2)(M, M);
+		MB_LUFFA_XOR(V[j], M);
+	}
+
+	// tweak and permutations (P5)
+	for (i = 4; i < 8; i++) {
+		V[1][i] = v32_rotl(V[1][i], 1);
+		V[2][i] = v32_rotl(V[2][i], 2);
+		V[3][i] = v32_rotl(V[3][i], 3);
+		V[4][i] = v32_rotl(V[4][i], 4);
+	}
+	for (j = 0; j < 5; j++) {
+		vec *x = V[j];
+		for (r = 0; r < 8; r++) {
+			MB_LUFFA_SUB_CRUMB(x[0], x[1], x[2], x[3]);
+			MB_LUFFA_SUB_CRUMB(x[5], x[6], x[7], x[4]);
+			MB_LUFFA_MIX_WORD(x[0], x[4]);
+			MB_LUFFA_MIX_WORD(x[1], x[5]);
+			MB_LUFFA_MIX_WORD(x[2], x[6]);
+			MB_LUFFA_MIX_WORD(x[3], x[7]);
+			x[0] = v_xor(x[0], v32_set1(rc[j][0][r]));
+			x[4] = v_xor(x[4], v32_set1(rc[j][1][r]));
+		}
+	}
+
+	for (j = 0; j < 5; j++)
+		for (i = 0; i < 8; i++)
+			v_store(v + (j * 8 + i) * MB_LANES32, V[j][i]);
+}
+
+static const mb512_impl MB_FN(impl) = {
+	MB_LANES64, MB_LANES32,
+	MB_FN(blake512), MB_FN(bmw512), MB_FN(bmw512_final), MB_FN(keccak512),
+	MB_FN(skein512), MB_FN(jh512), MB_FN(sha512),
+	MB_FN(cubehash512), MB_FN(shabal512), MB_FN(luffa512)
+};
+
+#undef v64_rotr
+#undef MB_BLAKE_G
+#undef mb_sb0
+#undef mb_sb1
+#undef mb_sb2
+#undef mb_sb3
+#undef mb_sb4
+#undef mb_sb5
+#undef MB_BMW_W
+#undef MB_BMW_ROL
+#undef MB_BMW_ELT
+#undef MB_BMW_EXPAND1
+#undef MB_BMW_EXPAND2
+#undef MB_KECCAK_RHO_PI
+#undef MB_SKEIN_MIX
+#undef MB_SKEIN_MIX8
+#undef MB_SKEIN_ADDKEY
+#undef MB_JH_SB
+#undef MB_JH_LB
+#undef MB_JH_WZ
+#undef MB_JH_W0
+#undef MB_JH_W1
+#undef MB_JH_W2
+#undef MB_JH_W3
+#undef MB_JH_W4
+#undef MB_JH_W5
+#undef MB_JH_W6
+#undef MB_JH_WX
+#undef MB_JH_W6X
+#undef MB_JH_SL
+#undef mb_S0
+#undef mb_S1
+#undef mb_s0
+#undef mb_s1
+#undef MB_SHABAL_P
+#undef MB_SHABAL_XOR_W
+#undef MB_SHABAL_SWAP_BC
+#undef MB_LUFFA_XOR
+#undef MB_LUFFA_SUB_CRUMB
+#undef MB_LUFFA_MIX_WORD
+
+#undef MB_LANES64
+#undef MB_LANES32
+#undef MB_TARGET
+#undef MB_FN
+#undef vec
+#undef v_load
+#undef v_store
+#undef v_xor
+#undef v_and
+#undef v_or
+#undef v_andnot
+#undef v_not
+#undef v64_add
+#undef v64_sub
+#undef v64_set1
+#undef v64_shl
+#undef v64_shr
+#undef v64_rotl
+#undef v32_add
+#undef v32_sub
+#undef v32_set1
+#undef v32_shl
+#undef v32_shr
+#undef v32_rotl
@@ -0,0 +1,36 @@
+/*
+ * Midstate snapshots of the sph hashes for 80 bytes block headers
+ * (see sph_midstate.h)
+ */
+
+#include <string.h>
+
+#include "sph_midstate.h"
+
+void sph_midstate80_load(sph_midstate80 *ms, void (*init)(void *cc),
+	void (*update)(void *cc, const void *data, size_t len), size_t size,
+	void *cc, const void *header)
+{
+	const unsigned char *in = (const unsigned char*) header;
+
+	if (size > sizeof(ms->ctx)) {
+		// not a known context, hash it all
+		init(cc);
+		update(cc, in, 80);
+		return;
+	}
+
+	if (!ms->valid || ms->init != init || ms->update != update || ms->size != size
+		|| memcmp(ms->prefix, in, SPH_MIDSTATE_PREFIX)) {
+		ms->init = init;
+		ms->update = update;
+		ms->size = size;
+		init(ms->ctx);
+		update(ms->ctx, in, SPH_MIDSTATE_PREFIX);
+		memcpy(ms->prefix, in, SPH_MIDSTATE_PREFIX);
+		ms->valid = 1;
+	}
+
+	memcpy(cc, ms->ctx, size);
+	update(cc, &in[SPH_MIDSTATE_PREFIX], 80 - SPH_MIDSTATE_PREFIX);
+}
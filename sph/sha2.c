@@ -78,7 +78,7 @@ void sha256_init(uint32_t *state)
  * SHA256 block compression function.  The 256-bit state is transformed via
  * the 512-bit input block to produce a new state.
  */
-void sha256_transform(uint32_t *state, const uint32_t *block, int swap)
+static void sha256_transform_c(uint32_t *state, const uint32_t *block, int swap)
 {
 	uint32_t W[64];
 	uint32_t S[8];
@@ -170,6 +170,18 @@ void sha256_transform(uint32_t *state, const uint32_t *block, int swap)
 		state[i] += S[i];
 }
 
+/* use the cpu sha extensions when available (sha256_mb.c) */
+void sha256_transform(uint32_t *state, const uint32_t *block, int swap)
+{
+	static int shani = -1;
+	if (unlikely(shani < 0))
+		shani = sha256_shani_available();
+	if (shani)
+		sha256_transform_shani(state, block, swap);
+	else
+		sha256_transform_c(state, block, swap);
+}
+
 #endif /* EXTERN_SHA256 */
 
 
@@ -195,16 +207,21 @@ static void sha256d_80_swap(uint32_t *hash, const uint32_t *data)
 		hash[i] = swab32(hash[i]);
 }
 
-void sha256d(unsigned char *hash, const unsigned char *data, int len)
+/*
+ * sha256d of a len bytes message, the first len - tail_len bytes
+ * (a multiple of 64) are already compressed in midstate
+ */
+void sha256d_midstate(unsigned char *hash, const uint32_t *midstate,
+	const unsigned char *tail, int tail_len, int len)
 {
 	uint32_t S[16], T[16];
 	int i, r;
 
-	sha256_init(S);
-	for (r = len; r > -9; r -= 64) {
+	memcpy(S, midstate, 32);
+	for (r = tail_len; r > -9; r -= 64) {
 		if (r < 64)
 			memset(T, 0, 64);
-		memcpy(T, data + len - r, r > 64 ? 64 : (r < 0 ? 0 : r));
+		memcpy(T, tail + tail_len - r, r > 64 ? 64 : (r < 0 ? 0 : r));
 		if (r >= 0 && r < 64)
 			((unsigned char *)T)[r] = 0x80;
 		for (i = 0; i < 16; i++)
@@ -220,6 +237,34 @@ void sha256d(unsigned char *hash, const unsigned char *data, int len)
 		be32enc((uint32_t *)hash + i, T[i]);
 }
 
+void sha256d(unsigned char *hash, const unsigned char *data, int len)
+{
+	sha256d_midstate(hash, sha256_h, data, len, len);
+}
+
+/* padding block of a 64 bytes message */
+static const uint32_t sha256d_pad64[16] = {
+	0x80000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x00000200
+};
+
+/* merkle tree level: hash = sha256d(hash | branch), both as big endian words */
+void sha256d_merkle(uint32_t *hash, const uint32_t *branch)
+{
+	uint32_t S[16], T[16];
+
+	memcpy(T, hash, 32);
+	memcpy(T + 8, branch, 32);
+	sha256_init(S);
+	sha256_transform(S, T, 0);
+	sha256_transform(S, sha256d_pad64, 0);
+	memcpy(S + 8, sha256d_hash1 + 8, 32);
+	sha256_init(hash);
+	sha256_transform(hash, S, 0);
+}
+
 static inline void sha256d_preextend(uint32_t *W)
 {
 	W[16] = s1(W[14]) + W[ 9] + s0(W[ 1]) + W[ 0];
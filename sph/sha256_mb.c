@@ -0,0 +1,581 @@
+/*
+ * Multi-buffer SHA-256 for the cpu side hashing (merkle roots,
+ * scrypt HMAC/PBKDF2) : 4 (sse2), 8 (avx2) or 16 (avx-512) messages
+ * at once, and a SHA-NI single buffer transform.
+ *
+ * The implementation is selected at runtime, SHA-NI is checked with a
+ * known answer and the wide ones against sha256_transform() before use.
+ */
+
+#include "miner.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SHA256_MB_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#define SHA256_TARGET(x) __attribute__((target(x)))
+#else
+#define SHA256_TARGET(x)
+#endif
+
+#if defined(SHA256_MB_X86)
+#define SHA256_MB_SSE2
+#if defined(_MSC_VER) || defined(__clang__) || (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define SHA256_MB_AVX2
+#define SHA256_MB_SHANI
+#endif
+#if (defined(_MSC_VER) && _MSC_VER >= 1910) || defined(__clang__) || (__GNUC__ >= 5)
+#define SHA256_MB_AVX512
+#endif
+#endif
+
+static const uint32_t sha256_mb_h[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint32_t _ALIGN(16) sha256_mb_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define CPU_SSE2   1
+#define CPU_AVX2   2
+#define CPU_AVX512 4
+#define CPU_SHANI  8
+
+static int sha256_mb_cpu(void)
+{
+	int flags = 0;
+#if defined(SHA256_MB_X86)
+	uint32_t r[4], max_level;
+	uint64_t xcr0 = 0;
+#ifdef _MSC_VER
+	int cr[4];
+	#define cpuid(leaf, sub) { __cpuidex(cr, leaf, sub); r[0] = cr[0]; r[1] = cr[1]; r[2] = cr[2]; r[3] = cr[3]; }
+#else
+	#define cpuid(leaf, sub) __cpuid_count(leaf, sub, r[0], r[1], r[2], r[3])
+#endif
+	cpuid(0, 0);
+	max_level = r[0];
+	cpuid(1, 0);
+	if (r[3] & (1 << 26)) flags |= CPU_SSE2;
+	bool sse41 = (r[2] & (1 << 19)) != 0;
+	// osxsave + avx, then the os enabled register state
+	if ((r[2] & (1 << 27)) && (r[2] & (1 << 28))) {
+#ifdef _MSC_VER
+		xcr0 = _xgetbv(0);
+#else
+		uint32_t lo, hi;
+		__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(lo), "=d"(hi) : "c"(0));
+		xcr0 = ((uint64_t)hi << 32) | lo;
+#endif
+	}
+	if (max_level >= 7) {
+		cpuid(7, 0);
+		if ((r[1] & (1 << 5)) && (xcr0 & 0x06) == 0x06)
+			flags |= CPU_AVX2;
+		if ((r[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6)
+			flags |= CPU_AVX512;
+		if ((r[1] & (1 << 29)) && sse41)
+			flags |= CPU_SHANI;
+	}
+	#undef cpuid
+#endif
+	return flags;
+}
+
+#if defined(SHA256_MB_SSE2)
+#define MB_LANES 4
+#define MB_TARGET SHA256_TARGET("sse2")
+#define MB_FN sha256_transform_x4_sse2
+#define vec __m128i
+#define v_add(a, b) _mm_add_epi32(a, b)
+#define v_xor(a, b) _mm_xor_si128(a, b)
+#define v_and(a, b) _mm_and_si128(a, b)
+#define v_or(a, b) _mm_or_si128(a, b)
+#define v_rotr(a, n) _mm_or_si128(_mm_srli_epi32(a, n), _mm_slli_epi32(a, 32 - (n)))
+#define v_shr(a, n) _mm_srli_epi32(a, n)
+#define v_set1(x) _mm_set1_epi32((int) (x))
+#define v_load(p) _mm_loadu_si128((const __m128i *)(p))
+#define v_store(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#include "sha256_mb_lanes.h"
+#endif
+
+#if defined(SHA256_MB_AVX2)
+#define MB_LANES 8
+#define MB_TARGET SHA256_TARGET("avx2")
+#define MB_FN sha256_transform_x8_avx2
+#define vec __m256i
+#define v_add(a, b) _mm256_add_epi32(a, b)
+#define v_xor(a, b) _mm256_xor_si256(a, b)
+#define v_and(a, b) _mm256_and_si256(a, b)
+#define v_or(a, b) _mm256_or_si256(a, b)
+#define v_rotr(a, n) _mm256_or_si256(_mm256_srli_epi32(a, n), _mm256_slli_epi32(a, 32 - (n)))
+#define v_shr(a, n) _mm256_srli_epi32(a, n)
+#define v_set1(x) _mm256_set1_epi32((int) (x))
+#define v_load(p) _mm256_loadu_si256((const __m256i *)(p))
+#define v_store(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#include "sha256_mb_lanes.h"
+#endif
+
+#if defined(SHA256_MB_AVX512)
+#define MB_LANES 16
+#define MB_TARGET SHA256_TARGET("avx512f")
+#define MB_FN sha256_transform_x16_avx512
+#define vec __m512i
+#define v_add(a, b) _mm512_add_epi32(a, b)
+#define v_xor(a, b) _mm512_xor_si512(a, b)
+#define v_and(a, b) _mm512_and_si512(a, b)
+#define v_or(a, b) _mm512_or_si512(a, b)
+#define v_rotr(a, n) _mm512_ror_epi32(a, n)
+#define v_shr(a, n) _mm512_srli_epi32(a, n)
+#define v_set1(x) _mm512_set1_epi32((int) (x))
+#define v_load(p) _mm512_loadu_si512((const void *)(p))
+#define v_store(p, v) _mm512_storeu_si512((void *)(p), v)
+#include "sha256_mb_lanes.h"
+#endif
+
+#if defined(SHA256_MB_SHANI)
+/* 4 rounds, and the message schedule of the next ones */
+#define SHANI_ROUNDS(g) { \
+	MSG = _mm_add_epi32(M[(g) & 3], _mm_load_si128((const __m128i*) &sha256_mb_k[(g) * 4])); \
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG); \
+	if ((g) >= 3 && (g) <= 14) { \
+		TMP = _mm_alignr_epi8(M[(g) & 3], M[((g) - 1) & 3], 4); \
+		M[((g) + 1) & 3] = _mm_add_epi32(M[((g) + 1) & 3], TMP); \
+		M[((g) + 1) & 3] = _mm_sha256msg2_epu32(M[((g) + 1) & 3], M[(g) & 3]); \
+	} \
+	MSG = _mm_shuffle_epi32(MSG, 0x0E); \
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG); \
+	if ((g) >= 1 && (g) <= 12) \
+		M[((g) - 1) & 3] = _mm_sha256msg1_epu32(M[((g) - 1) & 3], M[(g) & 3]); \
+}
+
+void SHA256_TARGET("sha,sse4.1") sha256_transform_shani(uint32_t *state, const uint32_t *block, int swap)
+{
+	const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i STATE0, STATE1, ABEF_SAVE, CDGH_SAVE, MSG, TMP;
+	__m128i M[4];
+	int i;
+
+	TMP = _mm_loadu_si128((const __m128i*) &state[0]);
+	STATE1 = _mm_loadu_si128((const __m128i*) &state[4]);
+	TMP = _mm_shuffle_epi32(TMP, 0xB1);          // CDAB
+	STATE1 = _mm_shuffle_epi32(STATE1, 0x1B);    // EFGH
+	STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);    // ABEF
+	STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0); // CDGH
+	ABEF_SAVE = STATE0;
+	CDGH_SAVE = STATE1;
+
+	for (i = 0; i < 4; i++) {
+		M[i] = _mm_loadu_si128((const __m128i*) &block[i * 4]);
+		if (swap)
+			M[i] = _mm_shuffle_epi8(M[i], MASK);
+	}
+
+	SHANI_ROUNDS(0);  SHANI_ROUNDS(1);  SHANI_ROUNDS(2);  SHANI_ROUNDS(3);
+	SHANI_ROUNDS(4);  SHANI_ROUNDS(5);  SHANI_ROUNDS(6);  SHANI_ROUNDS(7);
+	SHANI_ROUNDS(8);  SHANI_ROUNDS(9);  SHANI_ROUNDS(10); SHANI_ROUNDS(11);
+	SHANI_ROUNDS(12); SHANI_ROUNDS(13); SHANI_ROUNDS(14); SHANI_ROUNDS(15);
+
+	STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+	STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+
+	TMP = _mm_shuffle_epi32(STATE0, 0x1B);       // FEBA
+	STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);    // DCHG
+	STATE0 = _mm_blend_epi16(TMP, STATE1, 0xF0); // DCBA
+	STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);    // ABEF
+
+	_mm_storeu_si128((__m128i*) &state[0], STATE0);
+	_mm_storeu_si128((__m128i*) &state[4], STATE1);
+}
+#undef SHANI_ROUNDS
+#endif
+
+typedef void (*sha256_mb_fn)(uint32_t *state, const uint32_t *block, int swap);
+
+static struct {
+	int shani;
+	int lanes;
+	sha256_mb_fn fn16, fn8, fn4;
+	char name[32];
+} sha256_mb;
+
+/* compare a wide implementation with the scalar transform */
+static bool sha256_mb_check(sha256_mb_fn fn, int lanes)
+{
+	uint32_t _ALIGN(64) S[8*16], B[16*16], ref[8], blk[16];
+	int i, l;
+
+	for (i = 0; i < 16 * lanes; i++)
+		B[i] = (uint32_t) (i * 0x9e3779b9u + 0x01234567u);
+	for (i = 0; i < 8; i++)
+		for (l = 0; l < lanes; l++)
+			S[i * lanes + l] = sha256_mb_h[i] + l;
+	fn(S, B, 1);
+	for (l = 0; l < lanes; l++) {
+		for (i = 0; i < 8; i++) ref[i] = sha256_mb_h[i] + l;
+		for (i = 0; i < 16; i++) blk[i] = B[i * lanes + l];
+		sha256_transform(ref, blk, 1);
+		for (i = 0; i < 8; i++)
+			if (S[i * lanes + l] != ref[i])
+				return false;
+	}
+	return true;
+}
+
+static pthread_once_t sha256_mb_once = PTHREAD_ONCE_INIT;
+static pthread_once_t sha256_shani_once = PTHREAD_ONCE_INIT;
+static int sha256_shani_ok = 0;
+
+#if defined(SHA256_MB_SHANI)
+/* sha256("abc"), one padded block, with the native and the swapped words */
+static bool sha256_shani_check(void)
+{
+	static const uint32_t abc[8] = {
+		0xba7816bf, 0x8f01cfea, 0x414140de, 0x5dae2223,
+		0xb00361a3, 0x96177a9c, 0xb410ff61, 0xf20015ad
+	};
+	uint32_t S[8], blk[16] = { 0 };
+
+	for (int swap = 0; swap < 2; swap++) {
+		blk[0] = swap ? swab32(0x61626380) : 0x61626380;
+		blk[15] = swap ? swab32(0x18) : 0x18;
+		memcpy(S, sha256_mb_h, sizeof(S));
+		sha256_transform_shani(S, blk, swap);
+		if (memcmp(S, abc, sizeof(S)))
+			return false;
+	}
+	return true;
+}
+#endif
+
+static void sha256_shani_init(void)
+{
+#if defined(SHA256_MB_SHANI)
+	sha256_shani_ok = (sha256_mb_cpu() & CPU_SHANI) && sha256_shani_check();
+#endif
+}
+
+static void sha256_mb_init(void)
+{
+	int flags = sha256_mb_cpu();
+
+	sha256_mb.shani = sha256_shani_available();
+	sha256_mb.lanes = 1;
+#if defined(SHA256_MB_SSE2)
+	if ((flags & CPU_SSE2) && sha256_mb_check(sha256_transform_x4_sse2, 4)) {
+		sha256_mb.fn4 = sha256_transform_x4_sse2;
+		sha256_mb.lanes = 4;
+	}
+#endif
+#if defined(SHA256_MB_AVX2)
+	if ((flags & CPU_AVX2) && sha256_mb_check(sha256_transform_x8_avx2, 8)) {
+		sha256_mb.fn8 = sha256_transform_x8_avx2;
+		sha256_mb.lanes = 8;
+	}
+#endif
+#if defined(SHA256_MB_AVX512)
+	if ((flags & CPU_AVX512) && sha256_mb_check(sha256_transform_x16_avx512, 16)) {
+		sha256_mb.fn16 = sha256_transform_x16_avx512;
+		sha256_mb.lanes = 16;
+	}
+#endif
+	snprintf(sha256_mb.name, sizeof(sha256_mb.name), "%s%s",
+		sha256_mb.lanes == 16 ? "AVX-512 x16" : sha256_mb.lanes == 8 ? "AVX2 x8" :
+		sha256_mb.lanes == 4 ? "SSE2 x4" : "scalar", sha256_mb.shani ? " + SHA-NI" : "");
+}
+
+// used by sha256_transform()
+int sha256_shani_available(void)
+{
+	pthread_once(&sha256_shani_once, sha256_shani_init);
+	return sha256_shani_ok;
+}
+
+#if !defined(SHA256_MB_SHANI)
+void sha256_transform_shani(uint32_t *state, const uint32_t *block, int swap)
+{
+	sha256_transform(state, block, swap);
+}
+#endif
+
+int sha256_mb_lanes(void)
+{
+	pthread_once(&sha256_mb_once, sha256_mb_init);
+	return sha256_mb.lanes;
+}
+
+const char* sha256_mb_name(void)
+{
+	pthread_once(&sha256_mb_once, sha256_mb_init);
+	return sha256_mb.name;
+}
+
+/* widest transform for at most count messages, the scalar one below 4 */
+static sha256_mb_fn sha256_mb_get(int count, int *lanes)
+{
+	pthread_once(&sha256_mb_once, sha256_mb_init);
+	if (count >= 16 && sha256_mb.fn16) { *lanes = 16; return sha256_mb.fn16; }
+	if (count >= 8 && sha256_mb.fn8) { *lanes = 8; return sha256_mb.fn8; }
+	if (count >= 4 && sha256_mb.fn4) { *lanes = 4; return sha256_mb.fn4; }
+	*lanes = 1;
+	return sha256_transform;
+}
+
+/* message words <-> interleaved lanes */
+static inline void mb_gather(uint32_t *dst, const uint32_t *src, int stride, int words, int lanes)
+{
+	for (int l = 0; l < lanes; l++)
+		for (int i = 0; i < words; i++)
+			dst[i * lanes + l] = src[l * stride + i];
+}
+
+static inline void mb_scatter(uint32_t *dst, int stride, const uint32_t *src, int words, int lanes, int swap)
+{
+	for (int l = 0; l < lanes; l++)
+		for (int i = 0; i < words; i++)
+			dst[l * stride + i] = swap ? swab32(src[i * lanes + l]) : src[i * lanes + l];
+}
+
+static inline void mb_set(uint32_t *dst, const uint32_t *words, int count, int lanes)
+{
+	for (int i = 0; i < count; i++)
+		for (int l = 0; l < lanes; l++)
+			dst[i * lanes + l] = words[i];
+}
+
+static const uint32_t sha256_mb_hash1pad[8] = {
+	0x80000000, 0, 0, 0, 0, 0, 0, 0x00000100
+};
+
+static const uint32_t sha256_mb_pad64[16] = {
+	0x80000000, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00000200
+};
+
+/* sha256 of a 32 bytes hash, in state[8][lanes] */
+static inline void mb_sha256_32(sha256_mb_fn fn, uint32_t *hash, const uint32_t *state, int lanes)
+{
+	uint32_t _ALIGN(64) T[16*16];
+
+	memcpy(T, state, 8 * lanes * 4);
+	mb_set(T + 8 * lanes, sha256_mb_hash1pad, 8, lanes);
+	mb_set(hash, sha256_mb_h, 8, lanes);
+	fn(hash, T, 0);
+}
+
+/*
+ * sha256d of count messages of len bytes, which only differ in their
+ * tail_len last bytes : tails[count][tail_len]. The first bytes are
+ * already compressed in midstate. hash[count][32]
+ */
+void sha256d_midstate_mb(unsigned char *hash, const uint32_t *midstate,
+	const unsigned char *tails, int tail_len, int len, int count)
+{
+	uint32_t _ALIGN(64) S[8*16], T[16*16], H[8*16];
+	int lanes;
+
+	while (count > 0) {
+		sha256_mb_fn fn = sha256_mb_get(count, &lanes);
+
+		mb_set(S, midstate, 8, lanes);
+		for (int r = tail_len; r > -9; r -= 64) {
+			for (int l = 0; l < lanes; l++) {
+				uint32_t blk[16];
+				const unsigned char *tail = tails + l * tail_len;
+				if (r < 64)
+					memset(blk, 0, 64);
+				memcpy(blk, tail + tail_len - r, r > 64 ? 64 : (r < 0 ? 0 : r));
+				if (r >= 0 && r < 64)
+					((unsigned char *)blk)[r] = 0x80;
+				for (int i = 0; i < 16; i++)
+					T[i * lanes + l] = be32dec(blk + i);
+				if (r < 56)
+					T[15 * lanes + l] = 8 * len;
+			}
+			fn(S, T, 0);
+		}
+		mb_sha256_32(fn, H, S, lanes);
+		for (int l = 0; l < lanes; l++)
+			for (int i = 0; i < 8; i++)
+				be32enc((uint32_t *)(hash + l * 32) + i, H[i * lanes + l]);
+
+		tails += lanes * tail_len;
+		hash += lanes * 32;
+		count -= lanes;
+	}
+}
+
+/* count merkle tree levels with the same branch, hash[count][8] = sha256d(hash | branch) */
+void sha256d_merkle_mb(uint32_t *hash, const uint32_t *branch, int count)
+{
+	uint32_t _ALIGN(64) S[8*16], T[16*16];
+	int lanes;
+
+	while (count > 0) {
+		sha256_mb_fn fn = sha256_mb_get(count, &lanes);
+
+		mb_gather(T, hash, 8, 8, lanes);
+		mb_set(T + 8 * lanes, branch, 8, lanes);
+		mb_set(S, sha256_mb_h, 8, lanes);
+		fn(S, T, 0);
+		mb_set(T, sha256_mb_pad64, 16, lanes);
+		fn(S, T, 0);
+		mb_sha256_32(fn, T, S, lanes);
+		mb_scatter(hash, 8, T, 8, lanes, 0);
+
+		hash += lanes * 8;
+		count -= lanes;
+	}
+}
+
+static const uint32_t keypad[12] = {
+	0x80000000, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00000280
+};
+static const uint32_t innerpad[11] = {
+	0x80000000, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x000004a0
+};
+static const uint32_t outerpad[8] = {
+	0x80000000, 0, 0, 0, 0, 0, 0, 0x00000300
+};
+static const uint32_t finalblk[16] = {
+	0x00000001, 0x80000000, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00000620
+};
+
+/*
+ * HMAC-SHA256 keys of count 80 bytes headers key[count][20],
+ * tstate[count][8] contains the midstate of the keys on entry
+ */
+void hmac_sha256_80_init_mb(const uint32_t *key, uint32_t *tstate, uint32_t *ostate, int count)
+{
+	uint32_t _ALIGN(64) S[8*16], I[8*16], pad[16*16];
+	int lanes;
+
+	while (count > 0) {
+		sha256_mb_fn fn = sha256_mb_get(count, &lanes);
+
+		mb_gather(S, tstate, 8, 8, lanes);
+		for (int l = 0; l < lanes; l++)
+			for (int i = 0; i < 4; i++)
+				pad[i * lanes + l] = key[l * 20 + 16 + i];
+		mb_set(pad + 4 * lanes, keypad, 12, lanes);
+		fn(S, pad, 0);
+		memcpy(I, S, 8 * lanes * 4);
+
+		for (int i = 0; i < 8 * lanes; i++)
+			pad[i] = I[i] ^ 0x5c5c5c5c;
+		for (int i = 8 * lanes; i < 16 * lanes; i++)
+			pad[i] = 0x5c5c5c5c;
+		mb_set(S, sha256_mb_h, 8, lanes);
+		fn(S, pad, 0);
+		mb_scatter(ostate, 8, S, 8, lanes, 0);
+
+		for (int i = 0; i < 8 * lanes; i++)
+			pad[i] = I[i] ^ 0x36363636;
+		for (int i = 8 * lanes; i < 16 * lanes; i++)
+			pad[i] = 0x36363636;
+		mb_set(S, sha256_mb_h, 8, lanes);
+		fn(S, pad, 0);
+		mb_scatter(tstate, 8, S, 8, lanes, 0);
+
+		key += lanes * 20;
+		tstate += lanes * 8;
+		ostate += lanes * 8;
+		count -= lanes;
+	}
+}
+
+/* PBKDF2 of 80 bytes salts[count][20] to output[count][32] */
+void pbkdf2_sha256_80_128_mb(const uint32_t *tstate, const uint32_t *ostate,
+	const uint32_t *salt, uint32_t *output, int count)
+{
+	uint32_t _ALIGN(64) istate[8*16], ostate2[8*16], ibuf[16*16], obuf[16*16];
+	int lanes;
+
+	while (count > 0) {
+		sha256_mb_fn fn = sha256_mb_get(count, &lanes);
+
+		mb_gather(istate, tstate, 8, 8, lanes);
+		mb_gather(ibuf, salt, 20, 16, lanes);
+		fn(istate, ibuf, 0);
+
+		mb_gather(ibuf, salt + 16, 20, 4, lanes);
+		mb_set(ibuf + 5 * lanes, innerpad, 11, lanes);
+		mb_set(obuf + 8 * lanes, outerpad, 8, lanes);
+
+		for (int i = 0; i < 4; i++) {
+			uint32_t blk = i + 1;
+			memcpy(obuf, istate, 8 * lanes * 4);
+			mb_set(ibuf + 4 * lanes, &blk, 1, lanes);
+			fn(obuf, ibuf, 0);
+
+			mb_gather(ostate2, ostate, 8, 8, lanes);
+			fn(ostate2, obuf, 0);
+			mb_scatter(output + 8 * i, 32, ostate2, 8, lanes, 1);
+		}
+
+		tstate += lanes * 8;
+		ostate += lanes * 8;
+		salt += lanes * 20;
+		output += lanes * 32;
+		count -= lanes;
+	}
+}
+
+/* PBKDF2 of 128 bytes salts[count][32] to output[count][8] */
+void pbkdf2_sha256_128_32_mb(const uint32_t *tstate, const uint32_t *ostate,
+	const uint32_t *salt, uint32_t *output, int count)
+{
+	uint32_t _ALIGN(64) S[8*16], buf[16*16];
+	int lanes;
+
+	while (count > 0) {
+		sha256_mb_fn fn = sha256_mb_get(count, &lanes);
+
+		mb_gather(S, tstate, 8, 8, lanes);
+		mb_gather(buf, salt, 32, 16, lanes);
+		fn(S, buf, 1);
+		mb_gather(buf, salt + 16, 32, 16, lanes);
+		fn(S, buf, 1);
+		mb_set(buf, finalblk, 16, lanes);
+		fn(S, buf, 0);
+
+		memcpy(buf, S, 8 * lanes * 4);
+		mb_set(buf + 8 * lanes, outerpad, 8, lanes);
+		mb_gather(S, ostate, 8, 8, lanes);
+		fn(S, buf, 0);
+		mb_scatter(output, 8, S, 8, lanes, 1);
+
+		tstate += lanes * 8;
+		ostate += lanes * 8;
+		salt += lanes * 32;
+		output += lanes * 8;
+		count -= lanes;
+	}
+}
@@ -0,0 +1,76 @@
+/*
+ * SHA-256 compression of MB_LANES independent states, word i of
+ * lane l at [i * MB_LANES + l] (state[8][lanes], block[16][lanes])
+ *
+ * required macros:
+ * MB_LANES, MB_TARGET, MB_FN
+ * vec, v_add, v_xor, v_and, v_or, v_rotr, v_shr, v_set1, v_load, v_store
+ */
+
+#define mb_Ch(x, y, z)   v_xor(v_and(x, v_xor(y, z)), z)
+#define mb_Maj(x, y, z)  v_or(v_and(x, v_or(y, z)), v_and(y, z))
+#define mb_S0(x)         v_xor(v_xor(v_rotr(x, 2), v_rotr(x, 13)), v_rotr(x, 22))
+#define mb_S1(x)         v_xor(v_xor(v_rotr(x, 6), v_rotr(x, 11)), v_rotr(x, 25))
+#define mb_s0(x)         v_xor(v_xor(v_rotr(x, 7), v_rotr(x, 18)), v_shr(x, 3))
+#define mb_s1(x)         v_xor(v_xor(v_rotr(x, 17), v_rotr(x, 19)), v_shr(x, 10))
+#define mb_bswap(x)      v_or(v_rotr(v_and(x, v_set1(0x00ff00ff)), 8), v_rotr(v_and(x, v_set1(0xff00ff00)), 24))
+
+static void MB_TARGET MB_FN(uint32_t *state, const uint32_t *block, int swap)
+{
+	vec W[64];
+	vec a, b, c, d, e, f, g, h, t0, t1;
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		W[i] = v_load(block + i * MB_LANES);
+		if (swap)
+			W[i] = mb_bswap(W[i]);
+	}
+	for (i = 16; i < 64; i++)
+		W[i] = v_add(v_add(mb_s1(W[i - 2]), W[i - 7]), v_add(mb_s0(W[i - 15]), W[i - 16]));
+
+	a = v_load(state + 0 * MB_LANES); b = v_load(state + 1 * MB_LANES);
+	c = v_load(state + 2 * MB_LANES); d = v_load(state + 3 * MB_LANES);
+	e = v_load(state + 4 * MB_LANES); f = v_load(state + 5 * MB_LANES);
+	g = v_load(state + 6 * MB_LANES); h = v_load(state + 7 * MB_LANES);
+
+	for (i = 0; i < 64; i++) {
+		t0 = v_add(v_add(h, mb_S1(e)), v_add(mb_Ch(e, f, g), v_add(v_set1(sha256_mb_k[i]), W[i])));
+		t1 = v_add(mb_S0(a), mb_Maj(a, b, c));
+		h = g; g = f; f = e;
+		e = v_add(d, t0);
+		d = c; c = b; b = a;
+		a = v_add(t0, t1);
+	}
+
+	v_store(state + 0 * MB_LANES, v_add(v_load(state + 0 * MB_LANES), a));
+	v_store(state + 1 * MB_LANES, v_add(v_load(state + 1 * MB_LANES), b));
+	v_store(state + 2 * MB_LANES, v_add(v_load(state + 2 * MB_LANES), c));
+	v_store(state + 3 * MB_LANES, v_add(v_load(state + 3 * MB_LANES), d));
+	v_store(state + 4 * MB_LANES, v_add(v_load(state + 4 * MB_LANES), e));
+	v_store(state + 5 * MB_LANES, v_add(v_load(state + 5 * MB_LANES), f));
+	v_store(state + 6 * MB_LANES, v_add(v_load(state + 6 * MB_LANES), g));
+	v_store(state + 7 * MB_LANES, v_add(v_load(state + 7 * MB_LANES), h));
+}
+
+#undef mb_Ch
+#undef mb_Maj
+#undef mb_S0
+#undef mb_S1
+#undef mb_s0
+#undef mb_s1
+#undef mb_bswap
+
+#undef MB_LANES
+#undef MB_TARGET
+#undef MB_FN
+#undef vec
+#undef v_add
+#undef v_xor
+#undef v_and
+#undef v_or
+#undef v_rotr
+#undef v_shr
+#undef v_set1
+#undef v_load
+#undef v_store
@@ -0,0 +1,42 @@
+/*
+ * Multi-buffer versions of the 512 bits sph hashes (blake, bmw, keccak,
+ * skein, jh, sha512, cubehash, shabal, luffa)
+ *
+ * count messages of len bytes are hashed at once, 4 (avx2) or 8
+ * (avx-512) lanes for the 64 bits primitives, 8 or 16 for the 32 bits
+ * ones. The implementation is selected at runtime and checked against
+ * the scalar sph functions, which are used for the remaining messages
+ * or when no vector unit is available. The outputs are the same.
+ */
+
+#ifndef SPH_MB512_H__
+#define SPH_MB512_H__
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stddef.h>
+
+/* lanes of the 64 bits primitives, 1 without avx2 */
+int sph_mb512_lanes(void);
+const char* sph_mb512_name(void);
+
+/**
+ * Hash the count inputs of len bytes src[count][len] into dst[count][64]
+ */
+void sph_blake512_mb(void *dst, const void *src, size_t len, int count);
+void sph_bmw512_mb(void *dst, const void *src, size_t len, int count);
+void sph_keccak512_mb(void *dst, const void *src, size_t len, int count);
+void sph_skein512_mb(void *dst, const void *src, size_t len, int count);
+void sph_jh512_mb(void *dst, const void *src, size_t len, int count);
+void sph_sha512_mb(void *dst, const void *src, size_t len, int count);
+void sph_cubehash512_mb(void *dst, const void *src, size_t len, int count);
+void sph_shabal512_mb(void *dst, const void *src, size_t len, int count);
+void sph_luffa512_mb(void *dst, const void *src, size_t len, int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
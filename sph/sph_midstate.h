@@ -0,0 +1,59 @@
+/*
+ * Midstate snapshots of the sph hashes for 80 bytes block headers
+ *
+ * Only the nonce (the last 4 bytes) changes between the hashes of a job,
+ * so the context of the first function is kept after absorbing the 76
+ * bytes before it and cloned for each nonce. Only the functions with a
+ * block of 76 bytes or less (blake256, bmw256, keccak, skein, jh, luffa,
+ * whirlpool...) skip compressions, the 128 bytes ones (blake512, bmw512,
+ * groestl512...) still hash the whole header in their close and gain
+ * nothing from it.
+ */
+
+#ifndef SPH_MIDSTATE_H__
+#define SPH_MIDSTATE_H__
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stddef.h>
+#include "sph_types.h"
+
+#define SPH_MIDSTATE_PREFIX 76
+
+/* larger than the sph contexts (keccak, 360 bytes) */
+#define SPH_MIDSTATE_CTX_SIZE 512
+
+typedef struct {
+	void (*init)(void *cc);
+	void (*update)(void *cc, const void *data, size_t len);
+	size_t size;
+	unsigned char prefix[SPH_MIDSTATE_PREFIX];
+	int valid;
+	sph_u64 ctx[SPH_MIDSTATE_CTX_SIZE / 8];
+} sph_midstate80;
+
+/**
+ * Load the context cc (of size bytes) with the 80 bytes header, from the
+ * snapshot when its prefix is unchanged. The snapshot is taken again on a
+ * new prefix or another function. cc is then ready for the close function.
+ *
+ * @param ms      the snapshot, one per thread and per hash function
+ * @param header  the 80 bytes input
+ */
+void sph_midstate80_load(sph_midstate80 *ms, void (*init)(void *cc),
+	void (*update)(void *cc, const void *data, size_t len), size_t size,
+	void *cc, const void *header);
+
+/* init and update of a sph_<name>_context with a header, like
+ * sph_blake512_init(&ctx); sph_blake512(&ctx, header, 80); */
+#define SPH_MIDSTATE80(ms, name, cc, header) \
+	sph_midstate80_load(ms, sph_ ## name ## _init, sph_ ## name, \
+		sizeof(sph_ ## name ## _context), cc, header)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,34 +1,98 @@
 /**
  * Stats place holder
  *
- * Note: this source is C++ (requires std::map)
+ * One fixed ring of scans per thread, written only by its miner thread.
+ * The window average and an EWMA are updated on each write, readers use
+ * a sequence counter and retry instead of locking the writers.
  *
  * tpruvot@github 2014
  */
 #include <stdlib.h>
 #include <memory.h>
-#include <map>
 
 #include "miner.h"
 
-static std::map<uint64_t, stats_data> tlastscans;
-static uint64_t uid = 0;
-
 #define STATS_AVG_SAMPLES 30
 #define STATS_PURGE_TIMEOUT 120*60 /* 120 mn */
+#define STATS_RING_SIZE 256 /* per thread, max avg window */
+
+#ifdef _MSC_VER
+#define stats_barrier() MemoryBarrier()
+#else
+#define stats_barrier() __sync_synchronize()
+#endif
+
+struct stats_ring {
+	volatile uint32_t seq; // odd while the writer updates the ring
+	volatile uint32_t reset; // set by the purges, applied by the writer
+	uint32_t head; // records written
+	uint32_t window; // records in sum
+	double sum;
+	double ewma;
+	struct stats_data rec[STATS_RING_SIZE];
+};
+
+struct stats_sum {
+	uint32_t head;
+	uint32_t window;
+	double sum;
+	double ewma;
+};
+
+static struct stats_ring rings[MAX_GPUS];
+static volatile uint32_t uid = 0;
 
 extern uint64_t global_hashrate;
 extern int opt_statsavg;
 
+static inline uint32_t stats_window()
+{
+	if (opt_statsavg < 1 || opt_statsavg > STATS_RING_SIZE)
+		return STATS_RING_SIZE;
+	return (uint32_t) opt_statsavg;
+}
+
+/**
+ * Consistent copy of a thread ring summary and of its max newest records
+ * @return records copied
+ */
+static int stats_read(int thr_id, struct stats_sum *s, struct stats_data *data, int max_records)
+{
+	struct stats_ring *r = &rings[thr_id];
+	uint32_t seq;
+	int records;
+
+	do {
+		while ((seq = r->seq) & 1)
+			; // writer busy, only a few stores
+		stats_barrier();
+		records = 0;
+		if (r->reset) {
+			memset(s, 0, sizeof(*s));
+		} else {
+			s->head = r->head;
+			s->window = r->window;
+			s->sum = r->sum;
+			s->ewma = r->ewma;
+			for (uint32_t n = s->head; n > 0 && s->head - n < STATS_RING_SIZE && records < max_records; n--)
+				memcpy(&data[records++], &r->rec[(n - 1) % STATS_RING_SIZE], sizeof(struct stats_data));
+		}
+		stats_barrier();
+	} while (seq != r->seq);
+
+	return records;
+}
+
 /**
- * Store speed per thread
+ * Store speed per thread (called by the thread itself)
  */
 void stats_remember_speed(int thr_id, uint32_t hashcount, double hashrate, uint8_t found, uint32_t height)
 {
-	const uint64_t key = uid++;
+	struct stats_ring *r = &rings[thr_id];
+	const uint32_t window = stats_window();
 	stats_data data;
 	// to enough hashes to give right stats
-	if (hashcount < 1000 || hashrate < 0.01)
+	if (hashcount <= 1000 || hashrate < 0.01)
 		return;
 
 	// first hash rates are often erroneous
@@ -36,7 +100,11 @@ void stats_remember_speed(int thr_id, uint32_t hashcount, double hashrate, uint8
 	//	return;
 
 	memset(&data, 0, sizeof(data));
-	data.uid = (uint32_t) uid;
+#ifdef _MSC_VER
+	data.uid = (uint32_t) InterlockedIncrement((volatile LONG*) &uid);
+#else
+	data.uid = __sync_add_and_fetch(&uid, 1);
+#endif
 	data.gpu_id = (uint8_t) device_map[thr_id];
 	data.thr_id = (uint8_t) thr_id;
 	data.tm_stat = (uint32_t) time(NULL);
@@ -47,13 +115,45 @@ void stats_remember_speed(int thr_id, uint32_t hashcount, double hashrate, uint8
 	data.hashfound = found;
 	data.hashrate = hashrate;
 	data.difficulty = net_diff ? net_diff : stratum_diff;
-	if (opt_n_threads == 1 && global_hashrate && uid > 10) {
-		// prevent stats on too high vardiff (erroneous rates)
+	if (opt_n_threads == 1 && global_hashrate && r->head > 10) {
+		// prevent stats on too high vardiff (erroneous rates), not stored
 		double ratio = (hashrate / (1.0 * global_hashrate));
 		if (ratio < 0.4 || ratio > 1.6)
-			data.ignored = 1;
+			return;
+	}
+
+	r->seq++;
+	stats_barrier();
+
+	if (r->reset) {
+		r->reset = 0;
+		r->head = r->window = 0;
+		r->sum = r->ewma = 0.;
 	}
-	tlastscans[key] = data;
+
+	// the record leaving the window can be the one overwritten
+	while (r->window >= window) {
+		r->sum -= r->rec[(r->head - r->window) % STATS_RING_SIZE].hashrate;
+		r->window--;
+	}
+	memcpy(&r->rec[r->head % STATS_RING_SIZE], &data, sizeof(data));
+	r->head++;
+	r->window++;
+	r->sum += hashrate;
+	if (r->window == 1)
+		r->ewma = hashrate;
+	else
+		r->ewma += (hashrate - r->ewma) * 2.0 / (window + 1);
+
+	// drop the rounding drift once per ring turn
+	if (r->head % STATS_RING_SIZE == 0) {
+		r->sum = 0.;
+		for (uint32_t n = 0; n < r->window; n++)
+			r->sum += r->rec[(r->head - 1 - n) % STATS_RING_SIZE].hashrate;
+	}
+
+	stats_barrier();
+	r->seq++;
 }
 
 /**
@@ -62,33 +162,40 @@ void stats_remember_speed(int thr_id, uint32_t hashcount, double hashrate, uint8
  */
 double stats_get_speed(int thr_id, double def_speed)
 {
+	struct stats_sum s;
 	double speed = 0.0;
 	int records = 0;
 
-	std::map<uint64_t, stats_data>::reverse_iterator i = tlastscans.rbegin();
-	while (i != tlastscans.rend() && records < opt_statsavg) {
-		if (!i->second.ignored)
-		if (thr_id == -1 || i->second.thr_id == thr_id) {
-			if (i->second.hashcount > 1000) {
-				speed += i->second.hashrate;
-				records++;
-				// applog(LOG_BLUE, "%d %x %.1f", thr_id, i->second.thr_id, i->second.hashrate);
-			}
-		}
-		++i;
+	if (thr_id != -1) {
+		stats_read(thr_id, &s, NULL, 0);
+		return s.window ? s.sum / s.window : def_speed;
 	}
 
-	if (records)
-		speed /= (double)(records);
-	else
-		speed = def_speed;
-
-	if (thr_id == -1)
-		speed *= (double)(opt_n_threads);
+	// sum of the threads averages
+	for (int n = 0; n < opt_n_threads; n++) {
+		stats_read(n, &s, NULL, 0);
+		if (s.window) {
+			speed += s.sum / s.window;
+			records++;
+		}
+	}
+	if (!records)
+		speed = def_speed * (double)(opt_n_threads);
 
 	return speed;
 }
 
+/**
+ * Get the exponential moving average of a thread speed
+ * (same period as the window average)
+ */
+double stats_get_speed_ewma(int thr_id, double def_speed)
+{
+	struct stats_sum s;
+	stats_read(thr_id, &s, NULL, 0);
+	return s.window ? s.ewma : def_speed;
+}
+
 /**
  * Get the gpu average speed
  * @param gpu_id int (-1 for all threads)
@@ -107,21 +214,37 @@ double stats_get_gpu_speed(int gpu_id)
 }
 
 /**
- * Export data for api calls
+ * Export data for api calls (newest first)
  */
 int stats_get_history(int thr_id, struct stats_data *data, int max_records)
 {
+	struct stats_sum s;
+	struct stats_data *recs;
+	int count[MAX_GPUS] = { 0 }, pos[MAX_GPUS] = { 0 };
 	int records = 0;
 
-	std::map<uint64_t, stats_data>::reverse_iterator i = tlastscans.rbegin();
-	while (i != tlastscans.rend() && records < max_records) {
-		if (!i->second.ignored)
-			if (thr_id == -1 || i->second.thr_id == thr_id) {
-				memcpy(&data[records], &(i->second), sizeof(struct stats_data));
-				records++;
-			}
-		++i;
+	if (thr_id != -1)
+		return stats_read(thr_id, &s, data, max_records);
+
+	// merge the threads newest records on the global uid
+	recs = (struct stats_data*) malloc(sizeof(struct stats_data) * max_records * opt_n_threads);
+	if (!recs)
+		return 0;
+	for (int n = 0; n < opt_n_threads; n++)
+		count[n] = stats_read(n, &s, &recs[n * max_records], max_records);
+	while (records < max_records) {
+		int best = -1;
+		for (int n = 0; n < opt_n_threads; n++) {
+			if (pos[n] < count[n] && (best == -1 ||
+				recs[n * max_records + pos[n]].uid > recs[best * max_records + pos[best]].uid))
+				best = n;
+		}
+		if (best == -1)
+			break;
+		memcpy(&data[records++], &recs[best * max_records + pos[best]], sizeof(struct stats_data));
+		pos[best]++;
 	}
+	free(recs);
 	return records;
 }
 
@@ -132,17 +255,18 @@ void stats_purge_old(void)
 {
 	int deleted = 0;
 	uint32_t now = (uint32_t) time(NULL);
-	uint32_t sz = (uint32_t) tlastscans.size();
-	std::map<uint64_t, stats_data>::iterator i = tlastscans.begin();
-	while (i != tlastscans.end()) {
-		if (i->second.ignored || (now - i->second.tm_stat) > STATS_PURGE_TIMEOUT) {
+	struct stats_data last;
+	struct stats_sum s;
+
+	// the rings are overwritten, only drop the idle threads stats
+	for (int n = 0; n < opt_n_threads; n++) {
+		if (stats_read(n, &s, &last, 1) && (now - last.tm_stat) > STATS_PURGE_TIMEOUT) {
+			rings[n].reset = 1;
 			deleted++;
-			tlastscans.erase(i++);
 		}
-		else ++i;
 	}
 	if (opt_debug && deleted) {
-		applog(LOG_DEBUG, "stats: %d/%d records purged", deleted, sz);
+		applog(LOG_DEBUG, "stats: %d thread(s) records purged", deleted);
 	}
 }
 
@@ -151,7 +275,8 @@ void stats_purge_old(void)
  */
 void stats_purge_all(void)
 {
-	tlastscans.clear();
+	for (int n = 0; n < MAX_GPUS; n++)
+		rings[n].reset = 1;
 }
 
 /**
@@ -159,6 +284,11 @@ void stats_purge_all(void)
  */
 void stats_getmeminfo(uint64_t *mem, uint32_t *records)
 {
-	(*records) = (uint32_t) tlastscans.size();
+	struct stats_sum s;
+	(*records) = 0;
+	for (int n = 0; n < opt_n_threads; n++) {
+		stats_read(n, &s, NULL, 0);
+		(*records) += min(s.head, (uint32_t) STATS_RING_SIZE);
+	}
 	(*mem) = (*records) * sizeof(stats_data);
 }
@@ -8,6 +8,7 @@ extern "C" {
 #include "sph/sph_jh.h"
 #include "sph/sph_keccak.h"
 #include "sph/sph_echo.h"
+#include "sph/sph_midstate.h"
 }
 
 #include "miner.h"
@@ -23,6 +24,8 @@ static uint32_t *d_resNonce[MAX_GPUS];
 
 // cpu hash
 
+static __thread sph_midstate80 s_midstate;
+
 extern "C" void tribus_hash(void *state, const void *input)
 {
 	uint8_t _ALIGN(64) hash[64];
@@ -31,8 +34,7 @@ extern "C" void tribus_hash(void *state, const void *input)
 	sph_keccak512_context ctx_keccak;
 	sph_echo512_context ctx_echo;
 
-	sph_jh512_init(&ctx_jh);
-	sph_jh512(&ctx_jh, input, 80);
+	SPH_MIDSTATE80(&s_midstate, jh512, &ctx_jh, input);
 	sph_jh512_close(&ctx_jh, (void*) hash);
 
 	sph_keccak512_init(&ctx_keccak);
@@ -33,7 +33,12 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#define USE_EPOLL
+#endif
 #include "miner.h"
+#include "algos.h"
 #include "elist.h"
 
 #include "crypto/xmr-rpc.h"
@@ -166,7 +171,11 @@ void gpulog(int prio, int thr_id, const char *fmt, ...)
 	if (prio == LOG_DEBUG && !opt_debug)
 		return;
 
-	if (gpu_threads > 1)
+	if (device_type[thr_id % MAX_GPUS] == DEVICE_TYPE_CPU)
+		len = snprintf(pfmt, 128, "CPU T%d: %s", thr_id, fmt);
+	else if (device_type[thr_id % MAX_GPUS] == DEVICE_TYPE_SIM)
+		len = snprintf(pfmt, 128, "SIM T%d: %s", thr_id, fmt);
+	else if (gpu_threads > 1)
 		len = snprintf(pfmt, 128, "GPU T%d: %s", thr_id, fmt);
 	else
 		len = snprintf(pfmt, 128, "GPU #%d: %s", dev_id, fmt);
@@ -865,6 +874,52 @@ void work_set_target(struct work* work, double diff)
 	work->targetdiff = diff;
 }
 
+// the pok txs (64KB) are shared by the work copies, the last one frees them
+static pthread_mutex_t work_txs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct work_txs* work_txs_alloc()
+{
+	struct work_txs *txs = (struct work_txs*) calloc(1, sizeof(struct work_txs));
+	if (txs)
+		txs->refs = 1;
+	return txs;
+}
+
+static void work_txs_release(struct work_txs *txs)
+{
+	bool last;
+	if (!txs)
+		return;
+	pthread_mutex_lock(&work_txs_lock);
+	last = (--txs->refs == 0);
+	pthread_mutex_unlock(&work_txs_lock);
+	if (last)
+		free(txs);
+}
+
+// copy the header, target and nonces of a work, the txs are only referenced
+void work_copy(struct work *dest, const struct work *src)
+{
+	struct work_txs *old = dest->txs;
+	if (dest == src)
+		return;
+	if (src->txs) {
+		pthread_mutex_lock(&work_txs_lock);
+		src->txs->refs++;
+		pthread_mutex_unlock(&work_txs_lock);
+	}
+	memcpy(dest, src, sizeof(struct work));
+	work_txs_release(old);
+}
+
+// release the shared parts of a work
+void work_free(struct work *work)
+{
+	work_txs_release(work->txs);
+	work->txs = NULL;
+	work->tx_count = 0;
+}
+
 
 // Only used by longpoll pools
 double target_to_diff(uint32_t* target)
@@ -892,32 +947,123 @@ double target_to_diff(uint32_t* target)
 #define socket_blocks() (errno == EAGAIN || errno == EWOULDBLOCK)
 #endif
 
-static bool send_line(curl_socket_t sock, char *s)
-{
-	ssize_t len, sent = 0;
-	
-	len = (ssize_t)strlen(s);
-	s[len++] = '\n';
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define RBUFSIZE 16384
+#define RECVSIZE 4096
+#define SBUFSIZE 1024
 
-	while (len > 0) {
-		struct timeval timeout = {0, 0};
-		ssize_t n;
-		fd_set wd;
+#ifdef USE_EPOLL
+/* the stratum socket events, handled by the stratum thread, stratum_sock_lock for changes */
+static int stratum_epfd = -1;
+static int stratum_epsock = -1;
+static uint32_t stratum_epevents = 0;
 
-		FD_ZERO(&wd);
-		FD_SET(sock, &wd);
-		if (select((int)sock + 1, NULL, &wd, NULL, &timeout) < 1)
+static bool stratum_epoll_set(struct stratum_ctx *sctx, uint32_t events)
+{
+	struct epoll_event ev = { 0 };
+	int rc = 0;
+
+	if (stratum_epfd < 0) {
+		stratum_epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (stratum_epfd < 0)
 			return false;
-		n = send(sock, s + sent, len, 0);
+	}
+	ev.events = events;
+	if (stratum_epsock != (int) sctx->sock) {
+		if (stratum_epsock >= 0)
+			epoll_ctl(stratum_epfd, EPOLL_CTL_DEL, stratum_epsock, NULL);
+		rc = epoll_ctl(stratum_epfd, EPOLL_CTL_ADD, (int) sctx->sock, &ev);
+	} else if (events != stratum_epevents) {
+		rc = epoll_ctl(stratum_epfd, EPOLL_CTL_MOD, (int) sctx->sock, &ev);
+		// fd closed and reused since the last wait
+		if (rc && errno == ENOENT)
+			rc = epoll_ctl(stratum_epfd, EPOLL_CTL_ADD, (int) sctx->sock, &ev);
+	}
+	if (rc) {
+		stratum_epsock = -1;
+		return false;
+	}
+	stratum_epsock = (int) sctx->sock;
+	stratum_epevents = events;
+	return true;
+}
+
+static void stratum_epoll_del(struct stratum_ctx *sctx)
+{
+	if (stratum_epfd >= 0 && stratum_epsock == (int) sctx->sock)
+		epoll_ctl(stratum_epfd, EPOLL_CTL_DEL, stratum_epsock, NULL);
+	stratum_epsock = -1;
+	stratum_epevents = 0;
+}
+#endif
+
+static bool socket_full(curl_socket_t sock, int timeout)
+{
+	struct timeval tv;
+	fd_set rd;
+
+	FD_ZERO(&rd);
+	FD_SET(sock, &rd);
+	tv.tv_sec = timeout;
+	tv.tv_usec = 0;
+	if (select((int)sock + 1, &rd, NULL, NULL, &tv) > 0)
+		return true;
+	return false;
+}
+
+static void stratum_buffer_reset(struct stratum_ctx *sctx)
+{
+	sctx->sockbuf_head = sctx->sockbuf_tail = sctx->sockbuf_scan = 0;
+	sctx->sendbuf_len = sctx->sendbuf_sent = 0;
+}
+
+// send the queued data until the socket blocks, stratum_sock_lock held
+static bool stratum_flush(struct stratum_ctx *sctx)
+{
+	while (sctx->sendbuf_sent < sctx->sendbuf_len) {
+		ssize_t n = send(sctx->sock, sctx->sendbuf + sctx->sendbuf_sent,
+			sctx->sendbuf_len - sctx->sendbuf_sent, MSG_NOSIGNAL);
 		if (n < 0) {
-			if (!socket_blocks())
-				return false;
-			n = 0;
+			if (socket_blocks())
+				break;
+			sctx->sendbuf_len = sctx->sendbuf_sent = 0;
+			return false;
 		}
-		sent += n;
-		len -= n;
+		sctx->sendbuf_sent += n;
 	}
+	if (sctx->sendbuf_sent == sctx->sendbuf_len)
+		sctx->sendbuf_len = sctx->sendbuf_sent = 0;
+#ifdef USE_EPOLL
+	// also wake up the stratum thread to send the rest
+	stratum_epoll_set(sctx, EPOLLIN | (sctx->sendbuf_len ? EPOLLOUT : 0));
+#endif
+	return true;
+}
 
+static bool stratum_queue_line(struct stratum_ctx *sctx, const char *s)
+{
+	size_t len = strlen(s);
+	size_t pending = sctx->sendbuf_len - sctx->sendbuf_sent;
+
+	if (sctx->sendbuf_sent) {
+		memmove(sctx->sendbuf, sctx->sendbuf + sctx->sendbuf_sent, pending);
+		sctx->sendbuf_len = pending;
+		sctx->sendbuf_sent = 0;
+	}
+	if (pending + len + 1 > sctx->sendbuf_size) {
+		size_t size = max(sctx->sendbuf_size * 2, pending + len + SBUFSIZE);
+		char *buf = (char*) realloc(sctx->sendbuf, size);
+		if (!buf)
+			return false;
+		sctx->sendbuf = buf;
+		sctx->sendbuf_size = size;
+	}
+	memcpy(sctx->sendbuf + pending, s, len);
+	sctx->sendbuf[pending + len] = '\n';
+	sctx->sendbuf_len = pending + len + 1;
 	return true;
 }
 
@@ -929,109 +1075,190 @@ bool stratum_send_line(struct stratum_ctx *sctx, char *s)
 		applog(LOG_DEBUG, "> %s", s);
 
 	pthread_mutex_lock(&stratum_sock_lock);
-	ret = send_line(sctx->sock, s);
+	if (sctx->curl && stratum_queue_line(sctx, s))
+		ret = stratum_flush(sctx);
+#ifndef USE_EPOLL
+	// no event loop to finish the send, wait for the socket without
+	// the lock, the other threads can still queue lines or disconnect
+	if (ret && sctx->sendbuf_len) {
+		curl_socket_t sock = sctx->sock;
+		time_t start = time(NULL);
+		while (ret && sctx->sendbuf_len) {
+			struct timeval tv = { 1, 0 };
+			fd_set wd;
+			int rc;
+			FD_ZERO(&wd);
+			FD_SET(sock, &wd);
+			pthread_mutex_unlock(&stratum_sock_lock);
+			rc = select((int)sock + 1, NULL, &wd, NULL, &tv);
+			pthread_mutex_lock(&stratum_sock_lock);
+			if (rc < 0 || !sctx->curl || sctx->sock != sock || time(NULL) - start > opt_timeout)
+				ret = false;
+			else
+				ret = stratum_flush(sctx);
+		}
+	}
+#endif
 	pthread_mutex_unlock(&stratum_sock_lock);
 
 	return ret;
 }
 
-static bool socket_full(curl_socket_t sock, int timeout)
-{
-	struct timeval tv;
-	fd_set rd;
+/*
+ * wait for the socket to be readable, and send the queued lines if the
+ * socket becomes writable meanwhile. errors are reported as readable,
+ * the next recv will fail.
+ */
+static bool stratum_wait(struct stratum_ctx *sctx, int timeout)
+{
+#ifdef USE_EPOLL
+	struct epoll_event ev[2];
+	struct timeval tv_start, tv_now, diff;
+	int msecs = timeout * 1000;
+	int epfd, n;
+
+	gettimeofday(&tv_start, NULL);
+	while (msecs >= 0) {
+		pthread_mutex_lock(&stratum_sock_lock);
+		if (!sctx->curl || !stratum_epoll_set(sctx, EPOLLIN | (sctx->sendbuf_len ? EPOLLOUT : 0))) {
+			pthread_mutex_unlock(&stratum_sock_lock);
+			return socket_full(sctx->sock, timeout);
+		}
+		epfd = stratum_epfd;
+		pthread_mutex_unlock(&stratum_sock_lock);
 
-	FD_ZERO(&rd);
-	FD_SET(sock, &rd);
-	tv.tv_sec = timeout;
-	tv.tv_usec = 0;
-	if (select((int)sock + 1, &rd, NULL, NULL, &tv) > 0)
-		return true;
+		n = epoll_wait(epfd, ev, 2, msecs);
+		if (n < 0 && errno != EINTR)
+			return false;
+		for (int i = 0; i < n; i++) {
+			if (ev[i].events & EPOLLOUT) {
+				pthread_mutex_lock(&stratum_sock_lock);
+				bool sent = stratum_flush(sctx);
+				pthread_mutex_unlock(&stratum_sock_lock);
+				if (!sent)
+					return true;
+			}
+			if (ev[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+				return true;
+		}
+		if (n == 0)
+			break;
+		gettimeofday(&tv_now, NULL);
+		timeval_subtract(&diff, &tv_now, &tv_start);
+		msecs = timeout * 1000 - (int) (diff.tv_sec * 1000 + diff.tv_usec / 1000);
+	}
 	return false;
+#else
+	return socket_full(sctx->sock, timeout);
+#endif
 }
 
 bool stratum_socket_full(struct stratum_ctx *sctx, int timeout)
 {
 	if (!sctx->sockbuf) return false;
-	return strlen(sctx->sockbuf) || socket_full(sctx->sock, timeout);
+	return sctx->sockbuf_tail > sctx->sockbuf_head || stratum_wait(sctx, timeout);
 }
 
-#define RBUFSIZE 2048
-#define RECVSIZE (RBUFSIZE - 4)
+/* recv what is available at the end of the buffer: > 0 bytes read, 0 closed, -1 would block, -2 error */
+static ssize_t stratum_buffer_fill(struct stratum_ctx *sctx)
+{
+	ssize_t n;
+
+	if (sctx->sockbuf_size - sctx->sockbuf_tail < RECVSIZE + 1) {
+		size_t used = sctx->sockbuf_tail - sctx->sockbuf_head;
+		if (sctx->sockbuf_head) {
+			// move the partial line back to the start, keep scan position
+			memmove(sctx->sockbuf, sctx->sockbuf + sctx->sockbuf_head, used);
+			sctx->sockbuf_head = 0;
+			sctx->sockbuf_tail = used;
+		}
+		if (sctx->sockbuf_size - used < RECVSIZE + 1) {
+			char *buf = (char*) realloc(sctx->sockbuf, sctx->sockbuf_size * 2);
+			if (!buf)
+				return -2;
+			sctx->sockbuf = buf;
+			sctx->sockbuf_size *= 2;
+		}
+	}
 
-static void stratum_buffer_append(struct stratum_ctx *sctx, const char *s)
+	n = recv(sctx->sock, sctx->sockbuf + sctx->sockbuf_tail, sctx->sockbuf_size - sctx->sockbuf_tail - 1, 0);
+	if (n < 0)
+		return socket_blocks() ? -1 : -2;
+	sctx->sockbuf_tail += n;
+	return n;
+}
+
+/* next complete line of the buffer, terminated in place (no copy) */
+static char *stratum_buffer_line(struct stratum_ctx *sctx)
 {
-	size_t old, snew;
+	while (sctx->sockbuf_tail > sctx->sockbuf_head) {
+		char *start = sctx->sockbuf + sctx->sockbuf_head;
+		size_t avail = sctx->sockbuf_tail - sctx->sockbuf_head;
+		char *nl = (char*) memchr(start + sctx->sockbuf_scan, '\n', avail - sctx->sockbuf_scan);
+		size_t len;
 
-	old = strlen(sctx->sockbuf);
-	snew = old + strlen(s) + 1;
-	if (snew >= sctx->sockbuf_size) {
-		sctx->sockbuf_size = snew + (RBUFSIZE - (snew % RBUFSIZE));
-		sctx->sockbuf = (char*)realloc(sctx->sockbuf, sctx->sockbuf_size);
+		if (!nl) {
+			// dont rescan these bytes on the next recv
+			sctx->sockbuf_scan = avail;
+			return NULL;
+		}
+		len = nl - start;
+		*nl = '\0';
+		if (len && start[len-1] == '\r')
+			start[len-1] = '\0';
+		sctx->sockbuf_head += len + 1;
+		sctx->sockbuf_scan = 0;
+		if (sctx->sockbuf_head == sctx->sockbuf_tail)
+			sctx->sockbuf_head = sctx->sockbuf_tail = 0;
+		if (start[0])
+			return start;
+		// skip empty lines
 	}
-	strcpy(sctx->sockbuf + old, s);
+	return NULL;
 }
 
-char *stratum_recv_line(struct stratum_ctx *sctx)
+/*
+ * returns the next line received, the string stays in the socket buffer
+ * and is only valid until the next recv on this stratum context.
+ */
+const char *stratum_recv_line_view(struct stratum_ctx *sctx)
 {
-	ssize_t len, buflen;
-	char *tok, *sret = NULL;
+	char *sret = NULL;
 	int timeout = opt_timeout;
+	time_t rstart = time(NULL);
 
 	if (!sctx->sockbuf)
 		return NULL;
 
-	if (!strstr(sctx->sockbuf, "\n")) {
-		bool ret = true;
-		time_t rstart = time(NULL);
-		if (!socket_full(sctx->sock, timeout)) {
-			applog(LOG_ERR, "stratum_recv_line timed out");
-			goto out;
-		}
-		do {
-			char s[RBUFSIZE];
-			ssize_t n;
-
-			memset(s, 0, RBUFSIZE);
-			n = recv(sctx->sock, s, RECVSIZE, 0);
-			if (!n) {
-				ret = false;
+	sret = stratum_buffer_line(sctx);
+	while (!sret) {
+		ssize_t n = stratum_buffer_fill(sctx);
+		if (n == -1) {
+			int left = (int) (timeout - (time(NULL) - rstart));
+			if (left <= 0 || !stratum_wait(sctx, left)) {
+				applog(LOG_ERR, "stratum_recv_line timed out");
 				break;
 			}
-			if (n < 0) {
-				if (!socket_blocks() || !socket_full(sctx->sock, 1)) {
-					ret = false;
-					break;
-				}
-			} else
-				stratum_buffer_append(sctx, s);
-		} while (time(NULL) - rstart < timeout && !strstr(sctx->sockbuf, "\n"));
-
-		if (!ret) {
+			continue;
+		}
+		if (n <= 0) {
 			if (opt_debug) applog(LOG_ERR, "stratum_recv_line failed");
-			goto out;
+			break;
 		}
+		sret = stratum_buffer_line(sctx);
 	}
 
-	buflen = (ssize_t)strlen(sctx->sockbuf);
-	tok = strtok(sctx->sockbuf, "\n");
-	if (!tok) {
-		applog(LOG_ERR, "stratum_recv_line failed to parse a newline-terminated string");
-		goto out;
-	}
-	sret = strdup(tok);
-	len = (ssize_t)strlen(sret);
-
-	if (buflen > len + 1)
-		memmove(sctx->sockbuf, sctx->sockbuf + len + 1, buflen - len + 1);
-	else
-		sctx->sockbuf[0] = '\0';
-
-out:
 	if (sret && opt_protocol)
 		applog(LOG_DEBUG, "< %s", sret);
 	return sret;
 }
 
+char *stratum_recv_line(struct stratum_ctx *sctx)
+{
+	const char *line = stratum_recv_line_view(sctx);
+	return line ? strdup(line) : NULL;
+}
+
 #if LIBCURL_VERSION_NUM >= 0x071101
 static curl_socket_t opensocket_grab_cb(void *clientp, curlsocktype purpose,
 	struct curl_sockaddr *addr)
@@ -1061,7 +1288,11 @@ bool stratum_connect(struct stratum_ctx *sctx, const char *url)
 		sctx->sockbuf = (char*)calloc(RBUFSIZE, 1);
 		sctx->sockbuf_size = RBUFSIZE;
 	}
-	sctx->sockbuf[0] = '\0';
+	if (!sctx->sendbuf) {
+		sctx->sendbuf = (char*)calloc(SBUFSIZE, 1);
+		sctx->sendbuf_size = SBUFSIZE;
+	}
+	stratum_buffer_reset(sctx);
 	pthread_mutex_unlock(&stratum_sock_lock);
 
 	if (url != sctx->url) {
@@ -1129,6 +1360,7 @@ void stratum_free_job(struct stratum_ctx *sctx)
 		}
 		free(sctx->job.merkle);
 	}
+	free(sctx->job.merkle_be);
 	free(sctx->job.coinbase);
 	// note: xnonce2 is not allocated
 	memset(&(sctx->job.job_id), 0, sizeof(struct stratum_job));
@@ -1140,10 +1372,12 @@ void stratum_disconnect(struct stratum_ctx *sctx)
 	pthread_mutex_lock(&stratum_sock_lock);
 	if (sctx->curl) {
 		pools[sctx->pooln].disconnects++;
+#ifdef USE_EPOLL
+		stratum_epoll_del(sctx);
+#endif
 		curl_easy_cleanup(sctx->curl);
 		sctx->curl = NULL;
-		if (sctx->sockbuf)
-			sctx->sockbuf[0] = '\0';
+		stratum_buffer_reset(sctx);
 		// free(sctx->sockbuf);
 		// sctx->sockbuf = NULL;
 	}
@@ -1254,7 +1488,7 @@ start:
 	if (!stratum_send_line(sctx, s))
 		goto out;
 
-	if (!socket_full(sctx->sock, 10)) {
+	if (!stratum_socket_full(sctx, 10)) {
 		applog(LOG_ERR, "stratum_subscribe timed out");
 		goto out;
 	}
@@ -1388,7 +1622,7 @@ bool stratum_authorize(struct stratum_ctx *sctx, const char *user, const char *p
 		goto out;
 
 	// reduced timeout to handle pools ignoring this method without answer (like xpool.ca)
-	if (!socket_full(sctx->sock, 1)) {
+	if (!stratum_socket_full(sctx, 1)) {
 		if (opt_debug)
 			applog(LOG_DEBUG, "stratum extranonce subscribe timed out");
 		goto out;
@@ -1452,6 +1686,74 @@ static uint32_t getblocheight(struct stratum_ctx *sctx)
 	return height;
 }
 
+// job constant part of the merkle root, stratum_work_lock held
+static void stratum_merkle_prepare(struct stratum_ctx *sctx)
+{
+	struct stratum_job *job = &sctx->job;
+	int blocks = (int) (job->xnonce2 - job->coinbase) / 64;
+	uint32_t T[16];
+
+	// coinb1 + xnonce1 full blocks
+	sha256_init(job->coinbase_ms);
+	for (int b = 0; b < blocks; b++) {
+		for (int i = 0; i < 16; i++)
+			T[i] = be32dec(job->coinbase + b * 64 + i * 4);
+		sha256_transform(job->coinbase_ms, T, 0);
+	}
+	job->coinbase_ms_len = blocks * 64;
+
+	free(job->merkle_be);
+	job->merkle_be = NULL;
+	if (job->merkle_count) {
+		job->merkle_be = (uint32_t*) malloc(job->merkle_count * 32);
+		for (int n = 0; job->merkle_be && n < job->merkle_count; n++)
+			for (int i = 0; i < 8; i++)
+				job->merkle_be[n * 8 + i] = be32dec(job->merkle[n] + i * 4);
+	}
+}
+
+/*
+ * sha256d merkle roots of the current job for count xnonce2 values,
+ * as header words (roots[count][8]). Only the coinbase tail after the
+ * cached midstate is hashed, the count coinbases go through the
+ * multi-buffer sha256. stratum_work_lock held, false if out of memory.
+ */
+bool stratum_merkle_roots(struct stratum_ctx *sctx, const uchar *xnonce2s, uint32_t *roots, int count)
+{
+	struct stratum_job *job = &sctx->job;
+	const int len = (int) job->coinbase_size;
+	const int tail_len = len - job->coinbase_ms_len;
+	const int x2pos = (int) (job->xnonce2 - job->coinbase) - job->coinbase_ms_len;
+	const size_t buf_len = (size_t) count * (tail_len + 32);
+	uchar stack_buf[512];
+	uchar *tails = stack_buf, *hashes;
+
+	if (job->merkle_count && !job->merkle_be)
+		return false;
+	if (buf_len > sizeof(stack_buf))
+		tails = (uchar*) malloc(buf_len);
+	if (!tails)
+		return false;
+	hashes = tails + (size_t) count * tail_len;
+
+	for (int n = 0; n < count; n++) {
+		uchar *tail = tails + (size_t) n * tail_len;
+		memcpy(tail, job->coinbase + job->coinbase_ms_len, tail_len);
+		memcpy(tail + x2pos, xnonce2s + n * sctx->xnonce2_size, sctx->xnonce2_size);
+	}
+	sha256d_midstate_mb(hashes, job->coinbase_ms, tails, tail_len, len, count);
+
+	for (int n = 0; n < count; n++)
+		for (int i = 0; i < 8; i++)
+			roots[n * 8 + i] = be32dec(hashes + n * 32 + i * 4);
+	for (int i = 0; i < job->merkle_count; i++)
+		sha256d_merkle_mb(roots, &job->merkle_be[i * 8], count);
+
+	if (tails != stack_buf)
+		free(tails);
+	return true;
+}
+
 static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
 {
 	const char *job_id, *prevhash, *coinb1, *coinb2, *version, *nbits, *stime;
@@ -1559,6 +1861,7 @@ static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
 	free(sctx->job.merkle);
 	sctx->job.merkle = merkle;
 	sctx->job.merkle_count = merkle_count;
+	stratum_merkle_prepare(sctx);
 
 	hex2bin(sctx->job.version, version, 4);
 	hex2bin(sctx->job.nbits, nbits, 4);
@@ -1666,10 +1969,26 @@ static bool stratum_get_algo(struct stratum_ctx *sctx, json_t *id, json_t *param
 extern char driver_version[32];
 extern int cuda_arch[MAX_GPUS];
 
+// the verify threads also count the nonces of the miner threads
+static void gpu_counter_add(volatile uint32_t *counter, uint32_t n)
+{
+#ifdef _MSC_VER
+	InterlockedExchangeAdd((volatile LONG*) counter, (LONG) n);
+#else
+	__sync_fetch_and_add(counter, n);
+#endif
+}
+
+void gpu_increment_accept(int thr_id, uint32_t nonces)
+{
+	struct cgpu_info *gpu = &thr_info[thr_id].gpu;
+	gpu_counter_add((volatile uint32_t*) &gpu->accepted, nonces);
+}
+
 void gpu_increment_reject(int thr_id)
 {
 	struct cgpu_info *gpu = &thr_info[thr_id].gpu;
-	if (gpu) gpu->rejected++;
+	gpu_counter_add(&gpu->rejected, 1);
 }
 
 static bool json_object_set_error(json_t *result, int code, const char *msg)
@@ -2296,6 +2615,7 @@ void print_hash_tests(void)
 	printpfx("scrypt", hash);
 
 	scryptjane_hash(&hash[0], &buf[0]);
+	scryptjane_hash_free();
 	printpfx("scrypt-jane", hash);
 #endif
 	sha256d_hash(&hash[0], &buf[0]);
@@ -2390,3 +2710,86 @@ void print_hash_tests(void)
 
 	free(scratchbuf);
 }
+
+static void blakecoin_cpu_hash(void *output, const void *input) { blake256hash(output, input, 8); }
+static void blake_cpu_hash(void *output, const void *input) { blake256hash(output, input, 14); }
+static void bastion_cpu_hash(void *output, const void *input) {
+	bastionhash(output, (const unsigned char*) input);
+}
+static void fugue256_cpu_hash(void *output, const void *input) {
+	fugue256_hash((unsigned char*) output, (const unsigned char*) input, 80);
+}
+static void neoscrypt_cpu_hash(void *output, const void *input) {
+	neoscrypt((uchar*) output, (const uchar*) input, 0x80000620U);
+}
+
+/**
+ * Cpu hash of an 80 bytes block header (big endian words, as hashed by
+ * the scanhash functions to validate the gpu nonces). NULL for the algos
+ * using another header layout or an external context (scratchpad, rpc2)
+ */
+cpu_hash_fn algo_cpu_hash(int algo)
+{
+	switch (algo) {
+	case ALGO_ALLIUM:     return allium_hash;
+	case ALGO_BASTION:    return bastion_cpu_hash;
+	case ALGO_BITCORE:    return bitcore_hash;
+	case ALGO_BLAKE:      return blake_cpu_hash;
+	case ALGO_BLAKECOIN:
+	case ALGO_VANILLA:    return blakecoin_cpu_hash;
+	case ALGO_BLAKE2S:    return blake2s_hash;
+	case ALGO_BMW:        return bmw_hash;
+	case ALGO_C11:        return c11hash;
+	case ALGO_DEEP:       return deephash;
+	case ALGO_EXOSIS:     return exosis_hash;
+	case ALGO_FRESH:      return fresh_hash;
+	case ALGO_FUGUE256:   return fugue256_cpu_hash;
+	case ALGO_GROESTL:
+	case ALGO_DMD_GR:     return groestlhash;
+	case ALGO_HMQ1725:    return hmq17hash;
+	case ALGO_HSR:        return hsr_hash;
+	case ALGO_JACKPOT:    return jackpothash;
+	case ALGO_JHA:        return jha_hash;
+	case ALGO_KECCAK:     return keccak256_hash;
+	case ALGO_LUFFA:      return luffa_hash;
+	case ALGO_LYRA2:      return lyra2re_hash;
+	case ALGO_LYRA2v2:    return lyra2v2_hash;
+	case ALGO_LYRA2v3:    return lyra2v3_hash;
+	case ALGO_LYRA2Z:     return lyra2Z_hash;
+	case ALGO_MYR_GR:     return myriadhash;
+	case ALGO_NEOSCRYPT:  return neoscrypt_cpu_hash;
+	case ALGO_NIST5:      return nist5hash;
+	case ALGO_PENTABLAKE: return pentablakehash;
+	case ALGO_PHI:        return phi_hash;
+	case ALGO_POLYTIMOS:  return polytimos_hash;
+	case ALGO_QUARK:      return quarkhash;
+	case ALGO_QUBIT:      return qubithash;
+#ifndef ARM64
+	case ALGO_SCRYPT:     return scrypthash;
+#endif
+	case ALGO_SHA256D:    return sha256d_hash;
+	case ALGO_SHA256T:    return sha256t_hash;
+	case ALGO_SHA256Q:    return sha256q_hash;
+	case ALGO_SIB:        return sibhash;
+	case ALGO_SKEIN:      return skeincoinhash;
+	case ALGO_SKEIN2:     return skein2hash;
+	case ALGO_SKUNK:      return skunk_hash;
+	case ALGO_S3:         return s3hash;
+	case ALGO_TIMETRAVEL: return timetravel_hash;
+	case ALGO_TRIBUS:     return tribus_hash;
+	case ALGO_VELTOR:     return veltorhash;
+	case ALGO_WHIRLCOIN:
+	case ALGO_WHIRLPOOL:  return wcoinhash;
+	case ALGO_X11EVO:     return x11evo_hash;
+	case ALGO_X11:        return x11hash;
+	case ALGO_X12:        return x12hash;
+	case ALGO_X13:        return x13hash;
+	case ALGO_X14:        return x14hash;
+	case ALGO_X15:        return x15hash;
+	case ALGO_X16R:       return x16r_hash;
+	case ALGO_X16S:       return x16s_hash;
+	case ALGO_X17:        return x17hash;
+	default:
+		return NULL;
+	}
+}
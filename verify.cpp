@@ -0,0 +1,286 @@
+/**
+ * Background cpu verification of the gpu nonces (--verify-threads)
+ *
+ * The scanhash functions re-hash each candidate nonce with the cpu hash
+ * before the next kernel launch, so the gpu waits for the cpu, a long
+ * time with the memory hard algos. With --verify-threads the miner
+ * thread only pushes a (work snapshot, nonce) item in a bounded queue
+ * and launches the next batch. The workers check the nonce with the algo
+ * cpu hash, store the share diff and hand the valid ones to the submit
+ * path. When the queue is full, the caller verifies inline as before.
+ *
+ * On start, a valid and an invalid nonce are sent through the queue and
+ * the workers, so a broken pool is seen before the first gpu launch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "miner.h"
+#include "algos.h"
+
+int opt_verify_threads = 0;
+int opt_verify_queue = 64;
+
+#define VERIFY_TEST_MS 10000 /* max self test time, a memory hard hash */
+
+extern volatile bool abort_flag;
+
+struct verify_item {
+	int thr_id;
+	uint32_t nonce;
+	uint64_t tm_queued;
+	struct work work;
+};
+
+static struct verify_item *verify_ring = NULL;
+static int verify_head = 0;
+static int verify_count = 0;
+
+static pthread_mutex_t verify_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t verify_cond = PTHREAD_COND_INITIALIZER;
+
+static cpu_hash_fn verify_hash = NULL;
+static verify_result_fn verify_result = NULL;
+static bool verify_started = false;
+
+/* stats, under verify_lock */
+static uint32_t verify_valid = 0;
+static uint32_t verify_invalid = 0;
+static uint32_t verify_inline = 0; /* queue full */
+static int verify_depth_max = 0;
+static uint64_t verify_wait_us = 0;
+static uint64_t verify_hash_us = 0;
+static int verify_test_valid = 0;   /* self test items, thr_id -1 */
+static int verify_test_invalid = 0;
+
+static uint64_t verify_usecs()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void verify_check(struct verify_item *item)
+{
+	struct work *work = &item->work;
+	uint32_t _ALIGN(64) endiandata[20];
+	uint32_t _ALIGN(64) vhash[8];
+	uint64_t tm_start = verify_usecs();
+	bool valid;
+
+	for (int k = 0; k < 19; k++)
+		be32enc(&endiandata[k], work->data[k]);
+	be32enc(&endiandata[19], item->nonce);
+	verify_hash(vhash, endiandata);
+	valid = fulltest(vhash, work->target);
+
+	pthread_mutex_lock(&verify_lock);
+	if (item->thr_id < 0) {
+		if (valid) verify_test_valid++;
+		else verify_test_invalid++;
+		pthread_mutex_unlock(&verify_lock);
+		return;
+	}
+	verify_wait_us += tm_start - item->tm_queued;
+	verify_hash_us += verify_usecs() - tm_start;
+	if (valid) verify_valid++;
+	else verify_invalid++;
+	pthread_mutex_unlock(&verify_lock);
+
+	if (!valid) {
+		gpu_increment_reject(item->thr_id);
+		if (!opt_quiet)
+			gpulog(LOG_WARNING, item->thr_id, "result for %08x does not validate on CPU!", item->nonce);
+		return;
+	}
+
+	work->data[19] = item->nonce;
+	work->nonces[0] = item->nonce;
+	work->valid_nonces = 1;
+	work->submit_nonce_id = 0;
+	work_set_target_ratio(work, vhash);
+	if (!verify_result(item->thr_id, work))
+		applog(LOG_ERR, "verify: unable to submit the nonce %08x", item->nonce);
+}
+
+static void *verify_thread(void *userdata)
+{
+	struct verify_item *item = (struct verify_item*) aligned_calloc(sizeof(struct verify_item));
+
+	while (!abort_flag) {
+		pthread_mutex_lock(&verify_lock);
+		while (!verify_count && !abort_flag)
+			pthread_cond_wait(&verify_cond, &verify_lock);
+		if (abort_flag) {
+			pthread_mutex_unlock(&verify_lock);
+			break;
+		}
+		// the slot work (and its txs ref) moves to the local item
+		memcpy(item, &verify_ring[verify_head], sizeof(struct verify_item));
+		verify_ring[verify_head].work.txs = NULL;
+		verify_head = (verify_head + 1) % opt_verify_queue;
+		verify_count--;
+		pthread_mutex_unlock(&verify_lock);
+
+		verify_check(item);
+		work_free(&item->work);
+	}
+
+	aligned_free(item);
+	return NULL;
+}
+
+/* wait the self test items checked, false on timeout */
+static bool verify_test_wait(int items)
+{
+	for (int ms = 0; ms < VERIFY_TEST_MS; ms++) {
+		int done;
+		pthread_mutex_lock(&verify_lock);
+		done = verify_test_valid + verify_test_invalid;
+		pthread_mutex_unlock(&verify_lock);
+		if (done >= items)
+			return true;
+		usleep(1000);
+	}
+	return false;
+}
+
+/* an easy target nonce must reach the result path, an impossible one not */
+static bool verify_pool_test(void)
+{
+	struct work *work = (struct work*) aligned_calloc(sizeof(struct work));
+	bool ok = false;
+
+	if (!work)
+		return false;
+	for (int k = 0; k < 19; k++)
+		work->data[k] = 0x01010101U * k;
+
+	memset(work->target, 0xff, sizeof(work->target));
+	if (!verify_nonce_async(-1, work, 1) || !verify_test_wait(1))
+		goto out;
+	memset(work->target, 0, sizeof(work->target));
+	if (!verify_nonce_async(-1, work, 2) || !verify_test_wait(2))
+		goto out;
+	ok = true;
+out:
+	pthread_mutex_lock(&verify_lock);
+	ok = ok && verify_test_valid == 1 && verify_test_invalid == 1;
+	verify_depth_max = 0;
+	pthread_mutex_unlock(&verify_lock);
+	aligned_free(work);
+	return ok;
+}
+
+/* the cpu hash of these algos reads the hash order of the current ntime
+ * from a global, an item of an older job would be checked in a wrong order */
+static bool verify_algo_stateful(int algo)
+{
+	switch (algo) {
+	case ALGO_BITCORE:
+	case ALGO_EXOSIS:
+	case ALGO_TIMETRAVEL:
+	case ALGO_X11EVO:
+		return true;
+	}
+	return false;
+}
+
+/* start the workers, result is called by them with each valid nonce work */
+bool verify_pool_start(verify_result_fn result)
+{
+	pthread_t pth;
+
+	if (opt_verify_threads <= 0)
+		return true;
+
+	verify_hash = verify_algo_stateful(opt_algo) ? NULL : algo_cpu_hash(opt_algo);
+	if (!verify_hash) {
+		applog(LOG_WARNING, "No background verification with the %s algo, nonces are checked inline",
+			algo_names[opt_algo]);
+		return true;
+	}
+
+	verify_ring = (struct verify_item*) aligned_calloc(sizeof(struct verify_item) * opt_verify_queue);
+	if (!verify_ring)
+		return false;
+	verify_result = result;
+
+	for (int i = 0; i < opt_verify_threads; i++) {
+		if (pthread_create(&pth, NULL, verify_thread, NULL)) {
+			applog(LOG_ERR, "verify thread %d create failed", i);
+			return i > 0;
+		}
+		pthread_detach(pth);
+		verify_started = true;
+	}
+
+	if (!verify_pool_test()) {
+		applog(LOG_ERR, "verify: the self test of the %s cpu hash queue failed", algo_names[opt_algo]);
+		verify_started = false;
+		return false;
+	}
+
+	if (!opt_quiet)
+		applog(LOG_INFO, "%d cpu verification threads, queue of %d nonces",
+			opt_verify_threads, opt_verify_queue);
+	return true;
+}
+
+/* queue a candidate nonce of the work, false if the caller must verify it */
+bool verify_nonce_async(int thr_id, const struct work *work, uint32_t nonce)
+{
+	struct verify_item *item;
+
+	if (!verify_started)
+		return false;
+
+	pthread_mutex_lock(&verify_lock);
+	if (verify_count >= opt_verify_queue) {
+		verify_inline++;
+		pthread_mutex_unlock(&verify_lock);
+		return false;
+	}
+	item = &verify_ring[(verify_head + verify_count) % opt_verify_queue];
+	item->thr_id = thr_id;
+	item->nonce = nonce;
+	item->tm_queued = verify_usecs();
+	work_copy(&item->work, work);
+	verify_count++;
+	if (verify_count > verify_depth_max)
+		verify_depth_max = verify_count;
+	pthread_cond_signal(&verify_cond);
+	pthread_mutex_unlock(&verify_lock);
+	return true;
+}
+
+/* wake the workers waiting for an item, abort_flag is already set */
+void verify_pool_stop(void)
+{
+	if (!verify_started)
+		return;
+
+	pthread_mutex_lock(&verify_lock);
+	pthread_cond_broadcast(&verify_cond);
+	pthread_mutex_unlock(&verify_lock);
+}
+
+void verify_pool_report(void)
+{
+	uint32_t total;
+
+	if (!verify_started)
+		return;
+
+	pthread_mutex_lock(&verify_lock);
+	total = verify_valid + verify_invalid;
+	applog(LOG_INFO, "verify: %u nonces checked, %u invalid, %u verified inline (queue full), max depth %d",
+		total, verify_invalid, verify_inline, verify_depth_max);
+	if (total)
+		applog(LOG_INFO, "verify: average %u us in queue, %u us to hash",
+			(uint32_t) (verify_wait_us / total), (uint32_t) (verify_hash_us / total));
+	pthread_mutex_unlock(&verify_lock);
+}
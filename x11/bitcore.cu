@@ -128,24 +128,12 @@ static void get_travel_order(uint32_t ntime, char *permstr)
 	}
 }
 
+static __thread struct hash_chain s_chain;
+
 // CPU Hash
 extern "C" void bitcore_hash(void *output, const void *input)
 {
-	uint32_t _ALIGN(64) hash[64/4] = { 0 };
-
-	sph_blake512_context     ctx_blake;
-	sph_bmw512_context       ctx_bmw;
-	sph_groestl512_context   ctx_groestl;
-	sph_skein512_context     ctx_skein;
-	sph_jh512_context        ctx_jh;
-	sph_keccak512_context    ctx_keccak;
-	sph_luffa512_context     ctx_luffa1;
-	sph_cubehash512_context  ctx_cubehash1;
-	sph_shavite512_context   ctx_shavite1;
-	sph_simd512_context      ctx_simd1;
-#if HASH_FUNC_COUNT > 10
-	sph_echo512_context      ctx_echo1;
-#endif
+	uint32_t _ALIGN(64) hash[64/4];
 
 	if (s_sequence == UINT32_MAX) {
 		uint32_t *data = (uint32_t*) input;
@@ -153,82 +141,11 @@ extern "C" void bitcore_hash(void *output, const void *input)
 		get_travel_order(ntime, hashOrder);
 	}
 
-	void *in = (void*) input;
-	int size = 80;
-
-	const int hashes = (int) strlen(hashOrder);
-
-	for (int i = 0; i < hashes; i++)
-	{
-		const char elem = hashOrder[i];
-		uint8_t algo = elem >= 'A' ? elem - 'A' + 10 : elem - '0';
-
-		if (i > 0) {
-			in = (void*) hash;
-			size = 64;
-		}
-
-		switch (algo) {
-		case BLAKE:
-			sph_blake512_init(&ctx_blake);
-			sph_blake512(&ctx_blake, in, size);
-			sph_blake512_close(&ctx_blake, hash);
-			break;
-		case BMW:
-			sph_bmw512_init(&ctx_bmw);
-			sph_bmw512(&ctx_bmw, in, size);
-			sph_bmw512_close(&ctx_bmw, hash);
-			break;
-		case GROESTL:
-			sph_groestl512_init(&ctx_groestl);
-			sph_groestl512(&ctx_groestl, in, size);
-			sph_groestl512_close(&ctx_groestl, hash);
-			break;
-		case SKEIN:
-			sph_skein512_init(&ctx_skein);
-			sph_skein512(&ctx_skein, in, size);
-			sph_skein512_close(&ctx_skein, hash);
-			break;
-		case JH:
-			sph_jh512_init(&ctx_jh);
-			sph_jh512(&ctx_jh, in, size);
-			sph_jh512_close(&ctx_jh, hash);
-			break;
-		case KECCAK:
-			sph_keccak512_init(&ctx_keccak);
-			sph_keccak512(&ctx_keccak, in, size);
-			sph_keccak512_close(&ctx_keccak, hash);
-			break;
-		case LUFFA:
-			sph_luffa512_init(&ctx_luffa1);
-			sph_luffa512(&ctx_luffa1, in, size);
-			sph_luffa512_close(&ctx_luffa1, hash);
-			break;
-		case CUBEHASH:
-			sph_cubehash512_init(&ctx_cubehash1);
-			sph_cubehash512(&ctx_cubehash1, in, size);
-			sph_cubehash512_close(&ctx_cubehash1, hash);
-			break;
-		case SHAVITE:
-			sph_shavite512_init(&ctx_shavite1);
-			sph_shavite512(&ctx_shavite1, in, size);
-			sph_shavite512_close(&ctx_shavite1, hash);
-			break;
-		case SIMD:
-			sph_simd512_init(&ctx_simd1);
-			sph_simd512(&ctx_simd1, in, size);
-			sph_simd512_close(&ctx_simd1, hash);
-			break;
-#if HASH_FUNC_COUNT > 10
-		case ECHO:
-			sph_echo512_init(&ctx_echo1);
-			sph_echo512(&ctx_echo1, in, size);
-			sph_echo512_close(&ctx_echo1, hash);
-			break;
-#endif
-		}
-	}
+	// the enum of the algo matches the chain ids
+	if (!s_chain.count || s_chain.key != s_sequence)
+		hash_chain_compile(&s_chain, s_sequence, hashOrder, NULL);
 
+	hash_chain_hash(&s_chain, hash, input, 80);
 	memcpy(output, hash, 32);
 }
 
@@ -3,6 +3,7 @@ extern "C" {
 #include "sph/sph_shavite.h"
 #include "sph/sph_shabal.h"
 #include "sph/sph_streebog.h"
+#include "sph/sph_midstate.h"
 }
 
 #include "miner.h"
@@ -29,6 +30,8 @@ extern void skunk_cuda_streebog(int thr_id, uint32_t threads, uint32_t *d_hash,
 static uint32_t *d_hash[MAX_GPUS];
 static uint32_t *d_resNonce[MAX_GPUS];
 
+static __thread sph_midstate80 s_midstate;
+
 // veltor CPU Hash
 extern "C" void veltorhash(void *output, const void *input)
 {
@@ -39,8 +42,7 @@ extern "C" void veltorhash(void *output, const void *input)
 	sph_shabal512_context ctx_shabal;
 	sph_shavite512_context ctx_shavite;
 
-	sph_skein512_init(&ctx_skein);
-	sph_skein512(&ctx_skein, input, 80);
+	SPH_MIDSTATE80(&s_midstate, skein512, &ctx_skein, input);
 	sph_skein512_close(&ctx_skein, (void*) hash);
 
 	sph_shavite512_init(&ctx_shavite);
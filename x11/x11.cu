@@ -174,6 +174,26 @@ extern "C" int scanhash_x11(int thr_id, struct work* work, uint32_t max_nonce, u
 		{
 			const uint32_t Htarg = ptarget[7];
 			uint32_t _ALIGN(64) vhash[8];
+			if (verify_nonce_async(thr_id, work, work->nonces[0])) {
+				// the cpu threads check it, launch the next batch
+				uint32_t nonce2 = cuda_check_hash_suppl(thr_id, throughput, pdata[19], d_hash[thr_id], 1);
+				pdata[19] = max(work->nonces[0], nonce2) + 1;
+				if (!nonce2 || verify_nonce_async(thr_id, work, nonce2))
+					continue;
+				// queue full, the second one is checked here
+				be32enc(&endiandata[19], nonce2);
+				x11hash(vhash, endiandata);
+				if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
+					work->nonces[0] = nonce2;
+					work->valid_nonces = 1;
+					bn_set_target_ratio(work, vhash, 0);
+					return work->valid_nonces;
+				}
+				gpu_increment_reject(thr_id);
+				if (!opt_quiet)
+				gpulog(LOG_WARNING, thr_id, "result for %08x does not validate on CPU!", nonce2);
+				continue;
+			}
 			be32enc(&endiandata[19], work->nonces[0]);
 			x11hash(vhash, endiandata);
 
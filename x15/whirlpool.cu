@@ -3,6 +3,7 @@
  */
 extern "C" {
 #include <sph/sph_whirlpool.h>
+#include <sph/sph_midstate.h>
 #include <miner.h>
 }
 
@@ -28,6 +29,7 @@ extern void whirlpool512_setBlock_80(void *pdata, const void *ptarget);
 extern void whirlpool512_cpu_hash_80(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *resNonces, const uint64_t target);
 #endif
 
+static __thread sph_midstate80 s_midstate;
 
 // CPU Hash function
 extern "C" void wcoinhash(void *state, const void *input)
@@ -39,8 +41,7 @@ extern "C" void wcoinhash(void *state, const void *input)
 
 	memset(hash, 0, sizeof hash);
 
-	sph_whirlpool1_init(&ctx_whirlpool);
-	sph_whirlpool1(&ctx_whirlpool, input, 80);
+	SPH_MIDSTATE80(&s_midstate, whirlpool1, &ctx_whirlpool, input);
 	sph_whirlpool1_close(&ctx_whirlpool, hash);
 
 	sph_whirlpool1_init(&ctx_whirlpool);
@@ -4,6 +4,7 @@
  */
 extern "C" {
 #include "sph/sph_whirlpool.h"
+#include "sph/sph_midstate.h"
 }
 
 #include "miner.h"
@@ -17,6 +18,8 @@ extern void whirlpoolx_setBlock_80(void *pdata, const void *ptarget);
 extern uint32_t whirlpoolx_cpu_hash(int thr_id, uint32_t threads, uint32_t startNounce);
 extern void whirlpoolx_precompute(int thr_id);
 
+static __thread sph_midstate80 s_midstate;
+
 // CPU Hash function
 extern "C" void whirlxHash(void *state, const void *input)
 {
@@ -25,8 +28,7 @@ extern "C" void whirlxHash(void *state, const void *input)
 	unsigned char hash[64];
 	unsigned char hash_xored[32];
 
-	sph_whirlpool_init(&ctx_whirlpool);
-	sph_whirlpool(&ctx_whirlpool, input, 80);
+	SPH_MIDSTATE80(&s_midstate, whirlpool, &ctx_whirlpool, input);
 	sph_whirlpool_close(&ctx_whirlpool, hash);
 
 	// compress the 48 first bytes of the hash to 32
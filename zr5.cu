@@ -6,6 +6,7 @@ extern "C" {
 #include "sph/sph_skein.h"
 #include "sph/sph_jh.h"
 #include "sph/sph_keccak.h"
+#include "sph/sph_midstate.h"
 }
 
 #include "miner.h"
@@ -64,6 +65,8 @@ static const uint8_t permut[24][4] = {
 	{3, 2, 1, 0}
 };
 
+static __thread sph_midstate80 s_midstate;
+
 // CPU HASH
 extern "C" void zr5hash(void *output, const void *input)
 {
@@ -77,8 +80,7 @@ extern "C" void zr5hash(void *output, const void *input)
 	uint32_t *phash = (uint32_t *) hash;
 	uint32_t norder;
 
-	sph_keccak512_init(&ctx_keccak);
-	sph_keccak512(&ctx_keccak, (const void*) input, 80);
+	SPH_MIDSTATE80(&s_midstate, keccak512, &ctx_keccak, input);
 	sph_keccak512_close(&ctx_keccak, (void*) phash);
 
 	norder = phash[0] % ARRAY_SIZE(permut); /* % 24 */
@@ -254,7 +256,7 @@ void zr5_get_poks(int thr_id, uint32_t threads, uint16_t* d_poks, struct work* w
 
 	uint8_t txs = (uint8_t) work->tx_count;
 
-	if (txs && use_pok)
+	if (txs && use_pok && work->txs)
 	{
 		uint32_t txlens[POK_MAX_TXS];
 		uint8_t* txdata = (uint8_t*) calloc(POK_MAX_TXS, POK_MAX_TX_SZ);
@@ -264,8 +266,8 @@ void zr5_get_poks(int thr_id, uint32_t threads, uint16_t* d_poks, struct work* w
 		}
 		// create blocs to copy on device
 		for (uint8_t tx=0; tx < txs; tx++) {
-			txlens[tx] = (uint32_t) (work->txs[tx].len - 3U);
-			memcpy(&txdata[POK_MAX_TX_SZ*tx], work->txs[tx].data, min(POK_MAX_TX_SZ, txlens[tx]+3U));
+			txlens[tx] = (uint32_t) (work->txs->tx[tx].len - 3U);
+			memcpy(&txdata[POK_MAX_TX_SZ*tx], work->txs->tx[tx].data, min(POK_MAX_TX_SZ, txlens[tx]+3U));
 		}
 		cudaMemcpy(d_txs[thr_id], txdata, txs * POK_MAX_TX_SZ, cudaMemcpyHostToDevice);
 		CUDA_SAFE_CALL(cudaMemcpyToSymbol(c_txlens, txlens, txs * sizeof(uint32_t), 0, cudaMemcpyHostToDevice));